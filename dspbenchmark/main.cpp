@@ -0,0 +1,452 @@
+/*
+  ==============================================================================
+
+    main.cpp
+    Created: 16 Oct 2026
+
+    A standalone driver for the realtime parts of libzynthbox which do not need
+    jack (the sampler voice and grain rendering, the passthrough and track dsp,
+    midi input merging, and step delivery), which runs them over synthetic data,
+    and prints how long they take per frame for a few common buffer sizes.
+    Build it by turning on the BUILD_DSP_BENCHMARK cmake option, and run it on
+    the device you care about (ideally with nothing else going on).
+
+  ==============================================================================
+*/
+
+#include "Compressor.h"
+#include "GraineratorGrainRendering.h"
+#include "LockFreeRing.h"
+#include "MidiInputMerger.h"
+#include "SamplerSynthVoiceRendering.h"
+#include "StereoBiquadCascade.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+static constexpr double sampleRate{48000};
+// How much audio to run through each measurement (after a short warmup)
+static constexpr double measuredSeconds{10};
+static constexpr double warmupSeconds{1};
+static const int bufferSizes[]{64, 128, 256};
+
+/**
+ * \brief Run the given block processing function over the given number of seconds' worth of blocks, and print the cost per frame
+ * @param name The name to print alongside the results
+ * @param bufferSize The number of frames in each block
+ * @param processBlock The function which processes a single block of audio
+ */
+static void measure(const char *name, const int bufferSize, const std::function<void()> &processBlock)
+{
+    const int warmupBlocks{int(warmupSeconds * sampleRate / bufferSize)};
+    for (int block = 0; block < warmupBlocks; ++block) {
+        processBlock();
+    }
+    const int measuredBlocks{int(measuredSeconds * sampleRate / bufferSize)};
+    double totalNanoseconds{0};
+    double worstNanoseconds{0};
+    for (int block = 0; block < measuredBlocks; ++block) {
+        const auto start{std::chrono::steady_clock::now()};
+        processBlock();
+        const double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        totalNanoseconds += nanoseconds;
+        worstNanoseconds = std::max(worstNanoseconds, nanoseconds);
+    }
+    const double nanosecondsPerFrame{totalNanoseconds / (double(measuredBlocks) * bufferSize)};
+    // How many of these would fit on one core running in realtime (if nothing else was going on)
+    const double instancesPerCore{1.0e9 / (nanosecondsPerFrame * sampleRate)};
+    printf("%-28s %4d frames: %8.2f ns/frame average, %8.2f ns/frame worst, %8.1f instances per core\n", name, bufferSize, nanosecondsPerFrame, worstNanoseconds / bufferSize, instancesPerCore);
+}
+
+/**
+ * \brief Fill the given buffers with a couple of seconds of a detuned pair of sines with a bit of noise on top
+ */
+static void fillSyntheticAudio(std::vector<float> &left, std::vector<float> &right)
+{
+    juce::Random random(1);
+    for (std::size_t frame = 0; frame < left.size(); ++frame) {
+        const double time{double(frame) / sampleRate};
+        left[frame] = float(0.4 * std::sin(2.0 * M_PI * 220.0 * time) + 0.05 * (random.nextFloat() - 0.5f));
+        right[frame] = float(0.4 * std::sin(2.0 * M_PI * 220.5 * time) + 0.05 * (random.nextFloat() - 0.5f));
+    }
+}
+
+/**
+ * \brief Render a single pitched, looping voice the way SamplerSynthVoice::process() does
+ * That is: per-frame Hermite interpolation, envelope and gain, followed by the vectorised amplitude, pan, and mix stage,
+ * in sub-blocks of at most SamplerSynthVoiceRendering::SubBlockSize frames
+ */
+static void measureSamplerSynthVoice(const int bufferSize)
+{
+    std::vector<float> sampleLeft(size_t(2 * sampleRate)), sampleRight(size_t(2 * sampleRate));
+    fillSyntheticAudio(sampleLeft, sampleRight);
+    const int sampleDuration{int(sampleLeft.size()) - 1};
+    std::vector<float> outputLeft(size_t(bufferSize)), outputRight(size_t(bufferSize));
+    alignas(16) float subBlockLeft[SamplerSynthVoiceRendering::SubBlockSize];
+    alignas(16) float subBlockRight[SamplerSynthVoiceRendering::SubBlockSize];
+    alignas(16) float subBlockAmplitude[SamplerSynthVoiceRendering::SubBlockSize];
+    alignas(16) float subBlockPannedLeft[SamplerSynthVoiceRendering::SubBlockSize];
+    alignas(16) float subBlockPannedRight[SamplerSynthVoiceRendering::SubBlockSize];
+    juce::ADSR adsr;
+    adsr.setSampleRate(sampleRate);
+    adsr.setParameters({0.01f, 0.1f, 1.0f, 0.2f});
+    adsr.noteOn();
+    // A semitone up, so every frame goes through the interpolation (as it does for any pitched playback)
+    const double pitchRatio{std::pow(2.0, 1.0 / 12.0)};
+    const float gain{0.8f};
+    const float clipGain{0.9f};
+    const float pan{0.25f};
+    const float lPan = 0.5f * (1.0f + std::max(-1.0f, pan));
+    const float rPan = 0.5f * (1.0f - std::max(0.0f, pan));
+    double sourceSamplePosition{0};
+    measure("SamplerSynthVoice", bufferSize, [&](){
+        std::fill(outputLeft.begin(), outputLeft.end(), 0.0f);
+        std::fill(outputRight.begin(), outputRight.end(), 0.0f);
+        float peakLeft{0.0f}, peakRight{0.0f};
+        int frame{0};
+        while (frame < bufferSize) {
+            const int subBlockEnd{std::min(bufferSize, frame + SamplerSynthVoiceRendering::SubBlockSize)};
+            int renderedFrames{0};
+            for (int subBlockFrame = frame; subBlockFrame < subBlockEnd; ++subBlockFrame) {
+                const int sampleIndex{int(sourceSamplePosition)};
+                double modIntegral{0};
+                const float fraction = float(std::modf(sourceSamplePosition, &modIntegral));
+                const int previousSampleIndex{sampleIndex - 1};
+                const int nextSampleIndex{sampleIndex + 1 > sampleDuration ? -1 : sampleIndex + 1};
+                const int nextNextSampleIndex{sampleIndex + 2 > sampleDuration ? -1 : sampleIndex + 2};
+                subBlockLeft[renderedFrames] = SamplerSynthVoiceRendering::interpolatedSample(sampleLeft.data(), sampleDuration, previousSampleIndex, sampleIndex, nextSampleIndex, nextNextSampleIndex, fraction);
+                subBlockRight[renderedFrames] = SamplerSynthVoiceRendering::interpolatedSample(sampleRight.data(), sampleDuration, previousSampleIndex, sampleIndex, nextSampleIndex, nextNextSampleIndex, fraction);
+                subBlockAmplitude[renderedFrames] = gain * adsr.getNextSample() * clipGain;
+                ++renderedFrames;
+                sourceSamplePosition += pitchRatio;
+                if (sourceSamplePosition >= sampleDuration) {
+                    sourceSamplePosition = 1;
+                }
+            }
+            SamplerSynthVoiceRendering::amplifyPanAndMix(subBlockLeft, subBlockRight, subBlockAmplitude, lPan, rPan, subBlockPannedLeft, subBlockPannedRight, outputLeft.data() + frame, outputRight.data() + frame, renderedFrames, peakLeft, peakRight);
+            frame = subBlockEnd;
+        }
+    });
+}
+
+/**
+ * \brief Run the equaliser the way JackPassthrough does, with all six bands enabled
+ */
+static void measureEqualiser(const int bufferSize)
+{
+    std::vector<float> sourceLeft(size_t(sampleRate)), sourceRight(size_t(sampleRate));
+    fillSyntheticAudio(sourceLeft, sourceRight);
+    std::vector<float> left(size_t(bufferSize)), right(size_t(bufferSize));
+    StereoBiquadCascade filterChain;
+    const double frequencies[StereoBiquadCascade::BandCount]{80, 250, 800, 2500, 6000, 12000};
+    for (int band = 0; band < StereoBiquadCascade::BandCount; ++band) {
+        const auto coefficients = juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate, frequencies[band], 0.7f, band % 2 == 0 ? 1.5f : 0.7f);
+        std::copy(coefficients->getRawCoefficients(), coefficients->getRawCoefficients() + 5, filterChain.coefficients(band));
+        filterChain.setBandEnabled(band, true);
+    }
+    std::size_t sourcePosition{0};
+    measure("JackPassthrough equaliser", bufferSize, [&](){
+        if (sourcePosition + std::size_t(bufferSize) > sourceLeft.size()) {
+            sourcePosition = 0;
+        }
+        std::copy(sourceLeft.begin() + long(sourcePosition), sourceLeft.begin() + long(sourcePosition) + bufferSize, left.begin());
+        std::copy(sourceRight.begin() + long(sourcePosition), sourceRight.begin() + long(sourcePosition) + bufferSize, right.begin());
+        sourcePosition += std::size_t(bufferSize);
+        filterChain.process(left.data(), right.data(), bufferSize);
+    });
+}
+
+/**
+ * \brief Run the compressor the way JackPassthrough does, using the input as its own sidechain
+ */
+static void measureCompressor(const int bufferSize)
+{
+    std::vector<float> sourceLeft(size_t(sampleRate)), sourceRight(size_t(sampleRate));
+    fillSyntheticAudio(sourceLeft, sourceRight);
+    std::vector<float> buffers[2]{std::vector<float>(size_t(bufferSize)), std::vector<float>(size_t(bufferSize))};
+    std::vector<float> sideChainGain[2]{std::vector<float>(size_t(bufferSize)), std::vector<float>(size_t(bufferSize))};
+    iem::Compressor compressors[2];
+    for (iem::Compressor &compressor : compressors) {
+        compressor.prepare({sampleRate, juce::uint32(bufferSize), 1});
+        compressor.setThreshold(-20.0f);
+        compressor.setRatio(4.0f);
+        compressor.setKnee(6.0f);
+        compressor.setAttackTime(0.01f);
+        compressor.setReleaseTime(0.15f);
+        compressor.setMakeUpGain(3.0f);
+    }
+    std::size_t sourcePosition{0};
+    measure("JackPassthrough compressor", bufferSize, [&](){
+        if (sourcePosition + std::size_t(bufferSize) > sourceLeft.size()) {
+            sourcePosition = 0;
+        }
+        std::copy(sourceLeft.begin() + long(sourcePosition), sourceLeft.begin() + long(sourcePosition) + bufferSize, buffers[0].begin());
+        std::copy(sourceRight.begin() + long(sourcePosition), sourceRight.begin() + long(sourcePosition) + bufferSize, buffers[1].begin());
+        sourcePosition += std::size_t(bufferSize);
+        for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
+            compressors[channelIndex].getGainFromSidechainSignal(buffers[channelIndex].data(), sideChainGain[channelIndex].data(), bufferSize);
+            juce::FloatVectorOperations::multiply(buffers[channelIndex].data(), sideChainGain[channelIndex].data(), bufferSize);
+        }
+    });
+}
+
+/**
+ * \brief Render a Grainerator voice's worth of overlapping grains the way Grainerator::render() does
+ * A new grain is spawned every 10ms, each lasting 80ms at a slightly varying pitch and pan, so there are usually eight
+ * grains playing at once (which is around what the default settings end up with)
+ */
+static void measureGrainerator(const int bufferSize)
+{
+    std::vector<float> sampleLeft(size_t(2 * sampleRate)), sampleRight(size_t(2 * sampleRate));
+    fillSyntheticAudio(sampleLeft, sampleRight);
+    std::vector<float> outputLeft(size_t(bufferSize)), outputRight(size_t(bufferSize));
+    constexpr int grainCount{16};
+    GraineratorGrainPlayback grains[grainCount];
+    bool grainActive[grainCount]{};
+    const int framesBetweenGrains{int(0.01 * sampleRate)};
+    const double grainDuration{0.08};
+    const juce::ADSR::Parameters window{0.02f, 0.0f, 1.0f, 0.02f};
+    juce::Random random(1);
+    int framesUntilNextGrain{0};
+    measure("Grainerator", bufferSize, [&](){
+        std::fill(outputLeft.begin(), outputLeft.end(), 0.0f);
+        std::fill(outputRight.begin(), outputRight.end(), 0.0f);
+        // Spawn any grains which start during this block (they start at the beginning of it, which makes no difference to the cost)
+        framesUntilNextGrain -= bufferSize;
+        while (framesUntilNextGrain <= 0) {
+            framesUntilNextGrain += framesBetweenGrains;
+            for (int grainIndex = 0; grainIndex < grainCount; ++grainIndex) {
+                if (grainActive[grainIndex] == false) {
+                    GraineratorGrainPlayback &grain = grains[grainIndex];
+                    grain.inL = sampleLeft.data();
+                    grain.inR = sampleRight.data();
+                    grain.sampleDuration = int(sampleLeft.size());
+                    grain.increment = 0.9 + 0.2 * random.nextDouble();
+                    grain.sourcePosition = random.nextDouble() * (sampleRate / 2);
+                    grain.totalFrames = uint32_t(grainDuration * sampleRate);
+                    grain.framesRendered = 0;
+                    grain.window.reset();
+                    grain.window.setSampleRate(sampleRate);
+                    grain.window.setParameters(window);
+                    grain.window.noteOn();
+                    grain.releaseFrame = grain.totalFrames - uint32_t(window.release * sampleRate);
+                    const float pan{random.nextFloat() - 0.5f};
+                    const float lPan = 0.5f * (1.0f + std::max(-1.0f, pan));
+                    const float rPan = 0.5f * (1.0f - std::max(0.0f, pan));
+                    grain.leftFromLeft = 0.5f * (lPan + 1.0f);
+                    grain.leftFromRight = 0.5f * (lPan - 1.0f);
+                    grain.rightFromLeft = 0.5f * (rPan - 1.0f);
+                    grain.rightFromRight = 0.5f * (rPan + 1.0f);
+                    grainActive[grainIndex] = true;
+                    break;
+                }
+            }
+        }
+        for (int grainIndex = 0; grainIndex < grainCount; ++grainIndex) {
+            if (grainActive[grainIndex]) {
+                float windowValue{0};
+                if (grains[grainIndex].render(outputLeft.data(), outputRight.data(), 0, uint32_t(bufferSize), windowValue)) {
+                    grainActive[grainIndex] = false;
+                }
+            }
+        }
+    });
+}
+
+/**
+ * \brief Run a track's audio through the stages AudioLevelsChannel::process() does
+ * That is: gain and pan into the output buffers, peak analysis, and then the equaliser and compressor (with all six
+ * bands enabled, and the compressor using the input as its own sidechain)
+ */
+static void measureAudioLevelsChannel(const int bufferSize)
+{
+    std::vector<float> sourceLeft(size_t(sampleRate)), sourceRight(size_t(sampleRate));
+    fillSyntheticAudio(sourceLeft, sourceRight);
+    std::vector<float> outputs[2]{std::vector<float>(size_t(bufferSize)), std::vector<float>(size_t(bufferSize))};
+    std::vector<float> sideChainGain[2]{std::vector<float>(size_t(bufferSize)), std::vector<float>(size_t(bufferSize))};
+    StereoBiquadCascade filterChain;
+    const double frequencies[StereoBiquadCascade::BandCount]{80, 250, 800, 2500, 6000, 12000};
+    for (int band = 0; band < StereoBiquadCascade::BandCount; ++band) {
+        const auto coefficients = juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate, frequencies[band], 0.7f, band % 2 == 0 ? 1.5f : 0.7f);
+        std::copy(coefficients->getRawCoefficients(), coefficients->getRawCoefficients() + 5, filterChain.coefficients(band));
+        filterChain.setBandEnabled(band, true);
+    }
+    iem::Compressor compressors[2];
+    for (iem::Compressor &compressor : compressors) {
+        compressor.prepare({sampleRate, juce::uint32(bufferSize), 1});
+        compressor.setThreshold(-20.0f);
+        compressor.setRatio(4.0f);
+        compressor.setKnee(6.0f);
+        compressor.setAttackTime(0.01f);
+        compressor.setReleaseTime(0.15f);
+        compressor.setMakeUpGain(3.0f);
+    }
+    const float gainAmount{0.8f};
+    const float panAmount{0.25f};
+    float peaks[2]{0.0f, 0.0f};
+    std::size_t sourcePosition{0};
+    measure("AudioLevelsChannel", bufferSize, [&](){
+        if (sourcePosition + std::size_t(bufferSize) > sourceLeft.size()) {
+            sourcePosition = 0;
+        }
+        const float *inputs[2]{sourceLeft.data() + sourcePosition, sourceRight.data() + sourcePosition};
+        sourcePosition += std::size_t(bufferSize);
+        const float amounts[2]{gainAmount * std::min(1 - panAmount, 1.0f), gainAmount * std::min(1 + panAmount, 1.0f)};
+        const float fadeForPeriod{0.0001f * float(bufferSize)};
+        for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
+            juce::FloatVectorOperations::multiply(outputs[channelIndex].data(), inputs[channelIndex], amounts[channelIndex], bufferSize);
+            const auto channelPeaks = juce::FloatVectorOperations::findMinAndMax(outputs[channelIndex].data(), bufferSize);
+            const float peak{std::min(1.0f, std::max(std::abs(channelPeaks.getStart()), std::abs(channelPeaks.getEnd())))};
+            peaks[channelIndex] = std::max(peak, peaks[channelIndex] - fadeForPeriod);
+        }
+        filterChain.process(outputs[0].data(), outputs[1].data(), bufferSize);
+        for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
+            compressors[channelIndex].getGainFromSidechainSignal(outputs[channelIndex].data(), sideChainGain[channelIndex].data(), bufferSize);
+            juce::FloatVectorOperations::multiply(outputs[channelIndex].data(), sideChainGain[channelIndex].data(), bufferSize);
+        }
+    });
+}
+
+/**
+ * \brief A stand-in for MidiRouterDevice, holding a block's worth of input events, handed out in order
+ */
+struct BenchmarkMidiInput {
+    struct Event {
+        uint32_t time{0};
+        size_t size{0};
+        unsigned char buffer[3]{0, 0, 0};
+    };
+    std::vector<Event> events;
+    std::size_t nextEvent{0};
+    Event currentInputEvent;
+    void processBegin() {
+        nextEvent = 0;
+        nextInputEvent();
+    }
+    void nextInputEvent() {
+        if (nextEvent < events.size()) {
+            currentInputEvent = events[nextEvent];
+            ++nextEvent;
+        } else {
+            currentInputEvent.size = 0;
+        }
+    }
+};
+
+/**
+ * \brief Merge the events from a number of inputs the way MidiRouterPrivate::process() does
+ * Eight inputs each have a note on and off, and a controller change, every 64 frames, which are picked off in time
+ * order through the router's input merger, and written into an output buffer
+ */
+static void measureMidiRouter(const int bufferSize)
+{
+    constexpr int inputCount{8};
+    std::vector<BenchmarkMidiInput> inputs(inputCount);
+    std::vector<BenchmarkMidiInput*> enabledInputs;
+    for (int inputIndex = 0; inputIndex < inputCount; ++inputIndex) {
+        BenchmarkMidiInput &input = inputs[size_t(inputIndex)];
+        for (int frame = inputIndex; frame < bufferSize; frame += 64) {
+            const unsigned char channel{static_cast<unsigned char>(inputIndex)};
+            input.events.push_back({uint32_t(frame), 3, {static_cast<unsigned char>(0x90 | channel), 60, 100}});
+            input.events.push_back({uint32_t(frame), 3, {static_cast<unsigned char>(0xB0 | channel), 74, 64}});
+            input.events.push_back({uint32_t(frame + 32), 3, {static_cast<unsigned char>(0x80 | channel), 60, 0}});
+        }
+        enabledInputs.push_back(&input);
+    }
+    MidiInputMerger<BenchmarkMidiInput> inputMerger;
+    std::vector<unsigned char> output(size_t(bufferSize) * inputCount * 16);
+    int channelEvents[16]{};
+    measure("MidiRouter", bufferSize, [&](){
+        for (BenchmarkMidiInput *input : enabledInputs) {
+            input->processBegin();
+        }
+        std::size_t outputPosition{0};
+        inputMerger.reset(enabledInputs);
+        while (BenchmarkMidiInput *eventDevice = inputMerger.top()) {
+            const BenchmarkMidiInput::Event &event = eventDevice->currentInputEvent;
+            const unsigned char byte0{event.buffer[0]};
+            if (0x7F < byte0 && byte0 < 0xF0) {
+                ++channelEvents[byte0 & 0xf];
+            }
+            std::copy(event.buffer, event.buffer + event.size, output.begin() + long(outputPosition));
+            outputPosition += event.size;
+            eventDevice->nextInputEvent();
+            inputMerger.advanceTop();
+        }
+    });
+}
+
+/**
+ * \brief Send out steps the way SyncTimerPrivate::process() does
+ * At 120bpm, a step every 250 frames, each holding a note on and off for four of the tracks, along with the step
+ * content being taken from, and handed back to, a pool through the same kind of ring SyncTimer uses
+ */
+static void measureSyncTimer(const int bufferSize)
+{
+    // ZynthboxTrackCount tracks, and the master control track
+    constexpr int trackCount{11};
+    constexpr int stepContentCount{64};
+    struct BenchmarkStepContent {
+        juce::MidiBuffer trackBufferSequencer[trackCount];
+        juce::MidiBuffer trackBufferController[trackCount];
+    };
+    std::vector<BenchmarkStepContent> stepContents(stepContentCount);
+    typedef LockFreeRing<BenchmarkStepContent*, stepContentCount, LockFreeRingWriters::MultipleWriters, LockFreeRingReaders::MultipleReaders> StepContentPool;
+    StepContentPool freshStepContents{"dspbenchmark step contents"};
+    for (BenchmarkStepContent &stepContent : stepContents) {
+        for (int track = 0; track < 4; ++track) {
+            stepContent.trackBufferSequencer[track].addEvent(juce::MidiMessage::noteOn(track + 1, 60, juce::uint8(100)), 0);
+            stepContent.trackBufferSequencer[track].addEvent(juce::MidiMessage::noteOff(track + 1, 60), 0);
+        }
+        freshStepContents.write(&stepContent);
+    }
+    // The stand-in for the jack port buffers (one for each of the tracks' sequencer and controller ports)
+    std::vector<unsigned char> outputs[2 * trackCount];
+    for (std::vector<unsigned char> &output : outputs) {
+        output.resize(1024);
+    }
+    // BeatSubdivisions ticks per beat, at 120bpm
+    const double framesPerStep{sampleRate * 60.0 / (120.0 * 96.0)};
+    double nextStepFrame{0};
+    measure("SyncTimer", bufferSize, [&](){
+        std::size_t outputPositions[2 * trackCount]{};
+        while (nextStepFrame < bufferSize) {
+            BenchmarkStepContent *stepContent{nullptr};
+            if (freshStepContents.read(stepContent) == false) {
+                break;
+            }
+            for (int track = 0; track < trackCount; ++track) {
+                for (const juce::MidiMessageMetadata &juceMessage : stepContent->trackBufferSequencer[track]) {
+                    std::copy(juceMessage.data, juceMessage.data + juceMessage.numBytes, outputs[track].begin() + long(outputPositions[track]));
+                    outputPositions[track] += std::size_t(juceMessage.numBytes);
+                }
+                for (const juce::MidiMessageMetadata &juceMessage : stepContent->trackBufferController[track]) {
+                    std::copy(juceMessage.data, juceMessage.data + juceMessage.numBytes, outputs[trackCount + track].begin() + long(outputPositions[trackCount + track]));
+                    outputPositions[trackCount + track] += std::size_t(juceMessage.numBytes);
+                }
+            }
+            // Hand the step content back (in SyncTimer this happens on the timer thread, once the step has been played)
+            freshStepContents.write(stepContent);
+            nextStepFrame += framesPerStep;
+        }
+        nextStepFrame -= bufferSize;
+    });
+}
+
+int main(int /*argc*/, char **/*argv*/)
+{
+    printf("Measuring %.0f seconds of audio at %.0f Hz for each case\n", measuredSeconds, sampleRate);
+    for (const int bufferSize : bufferSizes) {
+        measureSamplerSynthVoice(bufferSize);
+        measureEqualiser(bufferSize);
+        measureCompressor(bufferSize);
+        measureGrainerator(bufferSize);
+        measureAudioLevelsChannel(bufferSize);
+        measureMidiRouter(bufferSize);
+        measureSyncTimer(bufferSize);
+    }
+    return 0;
+}
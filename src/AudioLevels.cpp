@@ -19,6 +19,7 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QVariantList>
 
 #define DebugAudioLevels false
@@ -56,6 +57,57 @@ public:
     bool initialized{false};
     quint64 startTimestamp{0};
     quint64 stopTimestamp{0};
+    // The identifier of the recordings most recently armed by AudioLevels::armRecording()
+    std::atomic<quint64> lastArmedTakeId{0};
+    // The number of recordings AudioLevels::startArmedRecording() was asked to start, but which had not been armed
+    std::atomic<int> missedRecordingStarts{0};
+
+    // Set the start of the recordings on all the channels to the given timestamp (or the current jack playhead, if 0)
+    void setRecordingStart(quint64 timestamp) {
+        if (timestamp > 0) {
+            startTimestamp = timestamp;
+        } else {
+            startTimestamp = SyncTimer::instance()->jackPlayhead();
+        }
+        stopTimestamp = ULONG_LONG_MAX;
+        // Inform all the channels they should only be recording from (and including) that given timestamp
+        for (AudioLevelsChannel *channel : qAsConst(audioLevelsChannels)) {
+            channel->firstRecordingFrame = startTimestamp;
+            channel->lastRecordingFrame = stopTimestamp;
+        }
+    }
+    // Stops the recording when playback stops during a bounce (see AudioLevels::bounceSong())
+    QMetaObject::Connection bounceStopConnection;
+    // While a bounce is waiting for its recordings to be prepared, this checks on them (see AudioLevels::bounceSong())
+    QTimer bouncePreparationTimer;
+    QElapsedTimer bouncePreparationElapsed;
+    TimerCommand *bounceStartCommand{nullptr};
+    int bounceStartOffset{0};
+    quint64 bounceDuration{0};
+
+    // Calls the given function for each of the recorders, along with the bit rate and channel count it records with
+    template<typename Function>
+    void forEachRecorder(Function function) const {
+        function(globalPlaybackWriter, 32, DISKWRITER_CHANNEL_COUNT);
+        function(portsRecorder, 16, recordPorts.count());
+        for (DiskWriter *channelWriter : channelWriters) {
+            function(channelWriter, 32, DISKWRITER_CHANNEL_COUNT);
+        }
+    }
+    // The full filename the recorder should record into, if started at the time described by the given timestamp
+    QString recordingFilename(const DiskWriter *writer, const QString &timestamp) const {
+        if (writer->filenamePrefix().endsWith(".wav")) {
+            // If prefix already ends with `.wav` do not add timestamp and suffix to filename
+            return writer->filenamePrefix();
+        }
+        return QString("%1-%2%3").arg(writer->filenamePrefix()).arg(timestamp).arg(writer->filenameSuffix());
+    }
+    void ensureRecordingDirectoryExists(const DiskWriter *writer) const {
+        const QString dirPath = writer->filenamePrefix().left(writer->filenamePrefix().lastIndexOf('/'));
+        if (!QDir().exists(dirPath)) {
+            QDir().mkpath(dirPath);
+        }
+    }
 
     void connectPorts(const QString &from, const QString &to) {
         int result = jack_connect(jackClient, from.toUtf8(), to.toUtf8());
@@ -214,6 +266,8 @@ AudioLevels::AudioLevels(QObject *parent)
                 d->isRecordingChangedThrottle.setInterval(10);
                 d->isRecordingChangedThrottle.setSingleShot(true);
                 connect(&d->isRecordingChangedThrottle, &QTimer::timeout, this, &AudioLevels::isRecordingChanged);
+                d->bouncePreparationTimer.setInterval(5);
+                connect(&d->bouncePreparationTimer, &QTimer::timeout, this, &AudioLevels::continueBounce);
                 for (AudioLevelsChannel *channel : d->audioLevelsChannels) {
                     channel->enabled = true;
                     connect(channel->diskRecorder(), &DiskWriter::isRecordingChanged, &d->isRecordingChangedThrottle, QOverload<>::of(&QTimer::start), Qt::QueuedConnection);
@@ -287,6 +341,15 @@ void AudioLevels::timerCallback() {
         }
         ++channelIndex;
     }
+    int missedRecordingStarts{d->missedRecordingStarts.exchange(0)};
+    for (AudioLevelsChannel *channel : qAsConst(d->audioLevelsChannels)) {
+        missedRecordingStarts += channel->missedRecordingStarts.exchange(0);
+        // Recordings are mostly started and stopped on the process callback, so the writers only tell us about that here
+        channel->diskRecorder()->emitPendingChanges();
+    }
+    if (missedRecordingStarts > 0) {
+        qWarning() << Q_FUNC_INFO << missedRecordingStarts << "recordings were scheduled to start without having been armed first, and so were not started (see AudioLevels::armRecordingForCommand())";
+    }
     Q_EMIT audioLevelsChanged();
 }
 
@@ -414,75 +477,97 @@ QString AudioLevels::getTimestampedFilename(const QString& prefix, const QString
     return QString("%1-%2%3").arg(prefix).arg(timestamp).arg(suffix);
 }
 
-void AudioLevels::startRecording(quint64 startTimestamp)
+void AudioLevels::startRecording(quint64 startTimestamp, quint64 takeId)
 {
     // If we've been passed a timestamp, use that, otherwise just set to the most recent jack playhead timestamp
-    if (startTimestamp > 0) {
-        d->startTimestamp = startTimestamp;
-    } else {
-        d->startTimestamp = SyncTimer::instance()->jackPlayhead();
-    }
-    d->stopTimestamp = ULONG_LONG_MAX;
-    // Inform all the channels they should only be recording from (and including) that given timestamp
-    for (AudioLevelsChannel *channel : qAsConst(d->audioLevelsChannels)) {
-        channel->firstRecordingFrame = d->startTimestamp;
-        channel->lastRecordingFrame = d->stopTimestamp;
-    }
-    const QString timestamp{QDateTime::currentDateTime().toString(Qt::ISODate)};
-    const double sampleRate = jack_get_sample_rate(d->jackClient);
-    // Doing this in two goes, because when we ask recording to start, it will very extremely start,
-    // and we kind of want to at least get pretty close to them starting at the same time, so let's
-    // do this bit of the ol' filesystem work first
-    QString dirPath = d->globalPlaybackWriter->filenamePrefix().left(d->globalPlaybackWriter->filenamePrefix().lastIndexOf('/'));
-    if (d->globalPlaybackWriter->shouldRecord() && !QDir().exists(dirPath)) {
-        QDir().mkpath(dirPath);
-    }
-    dirPath = d->portsRecorder->filenamePrefix().left(d->portsRecorder->filenamePrefix().lastIndexOf('/'));
-    if (d->portsRecorder->shouldRecord() && !QDir().exists(dirPath)) {
-        QDir().mkpath(dirPath);
-    }
-    for (DiskWriter *channelWriter : d->channelWriters) {
-        dirPath = channelWriter->filenamePrefix().left(channelWriter->filenamePrefix().lastIndexOf('/'));
-        if (channelWriter->shouldRecord() && !QDir().exists(dirPath)) {
-            QDir().mkpath(dirPath);
+    d->setRecordingStart(startTimestamp);
+    const quint64 armedTakeId{takeId > 0 ? takeId : d->lastArmedTakeId.load()};
+    // Recorders which have been armed (see armRecording()) can simply be started, which does no filesystem work. Any others
+    // need setting up in place (which is why this must not be called from the process callback, see startArmedRecording()),
+    // and we're doing that in two goes, because when we ask recording to start, it will very extremely start, and we kind of want to at least get pretty close to them starting at the same time, so let's do this bit of the ol'
+    // filesystem work first
+    QString timestamp;
+    double sampleRate{0};
+    auto prepareForUnarmedRecording = [this, &timestamp, &sampleRate](){
+        if (timestamp.isEmpty()) {
+            timestamp = QDateTime::currentDateTime().toString(Qt::ISODate);
+            sampleRate = jack_get_sample_rate(d->jackClient);
         }
-    }
-    if (d->globalPlaybackWriter->shouldRecord()) {
-        if (d->globalPlaybackWriter->filenamePrefix().endsWith(".wav")) {
-            // If prefix already ends with `.wav` do not add timestamp and suffix to filename
-            d->globalPlaybackWriter->startRecording(d->globalPlaybackWriter->filenamePrefix(), sampleRate);
-        } else {
-            const QString filename = QString("%1-%2%3").arg(d->globalPlaybackWriter->filenamePrefix()).arg(timestamp).arg(d->globalPlaybackWriter->filenameSuffix());
-            d->globalPlaybackWriter->startRecording(filename, sampleRate);
+    };
+    d->forEachRecorder([this, &prepareForUnarmedRecording, &armedTakeId](DiskWriter *writer, int /*bitRate*/, int /*channelCount*/){
+        if (writer->shouldRecord() && writer->hasArmedRecording(armedTakeId) == false) {
+            prepareForUnarmedRecording();
+            d->ensureRecordingDirectoryExists(writer);
         }
-    }
-    if (d->portsRecorder->shouldRecord()) {
-        if (d->portsRecorder->filenamePrefix().endsWith(".wav")) {
-            // If prefix already ends with `.wav` do not add timestamp and suffix to filename
-            d->portsRecorder->startRecording(d->portsRecorder->filenamePrefix(), sampleRate, 16, d->recordPorts.count());
-        } else {
-            const QString filename = QString("%1-%2%3").arg(d->portsRecorder->filenamePrefix()).arg(timestamp).arg(d->portsRecorder->filenameSuffix());
-            d->portsRecorder->startRecording(filename, sampleRate, 16, d->recordPorts.count());
+    });
+    d->forEachRecorder([this, &prepareForUnarmedRecording, &timestamp, &sampleRate, &armedTakeId](DiskWriter *writer, int bitRate, int channelCount){
+        if (writer->shouldRecord() && writer->startArmedRecording(armedTakeId) == false) {
+            prepareForUnarmedRecording();
+            writer->startRecording(d->recordingFilename(writer, timestamp), sampleRate, bitRate, channelCount);
+        }
+    });
+    Q_EMIT isRecordingChanged();
+}
+
+void AudioLevels::startArmedRecording(quint64 startTimestamp, quint64 takeId)
+{
+    d->setRecordingStart(startTimestamp);
+    const quint64 armedTakeId{takeId > 0 ? takeId : d->lastArmedTakeId.load()};
+    d->forEachRecorder([this, &armedTakeId](DiskWriter *writer, int /*bitRate*/, int /*channelCount*/){
+        if (writer->shouldRecord() && writer->startArmedRecording(armedTakeId) == false) {
+            ++d->missedRecordingStarts;
+        }
+    });
+}
+
+quint64 AudioLevels::armRecording()
+{
+    const quint64 takeId{DiskWriter::createTakeId()};
+    const QString timestamp{QDateTime::currentDateTime().toString(Qt::ISODate)};
+    const double sampleRate = jack_get_sample_rate(d->jackClient);
+    d->forEachRecorder([this, &takeId, &timestamp, &sampleRate](DiskWriter *writer, int bitRate, int channelCount){
+        if (writer->shouldRecord()) {
+            d->ensureRecordingDirectoryExists(writer);
+            writer->armRecording(takeId, d->recordingFilename(writer, timestamp), sampleRate, bitRate, channelCount);
         }
+    });
+    d->lastArmedTakeId = takeId;
+    return takeId;
+}
+
+void AudioLevels::disarmRecording(quint64 takeId)
+{
+    d->forEachRecorder([&takeId](DiskWriter *writer, int /*bitRate*/, int /*channelCount*/){
+        writer->disarmRecording(takeId);
+    });
+    quint64 expected{takeId};
+    if (takeId == 0) {
+        d->lastArmedTakeId = 0;
+    } else {
+        d->lastArmedTakeId.compare_exchange_strong(expected, 0);
     }
-    for (DiskWriter *channelWriter : d->channelWriters) {
-        if (channelWriter->shouldRecord()) {
-            if (channelWriter->filenamePrefix().endsWith(".wav")) {
-                // If prefix already ends with `.wav` do not add timestamp and suffix to filename
-                channelWriter->startRecording(channelWriter->filenamePrefix(), sampleRate);
-            } else {
-                const QString filename = QString("%1-%2%3").arg(channelWriter->filenamePrefix()).arg(timestamp).arg(channelWriter->filenameSuffix());
-                channelWriter->startRecording(filename, sampleRate);
+}
+
+void AudioLevels::armRecordingForCommand(TimerCommand* command)
+{
+    if (command->operation == TimerCommand::ChannelRecorderStartOperation) {
+        if (command->parameter == 1) {
+            if (-1 < command->parameter2 && command->parameter2 < 10) {
+                command->bigParameter = DiskWriter::createTakeId();
+                d->audioLevelsChannels[command->parameter2 + 3]->diskRecorder()->armRecording(command->bigParameter, command->variantParameter.toString(), jack_get_sample_rate(d->jackClient));
             }
+        } else {
+            command->bigParameter = armRecording();
         }
     }
-    Q_EMIT isRecordingChanged();
 }
 
 void AudioLevels::scheduleStartRecording(quint64 delay)
 {
     TimerCommand *command = SyncTimer::instance()->getTimerCommand();
     command->operation = TimerCommand::ChannelRecorderStartOperation;
+    // The recording will be started from the process callback, so make sure it doesn't need to do any filesystem work
+    armRecordingForCommand(command);
     SyncTimer::instance()->scheduleTimerCommand(delay, command);
 }
 
@@ -499,10 +584,69 @@ QString AudioLevels::scheduleChannelRecorderStart(quint64 delay, int sketchpadTr
     } else {
         command->variantParameter = QString("%1-%2%3").arg(prefix).arg(timestamp).arg(suffix);
     }
+    // The recording will be started from the process callback, so get the file and writer ready for it ahead of time
+    armRecordingForCommand(command);
     SyncTimer::instance()->scheduleTimerCommand(delay, command);
     return command->variantParameter.toString();
 }
 
+bool AudioLevels::bounceSong(int startOffset, quint64 duration)
+{
+    SyncTimer *syncTimer{SyncTimer::instance()};
+    if (isRecording() || syncTimer->timerRunning() || syncTimer->freewheeling() || d->bouncePreparationTimer.isActive()) {
+        qWarning() << Q_FUNC_INFO << "Attempted to bounce the song while recording, playback, or another bounce is already ongoing, which is not possible";
+        return false;
+    }
+    // Once jack is freewheeling, it will get through the start of the song faster than the files can be created, so the
+    // recordings need to be properly ready before we start anything. Rather than waiting for that here, continueBounce()
+    // checks on them from the event loop, and starts the bounce once they are.
+    d->bounceStartCommand = syncTimer->getTimerCommand();
+    d->bounceStartCommand->operation = TimerCommand::ChannelRecorderStartOperation;
+    armRecordingForCommand(d->bounceStartCommand);
+    d->bounceStartOffset = startOffset;
+    d->bounceDuration = duration;
+    d->bouncePreparationElapsed.start();
+    d->bouncePreparationTimer.start();
+    return true;
+}
+
+void AudioLevels::continueBounce()
+{
+    bool prepared{true};
+    d->forEachRecorder([&prepared](DiskWriter *writer, int /*bitRate*/, int /*channelCount*/){
+        if (writer->preparingRecordingCount() > 0) {
+            prepared = false;
+        }
+    });
+    if (prepared == false && d->bouncePreparationElapsed.elapsed() < 5000) {
+        return;
+    }
+    d->bouncePreparationTimer.stop();
+    SyncTimer *syncTimer{SyncTimer::instance()};
+    TimerCommand *startCommand{d->bounceStartCommand};
+    d->bounceStartCommand = nullptr;
+    if (syncTimer->timerRunning() || syncTimer->freewheeling()) {
+        qWarning() << Q_FUNC_INFO << "Playback was started while the bounce was being prepared, so the bounce has been abandoned";
+        disarmRecording(startCommand->bigParameter);
+        syncTimer->deleteTimerCommand(startCommand);
+        return;
+    }
+    if (prepared == false) {
+        qWarning() << Q_FUNC_INFO << "Gave up waiting for the recordings to be prepared - the start of the bounce will likely be missing from some of them";
+    }
+    disconnect(d->bounceStopConnection);
+    d->bounceStopConnection = connect(syncTimer, &SyncTimer::timerRunningChanged, this, [this, syncTimer](){
+        if (syncTimer->timerRunning() == false) {
+            disconnect(d->bounceStopConnection);
+            stopRecording();
+        }
+    });
+    // Recording goes first, so it is running by the time playback starts
+    syncTimer->scheduleTimerCommand(0, startCommand);
+    syncTimer->scheduleStartPlayback(0, true, d->bounceStartOffset, d->bounceDuration);
+    syncTimer->setFreewheeling(true);
+}
+
 void AudioLevels::stopRecording(quint64 stopTimestamp)
 {
     if (stopTimestamp > 0) {
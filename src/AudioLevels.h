@@ -222,8 +222,45 @@ public:
      * - Stop recording when needed
      * - Stop playback
      * @param startTimestamp If set, this will be used in place of the current jack playhead as the start time for recordings
+     * @param takeId The armed recordings to start (as returned by armRecording()), or 0 for the ones most recently armed
+     * @note Channels without an armed recording are set up in place, so do not call this from the process callback (see startArmedRecording())
      */
-    Q_INVOKABLE void startRecording(quint64 startTimestamp = 0);
+    Q_INVOKABLE void startRecording(quint64 startTimestamp = 0, quint64 takeId = 0);
+    /**
+     * \brief Start only the armed recordings on all enabled channels
+     * This is what scheduled recording starts use, and is safe to call from the process callback. Unlike startRecording(),
+     * channels which do not have an armed recording with the given identifier are not started (as setting them up in place
+     * would mean filesystem work and locking), and a warning is logged for them later instead.
+     * @param startTimestamp If set, this will be used in place of the current jack playhead as the start time for recordings
+     * @param takeId The armed recordings to start (as returned by armRecording()), or 0 for the ones most recently armed
+     */
+    void startArmedRecording(quint64 startTimestamp, quint64 takeId);
+    /**
+     * \brief Prepare the files for recording on all enabled channels ahead of time
+     *
+     * Creating the files to record into involves filesystem work, which can take a while (in particular on slow storage).
+     * Calling this before startRecording() means that work is done ahead of time, and starting the recording simply
+     * switches over to the prepared files. scheduleStartRecording() does this for you, but if you are going to have
+     * recording be started some other way (for example by way of starting playback with a clip set to record), call this
+     * once the channels, prefixes and such have been set up.
+     * @note The timestamp in the filenames will be the time this was called, not the time the recording was started
+     * @return The identifier of the armed recordings, which can be passed to startRecording() and disarmRecording()
+     * @see disarmRecording()
+     */
+    Q_INVOKABLE quint64 armRecording();
+    /**
+     * \brief Throw away armed recordings which are no longer going to be started
+     * The files created for them are removed again.
+     * @param takeId The identifier returned by armRecording(), or 0 to throw away all armed recordings
+     */
+    Q_INVOKABLE void disarmRecording(quint64 takeId = 0);
+    /**
+     * \brief Arm the recordings which the given command will start, and set the command up to start those specific recordings
+     * Use this on any ChannelRecorderStartOperation command you schedule yourself (such as copies of commands which were
+     * scheduled before), otherwise it will have to set up the recordings from the process callback. Other commands are left alone.
+     * @param command The command to arm the recordings for
+     */
+    void armRecordingForCommand(TimerCommand *command);
     /**
      * \brief Schedules a start of the recording process on all enabled channels
      * @param delay The amount of time to wait until starting the recording (if you need to do it now, just call startRecording)
@@ -239,6 +276,23 @@ public:
      * @return The full filename that will be used for the recording (timestamp will be scheduling time, not recording start time)
      */
     Q_INVOKABLE QString scheduleChannelRecorderStart(quint64 delay, int sketchpadTrack, const QString &prefix, const QString &suffix = QString{".wav"});
+    /**
+     * \brief Render the song to disk on all enabled channels, faster than realtime
+     *
+     * Set up the channels and filenames as you would for startRecording(), and then call this instead of starting recording
+     * and playback yourself. This prepares the recordings and returns straight away. Once their files are ready (so none of
+     * the audio is missed once jack is running flat out), the start of recording and song playback is scheduled from the event
+     * loop, and freewheeling is turned on (see SyncTimer::setFreewheeling()). Once playback stops, recording is stopped, and
+     * freewheeling turns itself off. If playback is started by something else while the recordings are being prepared, the
+     * bounce is abandoned.
+     *
+     * @note Freewheeling affects the whole jack server, so everything else connected to it also runs freewheeling, and the
+     * hardware outputs are silent for the duration of the render
+     * @param startOffset The position in the song to start playback at, in timer ticks (see SegmentHandler::startPlayback())
+     * @param duration How long to play for, in timer ticks (0, the default, renders until the end of the song)
+     * @return False if the render could not be started (because recording, playback, or another render is already ongoing), otherwise true
+     */
+    Q_INVOKABLE bool bounceSong(int startOffset = 0, quint64 duration = 0);
     /**
      * \brief Stop any ongoing recordings
      * @param stopTimestamp If set, this will be used in place of the current jack playhead as the stop time for recordings
@@ -323,6 +377,8 @@ private:
           channelsB[CHANNELS_COUNT] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
 
     Q_SLOT void timerCallback();
+    // Starts a bounce requested by bounceSong(), once its recordings have been prepared (called by a timer until that happens)
+    Q_SLOT void continueBounce();
     AudioLevelsPrivate *d{nullptr};
 
     static std::atomic<AudioLevels*> singletonInstance;
@@ -7,6 +7,8 @@
 #include "JackThreadAffinitySetter.h"
 #include "MidiRouter.h"
 #include "MidiRouterDeviceModel.h"
+#include "ProcessTiming.h"
+#include "StereoBiquadCascade.h"
 
 #include <cmath>
 #include <QDebug>
@@ -45,13 +47,9 @@ public:
                 equaliserSettings[equaliserBand]->setNext(equaliserSettings[equaliserBand + 1]);
             }
         }
-        // A bit awkward perhaps, but... this is a variadic template, and there's no indexed access, just a template one, so... alright
-        equaliserSettings[0]->setDspObjects(&filterChain[0].get<0>(), &filterChain[1].get<0>());
-        equaliserSettings[1]->setDspObjects(&filterChain[0].get<1>(), &filterChain[1].get<1>());
-        equaliserSettings[2]->setDspObjects(&filterChain[0].get<2>(), &filterChain[1].get<2>());
-        equaliserSettings[3]->setDspObjects(&filterChain[0].get<3>(), &filterChain[1].get<3>());
-        equaliserSettings[4]->setDspObjects(&filterChain[0].get<4>(), &filterChain[1].get<4>());
-        equaliserSettings[5]->setDspObjects(&filterChain[0].get<5>(), &filterChain[1].get<5>());
+        for (int equaliserBand = 0; equaliserBand < equaliserBandCount; ++equaliserBand) {
+            equaliserSettings[equaliserBand]->setDspObjects(&filterChain, equaliserBand);
+        }
         equaliserFrequencies.resize(300);
         for (size_t i = 0; i < equaliserFrequencies.size(); ++i) {
             equaliserFrequencies[i] = 20.0 * std::pow(2.0, i / 30.0);
@@ -104,23 +102,17 @@ public:
     }
     jack_port_t *sideChainInput[2]{nullptr};
     jack_default_audio_sample_t *sideChainGain[2]{nullptr};
-    dsp::ProcessorChain<dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>> filterChain[2];
+    StereoBiquadCascade filterChain;
     void bypassUpdater() {
-        for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
-            soloedFilter = nullptr;
-            for (JackPassthroughFilter *filter : equaliserSettings) {
-                if (filter->soloed()) {
-                    soloedFilter = filter;
-                    break;
-                }
+        soloedFilter = nullptr;
+        for (JackPassthroughFilter *filter : equaliserSettings) {
+            if (filter->soloed()) {
+                soloedFilter = filter;
+                break;
             }
-            // A bit awkward perhaps, but... this is a variadic template, and there's no indexed access, just a template one, so... alright
-            filterChain[channelIndex].setBypassed<0>((soloedFilter == equaliserSettings[0]) == false && equaliserSettings[0]->active() == false);
-            filterChain[channelIndex].setBypassed<1>((soloedFilter == equaliserSettings[1]) == false && equaliserSettings[1]->active() == false);
-            filterChain[channelIndex].setBypassed<2>((soloedFilter == equaliserSettings[2]) == false && equaliserSettings[2]->active() == false);
-            filterChain[channelIndex].setBypassed<3>((soloedFilter == equaliserSettings[3]) == false && equaliserSettings[3]->active() == false);
-            filterChain[channelIndex].setBypassed<4>((soloedFilter == equaliserSettings[4]) == false && equaliserSettings[4]->active() == false);
-            filterChain[channelIndex].setBypassed<5>((soloedFilter == equaliserSettings[5]) == false && equaliserSettings[5]->active() == false);
+        }
+        for (int equaliserBand = 0; equaliserBand < equaliserBandCount; ++equaliserBand) {
+            filterChain.setBandEnabled(equaliserBand, soloedFilter == equaliserSettings[equaliserBand] || equaliserSettings[equaliserBand]->active());
         }
     }
 
@@ -164,6 +156,7 @@ AudioLevelsChannel::~AudioLevelsChannel()
 
 int AudioLevelsChannel::process(jack_nframes_t nframes, jack_nframes_t current_frames, jack_nframes_t next_frames, jack_time_t /*current_usecs*/, jack_time_t /*next_usecs*/, float /*period_usecs*/)
 {
+    MEASURE_PROCESS_TIMING("AudioLevelsChannel", nframes)
     if (enabled) {
         leftBuffer = (jack_default_audio_sample_t *)jack_port_get_buffer(leftPort, nframes);
         rightBuffer = (jack_default_audio_sample_t *)jack_port_get_buffer(rightPort, nframes);
@@ -175,16 +168,19 @@ int AudioLevelsChannel::process(jack_nframes_t nframes, jack_nframes_t current_f
             doRecordingHandling(nframes, current_frames, next_frames);
             bool recordingStarted{false};
             quint64 timestamp{0};
-            while (startCommandsRing.readHead->processed == false && startCommandsRing.readHead->timestamp < next_frames) {
+            while (startCommandsRing.hasUnread() && startCommandsRing.peek()->timestamp < next_frames) {
                 TimerCommand *command = startCommandsRing.read(&timestamp);
                 firstRecordingFrame = timestamp;
                 recordingStarted = true;
-                const double sampleRate = jack_get_sample_rate(jackClient);
                 if (m_diskRecorder->isRecording()) {
                     qDebug() << Q_FUNC_INFO << "We have been asked to start a new recording while one is already going on. Stopping the ongoing one first.";
                     m_diskRecorder->stop();
                 }
-                m_diskRecorder->startRecording(command->variantParameter.toString(), sampleRate);
+                // The recording will have been armed when it was scheduled (see AudioLevels::armRecordingForCommand). If it wasn't, setting
+                // it up would mean filesystem work and locking on the process thread, so instead it is not started, and reported by AudioLevels
+                if (m_diskRecorder->startArmedRecording(command->bigParameter) == false) {
+                    ++missedRecordingStarts;
+                }
             }
             if (recordingStarted) {
                 doRecordingHandling(nframes, current_frames, next_frames);
@@ -221,18 +217,18 @@ int AudioLevelsChannel::process(jack_nframes_t nframes, jack_nframes_t current_f
             jack_default_audio_sample_t *inputBuffers[2]{leftOutBuffer, rightOutBuffer};
             if (d->equaliserEnabled) {
                 for (JackPassthroughFilter *filter : d->equaliserSettings) {
-                    filter->updateCoefficients();
+                    filter->updateCoefficients(int(nframes));
                 }
+                juce::AudioBuffer<float> bufferWrappers[2]{{&inputBuffers[0], 1, int(nframes)}, {&inputBuffers[1], 1, int(nframes)}};
                 for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
-                    juce::AudioBuffer<float> bufferWrapper(&inputBuffers[channelIndex], 1, int(nframes));
-                    juce::dsp::AudioBlock<float> block(bufferWrapper);
-                    juce::dsp::ProcessContextReplacing<float> context(block);
                     if (d->equaliserInputAnalysers[channelIndex]) {
-                        d->equaliserInputAnalysers[channelIndex]->addAudioData(bufferWrapper, 0, 1);
+                        d->equaliserInputAnalysers[channelIndex]->addAudioData(bufferWrappers[channelIndex], 0, 1);
                     }
-                    d->filterChain[channelIndex].process(context);
+                }
+                d->filterChain.process(inputBuffers[0], inputBuffers[1], int(nframes));
+                for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
                     if (d->equaliserOutputAnalysers[channelIndex]) {
-                        d->equaliserOutputAnalysers[channelIndex]->addAudioData(bufferWrapper, 0, 1);
+                        d->equaliserOutputAnalysers[channelIndex]->addAudioData(bufferWrappers[channelIndex], 0, 1);
                     }
                 }
             }
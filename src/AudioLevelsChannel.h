@@ -8,6 +8,7 @@
 #include <jack/jack.h>
 #include <QObject>
 #include <QString>
+#include <atomic>
 #include <limits.h>
 
 #define CHANNELS_COUNT 10
@@ -75,6 +76,8 @@ public:
     quint64 firstRecordingFrame{0};
     quint64 lastRecordingFrame{ULONG_LONG_MAX};
     TimerCommandRing startCommandsRing;
+    // The number of recordings which were asked to start by startCommandsRing, but had not been armed (reported by AudioLevels)
+    std::atomic<int> missedRecordingStarts{0};
 
     QObject* gainHandler() const;
 
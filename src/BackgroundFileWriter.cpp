@@ -0,0 +1,219 @@
+/*
+  ==============================================================================
+
+    BackgroundFileWriter.cpp
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#include "BackgroundFileWriter.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+
+struct BackgroundFileCompletion {
+    // Whether there was a context to begin with (as a QPointer can't tell a destroyed context from no context)
+    bool hasContext{false};
+    QPointer<QObject> context;
+    BackgroundFileWriter::Completion completion;
+};
+
+struct BackgroundFileOperation {
+    enum Type {
+        WriteOperation,
+        RemoveOperation,
+        RemoveFolderOperation,
+    };
+    Type type{WriteOperation};
+    QByteArray data;
+    // The position in the queue of the runner which will perform this operation
+    quint64 sequence{0};
+    // The completions for this operation, and for any operations it has been coalesced with
+    QList<BackgroundFileCompletion> completions;
+};
+
+class BackgroundFileWriterPrivate {
+public:
+    BackgroundFileWriterPrivate() {
+        // A single thread, so operations are performed in the order they were queued
+        threadPool.setMaxThreadCount(1);
+        if (QCoreApplication::instance()) {
+            completionReceiver.moveToThread(QCoreApplication::instance()->thread());
+        }
+    }
+    QThreadPool threadPool;
+    // Lives on the main thread, and is what the completions get called through
+    QObject completionReceiver;
+    QMutex mutex;
+    // The most recently queued operation for each path which has not yet been performed
+    QHash<QString, BackgroundFileOperation> pendingOperations;
+    quint64 nextSequence{0};
+    // The sequence of the most recently queued folder removal
+    quint64 lastFolderRemovalSequence{0};
+
+    void queue(const QString &path, BackgroundFileOperation operation);
+    void perform(const QString &path, const quint64 &sequence) {
+        BackgroundFileOperation operation;
+        {
+            QMutexLocker locker(&mutex);
+            // If the operation has since been superseded by one queued further along, leave it for that one's runner
+            if (!pendingOperations.contains(path) || pendingOperations[path].sequence != sequence) {
+                return;
+            }
+            operation = pendingOperations.take(path);
+        }
+        bool success{true};
+        switch (operation.type) {
+            case BackgroundFileOperation::WriteOperation:
+                success = BackgroundFileWriter::writeAtomically(path, operation.data);
+                break;
+            case BackgroundFileOperation::RemoveOperation:
+                if (QFile::exists(path) && !QFile::remove(path)) {
+                    qWarning() << Q_FUNC_INFO << "Failed to remove the file" << path;
+                    success = false;
+                }
+                break;
+            case BackgroundFileOperation::RemoveFolderOperation:
+                if (!QDir(path).removeRecursively()) {
+                    qWarning() << Q_FUNC_INFO << "Failed to remove the folder" << path;
+                    success = false;
+                }
+                break;
+        }
+        if (operation.completions.isEmpty() == false) {
+            // The contexts are checked on the main thread, where they live, right before the completions are called
+            const QList<BackgroundFileCompletion> completions{operation.completions};
+            QMetaObject::invokeMethod(&completionReceiver, [completions, success](){
+                for (const BackgroundFileCompletion &completion : completions) {
+                    if (completion.hasContext == false || completion.context) {
+                        completion.completion(success);
+                    }
+                }
+            }, Qt::QueuedConnection);
+        }
+    }
+};
+
+class BackgroundFileOperationRunner : public QRunnable {
+public:
+    BackgroundFileOperationRunner(BackgroundFileWriterPrivate *d, const QString &path, const quint64 &sequence)
+        : d(d)
+        , path(path)
+        , sequence(sequence)
+    {
+        setAutoDelete(true);
+    }
+    void run() override {
+        d->perform(path, sequence);
+    }
+private:
+    BackgroundFileWriterPrivate *d{nullptr};
+    QString path;
+    quint64 sequence{0};
+};
+
+void BackgroundFileWriterPrivate::queue(const QString& path, BackgroundFileOperation operation)
+{
+    QMutexLocker locker(&mutex);
+    if (pendingOperations.contains(path) && pendingOperations[path].sequence > lastFolderRemovalSequence && operation.type != BackgroundFileOperation::RemoveFolderOperation) {
+        // Coalesce with the operation already waiting for this path (which is safe as long as no folder removal has been
+        // queued since, as that might otherwise end up removing the file after the new operation has been performed)
+        operation.sequence = pendingOperations[path].sequence;
+        operation.completions = pendingOperations[path].completions + operation.completions;
+        pendingOperations[path] = operation;
+    } else {
+        ++nextSequence;
+        operation.sequence = nextSequence;
+        if (operation.type == BackgroundFileOperation::RemoveFolderOperation) {
+            lastFolderRemovalSequence = nextSequence;
+        }
+        if (pendingOperations.contains(path)) {
+            // The operation being replaced will now never be performed (its runner will find it superseded), so whoever was
+            // waiting on it is told about the outcome of this one instead, as that decides what the path ends up holding
+            operation.completions = pendingOperations[path].completions + operation.completions;
+        }
+        pendingOperations[path] = operation;
+        threadPool.start(new BackgroundFileOperationRunner(this, path, nextSequence));
+    }
+}
+
+BackgroundFileWriter::BackgroundFileWriter()
+    : d(new BackgroundFileWriterPrivate)
+{
+    // Make sure nothing we've been asked to write gets lost when the application shuts down
+    if (QCoreApplication::instance()) {
+        QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, QCoreApplication::instance(), [this](){ waitForDone(); });
+    }
+}
+
+BackgroundFileWriter::~BackgroundFileWriter()
+{
+    waitForDone();
+    delete d;
+}
+
+static QList<BackgroundFileCompletion> completionList(QObject *context, const BackgroundFileWriter::Completion &completion)
+{
+    QList<BackgroundFileCompletion> completions;
+    if (completion) {
+        completions << BackgroundFileCompletion{context != nullptr, context, completion};
+    }
+    return completions;
+}
+
+void BackgroundFileWriter::write(const QString& fileName, const QByteArray& data, QObject *context, Completion completion)
+{
+    d->queue(fileName, BackgroundFileOperation{BackgroundFileOperation::WriteOperation, data, 0, completionList(context, completion)});
+}
+
+void BackgroundFileWriter::remove(const QString& fileName, QObject *context, Completion completion)
+{
+    d->queue(fileName, BackgroundFileOperation{BackgroundFileOperation::RemoveOperation, QByteArray(), 0, completionList(context, completion)});
+}
+
+void BackgroundFileWriter::removeFolder(const QString& path, QObject *context, Completion completion)
+{
+    d->queue(path, BackgroundFileOperation{BackgroundFileOperation::RemoveFolderOperation, QByteArray(), 0, completionList(context, completion)});
+}
+
+void BackgroundFileWriter::waitForDone()
+{
+    d->threadPool.waitForDone();
+    if (QThread::currentThread() == d->completionReceiver.thread()) {
+        // Call the completions for everything which has now been performed, rather than leaving them for the event loop
+        QCoreApplication::sendPostedEvents(&d->completionReceiver, QEvent::MetaCall);
+    }
+}
+
+bool BackgroundFileWriter::writeAtomically(const QString& fileName, const QByteArray& data)
+{
+    bool success{false};
+    const QString folder{QFileInfo(fileName).absolutePath()};
+    if (QDir().mkpath(folder)) {
+        // QSaveFile writes to a temporary file next to the destination, and renames it over the destination on commit
+        QSaveFile file(fileName);
+        if (file.open(QIODevice::WriteOnly) && file.write(data) == data.size()) {
+            success = file.commit();
+        } else {
+            file.cancelWriting();
+        }
+        if (!success) {
+            qWarning() << Q_FUNC_INFO << "Failed to write the file" << fileName << ":" << file.errorString();
+        }
+    } else {
+        qWarning() << Q_FUNC_INFO << "Failed to create the folder" << folder << "for the file" << fileName;
+    }
+    return success;
+}
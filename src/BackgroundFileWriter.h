@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    BackgroundFileWriter.h
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include <functional>
+
+class BackgroundFileWriterPrivate;
+/**
+ * \brief Writes and removes files on a background thread, so saving never has to wait for the disk
+ *
+ * Operations are performed one at a time, in the order they were queued, on a single thread of the writer's own.
+ * Writes are atomic: the data is written to a temporary file next to the destination, which then replaces the
+ * destination in a single rename, so a file is only ever seen either as it was, or with all of its new contents,
+ * even if the device loses power half way through.
+ *
+ * If a file is queued for writing again before the previous write to it has been performed, the two are coalesced
+ * into one, and only the most recent data is written (which means a burst of saves of the same file only ends up
+ * touching the disk once).
+ *
+ * To find out how an operation went, pass a completion function along with it. Completions are called on the main
+ * thread once the operation has been performed (for coalesced operations, every completion is called with the result
+ * of the operation which was actually performed), and are dropped if their context object is destroyed before then.
+ */
+class BackgroundFileWriter {
+public:
+    static BackgroundFileWriter* instance() {
+        static BackgroundFileWriter* instance{nullptr};
+        if (!instance) {
+            instance = new BackgroundFileWriter();
+        }
+        return instance;
+    };
+    explicit BackgroundFileWriter();
+    ~BackgroundFileWriter();
+
+    /**
+     * \brief A function to be called with the result of an operation (true if it was successful, otherwise false)
+     */
+    typedef std::function<void(bool)> Completion;
+
+    /**
+     * \brief Queue up writing the given data to the given file (creating the folder it lives in if needed)
+     * @param fileName The full path of the file to write
+     * @param data The new contents of the file
+     * @param context If given, the completion is only called if this object still exists once the file has been written
+     * @param completion If given, this is called on the main thread once the file has been written (or failed to be)
+     */
+    void write(const QString &fileName, const QByteArray &data, QObject *context = nullptr, Completion completion = nullptr);
+    /**
+     * \brief Queue up removing the given file
+     * Removing a file which does not exist counts as a success
+     * @param fileName The full path of the file to remove
+     * @param context If given, the completion is only called if this object still exists once the file has been removed
+     * @param completion If given, this is called on the main thread once the file has been removed (or failed to be)
+     */
+    void remove(const QString &fileName, QObject *context = nullptr, Completion completion = nullptr);
+    /**
+     * \brief Queue up removing the given folder, and everything in it
+     * Removing a folder which does not exist counts as a success
+     * @param path The full path of the folder to remove
+     * @param context If given, the completion is only called if this object still exists once the folder has been removed
+     * @param completion If given, this is called on the main thread once the folder has been removed (or failed to be)
+     */
+    void removeFolder(const QString &path, QObject *context = nullptr, Completion completion = nullptr);
+    /**
+     * \brief Block until every operation queued so far has been performed
+     * When called on the main thread, the completions for those operations will also have been called once this returns
+     */
+    void waitForDone();
+
+    /**
+     * \brief Write the given data to the given file atomically, on the calling thread
+     * @param fileName The full path of the file to write
+     * @param data The new contents of the file
+     * @return True if the file was written successfully, false if it was left untouched
+     */
+    static bool writeAtomically(const QString &fileName, const QByteArray &data);
+private:
+    BackgroundFileWriterPrivate *d{nullptr};
+};
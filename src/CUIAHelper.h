@@ -1,5 +1,6 @@
 #pragma once
 
+#include "LockFreeRing.h"
 #include "ZynthboxBasics.h"
 
 #include <QObject>
@@ -286,66 +287,55 @@ private:
 Q_DECLARE_METATYPE(CUIAHelper::Event)
 
 #define CUIARingSize 512
-class CUIARing {
+struct CUIARingEntry {
+    CUIAHelper::Event event{CUIAHelper::NoCuiaEvent};
+    int originId{-1};
+    ZynthboxBasics::Track track{ZynthboxBasics::CurrentTrack};
+    ZynthboxBasics::Slot slot{ZynthboxBasics::CurrentSlot};
+    int value{0};
+};
+/**
+ * \brief A ring for passing CUIA events out of the midi handling (see LockFreeRing)
+ * This may be written to from any number of threads, but only read from one
+ */
+class CUIARing : public LockFreeRing<CUIARingEntry, CUIARingSize, LockFreeRingWriters::MultipleWriters> {
 public:
-    struct Entry {
-        Entry *next{nullptr};
-        Entry *previous{nullptr};
-        CUIAHelper::Event event{CUIAHelper::NoCuiaEvent};
-        int originId{-1};
-        ZynthboxBasics::Track track{ZynthboxBasics::CurrentTrack};
-        ZynthboxBasics::Slot slot{ZynthboxBasics::CurrentSlot};
-        int value{0};
-        bool processed{true};
-    };
-    explicit CUIARing() {
-        Entry* entryPrevious{&ringData[CUIARingSize - 1]};
-        for (quint64 i = 0; i < CUIARingSize; ++i) {
-            entryPrevious->next = &ringData[i];
-            ringData[i].previous = entryPrevious;
-            entryPrevious = &ringData[i];
-        }
-        readHead = writeHead = ringData;
-    }
+    explicit CUIARing()
+        : LockFreeRing("CUIARing")
+    {}
     ~CUIARing() {
     }
 
+    using LockFreeRing::write;
     void write(const CUIAHelper::Event &event, const int &originId, const ZynthboxBasics::Track &track = ZynthboxBasics::CurrentTrack, const ZynthboxBasics::Slot &slot = ZynthboxBasics::CurrentSlot, const double &value = 0) {
-        Entry *entry = writeHead;
-        writeHead = writeHead->next;
-        if (entry->processed == false) {
-            qWarning() << Q_FUNC_INFO << "There is unprocessed data at the write location:" << entry->event << "This likely means the buffer size is too small, which will require attention at the api level.";
-        }
-        entry->event = event;
-        entry->originId = originId;
-        entry->track = track;
-        entry->slot = slot;
-        entry->value = value;
-        entry->processed = false;
+        write([&event, &originId, &track, &slot, &value](CUIARingEntry &entry) {
+            entry.event = event;
+            entry.originId = originId;
+            entry.track = track;
+            entry.slot = slot;
+            entry.value = value;
+        });
     }
+    using LockFreeRing::read;
     CUIAHelper::Event read(int *originId = nullptr, ZynthboxBasics::Track *track = nullptr, ZynthboxBasics::Slot *slot = nullptr, int *value = nullptr) {
-        Entry *entry = readHead;
-        readHead = readHead->next;
-        CUIAHelper::Event event = entry->event;
-        entry->event = CUIAHelper::NoCuiaEvent;
-        if (originId) {
-            *originId = entry->originId;
-        }
-        if (track) {
-            *track = entry->track;
-        }
-        if (slot) {
-            *slot = entry->slot;
-        }
-        if (value) {
-            *value = entry->value;
+        CUIAHelper::Event event{CUIAHelper::NoCuiaEvent};
+        const CUIARingEntry *entry{peek()};
+        if (entry) {
+            event = entry->event;
+            if (originId) {
+                *originId = entry->originId;
+            }
+            if (track) {
+                *track = entry->track;
+            }
+            if (slot) {
+                *slot = entry->slot;
+            }
+            if (value) {
+                *value = entry->value;
+            }
+            markAsRead();
         }
-        entry->processed = true;
         return event;
     }
-
-    Entry *readHead{nullptr};
-    Entry *writeHead{nullptr};
-private:
-    Entry ringData[CUIARingSize];
 };
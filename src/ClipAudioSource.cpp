@@ -30,6 +30,7 @@
 #include "JackPassthroughFilter.h"
 #include "MidiRouterDeviceModel.h"
 #include "SamplerSynth.h"
+#include "StereoBiquadCascade.h"
 #include "SyncTimer.h"
 #include "Plugin.h"
 
@@ -68,13 +69,9 @@ public:
             equaliserSettings[equaliserBand]->setNext(equaliserSettings[equaliserBand + 1]);
         }
     }
-    // A bit awkward perhaps, but... this is a variadic template, and there's no indexed access, just a template one, so... alright
-    equaliserSettings[0]->setDspObjects(&filterChain[0].get<0>(), &filterChain[1].get<0>());
-    equaliserSettings[1]->setDspObjects(&filterChain[0].get<1>(), &filterChain[1].get<1>());
-    equaliserSettings[2]->setDspObjects(&filterChain[0].get<2>(), &filterChain[1].get<2>());
-    equaliserSettings[3]->setDspObjects(&filterChain[0].get<3>(), &filterChain[1].get<3>());
-    equaliserSettings[4]->setDspObjects(&filterChain[0].get<4>(), &filterChain[1].get<4>());
-    equaliserSettings[5]->setDspObjects(&filterChain[0].get<5>(), &filterChain[1].get<5>());
+    for (int equaliserBand = 0; equaliserBand < equaliserBandCount; ++equaliserBand) {
+        equaliserSettings[equaliserBand]->setDspObjects(&filterChain, equaliserBand);
+    }
     equaliserFrequencies.resize(300);
     for (size_t i = 0; i < equaliserFrequencies.size(); ++i) {
         equaliserFrequencies[i] = 20.0 * std::pow(2.0, i / 30.0);
@@ -129,23 +126,17 @@ public:
   std::vector<double> equaliserFrequencies;
   QList<JackPassthroughAnalyser*> equaliserInputAnalysers{nullptr,nullptr};
   QList<JackPassthroughAnalyser*> equaliserOutputAnalysers{nullptr,nullptr};
-  dsp::ProcessorChain<dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>> filterChain[2];
+  StereoBiquadCascade filterChain;
   void bypassUpdater() {
-      for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
-          soloedFilter = nullptr;
-          for (JackPassthroughFilter *filter : equaliserSettings) {
-              if (filter->soloed()) {
-                  soloedFilter = filter;
-                  break;
-              }
+      soloedFilter = nullptr;
+      for (JackPassthroughFilter *filter : equaliserSettings) {
+          if (filter->soloed()) {
+              soloedFilter = filter;
+              break;
           }
-          // A bit awkward perhaps, but... this is a variadic template, and there's no indexed access, just a template one, so... alright
-          filterChain[channelIndex].setBypassed<0>((soloedFilter == equaliserSettings[0]) == false && equaliserSettings[0]->active() == false);
-          filterChain[channelIndex].setBypassed<1>((soloedFilter == equaliserSettings[1]) == false && equaliserSettings[1]->active() == false);
-          filterChain[channelIndex].setBypassed<2>((soloedFilter == equaliserSettings[2]) == false && equaliserSettings[2]->active() == false);
-          filterChain[channelIndex].setBypassed<3>((soloedFilter == equaliserSettings[3]) == false && equaliserSettings[3]->active() == false);
-          filterChain[channelIndex].setBypassed<4>((soloedFilter == equaliserSettings[4]) == false && equaliserSettings[4]->active() == false);
-          filterChain[channelIndex].setBypassed<5>((soloedFilter == equaliserSettings[5]) == false && equaliserSettings[5]->active() == false);
+      }
+      for (int equaliserBand = 0; equaliserBand < equaliserBandCount; ++equaliserBand) {
+          filterChain.setBandEnabled(equaliserBand, soloedFilter == equaliserSettings[equaliserBand] || equaliserSettings[equaliserBand]->active());
       }
   }
 
@@ -1098,18 +1089,18 @@ void ClipAudioSource::finaliseProcess(jack_default_audio_sample_t** inputBuffers
 {
   if (d->equaliserEnabled) {
     for (JackPassthroughFilter *filter : d->equaliserSettings) {
-      filter->updateCoefficients();
+      filter->updateCoefficients(int(bufferLenth));
     }
+    juce::AudioBuffer<float> bufferWrappers[2]{{&inputBuffers[0], 1, int(bufferLenth)}, {&inputBuffers[1], 1, int(bufferLenth)}};
     for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
-      juce::AudioBuffer<float> bufferWrapper(&inputBuffers[channelIndex], 1, int(bufferLenth));
-      juce::dsp::AudioBlock<float> block(bufferWrapper);
-      juce::dsp::ProcessContextReplacing<float> context(block);
       if (d->equaliserInputAnalysers[channelIndex]) {
-        d->equaliserInputAnalysers[channelIndex]->addAudioData(bufferWrapper, 0, 1);
+        d->equaliserInputAnalysers[channelIndex]->addAudioData(bufferWrappers[channelIndex], 0, 1);
       }
-      d->filterChain[channelIndex].process(context);
+    }
+    d->filterChain.process(inputBuffers[0], inputBuffers[1], int(bufferLenth));
+    for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
       if (d->equaliserOutputAnalysers[channelIndex]) {
-        d->equaliserOutputAnalysers[channelIndex]->addAudioData(bufferWrapper, 0, 1);
+        d->equaliserOutputAnalysers[channelIndex]->addAudioData(bufferWrappers[channelIndex], 0, 1);
       }
     }
   }
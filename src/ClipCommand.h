@@ -4,6 +4,8 @@
 #include <QDebug>
 #include <atomic>
 
+#include "LockFreeRing.h"
+
 class ClipAudioSource;
 /**
  * \brief Used to schedule clips into the timer's playback queue
@@ -102,60 +104,52 @@ struct ClipCommand {
 };
 
 #define ClipCommandRingSize 4096
-class ClipCommandRing {
+struct ClipCommandRingEntry {
+    ClipCommand *clipCommand{nullptr};
+    quint64 timestamp{0};
+};
+/**
+ * \brief A ring for passing clip commands between threads (see LockFreeRing)
+ * This may be written to from any number of threads, but only read from one
+ */
+class ClipCommandRing : public LockFreeRing<ClipCommandRingEntry, ClipCommandRingSize, LockFreeRingWriters::MultipleWriters> {
 public:
-    struct Entry {
-        Entry *next{nullptr};
-        Entry *previous{nullptr};
-        ClipCommand *clipCommand{nullptr};
-        quint64 timestamp;
-        bool processed{true};
-    };
-    explicit ClipCommandRing() {
-        Entry* entryPrevious{&ringData[ClipCommandRingSize - 1]};
-        for (quint64 i = 0; i < ClipCommandRingSize; ++i) {
-            entryPrevious->next = &ringData[i];
-            ringData[i].previous = entryPrevious;
-            entryPrevious = &ringData[i];
-        }
-        readHead = writeHead = ringData;
-    }
+    explicit ClipCommandRing()
+        : LockFreeRing("ClipCommandRing")
+    {}
     ~ClipCommandRing() {
     }
 
-    void write(ClipCommand *command, quint64 timestamp) {
-        while (processFlag.test_and_set()) {
-            // spin while we wait for our guard to be released
-        }
-        Entry *entry = writeHead;
-        writeHead = writeHead->next;
-        if (entry->processed == false) {
-            qWarning() << Q_FUNC_INFO << "There is unprocessed data at the write location:" << entry->clipCommand << "This likely means the buffer size is too small, which will require attention at the api level.";
-        }
-        entry->clipCommand = command;
-        entry->timestamp = timestamp;
-        entry->processed = false;
-        processFlag.clear();
+    using LockFreeRing::write;
+    /**
+     * \brief Write the clip command into the ring
+     * @param command The clip command to write
+     * @param timestamp The timestamp to pass along with the command
+     * @return True if the command was written, or false if the ring was full (in which case the caller still owns the command, and must deal with it, usually by passing it to SyncTimer::deleteClipCommand())
+     */
+    bool write(ClipCommand *command, quint64 timestamp) {
+        return write([command, timestamp](ClipCommandRingEntry &entry) {
+            entry.clipCommand = command;
+            entry.timestamp = timestamp;
+        });
     }
+    using LockFreeRing::read;
+    /**
+     * \brief Read the oldest unread clip command out of the ring
+     * @param timestamp If given, this will be set to the timestamp the command was written with
+     * @return The clip command, or nullptr if there was nothing to read
+     */
     ClipCommand *read(quint64 *timestamp = nullptr) {
-        while (processFlag.test_and_set()) {
-            // spin while we wait for our guard to be released
-        }
-        Entry *entry = readHead;
-        readHead = readHead->next;
-        if (timestamp) {
-            *timestamp = entry->timestamp;
+        ClipCommand *command{nullptr};
+        ClipCommandRingEntry *entry{peek()};
+        if (entry) {
+            if (timestamp) {
+                *timestamp = entry->timestamp;
+            }
+            command = entry->clipCommand;
+            entry->clipCommand = nullptr;
+            markAsRead();
         }
-        ClipCommand *command = entry->clipCommand;
-        entry->clipCommand = nullptr;
-        entry->processed = true;
-        processFlag.clear();
         return command;
     }
-
-    Entry *readHead{nullptr};
-    Entry *writeHead{nullptr};
-private:
-    Entry ringData[ClipCommandRingSize];
-    std::atomic_flag processFlag = ATOMIC_FLAG_INIT;
 };
@@ -76,6 +76,8 @@ public:
 
     const float getMaxLevelInDecibels() { return maxLevel; }
 
+    void reset() { state = 0.0f; }
+
     void applyCharacteristicToOverShoot (float& overShoot)
     {
         if (overShoot <= -kneeHalf)
@@ -0,0 +1,224 @@
+/*
+  ==============================================================================
+
+    DSPWorkerPool.cpp
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#include "DSPWorkerPool.h"
+#include "JackThreadAffinitySetter.h"
+
+#include <QDebug>
+#include <QThread>
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <sched.h>
+#include <semaphore.h>
+
+// The most jobs handed out in one go (process() splits up larger job counts into rounds of at most this many)
+#define DSPWorkerPoolMaxJobs 256
+// How long the thread calling process() waits for the workers to pick up the jobs they have claimed, before running
+// any which have not yet been started itself (a worker which is preempted, or has not yet been scheduled, would
+// otherwise hold up the process callback for however long that lasts)
+#define DSPWorkerPoolClaimTimeoutMicroseconds 50
+
+// Let the core know we're spinning, so it can save power and give a sibling hyperthread the pipeline
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+template <typename T>
+static typename std::enable_if<std::is_integral_v<T>, T>::type from_HANDLE(Qt::HANDLE id)
+{
+    return static_cast<T>(reinterpret_cast<intptr_t>(id));
+}
+template <typename T>
+static typename std::enable_if<std::is_pointer_v<T>, T>::type from_HANDLE(Qt::HANDLE id)
+{
+    return static_cast<T>(id);
+}
+
+class DSPWorkerThread : public QThread {
+public:
+    DSPWorkerThread(DSPWorkerPoolPrivate *pool, int workerIndex, int realtimePriority)
+        : QThread()
+        , pool(pool)
+        , workerIndex(workerIndex)
+        , realtimePriority(realtimePriority)
+    {}
+    void run() override;
+    DSPWorkerPoolPrivate *pool{nullptr};
+    int workerIndex{0};
+    int realtimePriority{0};
+};
+
+class DSPWorkerPoolPrivate {
+public:
+    DSPWorkerPoolPrivate() {
+        sem_init(&wakeup, 0, 0);
+    }
+    ~DSPWorkerPoolPrivate() {
+        sem_destroy(&wakeup);
+    }
+    // Run the given job, unless someone else has already started it
+    void runJob(int jobIndex) {
+        if (jobStarted[jobIndex].exchange(true) == false) {
+            job.load()(jobIndex, context.load());
+            completedJobs.fetch_add(1);
+        }
+    }
+    // Claim and run jobs until there are none left to claim
+    void runJobs() {
+        int jobIndex{nextJob.fetch_add(1)};
+        while (jobIndex < jobCount.load()) {
+            runJob(jobIndex);
+            jobIndex = nextJob.fetch_add(1);
+        }
+    }
+    // Run one round of at most DSPWorkerPoolMaxJobs jobs, starting at the given job offset
+    void processRound(int roundJobCount);
+    QList<DSPWorkerThread*> workers;
+    sem_t wakeup;
+    std::atomic<DSPWorkerPool::JobFunction> job{nullptr};
+    std::atomic<void*> context{nullptr};
+    std::atomic<int> jobCount{0};
+    // Starts out past any job count, so a worker waking up before the first process call finds nothing to do
+    std::atomic<int> nextJob{INT_MAX / 2};
+    std::atomic<int> completedJobs{0};
+    // Set by whichever thread starts the job, so a job which has been claimed, but not yet started, by a worker can be
+    // run by the thread calling process() instead (and also so that a worker which claimed an index in a previous round,
+    // and only gets to it in this one, does not run a job which someone else already has)
+    std::atomic<bool> jobStarted[DSPWorkerPoolMaxJobs];
+    std::atomic<bool> aborted{false};
+    // The job function and context for the current process() call, and the offset of the current round's jobs
+    DSPWorkerPool::JobFunction processJob{nullptr};
+    void *processContext{nullptr};
+    int roundOffset{0};
+};
+
+// Rounds after the first are run through this, so the job indices passed on are the ones the caller asked for
+static void runOffsetJob(int jobIndex, void *context)
+{
+    DSPWorkerPoolPrivate *d{static_cast<DSPWorkerPoolPrivate*>(context)};
+    d->processJob(d->roundOffset + jobIndex, d->processContext);
+}
+
+void DSPWorkerPoolPrivate::processRound(int roundJobCount)
+{
+    if (roundOffset == 0) {
+        job.store(processJob);
+        context.store(processContext);
+    } else {
+        job.store(&runOffsetJob);
+        context.store(this);
+    }
+    jobCount.store(roundJobCount);
+    completedJobs.store(0);
+    for (int jobIndex = 0; jobIndex < roundJobCount; ++jobIndex) {
+        jobStarted[jobIndex].store(false);
+    }
+    // Storing this last is what opens up the jobs for claiming
+    nextJob.store(0);
+    // No reason to wake up more workers than there are jobs for them to do (as we do one ourselves)
+    const int workersToWake{qMin(workers.count(), roundJobCount - 1)};
+    for (int workerIndex = 0; workerIndex < workersToWake; ++workerIndex) {
+        sem_post(&wakeup);
+    }
+    runJobs();
+    // Any jobs not yet completed have been claimed by a worker, which should be done with them shortly, so give them a moment
+    const std::chrono::steady_clock::time_point claimDeadline{std::chrono::steady_clock::now() + std::chrono::microseconds(DSPWorkerPoolClaimTimeoutMicroseconds)};
+    int spinCount{0};
+    while (completedJobs.load() < roundJobCount) {
+        cpuRelax();
+        // Only check the clock every so often, as that is much more expensive than the relax hint
+        if ((++spinCount & 63) == 0 && std::chrono::steady_clock::now() > claimDeadline) {
+            // Some worker is taking its time getting to a job it claimed, so do whatever has not yet been started ourselves
+            for (int jobIndex = 0; jobIndex < roundJobCount; ++jobIndex) {
+                runJob(jobIndex);
+            }
+            // Anything left is now actually being worked on by a worker, and we have no choice but to wait for it to finish
+            while (completedJobs.load() < roundJobCount) {
+                cpuRelax();
+            }
+        }
+    }
+    // Close the jobs again, so a worker which is woken late does not attempt to pick up anything. There is no need to wait
+    // for the workers to notice: one which claimed an index in this round and only gets to it later will find the job has
+    // been started already (see runJob())
+    nextJob.store(INT_MAX / 2);
+}
+
+void DSPWorkerThread::run()
+{
+    const pthread_t threadId{from_HANDLE<pthread_t>(currentThreadId())};
+    zl_set_dsp_worker_thread_affinity(threadId, workerIndex);
+    if (realtimePriority > 0) {
+        struct sched_param param;
+        param.sched_priority = realtimePriority;
+        if (pthread_setschedparam(threadId, SCHED_FIFO, &param) != 0) {
+            qWarning() << Q_FUNC_INFO << "Failed to set realtime priority" << realtimePriority << "for DSP worker" << workerIndex;
+        }
+    }
+    while (true) {
+        sem_wait(&pool->wakeup);
+        if (pool->aborted) {
+            break;
+        }
+        pool->runJobs();
+    }
+}
+
+DSPWorkerPool::DSPWorkerPool(const QString &name, int workerCount, int realtimePriority)
+    : d(new DSPWorkerPoolPrivate)
+{
+    for (std::atomic<bool> &jobStarted : d->jobStarted) {
+        jobStarted = true;
+    }
+    // Work out which cores the workers go on before starting any of them
+    zl_dsp_worker_cores();
+    if (workerCount <= 0) {
+        workerCount = qMax(0, QThread::idealThreadCount() - 1);
+    }
+    for (int workerIndex = 0; workerIndex < workerCount; ++workerIndex) {
+        DSPWorkerThread *worker = new DSPWorkerThread(d, workerIndex, realtimePriority);
+        worker->setObjectName(QString("%1 Worker %2").arg(name).arg(workerIndex + 1));
+        worker->start();
+        d->workers << worker;
+    }
+}
+
+DSPWorkerPool::~DSPWorkerPool()
+{
+    d->aborted = true;
+    for (int workerIndex = 0; workerIndex < d->workers.count(); ++workerIndex) {
+        sem_post(&d->wakeup);
+    }
+    for (DSPWorkerThread *worker : qAsConst(d->workers)) {
+        worker->wait();
+        delete worker;
+    }
+    delete d;
+}
+
+int DSPWorkerPool::workerCount() const
+{
+    return d->workers.count();
+}
+
+void DSPWorkerPool::process(JobFunction job, void* context, int jobCount)
+{
+    d->processJob = job;
+    d->processContext = context;
+    for (d->roundOffset = 0; d->roundOffset < jobCount; d->roundOffset += DSPWorkerPoolMaxJobs) {
+        d->processRound(qMin(DSPWorkerPoolMaxJobs, jobCount - d->roundOffset));
+    }
+}
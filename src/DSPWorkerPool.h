@@ -0,0 +1,55 @@
+/*
+  ==============================================================================
+
+    DSPWorkerPool.h
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <QString>
+
+class DSPWorkerPoolPrivate;
+/**
+ * \brief A small pool of realtime worker threads which share the work of a single process callback
+ *
+ * Each job is identified only by its index, and jobs are claimed by the participating threads one at a
+ * time, so a thread which finishes its job early simply picks up the next one (meaning uneven jobs, such
+ * as a mix of idle and busy lanes, still spread evenly across the workers). The thread calling process()
+ * takes part in the work as well, and the call returns once every job has been completed. If a worker has claimed
+ * a job, but not started it within a short while (say, because it was preempted), the calling thread runs it instead.
+ *
+ * The workers run at the realtime priority passed in on construction, and each is pinned to its own DSP
+ * core (see zl_set_dsp_worker_thread_affinity).
+ *
+ * @note Only one thread may call process() on any given pool at a time
+ */
+class DSPWorkerPool {
+public:
+    typedef void (*JobFunction)(int jobIndex, void *context);
+    /**
+     * \brief Create a pool with the given number of workers (zero or below means one fewer than there are cores)
+     * @param name The name used for the worker threads (shown in e.g. top's thread view)
+     * @param workerCount The number of worker threads to start (in addition to the thread which calls process())
+     * @param realtimePriority The SCHED_FIFO priority for the workers (this should match the priority of the thread calling process())
+     */
+    explicit DSPWorkerPool(const QString &name, int workerCount, int realtimePriority);
+    ~DSPWorkerPool();
+
+    /**
+     * \brief The number of worker threads in the pool (not counting the thread calling process())
+     */
+    int workerCount() const;
+
+    /**
+     * \brief Run the given job function once for each index from 0 to jobCount - 1, and return once all are completed
+     * @param job The function to call for each job (this must be realtime safe, as it will be called on realtime threads)
+     * @param context Passed through to the job function
+     * @param jobCount The number of jobs to run
+     */
+    void process(JobFunction job, void *context, int jobCount);
+private:
+    DSPWorkerPoolPrivate *d{nullptr};
+};
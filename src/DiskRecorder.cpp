@@ -0,0 +1,244 @@
+/*
+  ==============================================================================
+
+    DiskRecorder.cpp
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#include "DiskRecorder.h"
+
+#include <QDebug>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <chrono>
+
+// The size of each stream's fifo, in frames (2^20 frames is a little under 22 seconds at 48kHz)
+static constexpr int streamFifoSize{1048576};
+// How much audio to gather up in a stream before writing it out (a little under 0.7 seconds at 48kHz)
+static constexpr int writeBatchSize{32768};
+// The size of the buffer between the wav writer and the file, so the writes that actually reach the disk are large ones
+static constexpr size_t fileBufferSize{262144};
+// How long to wait between checking on the streams, when there's nothing which needs writing right away
+static constexpr int idleWaitMilliseconds{20};
+
+DiskRecorderStream::DiskRecorderStream(AudioFormatWriter* writer, const QString& fileName, int bitRate)
+    : m_fileName(fileName)
+    , m_writer(writer)
+    , m_fifo(streamFifoSize)
+    , m_buffer(int(writer->getNumChannels()), streamFifoSize)
+    , m_bytesPerFrame(int(writer->getNumChannels()) * bitRate / 8)
+{
+    m_buffer.clear();
+}
+
+DiskRecorderStream::~DiskRecorderStream()
+{
+}
+
+bool DiskRecorderStream::write(const float** channelData, int numSamples)
+{
+    if (numSamples > m_fifo.getFreeSpace()) {
+        m_overrunCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    int start1, size1, start2, size2;
+    m_fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+    for (int channel = 0; channel < m_buffer.getNumChannels(); ++channel) {
+        if (size1 > 0) {
+            m_buffer.copyFrom(channel, start1, channelData[channel], size1);
+        }
+        if (size2 > 0) {
+            m_buffer.copyFrom(channel, start2, channelData[channel] + size1, size2);
+        }
+    }
+    m_fifo.finishedWrite(size1 + size2);
+    return true;
+}
+
+int DiskRecorderStream::channelCount() const
+{
+    return m_buffer.getNumChannels();
+}
+
+double DiskRecorderStream::sampleRate() const
+{
+    return m_writer->getSampleRate();
+}
+
+quint64 DiskRecorderStream::overrunCount() const
+{
+    return m_overrunCount.load(std::memory_order_relaxed);
+}
+
+class DiskRecorderPrivate : public juce::TimeSliceClient {
+public:
+    DiskRecorderPrivate() {}
+    ~DiskRecorderPrivate() override {}
+    juce::TimeSliceThread thread{"Disk Recorder"};
+    QMutex streamsMutex;
+    QList<DiskRecorderStream*> streams;
+
+    std::atomic<quint64> overrunCount{0};
+    std::atomic<quint64> bytesWritten{0};
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+    quint64 reportWriteCount{0};
+    quint64 reportBytesWritten{0};
+    quint64 reportNanosecondsWriting{0};
+    std::chrono::steady_clock::time_point nextReport{std::chrono::steady_clock::now()};
+#endif
+
+    // Write everything which is currently in the stream's fifo out to its file
+    void writeOut(DiskRecorderStream *stream) {
+        const int numReady{stream->m_fifo.getNumReady()};
+        int start1, size1, start2, size2;
+        stream->m_fifo.prepareToRead(numReady, start1, size1, start2, size2);
+        const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+        bool success{true};
+        if (size1 > 0) {
+            success = stream->m_writer->writeFromAudioSampleBuffer(stream->m_buffer, start1, size1);
+        }
+        if (success && size2 > 0) {
+            success = stream->m_writer->writeFromAudioSampleBuffer(stream->m_buffer, start2, size2);
+        }
+        const quint64 nanoseconds{quint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count())};
+        stream->m_fifo.finishedRead(size1 + size2);
+        if (success == false) {
+            qWarning() << Q_FUNC_INFO << "Failed to write" << size1 + size2 << "frames of audio to" << stream->m_fileName << "- the recording will be missing that audio";
+        }
+        const quint64 bytes{quint64(size1 + size2) * quint64(stream->m_bytesPerFrame)};
+        stream->m_framesWritten += quint64(size1 + size2);
+        stream->m_writeCount += 1;
+        stream->m_nanosecondsWriting += nanoseconds;
+        bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+        reportWriteCount += 1;
+        reportBytesWritten += bytes;
+        reportNanosecondsWriting += nanoseconds;
+#endif
+    }
+
+    // Close the stream's file (which writes out the final bits of the header), and report how things went
+    void close(DiskRecorderStream *stream) {
+        // Deleting the writer flushes and deletes the output stream too
+        stream->m_writer.reset();
+        const quint64 overruns{stream->overrunCount()};
+        overrunCount.fetch_add(overruns, std::memory_order_relaxed);
+        if (stream->m_discard) {
+            juce::File{stream->m_fileName.toStdString()}.deleteFile();
+        } else {
+            const double seconds{double(stream->m_nanosecondsWriting) / 1000000000.0};
+            const double megabytes{double(stream->m_framesWritten * quint64(stream->m_bytesPerFrame)) / 1048576.0};
+            qDebug() << Q_FUNC_INFO << "Finished recording" << stream->m_fileName << "-" << stream->m_framesWritten << "frames in" << stream->m_writeCount << "writes, taking" << seconds << "seconds" << (seconds > 0 ? QString("(%1 MiB/s)").arg(megabytes / seconds) : QString{});
+        }
+        if (overruns > 0) {
+            qWarning() << Q_FUNC_INFO << "The recording" << stream->m_fileName << "overran its buffer" << overruns << "times, and will be missing audio in those places. This means the disk could not keep up with the recording.";
+        }
+        delete stream;
+    }
+
+    int useTimeSlice() override {
+        bool moreToWrite{false};
+        {
+            QMutexLocker locker(&streamsMutex);
+            QMutableListIterator<DiskRecorderStream*> iterator(streams);
+            while (iterator.hasNext()) {
+                DiskRecorderStream *stream = iterator.next();
+                const bool finishing{stream->m_finishing.load(std::memory_order_acquire)};
+                const int numReady{stream->m_fifo.getNumReady()};
+                if (numReady >= writeBatchSize || (finishing && numReady > 0)) {
+                    writeOut(stream);
+                }
+                if (finishing) {
+                    close(stream);
+                    iterator.remove();
+                } else if (stream->m_fifo.getNumReady() >= writeBatchSize) {
+                    moreToWrite = true;
+                }
+            }
+        }
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+        const std::chrono::steady_clock::time_point now{std::chrono::steady_clock::now()};
+        if (nextReport <= now) {
+            nextReport = now + std::chrono::seconds(10);
+            if (reportWriteCount > 0) {
+                const double seconds{double(reportNanosecondsWriting) / 1000000000.0};
+                qInfo().nospace() << "Disk recorder: wrote " << reportBytesWritten << " bytes in " << reportWriteCount << " writes, taking " << seconds << " seconds"
+                    << " (" << (seconds > 0 ? double(reportBytesWritten) / 1048576.0 / seconds : 0) << " MiB/s), total overruns so far " << overrunCount.load();
+            }
+            reportWriteCount = reportBytesWritten = reportNanosecondsWriting = 0;
+        }
+#endif
+        return moreToWrite ? 0 : idleWaitMilliseconds;
+    }
+};
+
+DiskRecorder::DiskRecorder()
+    : d(new DiskRecorderPrivate)
+{
+    d->thread.addTimeSliceClient(d);
+    d->thread.startThread();
+}
+
+DiskRecorder::~DiskRecorder()
+{
+    d->thread.removeTimeSliceClient(d);
+    d->thread.stopThread(5000);
+    for (DiskRecorderStream *stream : qAsConst(d->streams)) {
+        if (stream->m_fifo.getNumReady() > 0) {
+            d->writeOut(stream);
+        }
+        d->close(stream);
+    }
+    delete d;
+}
+
+DiskRecorderStream * DiskRecorder::createStream(const QString& fileName, double sampleRate, int bitRate, int channelCount)
+{
+    DiskRecorderStream *stream{nullptr};
+    juce::File file{fileName.toStdString()};
+    // In case there's a file there already, get rid of it - at this point, the user should have been made aware, so we can be ruthless
+    file.deleteFile();
+    // Create our file stream, so we have somewhere to write data to
+    if (auto fileStream = std::unique_ptr<FileOutputStream>(file.createOutputStream(fileBufferSize))) {
+        // Now create a WAV writer, which will be writing to our output stream
+        WavAudioFormat wavFormat;
+        if (auto writer = wavFormat.createWriterFor(fileStream.get(), sampleRate, quint32(channelCount), bitRate, {}, 0)) {
+            fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
+            stream = new DiskRecorderStream(writer, fileName, bitRate);
+            QMutexLocker locker(&d->streamsMutex);
+            d->streams << stream;
+        }
+    }
+    if (stream == nullptr) {
+        qWarning() << Q_FUNC_INFO << "Failed to create the file or writer for a recording into" << fileName;
+    }
+    return stream;
+}
+
+void DiskRecorder::finishStream(DiskRecorderStream* stream, bool discard)
+{
+    if (stream) {
+        stream->m_discard = discard;
+        stream->m_finishing.store(true, std::memory_order_release);
+        d->thread.moveToFrontOfQueue(d);
+    }
+}
+
+juce::TimeSliceThread & DiskRecorder::thread()
+{
+    return d->thread;
+}
+
+quint64 DiskRecorder::overrunCount() const
+{
+    return d->overrunCount.load(std::memory_order_relaxed);
+}
+
+quint64 DiskRecorder::bytesWritten() const
+{
+    return d->bytesWritten.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    DiskRecorder.h
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JUCEHeaders.h"
+
+#include <QString>
+
+#include <atomic>
+
+class DiskRecorder;
+class DiskRecorderPrivate;
+/**
+ * \brief A single recording being written to disk by the DiskRecorder
+ *
+ * Audio is passed in through write(), which is safe to call from the process callback, and is picked up
+ * and written out to the file by the DiskRecorder's thread. Create streams using DiskRecorder::createStream(),
+ * and hand them back using DiskRecorder::finishStream() once you are done writing to them.
+ */
+class DiskRecorderStream {
+public:
+    /**
+     * \brief Add the given audio to the stream
+     * This is lock free, and safe to call from the process callback, but must only be called from one thread at a time
+     * @param channelData An array of one pointer per channel (if there are more channels than the stream has, the extra ones are ignored)
+     * @param numSamples The number of samples in each channel
+     * @return True if the audio was added, or false if there was not enough space for it (which is counted as an overrun)
+     */
+    bool write(const float **channelData, int numSamples);
+
+    int channelCount() const;
+    double sampleRate() const;
+    /**
+     * \brief The number of times write() was called with more audio than there was space for
+     */
+    quint64 overrunCount() const;
+private:
+    friend class DiskRecorder;
+    friend class DiskRecorderPrivate;
+    DiskRecorderStream(AudioFormatWriter *writer, const QString &fileName, int bitRate);
+    ~DiskRecorderStream();
+
+    QString m_fileName;
+    std::unique_ptr<AudioFormatWriter> m_writer;
+    juce::AbstractFifo m_fifo;
+    juce::AudioBuffer<float> m_buffer;
+    int m_bytesPerFrame{0};
+    std::atomic<bool> m_finishing{false};
+    bool m_discard{false};
+    std::atomic<quint64> m_overrunCount{0};
+    quint64 m_framesWritten{0};
+    quint64 m_writeCount{0};
+    quint64 m_nanosecondsWriting{0};
+};
+
+/**
+ * \brief The service which writes all of the disk recordings out to disk, on a single thread
+ *
+ * Rather than each recording having its own thread writing small blocks to its file as soon as any audio arrives
+ * (which, when recording all the tracks and the master at the same time, ends up as a large number of small, interleaved,
+ * writes to different files), every stream's audio is gathered in its own lock free fifo, and one thread writes out
+ * each stream in large batches (and through a large output buffer), one stream after the other.
+ *
+ * The same thread is also used by the DiskWriter instances to prepare and dispose of their recordings (see DiskWriter::armRecording()).
+ *
+ * The recorder keeps count of overruns (audio dropped because a stream's fifo was full) and of how much was written to disk,
+ * and how long that took. A summary is written to the log when each stream is finished, and when libzynthbox is built with
+ * ZYNTHBOX_MEASURE_PROCESS_TIMING, the totals are also reported every ten seconds while recording.
+ */
+class DiskRecorder {
+public:
+    static DiskRecorder* instance() {
+        static DiskRecorder* instance{nullptr};
+        if (!instance) {
+            instance = new DiskRecorder();
+        }
+        return instance;
+    };
+    explicit DiskRecorder();
+    ~DiskRecorder();
+
+    /**
+     * \brief Create the file and writer for a new recording
+     * This does filesystem work, allocates, and locks against the recorder's thread (which holds that lock while writing
+     * to disk), so must never be called from the process callback. Arm recordings ahead of time instead (see DiskWriter::armRecording())
+     * @param fileName The full path of the file to record into (an existing file will be replaced, and the directory must exist)
+     * @param sampleRate The sample rate of the audio which will be recorded
+     * @param bitRate The bit depth of the file
+     * @param channelCount The number of channels to record
+     * @return The new stream, or nullptr if the file or writer could not be created
+     */
+    DiskRecorderStream *createStream(const QString &fileName, double sampleRate, int bitRate, int channelCount);
+    /**
+     * \brief Mark the stream as finished
+     * Whatever audio remains in the stream will be written out, the file closed, and the stream deleted, on the recorder's thread.
+     * Do not call write() on the stream after calling this.
+     * @param stream The stream to finish
+     * @param discard If true, the file will be removed once it has been closed, rather than being kept
+     */
+    void finishStream(DiskRecorderStream *stream, bool discard = false);
+
+    /**
+     * \brief The thread which the recorder does its work on
+     */
+    juce::TimeSliceThread &thread();
+
+    /**
+     * \brief The total number of overruns for all the streams which have been finished so far
+     */
+    quint64 overrunCount() const;
+    /**
+     * \brief The total number of bytes of audio written to disk so far
+     */
+    quint64 bytesWritten() const;
+private:
+    DiskRecorderPrivate *d{nullptr};
+};
@@ -1,91 +1,369 @@
 #include "DiskWriter.h"
 #include "AudioLevelsChannel.h"
+#include "DiskRecorder.h"
+#include "SyncTimer.h"
 
 #include <QDebug>
 
+#include <unistd.h>
+
+/**
+ * A single recording, from being armed, through being recorded, until it has been written out to disk
+ */
+struct DiskWriterTake {
+    enum State {
+        PreparingState, // The file and writer are being created
+        ArmedState, // Ready to be started
+        StartPendingState, // Started before it was ready, and will be recording as soon as it is
+        RecordingState, // The writer is being written to by processBlock()
+        FinishedState, // Recording has been stopped, and the take can be disposed of
+        FailedState, // The file or writer could not be created
+    };
+    // The identifier used to start the take (see DiskWriter::armRecording())
+    quint64 id{0};
+    QString fileName;
+    double sampleRate{0};
+    int bitRate{0};
+    int channelCount{0};
+    DiskRecorderStream *stream{nullptr};
+    std::atomic<int> state{PreparingState};
+    // Set once the take is no longer in the armed takes (that is, once nothing other than the preparer knows about it)
+    std::atomic<bool> consumed{false};
+    bool prepared{false};
+    // Whether to remove the file when the take is disposed of (for takes which were armed, but never started)
+    bool discard{false};
+    // The DiskWriter's processBlock sequence seen when the take was first found to be finished (see DiskWriter::processBlock())
+    quint64 retireSequence{0};
+
+    ~DiskWriterTake() {
+        // The recorder writes out whatever remains of the audio, and closes the file, on its own thread
+        DiskRecorder::instance()->finishStream(stream, discard);
+    }
+    // Creates the file and writer (this does filesystem work and allocates, so must not be called from the process callback)
+    bool prepare() {
+        prepared = true;
+        stream = DiskRecorder::instance()->createStream(fileName, sampleRate, bitRate, qMin(channelCount, DISKWRITER_CHANNEL_COUNT));
+        return stream != nullptr;
+    }
+};
+
+/**
+ * Runs on the DiskRecorder's thread, and prepares armed takes, starts the ones which were started before they
+ * were ready, and disposes of the finished ones, so that none of that needs to happen on the process callback
+ */
+class DiskWriterPreparer : public juce::TimeSliceClient {
+public:
+    DiskWriterPreparer(DiskWriter *q)
+        : q(q)
+    {}
+    ~DiskWriterPreparer() override {
+        takes << q->m_newTakes;
+        q->m_newTakes.clear();
+        for (DiskWriterTake *take : qAsConst(takes)) {
+            // Armed, but never started, so don't leave an empty recording lying around
+            take->discard = take->discard || (take->state.load() == DiskWriterTake::ArmedState);
+            delete take;
+        }
+    }
+    DiskWriter *q{nullptr};
+    // All the takes which have not yet been disposed of (only touched on the recorder's thread)
+    QList<DiskWriterTake*> takes;
+
+    int useTimeSlice() override {
+        {
+            QMutexLocker locker(&q->m_newTakesMutex);
+            takes << q->m_newTakes;
+            q->m_newTakes.clear();
+        }
+        if (q->m_thumbnailResetPending.load(std::memory_order_acquire)) {
+            // Takes are only ever disposed of here, so the active take can't go away underneath us while we look at it
+            const DiskWriterTake *activeTake{q->m_activeTake.load()};
+            // processBlock leaves the thumbnail alone while the reset is pending, so this is safe to do from here
+            if (activeTake) {
+                q->m_audioLevelsChannel->m_thumbnail.reset(qMin(activeTake->channelCount, DISKWRITER_CHANNEL_COUNT), activeTake->sampleRate);
+            }
+            q->m_audioLevelsChannel->m_nextSampleNum = 0;
+            q->m_thumbnailResetPending.store(false, std::memory_order_release);
+        }
+        QMutableListIterator<DiskWriterTake*> iterator(takes);
+        while (iterator.hasNext()) {
+            DiskWriterTake *take = iterator.next();
+            if (take->prepared == false) {
+                if (take->state.load() == DiskWriterTake::FinishedState) {
+                    // Disarmed before we got to it, so there is no file to create
+                    take->prepared = true;
+                } else if (take->prepare()) {
+                    int expected{DiskWriterTake::PreparingState};
+                    if (take->state.compare_exchange_strong(expected, DiskWriterTake::ArmedState) == false) {
+                        // Then it was started before it was ready, so hand it over to processBlock now (unless it was stopped in the meantime)
+                        expected = DiskWriterTake::StartPendingState;
+                        take->state.compare_exchange_strong(expected, DiskWriterTake::RecordingState);
+                    }
+                } else {
+                    take->state = DiskWriterTake::FailedState;
+                    // If it was started before we got here, it will be the active take, so stop that (startArmedRecording() sets
+                    // the active take before changing the state, so if it has not yet done so, it will see the failure and back out)
+                    DiskWriterTake *expected{take};
+                    if (q->m_activeTake.compare_exchange_strong(expected, nullptr)) {
+                        q->m_isRecordingChangedPending = true;
+                    }
+                }
+                --q->m_preparingTakeCount;
+            }
+            const int state{take->state.load()};
+            // Something looking through the armed takes may have found this one just before it was taken out of them, so
+            // also make sure nothing is doing that (anything which starts looking after this point will not find it)
+            if (take->consumed.load() && (state == DiskWriterTake::FinishedState || state == DiskWriterTake::FailedState) && q->m_armedTakeReaders.load() == 0) {
+                // processBlock() may still be writing to the take's stream if it started before the take was stopped, so
+                // only let go of it once we know it isn't (that is, if processBlock() is not running, or has moved on to
+                // another call since we last looked)
+                const quint64 sequence{q->m_processBlockSequence.load()};
+                if ((sequence & 1) == 0 || (take->retireSequence != 0 && take->retireSequence != sequence)) {
+                    delete take;
+                    iterator.remove();
+                } else {
+                    take->retireSequence = sequence;
+                }
+            }
+        }
+        // While there are takes around, we need to be responsive to them being started and stopped, otherwise just check in occasionally
+        return takes.isEmpty() ? 100 : 10;
+    }
+};
+
 DiskWriter::DiskWriter(AudioLevelsChannel *audioLevelsChannel)
     : m_audioLevelsChannel(audioLevelsChannel)
 {
-    m_backgroundThread.startThread();
+    for (std::atomic<DiskWriterTake*> &armedTake : m_armedTakes) {
+        armedTake = nullptr;
+    }
+    m_preparer = new DiskWriterPreparer(this);
+    DiskRecorder::instance()->thread().addTimeSliceClient(m_preparer);
 }
 
 DiskWriter::~DiskWriter() {
     stop();
+    DiskRecorder::instance()->thread().removeTimeSliceClient(m_preparer);
+    delete m_preparer;
 }
 
 void DiskWriter::startRecording(const QString& fileName, double sampleRate, int bitRate, int channelCount) {
-    m_fileName = fileName;
-    m_file = juce::File(fileName.toStdString());
-    m_sampleRate = sampleRate;
-    if (m_sampleRate > 0) {
-        // In case there's a file there already, get rid of it - at this point, the user should have been made aware, so we can be ruthless
-        m_file.deleteFile();
-        // Create our file stream, so we have somewhere to write data to
-        if (auto fileStream = std::unique_ptr<FileOutputStream>(m_file.createOutputStream())) {
-            // Now create a WAV writer, which will be writing to our output stream
-            WavAudioFormat wavFormat;
-            if (auto writer = wavFormat.createWriterFor(fileStream.get(), sampleRate, quint32(qMin(channelCount, DISKWRITER_CHANNEL_COUNT)), bitRate, {}, 0)) {
-                fileStream.release(); // (passes responsibility for deleting the stream to the writer object that is now using it)
-                // Now we'll create one of these helper objects which will act as a FIFO buffer, and will
-                // write the data to disk on our background thread.
-                // A buffer of size 2^20 should hopefully do us reasonably well (this will, when recording all ten tracks plus the song itself, use a total of 11'534'336 bytes of space)
-                m_threadedWriter.reset(new AudioFormatWriter::ThreadedWriter(writer, m_backgroundThread, 1048576));
-
-                // Reset our thumbnail, so we don't carry over any old recording information and the like
-                m_audioLevelsChannel->m_thumbnail.reset(writer->getNumChannels(), writer->getSampleRate());
-                m_audioLevelsChannel->m_nextSampleNum = 0;
-
-                // And now, swap over our active writer pointer so that the audio callback will start using it..
-                const ScopedLock sl (m_writerLock);
-                m_activeWriter = m_threadedWriter.get();
-                m_audioLevelsChannel->lastRecordingFrame = ULONG_LONG_MAX;
-                m_isRecording = true;
-                Q_EMIT isRecordingChanged();
+    if (sampleRate > 0) {
+        DiskWriterTake *take = new DiskWriterTake;
+        take->fileName = fileName;
+        take->sampleRate = sampleRate;
+        take->bitRate = bitRate;
+        take->channelCount = channelCount;
+        take->consumed = true;
+        if (take->prepare()) {
+            // Reset our thumbnail, so we don't carry over any old recording information and the like
+            m_audioLevelsChannel->m_thumbnail.reset(take->stream->channelCount(), take->stream->sampleRate());
+            m_audioLevelsChannel->m_nextSampleNum = 0;
+            // Stop whatever we were doing before, and then swap over our active take so that the audio callback will start using it..
+            if (isRecording()) {
+                stop();
+            }
+            take->state = DiskWriterTake::RecordingState;
+            m_fileName = fileName;
+            m_sampleRate = sampleRate;
+            m_audioLevelsChannel->lastRecordingFrame = ULONG_LONG_MAX;
+            m_activeTake = take;
+            m_isRecordingChangedPending = true;
+        } else {
+            take->state = DiskWriterTake::FailedState;
+        }
+        // Hand it to the preparer, which will dispose of it once it's done
+        QMutexLocker locker(&m_newTakesMutex);
+        m_newTakes << take;
+    }
+}
+
+quint64 DiskWriter::createTakeId()
+{
+    static std::atomic<quint64> nextTakeId{1};
+    return nextTakeId++;
+}
+
+bool DiskWriter::armRecording(const quint64 &takeId, const QString& fileName, double sampleRate, int bitRate, int channelCount)
+{
+    bool armed{false};
+    if (sampleRate > 0) {
+        DiskWriterTake *take = new DiskWriterTake;
+        take->id = takeId;
+        take->fileName = fileName;
+        take->sampleRate = sampleRate;
+        take->bitRate = bitRate;
+        take->channelCount = channelCount;
+        // Add it to the armed takes first, so the preparer can't dispose of it before the process callback has had a chance to see it
+        for (std::atomic<DiskWriterTake*> &armedTake : m_armedTakes) {
+            DiskWriterTake *expected{nullptr};
+            if (armedTake.compare_exchange_strong(expected, take)) {
+                ++m_armedTakeCount;
+                ++m_preparingTakeCount;
+                armed = true;
+                break;
             }
         }
+        if (armed == false) {
+            qWarning() << Q_FUNC_INFO << "Attempted to arm a recording into" << fileName << "but there were already" << DISKWRITER_ARMED_RECORDING_COUNT << "armed recordings";
+            take->consumed = true;
+            take->prepared = true;
+            take->state = DiskWriterTake::FailedState;
+        }
+        QMutexLocker locker(&m_newTakesMutex);
+        m_newTakes << take;
+        DiskRecorder::instance()->thread().moveToFrontOfQueue(m_preparer);
+    }
+    return armed;
+}
+
+bool DiskWriter::startArmedRecording(const quint64 &takeId)
+{
+    DiskWriterTake *take{nullptr};
+    ++m_armedTakeReaders;
+    for (std::atomic<DiskWriterTake*> &armedTake : m_armedTakes) {
+        DiskWriterTake *candidate{armedTake.load()};
+        if (candidate && candidate->id == takeId && armedTake.compare_exchange_strong(candidate, nullptr)) {
+            take = candidate;
+            break;
+        }
+    }
+    --m_armedTakeReaders;
+    if (take) {
+        --m_armedTakeCount;
+        // Stop whatever we were doing before
+        if (isRecording()) {
+            stop();
+        }
+        // This is made the active take before its state changes, so that if the preparer fails to create its stream in the
+        // meantime, it finds the take here and clears it again (processBlock() only writes to takes which are recording)
+        m_activeTake = take;
+        int expected{DiskWriterTake::ArmedState};
+        bool started{false};
+        if (take->state.compare_exchange_strong(expected, DiskWriterTake::RecordingState)) {
+            started = true;
+        } else if (expected == DiskWriterTake::PreparingState && take->state.compare_exchange_strong(expected, DiskWriterTake::StartPendingState)) {
+            // The preparer will set this one to recording once it's ready
+            started = true;
+        }
+        if (started) {
+            // This is implicitly shared, so the assignment does not allocate
+            m_fileName = take->fileName;
+            m_sampleRate = take->sampleRate;
+            m_thumbnailResetPending.store(true, std::memory_order_release);
+            m_audioLevelsChannel->lastRecordingFrame = ULONG_LONG_MAX;
+        } else {
+            // Preparing the take failed, so there's nothing to record into
+            DiskWriterTake *activeTake{take};
+            m_activeTake.compare_exchange_strong(activeTake, nullptr);
+        }
+        m_isRecordingChangedPending = true;
+        take->consumed = true;
+        return started;
     }
+    return false;
+}
+
+bool DiskWriter::disarmRecording(const quint64 &takeId)
+{
+    bool disarmed{false};
+    ++m_armedTakeReaders;
+    for (std::atomic<DiskWriterTake*> &armedTake : m_armedTakes) {
+        DiskWriterTake *take{armedTake.load()};
+        if (take && (takeId == 0 || take->id == takeId) && armedTake.compare_exchange_strong(take, nullptr)) {
+            --m_armedTakeCount;
+            // The take was never started, so have the preparer remove the file when it disposes of it (or not create it at all, if it has not yet done so)
+            take->discard = true;
+            take->state = DiskWriterTake::FinishedState;
+            take->consumed = true;
+            disarmed = true;
+        }
+    }
+    --m_armedTakeReaders;
+    return disarmed;
+}
+
+bool DiskWriter::hasArmedRecording(const quint64 &takeId) const
+{
+    bool found{false};
+    ++m_armedTakeReaders;
+    for (const std::atomic<DiskWriterTake*> &armedTake : m_armedTakes) {
+        const DiskWriterTake *take{armedTake.load()};
+        if (take && take->id == takeId) {
+            found = true;
+            break;
+        }
+    }
+    --m_armedTakeReaders;
+    return found;
+}
+
+int DiskWriter::armedRecordingCount() const
+{
+    return m_armedTakeCount;
+}
+
+int DiskWriter::preparingRecordingCount() const
+{
+    return m_preparingTakeCount;
 }
 
 // The input data must be an array with the same number of channels as the writer expects (that is, in our general case DISKWRITER_CHANNEL_COUNT)
 void DiskWriter::processBlock(const float** inputChannelData, int numSamples) const {
-    const ScopedLock sl (m_writerLock);
-    if (m_activeWriter.load() != nullptr) {
-        if (m_activeWriter.load()->write(inputChannelData, numSamples) == false) {
-            qWarning() << Q_FUNC_INFO << "Attempted to write data, but did not have the space to do so. This will result in a glitchy recording, and means we should be using a larger buffer.";
+    // Rather than locking, let the preparer know whether we're currently in here (the sequence is odd while we are),
+    // so it can tell when it is safe to dispose of a stream which has been stopped
+    ++m_processBlockSequence;
+    const DiskWriterTake *take{m_activeTake.load()};
+    if (take != nullptr && take->state.load() == DiskWriterTake::RecordingState) {
+        DiskRecorderStream *stream{take->stream};
+        while (stream->write(inputChannelData, numSamples) == false) {
+            if (SyncTimer::instance()->freewheeling()) {
+                // When rendering offline we can easily outrun the disk, but we're also not realtime, so just wait for the recorder's thread to catch up
+                usleep(1000);
+            } else {
+                qWarning() << Q_FUNC_INFO << "Attempted to write data, but did not have the space to do so. This will result in a glitchy recording, and means we should be using a larger buffer.";
+                break;
+            }
         }
         // There's no reason to do the thumbnailery stuff if there's no listeners...
         // If one dips in later, this will result in the thumbnail being out of
         // sync, but we'd rather be light weight than purely correctly visualised
         // for this particular case. For now, at least, we can easily revisit this.
-        if (m_audioLevelsChannel->m_thumbnailListenerCount > 0) {
+        // The same goes for the few milliseconds before the thumbnail has been reset for a newly started recording.
+        if (m_audioLevelsChannel->m_thumbnailListenerCount > 0 && m_thumbnailResetPending.load(std::memory_order_acquire) == false) {
             // Create an AudioBuffer to wrap our incoming data, note that this does no allocations or copies, it simply references our input data
             AudioBuffer<float> buffer (const_cast<float**> (inputChannelData), m_audioLevelsChannel->m_thumbnail.getNumChannels(), numSamples);
             m_audioLevelsChannel->m_thumbnail.addBlock(m_audioLevelsChannel->m_nextSampleNum, buffer, 0, numSamples);
             m_audioLevelsChannel->m_nextSampleNum += numSamples;
         }
     }
+    ++m_processBlockSequence;
 }
 
 void DiskWriter::stop() {
-    // First, clear this pointer to stop the audio callback from using our writer object..
-    {
-        const ScopedLock sl(m_writerLock);
-        m_activeWriter = nullptr;
-        m_sampleRate = 0;
-        m_audioLevelsChannel->lastRecordingFrame = ULONG_LONG_MAX;
-        m_isRecording = false;
-        Q_EMIT isRecordingChanged();
+    static const QString defaultFileNameSuffix{".wav"};
+    // Clear the active take to stop the audio callback from using its stream, and hand the take back
+    // to the preparer, which will dispose of it (and so finish writing it out) on the recorder's thread
+    DiskWriterTake *take{m_activeTake.exchange(nullptr)};
+    if (take) {
+        take->state = DiskWriterTake::FinishedState;
     }
+    m_sampleRate = 0;
+    m_audioLevelsChannel->lastRecordingFrame = ULONG_LONG_MAX;
+    m_isRecordingChangedPending = true;
+    // Assigning from a shared string, so this does not allocate (stop is commonly called from the process callback)
+    m_fileNameSuffix = defaultFileNameSuffix;
+}
 
-    // Now we can delete the writer object. It's done in this order because the deletion could
-    // take a little time while remaining data gets flushed to disk, so it's best to avoid blocking
-    // the audio callback while this happens.
-    m_threadedWriter.reset();
-    m_fileNameSuffix = ".wav";
+bool DiskWriter::isRecording() const {
+    return m_activeTake.load() != nullptr;
 }
 
-const bool &DiskWriter::isRecording() const {
-    return m_isRecording;
+void DiskWriter::emitPendingChanges()
+{
+    if (m_isRecordingChangedPending.exchange(false)) {
+        Q_EMIT isRecordingChanged();
+    }
 }
 
 const QString &DiskWriter::filenamePrefix() const {
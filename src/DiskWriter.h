@@ -2,28 +2,103 @@
 
 #include "JUCEHeaders.h"
 
+#include <QMutex>
 #include <QObject>
 #include <QString>
 
+#include <atomic>
+
 // that is one left and one right channel
 #define DISKWRITER_CHANNEL_COUNT 2
+// The number of recordings which can be armed ahead of time on a single writer
+#define DISKWRITER_ARMED_RECORDING_COUNT 8
 
 class AudioLevelsChannel;
+class DiskRecorderStream;
+class DiskWriterPreparer;
+struct DiskWriterTake;
 class DiskWriter : public QObject {
     Q_OBJECT
 public:
     explicit DiskWriter(AudioLevelsChannel *audioLevelsChannel);
     ~DiskWriter();
 
+    /**
+     * \brief Start recording into the given file immediately
+     * @note This creates the file and the writer before returning, so do not call this from the process callback (use armRecording() and startArmedRecording() instead)
+     */
     void startRecording(const QString& fileName, double sampleRate = 44100, int bitRate = 32, int channelCount=DISKWRITER_CHANNEL_COUNT);
 
+    /**
+     * \brief Create a new identifier for an armed recording (see armRecording())
+     * The identifiers are unique across all writers, so the same one can be used to arm a recording on several writers,
+     * which can then all be started together. This never returns 0.
+     */
+    static quint64 createTakeId();
+    /**
+     * \brief Prepare a recording into the given file, so that it can later be started from the process callback
+     * The file and its writer are created on the DiskRecorder's thread, so this returns immediately. Up to
+     * DISKWRITER_ARMED_RECORDING_COUNT recordings may be armed at the same time (which allows for back-to-back
+     * recordings without having to arm each after the previous started), and each is started by its identifier.
+     * @param takeId The identifier used to start the recording (see createTakeId())
+     * @param fileName The full path of the file to record into (an existing file will be replaced, and the directory must exist)
+     * @return True if the recording was armed, or false if there were already too many armed recordings
+     * @see startArmedRecording()
+     * @see disarmRecording()
+     */
+    bool armRecording(const quint64 &takeId, const QString& fileName, double sampleRate = 44100, int bitRate = 32, int channelCount=DISKWRITER_CHANNEL_COUNT);
+    /**
+     * \brief Start the armed recording with the given identifier
+     * This is safe to call from the process callback, and does no more than hand the armed recording over to processBlock().
+     * If the armed recording has not yet finished being prepared, it will start as soon as it is.
+     * @param takeId The identifier the recording was armed with
+     * @return True if there was an armed recording with that identifier to start, or false if there was not (in which case nothing happens)
+     * @see armRecording()
+     */
+    bool startArmedRecording(const quint64 &takeId);
+    /**
+     * \brief Throw away an armed recording which is no longer going to be started
+     * The recording's file is removed, and the slot it took up is freed up for another armed recording. This is
+     * safe to call from the process callback.
+     * @param takeId The identifier the recording was armed with, or 0 to throw away all the armed recordings
+     * @return True if any armed recordings were thrown away
+     */
+    bool disarmRecording(const quint64 &takeId);
+    /**
+     * \brief Whether there is an armed recording with the given identifier, which has not yet been started
+     */
+    bool hasArmedRecording(const quint64 &takeId) const;
+    /**
+     * \brief The number of recordings which are currently armed (see armRecording())
+     */
+    int armedRecordingCount() const;
+    /**
+     * \brief The number of armed recordings whose files and writers are still being created
+     * Recordings started before they are ready will miss the audio until they are, so use this to wait for them
+     * when that matters (for example when rendering faster than realtime, see AudioLevels::bounceSong())
+     */
+    int preparingRecordingCount() const;
+
     // The input data must be an array with the same number of channels as the writer expects (that is, in our general case DISKWRITER_CHANNEL_COUNT)
     void processBlock(const float** inputChannelData, int numSamples) const;
 
+    /**
+     * \brief Stop the current recording
+     * This is safe to call from the process callback (the remaining data is written out, and the file closed, on the DiskRecorder's thread)
+     */
     void stop();
 
-    const bool &isRecording() const;
+    bool isRecording() const;
+    /**
+     * \brief Fired when the writer starts or stops recording
+     * As that commonly happens on the process callback, where emitting is not safe, this is fired by emitPendingChanges()
+     */
     Q_SIGNAL void isRecordingChanged();
+    /**
+     * \brief Fire isRecordingChanged if the writer has started or stopped recording since the last call
+     * Call this regularly on the main thread (AudioLevels does so from its analysis timer)
+     */
+    void emitPendingChanges();
 
     const QString &filenamePrefix() const;
     void setFilenamePrefix(const QString& fileNamePrefix);
@@ -33,18 +108,32 @@ public:
     const bool &shouldRecord() const;
     void setShouldRecord(bool shouldRecord);
 private:
+    friend class DiskWriterPreparer;
     QString m_fileNamePrefix;
     QString m_fileNameSuffix{".wav"};
     bool m_shouldRecord{false};
-    bool m_isRecording{false};
+    // Set whenever the active take changes, and cleared by emitPendingChanges()
+    std::atomic<bool> m_isRecordingChangedPending{false};
 
     QString m_fileName;
-    juce::File m_file;
-    juce::TimeSliceThread m_backgroundThread{"AudioLevel Disk Recorder"}; // the thread that will write our audio data to disk
-    std::unique_ptr<AudioFormatWriter::ThreadedWriter> m_threadedWriter; // the FIFO used to buffer the incoming data
     double m_sampleRate{0.0};
 
     AudioLevelsChannel *m_audioLevelsChannel{nullptr};
-    CriticalSection m_writerLock;
-    std::atomic<AudioFormatWriter::ThreadedWriter*> m_activeWriter{nullptr};
+    // Incremented on entry to, and exit from, processBlock() (so it is odd while processBlock() is running)
+    mutable std::atomic<quint64> m_processBlockSequence{0};
+    // The take currently being recorded (or waiting to be, if it was started before it was ready), which processBlock() writes to
+    // once its state is RecordingState (only the preparer disposes of takes, so it never goes away while processBlock() uses it)
+    std::atomic<DiskWriterTake*> m_activeTake{nullptr};
+    // The armed takes (set by armRecording(), and cleared by whichever of startArmedRecording() and disarmRecording() gets to them first)
+    std::atomic<DiskWriterTake*> m_armedTakes[DISKWRITER_ARMED_RECORDING_COUNT];
+    // How many calls are currently looking through the armed takes (the preparer holds on to taken takes until this is 0)
+    mutable std::atomic<int> m_armedTakeReaders{0};
+    std::atomic<int> m_armedTakeCount{0};
+    std::atomic<int> m_preparingTakeCount{0};
+    // Takes which have been created, but not yet picked up by the preparer
+    QMutex m_newTakesMutex;
+    QList<DiskWriterTake*> m_newTakes;
+    DiskWriterPreparer *m_preparer{nullptr};
+    // Set when a take has been started, until the preparer has reset the thumbnail for it
+    mutable std::atomic<bool> m_thumbnailResetPending{false};
 };
@@ -0,0 +1,72 @@
+/*
+  ==============================================================================
+
+    GraineratorGrainRendering.h
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <cstdint>
+
+/**
+ * \brief The playback state of a single Grainerator grain, and the rendering of it, kept free of the sampler's state
+ *
+ * This only works on the sample data and buffers it is handed, which means it can be run on its own (see the dspbenchmark
+ * tool, which uses it to measure the cost of rendering grains without needing jack, a sound, or a sampler).
+ */
+struct GraineratorGrainPlayback {
+    const float *inL{nullptr};
+    const float *inR{nullptr};
+    int sampleDuration{0};
+    double sourcePosition{0};
+    double increment{0};
+    // The grain's window (the grain envelope, released such that it has finished by the end of the grain)
+    juce::ADSR window;
+    uint32_t framesRendered{0};
+    uint32_t releaseFrame{0};
+    uint32_t totalFrames{0};
+    // The M/S panning coefficients with the grain's gain applied
+    float leftFromLeft{0};
+    float leftFromRight{0};
+    float rightFromLeft{0};
+    float rightFromRight{0};
+
+    /**
+     * \brief Mix the grain into the given buffers, from the given frame until the end of the buffers, or the end of the grain
+     * @param leftBuffer The left channel to mix the grain into
+     * @param rightBuffer The right channel to mix the grain into
+     * @param frame The first frame in the buffers to render the grain into
+     * @param nframes The number of frames in the buffers
+     * @param windowValue Set to the value of the window for the most recently rendered frame
+     * @return True if the grain has finished playing
+     */
+    inline bool render(float *leftBuffer, float *rightBuffer, uint32_t frame, const uint32_t nframes, float &windowValue) {
+        const int lastSampleIndex{sampleDuration - 1};
+        for (; frame < nframes; ++frame) {
+            if (framesRendered == releaseFrame) {
+                window.noteOff();
+            }
+            windowValue = window.getNextSample();
+            const int sampleIndex{int(sourcePosition)};
+            if (sampleIndex < 0 || sampleIndex >= lastSampleIndex) {
+                return true;
+            }
+            // Grains are short and windowed, so linear interpolation is plenty here
+            const float fraction{float(sourcePosition - double(sampleIndex))};
+            const float l{inL[sampleIndex] + fraction * (inL[sampleIndex + 1] - inL[sampleIndex])};
+            const float r{inR[sampleIndex] + fraction * (inR[sampleIndex + 1] - inR[sampleIndex])};
+            leftBuffer[frame] += windowValue * (l * leftFromLeft + r * leftFromRight);
+            rightBuffer[frame] += windowValue * (l * rightFromLeft + r * rightFromRight);
+            sourcePosition += increment;
+            ++framesRendered;
+            if (framesRendered >= totalFrames || window.isActive() == false) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
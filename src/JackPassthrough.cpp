@@ -9,6 +9,7 @@
 */
 
 #include "JackPassthrough.h"
+#include "DSPWorkerPool.h"
 #include "GainHandler.h"
 #include "JackPassthroughAnalyser.h"
 #include "JackPassthroughCompressor.h"
@@ -16,18 +17,39 @@
 #include "JackThreadAffinitySetter.h"
 #include "MidiRouter.h"
 #include "MidiRouterDeviceModel.h"
+#include "ProcessTiming.h"
+#include "StereoBiquadCascade.h"
 
 #include <QDebug>
 #include <QGlobalStatic>
 #include <QPolygonF>
+#include <QThread>
 
 #include <jack/jack.h>
 #include <jack/midiport.h>
 
-#define equaliserBandCount 6
+#include <atomic>
 
+#define equaliserBandCount 6
+// The largest number of passthroughs a single jack client will process (the TrackPassthrough client is the largest, with 100)
+#define JackPassthroughAggregateMaxNodes 128
+// Clients with at least this many passthroughs spread their processing across a pool of DSP worker threads
+#define JackPassthroughAggregateParallelThreshold 32
+
+/**
+ * \brief A single jack client, which runs the processing for any number of passthroughs
+ *
+ * The passthroughs list is the bookkeeping used on the main thread, and any change to it must be followed by a call
+ * to publishNodes(), which copies the list into the flat array the process callback iterates over. There are two of
+ * those arrays, and the process callback only ever sees the one which is not being written to, so adding and removing
+ * passthroughs never leaves the jack thread looking at a list in the middle of changing.
+ */
 struct JackPassthroughAggregate {
 public:
+    struct NodeList {
+        JackPassthroughPrivate *nodes[JackPassthroughAggregateMaxNodes]{nullptr};
+        int count{0};
+    };
     JackPassthroughAggregate(jack_client_t *client)
         : client(client)
     {}
@@ -35,9 +57,43 @@ public:
         if (client) {
             jack_client_close(client);
         }
+        delete workerPool.load();
+    }
+    void publishNodes() {
+        if (workerPool.load() == nullptr && client && passthroughs.count() >= JackPassthroughAggregateParallelThreshold && QThread::idealThreadCount() > 2) {
+            // The passthroughs on a client never feed each other directly (any routing between them goes through jack), so they can
+            // all be processed at the same time. We leave one core for everything else, and cap it at three workers, which is
+            // enough to get the ten sketchpad tracks' lanes through in time on our quad core devices
+            workerPool = new DSPWorkerPool(QString(jack_get_client_name(client)), qMin(3, QThread::idealThreadCount() - 2), jack_client_real_time_priority(client));
+        }
+        NodeList *inactiveNodes{activeNodes.load() == &nodeLists[0] ? &nodeLists[1] : &nodeLists[0]};
+        inactiveNodes->count = 0;
+        for (JackPassthroughPrivate *passthrough : qAsConst(passthroughs)) {
+            if (inactiveNodes->count == JackPassthroughAggregateMaxNodes) {
+                qWarning() << Q_FUNC_INFO << "Attempted to add more than" << JackPassthroughAggregateMaxNodes << "passthroughs to a single jack client, the remainder will not be processed";
+                break;
+            }
+            inactiveNodes->nodes[inactiveNodes->count] = passthrough;
+            ++inactiveNodes->count;
+        }
+        activeNodes.store(inactiveNodes);
+        // Wait for any process run which might have picked up the previous list before we swapped it out to complete,
+        // so the next call to this function can safely write to it (jack will time out a process run long before this does)
+        int waitCount{0};
+        while (inProcess.load() && waitCount < 1000) {
+            QThread::usleep(100);
+            ++waitCount;
+        }
     }
     jack_client_t *client{nullptr};
+    std::atomic<DSPWorkerPool*> workerPool{nullptr};
+    // The state for the current process run, for use by the worker pool's jobs
+    jack_nframes_t nframes{0};
+    const NodeList *processingNodes{nullptr};
     QList<JackPassthroughPrivate*> passthroughs;
+    NodeList nodeLists[2];
+    std::atomic<NodeList*> activeNodes{&nodeLists[0]};
+    std::atomic<bool> inProcess{false};
 };
 
 typedef QHash<QString, JackPassthroughAggregate*> JackClientHash;
@@ -58,6 +114,7 @@ public:
         }
         if (aggregate) {
             aggregate->passthroughs.removeAll(this);
+            aggregate->publishNodes();
             if (aggregate->passthroughs.count() == 0) {
                 jackPassthroughClients->remove(key);
                 delete aggregate;
@@ -162,27 +219,24 @@ public:
     jack_port_t *sideChainInput[2]{nullptr};
     jack_default_audio_sample_t *sideChainGain[2]{nullptr};
 
-    dsp::ProcessorChain<dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>, dsp::IIR::Filter<float>> filterChain[2];
+    StereoBiquadCascade filterChain;
+    // Whether the previous process call skipped the effects (because we were muted or had nothing connected)
+    bool skippedEffects{false};
     void bypassUpdater() {
-        for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
-            soloedFilter = nullptr;
-            for (JackPassthroughFilter *filter : equaliserSettings) {
-                if (filter->soloed()) {
-                    soloedFilter = filter;
-                    break;
-                }
+        soloedFilter = nullptr;
+        for (JackPassthroughFilter *filter : equaliserSettings) {
+            if (filter->soloed()) {
+                soloedFilter = filter;
+                break;
             }
-            // A bit awkward perhaps, but... this is a variadic template, and there's no indexed access, just a template one, so... alright
-            filterChain[channelIndex].setBypassed<0>((soloedFilter == equaliserSettings[0]) == false && equaliserSettings[0]->active() == false);
-            filterChain[channelIndex].setBypassed<1>((soloedFilter == equaliserSettings[1]) == false && equaliserSettings[1]->active() == false);
-            filterChain[channelIndex].setBypassed<2>((soloedFilter == equaliserSettings[2]) == false && equaliserSettings[2]->active() == false);
-            filterChain[channelIndex].setBypassed<3>((soloedFilter == equaliserSettings[3]) == false && equaliserSettings[3]->active() == false);
-            filterChain[channelIndex].setBypassed<4>((soloedFilter == equaliserSettings[4]) == false && equaliserSettings[4]->active() == false);
-            filterChain[channelIndex].setBypassed<5>((soloedFilter == equaliserSettings[5]) == false && equaliserSettings[5]->active() == false);
+        }
+        for (int equaliserBand = 0; equaliserBand < equaliserBandCount; ++equaliserBand) {
+            filterChain.setBandEnabled(equaliserBand, soloedFilter == equaliserSettings[equaliserBand] || equaliserSettings[equaliserBand]->active());
         }
     }
 
     int process(jack_nframes_t nframes) {
+        MEASURE_PROCESS_TIMING("JackPassthrough", nframes)
         if (createPorts && inputLeft && inputRight) {
             inputLeftBuffer = (jack_default_audio_sample_t *)jack_port_get_buffer(inputLeft, nframes);
             inputRightBuffer = (jack_default_audio_sample_t *)jack_port_get_buffer(inputRight, nframes);
@@ -213,7 +267,32 @@ public:
                     memset(wetOutFx2RightBuffer, 0, nframes * sizeof(jack_default_audio_sample_t));
                 }
             }
-            if (muted) {
+            // Most of the passthroughs on a client sit idle most of the time (lanes with nothing routed into them), and
+            // for those there is no reason to run the mixing and effects, all we need is to make sure the outputs are silent
+            const bool hasConnectedInputs{jack_port_connected(inputLeft) > 0 || jack_port_connected(inputRight) > 0 || (wetInPortsEnabled && ((wetInputLeft && jack_port_connected(wetInputLeft) > 0) || (wetInputRight && jack_port_connected(wetInputRight) > 0)))};
+            if (muted || hasConnectedInputs == false) {
+                skippedEffects = true;
+                if (hasConnectedInputs == false) {
+                    // Keep the visualisations ticking over, so they show the silence rather than whatever they were last fed
+                    // (unconnected inputs are silent, and without any effects applied, silence in means silence out)
+                    if (equaliserEnabled) {
+                        jack_default_audio_sample_t *inputBuffers[2]{inputLeftBuffer, inputRightBuffer};
+                        juce::AudioBuffer<float> bufferWrappers[2]{{&inputBuffers[0], 1, int(nframes)}, {&inputBuffers[1], 1, int(nframes)}};
+                        for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
+                            if (equaliserInputAnalysers[channelIndex]) {
+                                equaliserInputAnalysers[channelIndex]->addAudioData(bufferWrappers[channelIndex], 0, 1);
+                            }
+                            if (equaliserOutputAnalysers[channelIndex]) {
+                                equaliserOutputAnalysers[channelIndex]->addAudioData(bufferWrappers[channelIndex], 0, 1);
+                            }
+                        }
+                    }
+                    if (compressorEnabled) {
+                        compressorSettings->updatePeaks(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+                    } else if (compressorSettings) {
+                        compressorSettings->setPeaks(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+                    }
+                }
                 if (dryOutPortsEnabled) {
                     memset(dryOutLeftBuffer, 0, nframes * sizeof(jack_default_audio_sample_t));
                     memset(dryOutRightBuffer, 0, nframes * sizeof(jack_default_audio_sample_t));
@@ -227,6 +306,16 @@ public:
                     memset(wetOutFx2RightBuffer, 0, nframes * sizeof(jack_default_audio_sample_t));
                 }
             } else {
+                if (skippedEffects) {
+                    // The filters and compressors were last fed whatever came before we stopped processing, so start them
+                    // afresh (which is where they would have decayed to over the silence), rather than letting that leak out
+                    skippedEffects = false;
+                    filterChain.reset();
+                    if (compressorSettings) {
+                        compressorSettings->compressors[0].reset();
+                        compressorSettings->compressors[1].reset();
+                    }
+                }
                 jack_default_audio_sample_t *inputBuffers[2]{inputLeftBuffer, inputRightBuffer};
                 if (wetInPortsEnabled) {
                     // If the wet inputs are enabled, it means we mix down before applying eq/compressor and outputting the result to all enabled outputs
@@ -252,18 +341,18 @@ public:
                 }
                 if (equaliserEnabled) {
                     for (JackPassthroughFilter *filter : equaliserSettings) {
-                        filter->updateCoefficients();
+                        filter->updateCoefficients(int(nframes));
                     }
+                    juce::AudioBuffer<float> bufferWrappers[2]{{&inputBuffers[0], 1, int(nframes)}, {&inputBuffers[1], 1, int(nframes)}};
                     for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
-                        juce::AudioBuffer<float> bufferWrapper(&inputBuffers[channelIndex], 1, int(nframes));
-                        juce::dsp::AudioBlock<float> block(bufferWrapper);
-                        juce::dsp::ProcessContextReplacing<float> context(block);
                         if (equaliserInputAnalysers[channelIndex]) {
-                            equaliserInputAnalysers[channelIndex]->addAudioData(bufferWrapper, 0, 1);
+                            equaliserInputAnalysers[channelIndex]->addAudioData(bufferWrappers[channelIndex], 0, 1);
                         }
-                        filterChain[channelIndex].process(context);
+                    }
+                    filterChain.process(inputBuffers[0], inputBuffers[1], int(nframes));
+                    for (int channelIndex = 0; channelIndex < 2; ++channelIndex) {
                         if (equaliserOutputAnalysers[channelIndex]) {
-                            equaliserOutputAnalysers[channelIndex]->addAudioData(bufferWrapper, 0, 1);
+                            equaliserOutputAnalysers[channelIndex]->addAudioData(bufferWrappers[channelIndex], 0, 1);
                         }
                     }
                 }
@@ -378,13 +467,26 @@ public:
     }
 };
 
+static void jackPassthroughProcessNode(int nodeIndex, void *arg) {
+    JackPassthroughAggregate *aggregate = static_cast<JackPassthroughAggregate*>(arg);
+    aggregate->processingNodes->nodes[nodeIndex]->process(aggregate->nframes);
+}
+
 static int jackPassthroughProcess(jack_nframes_t nframes, void* arg) {
     JackPassthroughAggregate *aggregate = static_cast<JackPassthroughAggregate*>(arg);
-    for (JackPassthroughPrivate *passthrough : qAsConst(aggregate->passthroughs)) {
-        if (passthrough) {
-            passthrough->process(nframes);
+    aggregate->inProcess.store(true);
+    const JackPassthroughAggregate::NodeList *nodeList{aggregate->activeNodes.load()};
+    DSPWorkerPool *workerPool{aggregate->workerPool.load()};
+    if (workerPool && workerPool->workerCount() > 0) {
+        aggregate->nframes = nframes;
+        aggregate->processingNodes = nodeList;
+        workerPool->process(&jackPassthroughProcessNode, aggregate, nodeList->count);
+    } else {
+        for (int nodeIndex = 0; nodeIndex < nodeList->count; ++nodeIndex) {
+            nodeList->nodes[nodeIndex]->process(nframes);
         }
     }
+    aggregate->inProcess.store(false);
     return 0;
 }
 
@@ -478,13 +580,9 @@ JackPassthroughPrivate::JackPassthroughPrivate(const QString &clientName, const
                 equaliserSettings[equaliserBand]->setNext(equaliserSettings[equaliserBand + 1]);
             }
         }
-        // A bit awkward perhaps, but... this is a variadic template, and there's no indexed access, just a template one, so... alright
-        equaliserSettings[0]->setDspObjects(&filterChain[0].get<0>(), &filterChain[1].get<0>());
-        equaliserSettings[1]->setDspObjects(&filterChain[0].get<1>(), &filterChain[1].get<1>());
-        equaliserSettings[2]->setDspObjects(&filterChain[0].get<2>(), &filterChain[1].get<2>());
-        equaliserSettings[3]->setDspObjects(&filterChain[0].get<3>(), &filterChain[1].get<3>());
-        equaliserSettings[4]->setDspObjects(&filterChain[0].get<4>(), &filterChain[1].get<4>());
-        equaliserSettings[5]->setDspObjects(&filterChain[0].get<5>(), &filterChain[1].get<5>());
+        for (int equaliserBand = 0; equaliserBand < equaliserBandCount; ++equaliserBand) {
+            equaliserSettings[equaliserBand]->setDspObjects(&filterChain, equaliserBand);
+        }
         equaliserFrequencies.resize(300);
         for (size_t i = 0; i < equaliserFrequencies.size(); ++i) {
             equaliserFrequencies[i] = 20.0 * std::pow(2.0, i / 30.0);
@@ -531,6 +629,7 @@ void JackPassthroughPrivate::registerPorts()
         if (inputLeft != NULL && inputRight != NULL && !dryOutPortsRegistrationFailed && !wetOutFx1PortsRegistrationFailed && !wetOutFx2PortsRegistrationFailed) {
             if (!aggregate->passthroughs.contains(this)) {
                 aggregate->passthroughs << this;
+                aggregate->publishNodes();
             }
         } else {
             qWarning() << "JackPasstrough Client: Failed to register ports for" << actualClientName << portPrefix;
@@ -849,6 +948,7 @@ void JackPassthrough::setCreatePorts(const bool& createPorts)
         } else {
             JackPassthroughAggregate *aggregate{jackPassthroughClients->value(d->actualClientName)};
             aggregate->passthroughs.removeAll(d);
+            aggregate->publishNodes();
             if (d->inputLeft) {
                 jack_port_unregister(d->client, d->inputLeft);
                 d->inputLeft = nullptr;
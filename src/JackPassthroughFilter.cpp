@@ -11,13 +11,57 @@
 
 #include "AudioLevelsChannel.h"
 #include "JUCEHeaders.h"
+#include "StereoBiquadCascade.h"
 
 #include <QDebug>
 #include <QPolygonF>
 #include <QTimer>
 
+#include <atomic>
+
 static constexpr float inverseRootTwo{0.70710678118654752440};
 static constexpr float maxGainDB{24.0f};
+// How long it takes for the filters to move from one set of coefficients to the next
+static constexpr float coefficientSmoothingSeconds{0.02f};
+
+/**
+ * \brief A set of normalised biquad coefficients (first order filters are stored with their second order terms set to zero)
+ */
+struct BiquadCoefficients {
+    float values[5]{1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+};
+
+/**
+ * \brief Hands the most recently calculated coefficients from the ui thread to the process thread, without locking or allocating
+ *
+ * There are three slots: one being written by the ui thread, one being read by the process thread, and one in the middle
+ * which holds the most recently published set. Publishing and fetching each swap their own slot with the middle one, so
+ * neither side ever touches a slot the other side is using, and the process side always gets the newest coefficients.
+ */
+class BiquadCoefficientsExchange {
+public:
+    // Only call this from the ui thread
+    void publish(const BiquadCoefficients &coefficients) {
+        slots[writeIndex] = coefficients;
+        writeIndex = middleIndex.exchange(writeIndex | FreshFlag, std::memory_order_acq_rel) & IndexMask;
+    }
+    // Only call this from the process thread
+    bool fetch(BiquadCoefficients &coefficients) {
+        if ((middleIndex.load(std::memory_order_relaxed) & FreshFlag) == 0) {
+            return false;
+        }
+        readIndex = middleIndex.exchange(readIndex, std::memory_order_acq_rel) & IndexMask;
+        coefficients = slots[readIndex];
+        return true;
+    }
+private:
+    static constexpr int IndexMask{0x3};
+    static constexpr int FreshFlag{0x4};
+    BiquadCoefficients slots[3];
+    int writeIndex{0};
+    std::atomic<int> middleIndex{1};
+    int readIndex{2};
+};
 
 template <typename ValueT>
 juce::NormalisableRange<ValueT> logRange (ValueT min, ValueT max)
@@ -65,13 +109,18 @@ public:
     JackPassthroughFilter *previous{nullptr};
     JackPassthroughFilter *next{nullptr};
 
-    dsp::IIR::Filter<float> *filters[2]{nullptr, nullptr};
+    StereoBiquadCascade *cascade{nullptr};
+    int cascadeBand{0};
     QTimer coefficientUpdater;
     void updateCoefficients() {
         coefficientUpdater.start();
     }
     void updateCoefficientsActual();
-    juce::dsp::IIR::Coefficients<float>::Ptr updatedCoefficients;
+    BiquadCoefficientsExchange coefficientsExchange;
+    // Process thread only: where the filters are heading, and how many frames remain until they get there
+    BiquadCoefficients targetCoefficients;
+    float smoothingFramesRemaining{0};
+    bool hasCoefficients{false};
 
     std::vector<double> frequencies;
     std::vector<double> magnitudes;
@@ -508,10 +557,10 @@ std::vector<double> & JackPassthroughFilter::magnitudes() const
     return d->magnitudes;
 }
 
-void JackPassthroughFilter::setDspObjects(dsp::IIR::Filter<float> *filterLeft, dsp::IIR::Filter<float> *filterRight)
+void JackPassthroughFilter::setDspObjects(StereoBiquadCascade *cascade, const int &band)
 {
-    d->filters[0] = filterLeft;
-    d->filters[1] = filterRight;
+    d->cascade = cascade;
+    d->cascadeBand = band;
     d->updateCoefficients();
 }
 
@@ -520,12 +569,32 @@ void JackPassthroughFilter::setSampleRate(const float& sampleRate)
     d->sampleRate = sampleRate;
 }
 
-void JackPassthroughFilter::updateCoefficients() const
+void JackPassthroughFilter::updateCoefficients(const int &nframes) const
 {
-    if (d->updatedCoefficients) {
-        d->filters[0]->coefficients = d->updatedCoefficients;
-        d->filters[1]->coefficients = d->updatedCoefficients;
-        d->updatedCoefficients = nullptr;
+    if (d->coefficientsExchange.fetch(d->targetCoefficients)) {
+        if (d->hasCoefficients) {
+            d->smoothingFramesRemaining = d->sampleRate * coefficientSmoothingSeconds;
+        } else {
+            // The very first set of coefficients is applied immediately, there's nothing sensible to smooth from
+            d->smoothingFramesRemaining = 0;
+            d->hasCoefficients = true;
+            std::copy(std::begin(d->targetCoefficients.values), std::end(d->targetCoefficients.values), d->cascade->coefficients(d->cascadeBand));
+        }
+    }
+    if (d->smoothingFramesRemaining > 0) {
+        // Move the coefficients linearly towards the target, one step per block. As the region of stable
+        // biquad denominators is convex, every set of coefficients along the way is stable as well
+        float *current{d->cascade->coefficients(d->cascadeBand)};
+        if (float(nframes) >= d->smoothingFramesRemaining) {
+            std::copy(std::begin(d->targetCoefficients.values), std::end(d->targetCoefficients.values), current);
+            d->smoothingFramesRemaining = 0;
+        } else {
+            const float step{float(nframes) / d->smoothingFramesRemaining};
+            for (int index = 0; index < 5; ++index) {
+                current[index] += (d->targetCoefficients.values[index] - current[index]) * step;
+            }
+            d->smoothingFramesRemaining -= float(nframes);
+        }
     }
 }
 
@@ -575,8 +644,21 @@ void JackPassthroughFilterPrivate::updateCoefficientsActual()
 
     if (newCoefficients)
     {
-        // set the coefficients somewhere else, and before performing operations in process(), set the new coefficients if they are != nullptr
-        updatedCoefficients = newCoefficients;
+        // Hand the values over to the process thread (which will move the filters towards them, see JackPassthroughFilter::updateCoefficients)
+        // Every filter type is run as a biquad, and first order ones simply have their second order terms set to zero
+        BiquadCoefficients biquadCoefficients;
+        const float *rawCoefficients{newCoefficients->getRawCoefficients()};
+        if (newCoefficients->getFilterOrder() == 1) {
+            // First order coefficients are b0, b1, a1
+            biquadCoefficients.values[0] = rawCoefficients[0];
+            biquadCoefficients.values[1] = rawCoefficients[1];
+            biquadCoefficients.values[2] = 0;
+            biquadCoefficients.values[3] = rawCoefficients[2];
+            biquadCoefficients.values[4] = 0;
+        } else {
+            std::copy(rawCoefficients, rawCoefficients + 5, biquadCoefficients.values);
+        }
+        coefficientsExchange.publish(biquadCoefficients);
         newCoefficients->getMagnitudeForFrequencyArray(frequencies.data(), magnitudes.data(), frequencies.size(), sampleRate);
     }
     Q_EMIT q->dataChanged();
@@ -15,6 +15,7 @@
 #include <QColor>
 
 class JackPassthroughFilterPrivate;
+class StereoBiquadCascade;
 class JackPassthroughFilter : public QObject {
     Q_OBJECT
     Q_PROPERTY(QString name READ name NOTIFY nameChanged)
@@ -130,11 +131,22 @@ public:
 
     void createFrequencyPlot(QPolygonF &p, const QRect bounds, float pixelsPerDouble);
     std::vector<double> &magnitudes() const;
-    void setDspObjects(dsp::IIR::Filter<float> *filterLeft, dsp::IIR::Filter<float> *filterRight);
+    /**
+     * \brief Set the filter cascade, and the band within it, which this filter's settings should be applied to
+     * @param cascade The filter cascade which does the actual processing
+     * @param band The index of the band in the cascade which this filter controls
+     */
+    void setDspObjects(StereoBiquadCascade *cascade, const int &band);
     void setSampleRate(const float &sampleRate);
 
-    // Called at the start of each process call to update the filters internal state, so needs to be very low impact
-    void updateCoefficients() const;
+    /**
+     * \brief Called at the start of each process call to update the filters internal state, so needs to be very low impact
+     * This picks up any newly calculated coefficients, and moves the filters' coefficients a step further towards them,
+     * so that changes are spread out over a short while, rather than happening all at once. The coefficients are written
+     * directly into the cascade's coefficient storage, so this never allocates or frees anything.
+     * @param nframes The number of frames which are about to be processed by the filters
+     */
+    void updateCoefficients(const int &nframes) const;
 private:
     JackPassthroughFilterPrivate *d{nullptr};
 };
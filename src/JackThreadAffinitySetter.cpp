@@ -10,6 +10,9 @@
 
 #include "JackThreadAffinitySetter.h"
 
+#include <QFile>
+#include <QThread>
+
 #define DEBUG_JACK_THREAD_AFFINITY_SETTER false
 
 void zl_set_jack_client_affinity(jack_client_t *client) {
@@ -39,3 +42,52 @@ void zl_set_dsp_thread_affinity(const pthread_t& threadID)
 // #endif
 //     }
 }
+
+const QList<int> &zl_dsp_worker_cores()
+{
+    // Worked out once, the first time it is asked for (which is thread safe, and DSPWorkerPool does so before starting any workers)
+    static const QList<int> workerCores{[](){
+        QList<int> workerCores;
+        // The isolated list is in the kernel's cpu list format, e.g. "1-3" or "2,3" (or empty if nothing is isolated)
+        QFile isolatedFile{"/sys/devices/system/cpu/isolated"};
+        if (isolatedFile.open(QIODevice::ReadOnly)) {
+            const QString isolated{QString::fromLatin1(isolatedFile.readAll()).trimmed()};
+            for (const QString &range : isolated.split(',', Qt::SkipEmptyParts)) {
+                const QStringList bounds{range.split('-')};
+                const int first{bounds.first().toInt()};
+                const int last{bounds.last().toInt()};
+                for (int core = first; core <= last; ++core) {
+                    workerCores << core;
+                }
+            }
+        }
+        if (workerCores.isEmpty()) {
+            const int coreCount{QThread::idealThreadCount()};
+            for (int core = 1; core < coreCount; ++core) {
+                workerCores << core;
+            }
+        }
+        if (workerCores.isEmpty()) {
+            workerCores << 0;
+        }
+        return workerCores;
+    }()};
+    return workerCores;
+}
+
+void zl_set_dsp_worker_thread_affinity(const pthread_t& threadID, const int& workerIndex)
+{
+    const QList<int> &workerCores{zl_dsp_worker_cores()};
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(workerCores[workerIndex % workerCores.count()], &cpuset);
+    int result = pthread_setaffinity_np(threadID, sizeof(cpuset), &cpuset);
+    if (result != 0) {
+        errno = result;
+        perror("pthread_setaffinity_np");
+#if DEBUG_JACK_THREAD_AFFINITY_SETTER
+    } else {
+        qDebug() << "Pinned DSP worker" << workerIndex << "to CPU" << workerCores[workerIndex % workerCores.count()];
+#endif
+    }
+}
@@ -14,6 +14,7 @@
 #include <pthread.h>
 #include <errno.h>
 #include <QDebug>
+#include <QList>
 
 /**
  * \brief Set the thread affinity of the given jack client to our DSP cores
@@ -26,3 +27,21 @@ void zl_set_jack_client_affinity(jack_client_t *client);
  * @param threadID The pthread ID of the thread that wants its affinity set
  */
 void zl_set_dsp_thread_affinity(const pthread_t &threadID);
+
+/**
+ * \brief The cores DSP worker threads are spread across (see zl_set_dsp_worker_thread_affinity())
+ *
+ * If the kernel has been told to isolate some cores (using the isolcpus option), these are those cores, and otherwise
+ * all the cores except the first (which is where the kernel does most of its work)
+ */
+const QList<int> &zl_dsp_worker_cores();
+
+/**
+ * \brief Pin a DSP worker thread to a single core
+ *
+ * If the kernel has been told to isolate some cores (using the isolcpus option), the workers are spread across
+ * those, and otherwise across all the cores except the first (which is where the kernel does most of its work)
+ * @param threadID The pthread ID of the worker thread
+ * @param workerIndex The index of the worker in its pool (the first worker gets the first core, and so on, wrapping around)
+ */
+void zl_set_dsp_worker_thread_affinity(const pthread_t &threadID, const int &workerIndex);
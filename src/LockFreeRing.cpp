@@ -0,0 +1,40 @@
+#include "LockFreeRing.h"
+
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+// All the rings which currently exist (rings are created and destroyed outside of the realtime threads, so locking here is fine)
+static QMutex &ringsMutex() {
+    static QMutex mutex;
+    return mutex;
+}
+static QList<LockFreeRingBase*> &rings() {
+    static QList<LockFreeRingBase*> list;
+    return list;
+}
+
+LockFreeRingBase::LockFreeRingBase(const char* name)
+    : m_name(name)
+{
+    QMutexLocker locker(&ringsMutex());
+    rings() << this;
+}
+
+LockFreeRingBase::~LockFreeRingBase()
+{
+    QMutexLocker locker(&ringsMutex());
+    rings().removeOne(this);
+}
+
+void LockFreeRingBase::reportOverflows()
+{
+    QMutexLocker locker(&ringsMutex());
+    for (LockFreeRingBase *ring : qAsConst(rings())) {
+        const quint64 overflows{ring->overflowCount()};
+        if (overflows != ring->m_reportedOverflowCount) {
+            qWarning() << Q_FUNC_INFO << ring->m_name << "was full, and dropped" << overflows - ring->m_reportedOverflowCount << "entries since the last report (" << overflows << "in total). This likely means the ring size is too small, which will require attention at the api level.";
+            ring->m_reportedOverflowCount = overflows;
+        }
+    }
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <QDebug>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Whether a LockFreeRing can be written to from one thread only, or from several at the same time
+ */
+enum class LockFreeRingWriters {
+    SingleWriter,
+    MultipleWriters,
+};
+
+/**
+ * \brief Whether a LockFreeRing can be read from one thread only, or from several at the same time
+ * Rings with multiple readers can only be read through read() and readIf(), as peeking at an entry and then
+ * marking it as read are two separate steps, which another reader might get in between
+ */
+enum class LockFreeRingReaders {
+    SingleReader,
+    MultipleReaders,
+};
+
+/**
+ * \brief The parts of LockFreeRing which do not depend on the payload
+ *
+ * Every ring registers itself in a global list for as long as it exists, so that overflows can be reported
+ * from outside of the (often realtime) threads which write to the rings (see reportOverflows())
+ */
+class LockFreeRingBase {
+public:
+    /**
+     * \brief The number of writes which have been dropped because the ring was full
+     */
+    quint64 overflowCount() const {
+        return m_overflowCount.load(std::memory_order_relaxed);
+    }
+    /**
+     * \brief Write a warning to the log for each ring which has dropped writes since the last time this was called
+     * This takes a lock and writes to the log, so call it from a non-realtime thread (Plugin does so periodically)
+     */
+    static void reportOverflows();
+protected:
+    explicit LockFreeRingBase(const char *name);
+    ~LockFreeRingBase();
+    alignas(64) std::atomic<quint64> m_overflowCount{0};
+    const char *m_name{nullptr};
+private:
+    // Only touched by reportOverflows(), while holding the list lock
+    quint64 m_reportedOverflowCount{0};
+};
+
+/**
+ * \brief A fixed-size ring for passing data between threads without locking or allocating
+ *
+ * Payloads are stored inline in the ring, and are written in place (see write()). This means that a payload which
+ * holds onto its own memory (like a juce::MidiBuffer) only needs to allocate that memory once, and that memory is then
+ * reused every time the entry is written to.
+ *
+ * Neither writing nor reading ever waits for another thread: if the ring is full, the write is dropped and counted in
+ * overflowCount() (and reported later by LockFreeRingBase::reportOverflows(), rather than on the writing thread), and
+ * if it is empty, there is simply nothing to read. Callers handing ownership of something through the ring must check
+ * the result of write(), and deal with whatever could not be written.
+ *
+ * @param Payload The data stored in each entry (must be default constructible)
+ * @param Capacity The number of entries in the ring (must be a power of two)
+ * @param Writers Use MultipleWriters if more than one thread might write to the ring at the same time
+ * @param Readers Use MultipleReaders if more than one thread might read from the ring at the same time
+ */
+template<typename Payload, std::size_t Capacity, LockFreeRingWriters Writers = LockFreeRingWriters::SingleWriter, LockFreeRingReaders Readers = LockFreeRingReaders::SingleReader>
+class LockFreeRing : public LockFreeRingBase {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "LockFreeRing capacity must be a power of two");
+public:
+    explicit LockFreeRing(const char *name = "LockFreeRing")
+        : LockFreeRingBase(name)
+    {
+        for (std::size_t i = 0; i < Capacity; ++i) {
+            m_entries[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    ~LockFreeRing() {}
+
+    /**
+     * \brief Write a new entry into the ring, by filling in the payload in place
+     * @param fill A function taking a Payload& which fills in the entry (it will only be called if there is space for the entry)
+     * @return True if the entry was written, or false if the ring was full (which is counted as an overflow)
+     */
+    template<typename Fill>
+    bool write(Fill fill) {
+        std::size_t position{m_writePosition.load(std::memory_order_relaxed)};
+        Entry *entry{nullptr};
+        while (true) {
+            entry = &m_entries[position & (Capacity - 1)];
+            const intptr_t difference{intptr_t(entry->sequence.load(std::memory_order_acquire)) - intptr_t(position)};
+            if (difference == 0) {
+                if (Writers == LockFreeRingWriters::SingleWriter) {
+                    m_writePosition.store(position + 1, std::memory_order_relaxed);
+                    break;
+                } else if (m_writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                // Only count it here, as this is commonly called from a realtime thread (see LockFreeRingBase::reportOverflows())
+                m_overflowCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = m_writePosition.load(std::memory_order_relaxed);
+            }
+        }
+        fill(entry->payload);
+        entry->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+    /**
+     * \brief Write a copy of the given payload into the ring
+     * @see write(Fill)
+     */
+    bool write(const Payload &payload) {
+        return write([&payload](Payload &entryPayload) { entryPayload = payload; });
+    }
+
+    /**
+     * \brief The oldest unread entry in the ring, if there is one
+     * The payload remains valid until markAsRead() is called
+     * @return The payload of the oldest unread entry, or nullptr if there are no unread entries
+     */
+    Payload *peek() {
+        static_assert(Readers == LockFreeRingReaders::SingleReader, "Rings with multiple readers must be read using read() or readIf()");
+        const std::size_t position{m_readPosition.load(std::memory_order_relaxed)};
+        Entry &entry = m_entries[position & (Capacity - 1)];
+        if (entry.sequence.load(std::memory_order_acquire) == position + 1) {
+            return &entry.payload;
+        }
+        return nullptr;
+    }
+    const Payload *peek() const {
+        return const_cast<LockFreeRing*>(this)->peek();
+    }
+    /**
+     * \brief Release the oldest unread entry back to the writers (only call this after peek() has returned an entry)
+     */
+    void markAsRead() {
+        static_assert(Readers == LockFreeRingReaders::SingleReader, "Rings with multiple readers must be read using read() or readIf()");
+        const std::size_t position{m_readPosition.load(std::memory_order_relaxed)};
+        m_entries[position & (Capacity - 1)].sequence.store(position + Capacity, std::memory_order_release);
+        m_readPosition.store(position + 1, std::memory_order_relaxed);
+    }
+    /**
+     * \brief Copy out the oldest unread entry, and mark it as read
+     * @return True if there was an entry to read, otherwise false
+     */
+    bool read(Payload &payload) {
+        return readIf(payload, [](const Payload &) { return true; });
+    }
+    /**
+     * \brief Copy out the oldest unread entry and mark it as read, but only if the given function accepts it
+     * With multiple readers, the function may be called on an entry which another reader then gets to first (in which
+     * case the next entry is looked at instead), so it must not have any side effects
+     * @param payload Set to the entry's payload, if it was read
+     * @param accept A function taking a const Payload&, and returning true if the entry should be read
+     * @return True if there was an entry to read, and it was accepted, otherwise false
+     */
+    template<typename Accept>
+    bool readIf(Payload &payload, Accept accept) {
+        std::size_t position{m_readPosition.load(std::memory_order_relaxed)};
+        Entry *entry{nullptr};
+        while (true) {
+            entry = &m_entries[position & (Capacity - 1)];
+            const intptr_t difference{intptr_t(entry->sequence.load(std::memory_order_acquire)) - intptr_t(position + 1)};
+            if (difference == 0) {
+                if (accept(const_cast<const Payload&>(entry->payload)) == false) {
+                    return false;
+                }
+                if (Readers == LockFreeRingReaders::SingleReader) {
+                    m_readPosition.store(position + 1, std::memory_order_relaxed);
+                    break;
+                } else if (m_readPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                // The ring is empty
+                return false;
+            } else {
+                position = m_readPosition.load(std::memory_order_relaxed);
+            }
+        }
+        payload = entry->payload;
+        entry->sequence.store(position + Capacity, std::memory_order_release);
+        return true;
+    }
+    /**
+     * \brief Whether there is anything to read
+     * With multiple readers this is only a hint, as another thread may read from the ring at any time
+     */
+    bool hasUnread() const {
+        const std::size_t position{m_readPosition.load(std::memory_order_relaxed)};
+        return m_entries[position & (Capacity - 1)].sequence.load(std::memory_order_acquire) == position + 1;
+    }
+    /**
+     * \brief Whether there is currently no space for another entry
+     * With multiple writers this is only a hint, as another thread may write to or read from the ring at any time
+     */
+    bool isFull() const {
+        const std::size_t position{m_writePosition.load(std::memory_order_relaxed)};
+        return intptr_t(m_entries[position & (Capacity - 1)].sequence.load(std::memory_order_acquire)) - intptr_t(position) < 0;
+    }
+    /**
+     * \brief Call the given function for every payload in the ring
+     * This is intended for setting up the payloads (for example, to preallocate their storage) before the ring is put to use,
+     * and must not be called while anything else is using the ring
+     * @param function A function taking a Payload&
+     */
+    template<typename Function>
+    void forEachPayload(Function function) {
+        for (std::size_t i = 0; i < Capacity; ++i) {
+            function(m_entries[i].payload);
+        }
+    }
+private:
+    struct Entry {
+        std::atomic<std::size_t> sequence{0};
+        Payload payload;
+    };
+    Entry m_entries[Capacity];
+    // Keep the writer and reader positions on their own cache lines, so the two sides don't keep invalidating each other
+    alignas(64) std::atomic<std::size_t> m_writePosition{0};
+    alignas(64) std::atomic<std::size_t> m_readPosition{0};
+};
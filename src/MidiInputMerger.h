@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    MidiInputMerger.h
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#define MAX_MERGED_INPUTS 256
+
+/**
+ * \brief A min-heap of the enabled input devices which have an event waiting, ordered by the time of that event
+ *
+ * Devices with events at the same time are ordered by their position in the list of inputs, so simultaneous events come
+ * out in the same order as they would from simply scanning through the list for the earliest one.
+ *
+ * The device type only needs a currentInputEvent with a size and a time (MidiRouter uses it with MidiRouterDevice, and
+ * the dspbenchmark tool with a stand-in device, to measure the cost of merging without needing jack).
+ */
+template<typename Device>
+struct MidiInputMerger {
+    struct Entry {
+        uint32_t time{0};
+        int order{0};
+        Device *device{nullptr};
+    };
+    Entry entries[MAX_MERGED_INPUTS];
+    int count{0};
+
+    // Fill the heap from the given inputs (call this once all the devices have had processBegin() called)
+    template<typename DeviceList>
+    inline void reset(const DeviceList &inputs) {
+        count = 0;
+        int order{0};
+        for (Device *device : inputs) {
+            if (device->currentInputEvent.size > 0 && count < MAX_MERGED_INPUTS) {
+                Entry &entry = entries[count];
+                entry.time = device->currentInputEvent.time;
+                entry.order = order;
+                entry.device = device;
+                ++count;
+            }
+            ++order;
+        }
+        for (int index = (count / 2) - 1; index > -1; --index) {
+            siftDown(index);
+        }
+    }
+    // The device with the earliest event (or nullptr if there are no more events)
+    inline Device *top() const {
+        return count > 0 ? entries[0].device : nullptr;
+    }
+    // Call this after calling nextInputEvent() on the top device, to move it to where its new event belongs (or out of the heap, if it has no more events)
+    inline void advanceTop() {
+        const Device *device{entries[0].device};
+        if (device->currentInputEvent.size > 0) {
+            entries[0].time = device->currentInputEvent.time;
+        } else {
+            --count;
+            entries[0] = entries[count];
+        }
+        siftDown(0);
+    }
+private:
+    static inline bool isBefore(const Entry &first, const Entry &second) {
+        return first.time < second.time || (first.time == second.time && first.order < second.order);
+    }
+    inline void siftDown(int index) {
+        const Entry entry{entries[index]};
+        while (true) {
+            int child{(2 * index) + 1};
+            if (child >= count) {
+                break;
+            }
+            if (child + 1 < count && isBefore(entries[child + 1], entries[child])) {
+                ++child;
+            }
+            if (isBefore(entries[child], entry) == false) {
+                break;
+            }
+            entries[index] = entries[child];
+            index = child;
+        }
+        entries[index] = entry;
+    }
+};
@@ -21,6 +21,7 @@
 
 #include "MidiRecorder.h"
 
+#include "LockFreeRing.h"
 #include "MidiRouter.h"
 #include "Note.h"
 #include "PlayGridManager.h"
@@ -38,67 +39,51 @@
 #include <juce_audio_formats/juce_audio_formats.h>
 
 #define MidiRecorderRingSize 65536
-class MidiRecorderRing {
+struct MidiRecorderRingEntry {
+    double timestamp{0.0};
+    int sketchpadTrack{-1};
+    unsigned char byte0{0};
+    unsigned char byte1{0};
+    unsigned char byte2{0};
+    unsigned char size{0};
+};
+class MidiRecorderRing : public LockFreeRing<MidiRecorderRingEntry, MidiRecorderRingSize> {
 public:
-    struct Entry {
-        Entry *previous{nullptr};
-        Entry *next{nullptr};
-        double timestamp{0.0};
-        int sketchpadTrack{-1};
-        bool processed{true};
-        unsigned char byte0{0};
-        unsigned char byte1{0};
-        unsigned char byte2{0};
-        unsigned char size{0};
-    };
-    MidiRecorderRing() {
-        Entry* entryPrevious{&ringData[MidiRecorderRingSize - 1]};
-        for (quint64 i = 0; i < MidiRecorderRingSize; ++i) {
-            entryPrevious->next = &ringData[i];
-            ringData[i].previous = entryPrevious;
-            entryPrevious = &ringData[i];
-        }
-        readHead = writeHead = ringData;
-    }
+    MidiRecorderRing()
+        : LockFreeRing("MidiRecorderRing")
+    {}
     ~MidiRecorderRing() { }
 
+    using LockFreeRing::write;
     void write(const double &timestamp, const int &sketchpadTrack, const unsigned char &byte0, const unsigned char &byte1, const unsigned char &byte2, const unsigned char &size) {
-        Entry *entry = writeHead;
-        writeHead = writeHead->next;
-        if (entry->processed == false) {
-            qWarning() << Q_FUNC_INFO << "There is unprocessed data stored at the write location for time" << writeHead->timestamp << "This likely means the buffer size is too small, which will require attention at the api level.";
-        }
-        entry->sketchpadTrack = sketchpadTrack;
-        entry->size = size;
-        entry->byte0 = byte0;
-        entry->byte1 = byte1;
-        entry->byte2 = byte2;
-        entry->timestamp = timestamp;
-        entry->processed = false;
-    }
+        write([&](MidiRecorderRingEntry &entry) {
+            entry.sketchpadTrack = sketchpadTrack;
+            entry.size = size;
+            entry.byte0 = byte0;
+            entry.byte1 = byte1;
+            entry.byte2 = byte2;
+            entry.timestamp = timestamp;
+        });
+    }
+    using LockFreeRing::read;
     /**
      * \brief Attempt to read the data out of the ring, until there are no more unprocessed entries
      * @return Whether or not the read was valid
      */
     bool read(double *timestamp, int *sketchpadTrack, unsigned char *byte0, unsigned char *byte1, unsigned char *byte2, unsigned char *size) {
-        if (readHead->processed == false) {
-            Entry *entry = readHead;
-            readHead = readHead->next;
+        const MidiRecorderRingEntry *entry{peek()};
+        if (entry) {
             *sketchpadTrack = entry->sketchpadTrack;
             *byte0 = entry->byte0;
             *byte1 = entry->byte1;
             *byte2 = entry->byte2;
             *size = entry->size;
             *timestamp = entry->timestamp;
-            entry->processed = true;
+            markAsRead();
             return true;
         }
         return false;
     }
-
-    Entry ringData[MidiRecorderRingSize];
-    Entry *readHead{nullptr};
-    Entry *writeHead{nullptr};
 };
 
 class MidiRecorderPrivate {
@@ -1,47 +1,49 @@
 #pragma once
 
 #include "JUCEHeaders.h"
+#include "LockFreeRing.h"
 #include <QDebug>
 
 #define MidiRingSize 512
-class MidiRing {
+// The number of bytes of midi data each entry in the ring can hold before it will need to allocate more
+#define MidiRingEntryPreallocatedBytes 256
+struct MidiRingEntry {
+    juce::MidiBuffer buffer;
+};
+/**
+ * \brief A ring for passing midi buffers between threads (see LockFreeRing)
+ * This may be written to from any number of threads, but only read from one. Each entry keeps its own preallocated buffer,
+ * and writing copies the events into that, so writing only allocates if the events will not fit in the preallocated space.
+ */
+class MidiRing : public LockFreeRing<MidiRingEntry, MidiRingSize, LockFreeRingWriters::MultipleWriters> {
 public:
-    struct Entry {
-        Entry *next{nullptr};
-        Entry *previous{nullptr};
-        bool processed{true};
-        juce::MidiBuffer buffer;
-    };
-    explicit MidiRing() {
-        Entry* entryPrevious{&ringData[MidiRingSize - 1]};
-        for (quint64 i = 0; i < MidiRingSize; ++i) {
-            entryPrevious->next = &ringData[i];
-            ringData[i].previous = entryPrevious;
-            entryPrevious = &ringData[i];
-        }
-        readHead = writeHead = ringData;
+    explicit MidiRing()
+        : LockFreeRing("MidiRing")
+    {
+        forEachPayload([](MidiRingEntry &entry) {
+            entry.buffer.ensureSize(MidiRingEntryPreallocatedBytes);
+        });
     }
     ~MidiRing() {
     }
 
     void write(const juce::MidiBuffer &buffer) {
-        Entry *entry = writeHead;
-        writeHead = writeHead->next;
-        if (entry->processed == false) {
-            qWarning() << Q_FUNC_INFO << "There is unprocessed data at the write location: midi buffer with" << entry->buffer.getNumEvents() << "events. This likely means the buffer size is too small, which will require attention at the api level.";
-        }
-        entry->buffer = buffer;
-        entry->processed = false;
+        LockFreeRing::write([&buffer](MidiRingEntry &entry) {
+            entry.buffer.clear();
+            entry.buffer.addEvents(buffer, 0, -1, 0);
+        });
     }
-    // This ring does not have a read-and-clear function, as it is likely to be called from the jack process loop and we want to avoid that doing memory type things
-    void markAsRead() {
-        Entry *entry = readHead;
-        readHead = readHead->next;
-        entry->processed = true;
+    /**
+     * \brief Write a single midi event into the ring
+     * @param data The raw bytes of the event
+     * @param size The number of bytes in the event
+     */
+    void write(const void *data, int size) {
+        LockFreeRing::write([data, size](MidiRingEntry &entry) {
+            entry.buffer.clear();
+            entry.buffer.addEvent(data, size, 0);
+        });
     }
-
-    Entry *readHead{nullptr};
-    Entry *writeHead{nullptr};
-private:
-    Entry ringData[MidiRingSize];
+    // This ring does not have a read-and-clear function, as it is likely to be called from the jack process loop and we want to avoid that doing memory type things
+    // Use peek() to get at the oldest unread buffer, and markAsRead() once done with it
 };
@@ -6,7 +6,9 @@
 #include "JackPassthrough.h"
 #include "PatternModel.h"
 #include "PlayGridManager.h"
+#include "ProcessTiming.h"
 #include "Plugin.h"
+#include "MidiInputMerger.h"
 #include "MidiRecorder.h"
 #include "MidiRouterDevice.h"
 #include "MidiRouterFilter.h"
@@ -17,6 +19,7 @@
 #include "SketchpadTrackInfo.h"
 
 #include <QDebug>
+#include <QMetaMethod>
 #include <QProcessEnvironment>
 #include <QSettings>
 #include <QTimer>
@@ -24,7 +27,11 @@
 #include <jack/jack.h>
 #include <jack/midiport.h>
 
+#include <atomic>
 #include <chrono>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include "MidiRouterFilterEntry.h"
 
 // Set this to true to emit a bunch more debug output when the router is operating
@@ -187,6 +194,9 @@ public:
         if (jackClient) {
             jack_client_close(jackClient);
         }
+        if (wakeupDescriptor > -1) {
+            close(wakeupDescriptor);
+        }
         for (SketchpadTrackInfo *track : sketchpadTracks) {
             delete track;
         }
@@ -199,6 +209,23 @@ public:
     SyncTimer *syncTimer{nullptr};
     bool done{false};
     bool constructing{true};
+    // The listener thread (see MidiRouter::run()) sleeps on this until there is something for it to deliver
+    int wakeupDescriptor{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)};
+    // Set when the listener thread has been woken up, and cleared by it before it starts delivering, so that
+    // the process callback only performs the write (which is a system call) once for each round of delivery
+    std::atomic<bool> wakeupPending{false};
+    /**
+     * \brief Wake up the listener thread, if it is not already awake
+     * This is safe to call from the process callback (writing to an eventfd does not block)
+     */
+    void wakeUp() {
+        if (wakeupPending.exchange(true, std::memory_order_seq_cst) == false && wakeupDescriptor > -1) {
+            const uint64_t increment{1};
+            if (write(wakeupDescriptor, &increment, sizeof(increment)) < 0) {
+                // This only fails if the counter would overflow, in which case the thread is already going to wake up
+            }
+        }
+    }
     bool filterMidiOut{false};
     QStringList disabledMidiInPorts;
     QStringList enabledMidiOutPorts;
@@ -219,6 +246,31 @@ public:
     QList<MidiRouterDevice*> devices;
     QList<MidiRouterDevice*> allEnabledInputs;
     QList<MidiRouterDevice*> allEnabledOutputs;
+    MidiInputMerger<MidiRouterDevice> inputMerger;
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+    // Statistics for the events routed by the process callback, gathered there and reported by the listener thread
+    // when process timing is being measured (see ProcessTiming.h)
+    struct ProcessStatistics {
+        std::atomic<quint64> cycles{0};
+        std::atomic<quint64> events{0};
+        // The number of inputs which had events, summed over all cycles
+        std::atomic<quint64> activeInputs{0};
+        std::atomic<quint32> mostEvents{0};
+        std::atomic<quint32> mostActiveInputs{0};
+        static inline void raise(std::atomic<quint32> &most, const quint32 value) {
+            quint32 current{most.load(std::memory_order_relaxed)};
+            while (current < value && most.compare_exchange_weak(current, value, std::memory_order_relaxed) == false) {}
+        }
+        inline void add(const quint32 eventCount, const quint32 activeInputCount) {
+            cycles.fetch_add(1, std::memory_order_relaxed);
+            events.fetch_add(eventCount, std::memory_order_relaxed);
+            activeInputs.fetch_add(activeInputCount, std::memory_order_relaxed);
+            raise(mostEvents, eventCount);
+            raise(mostActiveInputs, activeInputCount);
+        }
+    };
+    ProcessStatistics processStatistics;
+#endif
 
     MidiRouterDevice *zynthianOutputs[16];
     SketchpadTrackInfo *sketchpadTracks[ZynthboxTrackCount];
@@ -257,6 +309,7 @@ public:
     uint32_t mostRecentEventsForZynthian{0};
     QAtomicInt jack_xrun_count{0};
     int process(jack_nframes_t nframes) {
+        MEASURE_PROCESS_TIMING("MidiRouter", nframes)
         // auto t1 = std::chrono::high_resolution_clock::now();
         jack_nframes_t current_frames;
         jack_time_t current_usecs;
@@ -307,22 +360,28 @@ public:
             for (MidiRouterDevice *device : qAsConst(devices)) {
                 device->processBegin(nframes);
             }
+            // Whether there is anything for the listener thread to deliver once we're done (the listener ports, cuia
+            // events, and the devices' postponed events are all only ever written to as a result of handling an event)
+            bool handledEvents{false};
+            // Pick the events off the inputs in time order, by way of a heap of the devices keyed on their current event's time
+            inputMerger.reset(allEnabledInputs);
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+            const quint32 activeInputCount{quint32(inputMerger.count)};
+            quint32 eventCount{0};
+#endif
             while(true) {
-                for (MidiRouterDevice *device : qAsConst(allEnabledInputs)) {
-                    jack_midi_event_t *deviceEvent = &device->currentInputEvent;
-                    // If there either is not currently an event picked for comparison, or the device's event
-                    // is older than what is currently picked, that should be the next one to get processed
-                    if (deviceEvent->size > 0 && (event == nullptr || deviceEvent->time < event->time)) {
-                        event = deviceEvent;
-                        eventDevice = device;
-                        inputDeviceIsHardware = device->deviceType(MidiRouterDevice::HardwareDeviceType);
-                        inputDeviceIsSequencer = device->deviceType(MidiRouterDevice::SequencerType);
-                    }
-                }
+                eventDevice = inputMerger.top();
                 // If we no longer have any incoming events to process, scamper
-                if (event == nullptr) {
+                if (eventDevice == nullptr) {
                     break;
                 }
+                event = &eventDevice->currentInputEvent;
+                inputDeviceIsHardware = eventDevice->deviceType(MidiRouterDevice::HardwareDeviceType);
+                inputDeviceIsSequencer = eventDevice->deviceType(MidiRouterDevice::SequencerType);
+                handledEvents = true;
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+                ++eventCount;
+#endif
                 const MidiRouterFilterEntry *eventDeviceFilterEntry = eventDevice->inputEventFilter()->match(*event);
                 // Now process the event we picked
                 const unsigned char &byte0 = event->buffer[0];
@@ -544,12 +603,19 @@ public:
                 }
                 // Set us back up for the next run
                 eventDevice->nextInputEvent();
+                inputMerger.advanceTop();
                 eventDevice = nullptr;
                 event = nullptr;
             }
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+            processStatistics.add(eventCount, activeInputCount);
+#endif
             for (MidiRouterDevice *device : qAsConst(devices)) {
                 device->processEnd();
             }
+            if (handledEvents) {
+                wakeUp();
+            }
             processingLoad = qMax(qMax(0.0f, processingLoad - 0.3f), qMin(100.0f, jack_cpu_load(jackClient)));
 
 #if ZLROUTER_WATCHDOG
@@ -826,6 +892,9 @@ public:
                 enabledOutputs << trackInfo->externalDevice;
             }
         }
+        if (enabledInputs.count() > MAX_MERGED_INPUTS) {
+            qWarning() << "ZLRouter: There are" << enabledInputs.count() << "enabled inputs, but we can only route events from" << MAX_MERGED_INPUTS << "of them - the remainder will be ignored";
+        }
         allEnabledInputs = enabledInputs;
         allEnabledOutputs = enabledOutputs;
         for (int i = 0; i < ZynthboxTrackCount + 1; ++i) {
@@ -933,6 +1002,8 @@ MidiRouter::MidiRouter(QObject *parent)
     QCoreApplication::setOrganizationName("zynthbox");
     QCoreApplication::setApplicationName("zynthbox-qml");
     qRegisterMetaType<MidiRouter::ListenerPort>();
+    qRegisterMetaType<MidiRouter::ListenerMessage>();
+    qRegisterMetaType<QVector<MidiRouter::ListenerMessage>>();
     qRegisterMetaType<MidiRouterFilterEntryRewriter::RuleType>();
     qRegisterMetaType<MidiRouterFilterEntryRewriter::EventSize>();
     qRegisterMetaType<MidiRouterFilterEntryRewriter::EventByte>();
@@ -1102,42 +1173,119 @@ void MidiRouter::run() {
     ZynthboxBasics::Slot cuiaSlot{ZynthboxBasics::CurrentSlot};
     static const QString emptyString{};
     int cuiaValue{0};
+    const QMetaMethod noteChangedSignal{QMetaMethod::fromSignal(&MidiRouter::noteChanged)};
+    const QMetaMethod midiMessageSignal{QMetaMethod::fromSignal(&MidiRouter::midiMessage)};
+    QVector<MidiRouter::ListenerMessage> listenerMessages;
+    // How often to let people know how busy the process callback is (this is also the longest we will sleep for without being woken up)
+    static constexpr int processingLoadInterval{250};
+    std::chrono::steady_clock::time_point nextProcessingLoadUpdate{std::chrono::steady_clock::now()};
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+    std::chrono::steady_clock::time_point nextProcessStatisticsReport{nextProcessingLoadUpdate};
+#endif
+    pollfd wakeupPoll{d->wakeupDescriptor, POLLIN, 0};
     while (true) {
         if (d->done) {
             break;
         }
+        // Drain the eventfd first, and only then clear the pending flag, so a wakeup written after this point is never
+        // swallowed by the read (anything written after the flag is cleared will cause another write to the eventfd)
+        uint64_t wakeupCount{0};
+        if (d->wakeupDescriptor > -1 && read(d->wakeupDescriptor, &wakeupCount, sizeof(wakeupCount)) < 0) {
+            // Nothing to reset, which just means we woke up on the timeout
+        }
+        d->wakeupPending.store(false, std::memory_order_seq_cst);
+        // The per-message signals are expensive enough that we only want to spend time on them if someone is listening
+        const bool emitNoteChanged{isSignalConnected(noteChangedSignal)};
+        const bool emitMidiMessage{isSignalConnected(midiMessageSignal)};
         for (int i = 0; i < 5; ++i) {
             MidiListenerPort *listenerPort = d->listenerPorts[i];
             MidiListenerPort::NoteMessage *message = listenerPort->readHead;
             while (!message->submitted) {
+                const QString &hardwareDeviceId{message->eventDevice ? message->eventDevice->hardwareId() : emptyString};
+                MidiRouter::ListenerMessage listenerMessage;
+                listenerMessage.timestamp = quint64(message->timeStamp);
+                listenerMessage.size = message->size;
+                listenerMessage.byte1 = message->byte0;
+                listenerMessage.byte2 = message->byte1;
+                listenerMessage.byte3 = message->byte2;
                 // FIXME Somehow eventDevice might end up as a nullptr - that seems extremely weird and will need some proper investigating...
-                if (message->isNoteMessage && message->eventDevice) {
+                listenerMessage.isNoteMessage = message->isNoteMessage && message->eventDevice;
+                listenerMessage.fromInternal = message->fromInternal;
+                listenerMessage.sketchpadTrack = message->sketchpadTrack;
+                listenerMessage.hardwareDeviceId = hardwareDeviceId;
+                listenerMessages << listenerMessage;
+                if (emitNoteChanged && listenerMessage.isNoteMessage) {
                     const bool setOn = (message->byte0 >= 0x90 && message->byte2 > 0);
                     const int midiChannel = (message->byte0 & 0xf);
                     const int &midiNote = message->byte1;
                     const int &velocity = message->byte2;
-                    Q_EMIT noteChanged(listenerPort->identifier, midiNote, midiChannel, velocity, setOn, message->timeStamp, message->byte0, message->byte1, message->byte2, message->sketchpadTrack, message->eventDevice->hardwareId());
+                    Q_EMIT noteChanged(listenerPort->identifier, midiNote, midiChannel, velocity, setOn, message->timeStamp, message->byte0, message->byte1, message->byte2, message->sketchpadTrack, hardwareDeviceId);
+                }
+                if (emitMidiMessage) {
+                    Q_EMIT midiMessage(listenerPort->identifier, message->size, message->byte0, message->byte1, message->byte2, message->sketchpadTrack, message->fromInternal, hardwareDeviceId);
                 }
-                Q_EMIT midiMessage(listenerPort->identifier, message->size, message->byte0, message->byte1, message->byte2, message->sketchpadTrack, message->fromInternal, message->eventDevice ? message->eventDevice->hardwareId() : emptyString);
                 message->submitted = true;
                 listenerPort->readHead = listenerPort->readHead->next;
                 message = listenerPort->readHead;
             }
+            if (listenerMessages.isEmpty() == false) {
+                Q_EMIT listenerMessagesReceived(listenerPort->identifier, listenerMessages);
+                listenerMessages.clear();
+            }
         }
         for (MidiRouterDevice* device : d->devices) {
-            while (device->cuiaRing.readHead->processed == false) {
+            while (device->cuiaRing.hasUnread()) {
                 CUIAHelper::Event event = device->cuiaRing.read(&cuiaOriginId, &cuiaTrack, &cuiaSlot, &cuiaValue);
                 Q_EMIT cuiaEvent(CUIAHelper::instance()->cuiaCommand(event), cuiaOriginId, cuiaTrack, cuiaSlot, cuiaValue);
             }
-            // Ensure that this is run on the device object's own thread
-            QMetaObject::invokeMethod(device, &MidiRouterDevice::handlePostponedEvents, Qt::QueuedConnection);
+            if (device->postponedEventsPending.exchange(false, std::memory_order_acq_rel)) {
+                // Ensure that this is run on the device object's own thread
+                QMetaObject::invokeMethod(device, &MidiRouterDevice::handlePostponedEvents, Qt::QueuedConnection);
+            }
         }
-        static int cpuLoadThrottle{0};
-        if (++cpuLoadThrottle > 50) {
-            cpuLoadThrottle = 0;
+        const std::chrono::steady_clock::time_point now{std::chrono::steady_clock::now()};
+        if (nextProcessingLoadUpdate <= now) {
+            nextProcessingLoadUpdate = now + std::chrono::milliseconds(processingLoadInterval);
             Q_EMIT processingLoadChanged();
         }
-        msleep(5);
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+        if (nextProcessStatisticsReport <= now) {
+            nextProcessStatisticsReport = now + std::chrono::seconds(10);
+            MidiRouterPrivate::ProcessStatistics &statistics = d->processStatistics;
+            const quint64 cycles{statistics.cycles.exchange(0, std::memory_order_relaxed)};
+            const quint64 events{statistics.events.exchange(0, std::memory_order_relaxed)};
+            const quint64 activeInputs{statistics.activeInputs.exchange(0, std::memory_order_relaxed)};
+            const quint32 mostEvents{statistics.mostEvents.exchange(0, std::memory_order_relaxed)};
+            const quint32 mostActiveInputs{statistics.mostActiveInputs.exchange(0, std::memory_order_relaxed)};
+            if (cycles > 0) {
+                qInfo().nospace() << "Routing statistics for MidiRouter over " << cycles << " cycles (" << d->allEnabledInputs.count() << " enabled inputs):"
+                    << " average " << double(events) / double(cycles) << " events per cycle (most " << mostEvents << "),"
+                    << " average " << double(activeInputs) / double(cycles) << " inputs with events per cycle (most " << mostActiveInputs << ")";
+            }
+        }
+#endif
+        // Anything which arrived while we were delivering, but which saw the pending flag still set (and so did not write to the
+        // eventfd), would otherwise sit there until the next wakeup, so check for that before going to sleep
+        bool hasUndelivered{false};
+        for (int i = 0; i < 5 && hasUndelivered == false; ++i) {
+            hasUndelivered = (d->listenerPorts[i]->readHead->submitted == false);
+        }
+        for (MidiRouterDevice* device : d->devices) {
+            if (hasUndelivered) {
+                break;
+            }
+            hasUndelivered = device->cuiaRing.hasUnread() || device->postponedEventsPending.load(std::memory_order_acquire);
+        }
+        if (hasUndelivered) {
+            continue;
+        }
+        if (d->wakeupDescriptor > -1) {
+            const int timeout{int(std::chrono::duration_cast<std::chrono::milliseconds>(nextProcessingLoadUpdate - now).count()) + 1};
+            poll(&wakeupPoll, 1, timeout);
+        } else {
+            // If we couldn't get an eventfd for whatever reason, fall back to checking in regularly
+            msleep(5);
+        }
     }
 }
 
@@ -1148,6 +1296,7 @@ void MidiRouter::enqueueCuiaCommand(const QString& cuiaCommand)
         // The first device is the TransportManager device, and we really
         // just need... literally any device here, so that'll do.
         d->internalDevices[0]->cuiaRing.write(cuiaEvent, -1);
+        d->wakeUp();
     }
 }
 
@@ -1237,6 +1386,7 @@ MidiRouterDevice * MidiRouter::getSynthOutputDevice(const int& id) const
 
 void MidiRouter::markAsDone() {
     d->done = true;
+    d->wakeUp();
 }
 
 void MidiRouter::setSkechpadTrackDestination(int sketchpadTrack, MidiRouter::RoutingDestination destination, int externalChannel)
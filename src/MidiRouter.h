@@ -7,6 +7,7 @@
 #include <QObject>
 #include <QCoreApplication>
 #include <QThread>
+#include <QVector>
 
 class MidiRouterPrivate;
 class MidiRouterDevice;
@@ -292,6 +293,49 @@ public:
 // Ouch not cool hack: https://forum.qt.io/topic/130255/shiboken-signals-don-t-work
 // Core message (by vberlier): Turns out Shiboken shouldn't do anything for signals and let PySide setup the signals using the MOC data. Shiboken generates bindings for signals as if they were plain methods and shadows the actual signals.
 #ifndef PYSIDE_BINDINGS_H
+    /**
+     * \brief A single midi message, as delivered by listenerMessagesReceived()
+     */
+    struct ListenerMessage {
+        /**
+         * \brief The timestamp at which the message arrived, counted in jack frames (absolute value since startup)
+         */
+        quint64 timestamp{0};
+        /**
+         * \brief How many bytes the message contains (either 1, 2, or 3)
+         */
+        int size{0};
+        unsigned char byte1{0};
+        unsigned char byte2{0};
+        unsigned char byte3{0};
+        /**
+         * \brief Whether the message is a note on or note off message
+         */
+        bool isNoteMessage{false};
+        /**
+         * \brief Whether the message arrived from an internal source
+         */
+        bool fromInternal{false};
+        /**
+         * \brief The sketchpad track the message arrived on
+         */
+        int sketchpadTrack{0};
+        /**
+         * \brief The device ID of the hardware device the event arrived on (this will only be valid if the event in fact arrived from a hardware device)
+         */
+        QString hardwareDeviceId;
+    };
+    /**
+     * \brief Fired whenever one or more midi messages have arrived on a listener port
+     *
+     * This is fired at most once per port each time the router's listener thread wakes up (which it does when
+     * the process callback has handled some events), and carries all the messages which arrived on that port
+     * since the last time, in the order they arrived. Prefer this over noteChanged and midiMessage, which are
+     * fired once per message (and only while something is connected to them).
+     * @param port The listener port the messages arrived on (you will likely want to filter on just managing PassthroughPort, unless you have a specific reason)
+     * @param messages The messages which arrived
+     */
+    Q_SIGNAL void listenerMessagesReceived(MidiRouter::ListenerPort port, const QVector<MidiRouter::ListenerMessage> &messages);
     /**
      * \brief Fired whenever a note has changed
      * @param port The listener port the message arrived on (you will likely want to filter on just managing PassthroughPort, unless you have a specific reason)
@@ -363,3 +407,6 @@ private:
 };
 Q_DECLARE_METATYPE(MidiRouter::ClockSource)
 Q_DECLARE_METATYPE(MidiRouter::ListenerPort)
+#ifndef PYSIDE_BINDINGS_H
+Q_DECLARE_METATYPE(MidiRouter::ListenerMessage)
+#endif
@@ -365,8 +365,8 @@ void MidiRouterDevice::processBegin(const jack_nframes_t &nframes)
     }
     d->mostRecentOutputTime = 0;
     // Fire off any events that might be in the output ring for immediate dispatch
-    while (midiOutputRing.readHead->processed == false) {
-        const juce::MidiBuffer &buffer = midiOutputRing.readHead->buffer;
+    while (const MidiRingEntry *entry = midiOutputRing.peek()) {
+        const juce::MidiBuffer &buffer = entry->buffer;
         for (const juce::MidiMessageMetadata &juceMessage : buffer) {
             // These want to be written raw onto the output buffer (they will have already gone through filters etc)
             jack_midi_event_write(d->outputBuffer, 0,
@@ -491,10 +491,12 @@ void MidiRouterDevice::nextInputEvent()
                     // leave the time code intact
                 }
                 d->ccValueUpdates.write(currentInputEvent);
+                postponedEventsPending.store(true, std::memory_order_release);
                 d->ccValues[currentInputEvent.buffer[0] & 0xf][currentInputEvent.buffer[1]] = currentInputEvent.buffer[2];
             } else if (currentInputEvent.buffer[0] == 0xF0) {
                 // This is a sysex message, so pass it to the helper for handling
                 d->sysexHelper->handleInputEvent(currentInputEvent);
+                postponedEventsPending.store(true, std::memory_order_release);
             }
             // if (d->type.testFlag(MidiRouterDevice::HardwareDeviceType)) {
             //     qDebug() << Q_FUNC_INFO << d->humanReadableName << objectName() << "Retrieved jack midi event on device" << d->humanReadableName << "with data size" << d->currentInputEvent->size << "at time" << d->currentInputEvent->time << "event" << d->nextInputEventIndex + 1 << "of" << d->inputEventCount;
@@ -7,6 +7,8 @@
 #include <jack/midiport.h>
 #include <QFlags>
 
+#include <atomic>
+
 class QString;
 class MidiRouterDevicePrivate;
 class MidiRouterFilter;
@@ -598,6 +600,11 @@ public:
     MidiRouterFilter *inputEventFilter() const;
     MidiRouterFilter *outputEventFilter() const;
     CUIARing cuiaRing;
+    /**
+     * \brief Set by the process callback when handlePostponedEvents() has something to do
+     * MidiRouter will clear this when queueing a call to handlePostponedEvents(), so it only gets called when needed
+     */
+    std::atomic<bool> postponedEventsPending{false};
 protected:
     friend class MidiRouterFilter;
     /**
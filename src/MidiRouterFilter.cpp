@@ -3,23 +3,70 @@
 #include "MidiRouterFilterEntry.h"
 
 #include <QDebug>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QTimer>
+#include <QVector>
+
+/**
+ * The lists of entries which can potentially match an event, for each possible combination of the first and
+ * second byte of the event.
+ *
+ * The lists are all stored in the candidates vector, one after the other, each terminated by a nullptr, and
+ * each cell holds the position of the first entry in its list. Many cells end up with the same list (most
+ * commonly the empty one), so identical lists are only stored once. The entries in each list are in the same
+ * order as in the filter's entries list, so the first match in a list is the first match in the filter.
+ */
+struct MidiRouterFilterTable {
+    // For events which are a single byte long, indexed by that byte (less 0x80)
+    quint16 singleByteCells[128];
+    // For events which are two or three bytes long, indexed by the first byte (less 0x80) and the second byte
+    quint16 cells[128][128];
+    // For events of any other length
+    quint16 otherSizesCell{0};
+    QVector<const MidiRouterFilterEntry*> candidates;
+};
 
 MidiRouterFilter::MidiRouterFilter(MidiRouterDevice* parent)
     : QObject(parent)
 {
     connect(this, &MidiRouterFilter::entriesChanged, &MidiRouterFilter::entriesDataChanged);
+    // As with the description, this is likely to get hit quite a lot during loading, so throttle the compilation
+    m_tableCompiler = new QTimer(this);
+    m_tableCompiler->setInterval(0);
+    m_tableCompiler->setSingleShot(true);
+    m_tableCompiler->callOnTimeout(this, &MidiRouterFilter::compileTable);
+    connect(this, &MidiRouterFilter::entriesDataChanged, m_tableCompiler, QOverload<>::of(&QTimer::start));
 }
 
 MidiRouterFilter::~MidiRouterFilter()
 {
+    delete m_table.exchange(nullptr);
 }
 
 const MidiRouterFilterEntry * MidiRouterFilter::match(const jack_midi_event_t& event) const
 {
+    const MidiRouterFilterTable *table{m_table.load(std::memory_order_acquire)};
+    if (table != nullptr && event.size > 0 && event.buffer[0] > 0x7F && (event.size < 2 || event.buffer[1] < 0x80)) {
+        quint16 cell{table->otherSizesCell};
+        if (event.size == 1) {
+            cell = table->singleByteCells[event.buffer[0] - 0x80];
+        } else if (event.size < 4) {
+            cell = table->cells[event.buffer[0] - 0x80][event.buffer[1]];
+        }
+        for (const MidiRouterFilterEntry * const *candidate = table->candidates.constData() + cell; *candidate != nullptr; ++candidate) {
+            if ((*candidate)->match(event)) {
+                // ##################################
+                // EARLY RETURN - to retain constness
+                // ##################################
+                return *candidate;
+            }
+        }
+        return nullptr;
+    }
+    // If there's no table to use (or the event is not one the table can handle), test each entry in turn
     for (const MidiRouterFilterEntry *entry : qAsConst(m_entries)) {
         if (entry->match(event)) {
             // ##################################
@@ -226,6 +273,72 @@ void MidiRouterFilter::swap(MidiRouterFilterEntry* swapThis, MidiRouterFilterEnt
     }
 }
 
+void MidiRouterFilter::compileTable()
+{
+    MidiRouterFilterTable *table{nullptr};
+    if (m_entries.count() > 0) {
+        table = new MidiRouterFilterTable;
+        QHash<QVector<const MidiRouterFilterEntry*>, int> knownLists;
+        // Adds the list to the candidates (unless we've already got one just like it), and returns its position
+        auto addList = [&table, &knownLists](const QVector<const MidiRouterFilterEntry*> &list) -> int {
+            int position = knownLists.value(list, -1);
+            if (position == -1) {
+                position = table->candidates.count();
+                table->candidates << list;
+                table->candidates << nullptr;
+                knownLists.insert(list, position);
+            }
+            return position;
+        };
+        QVector<const MidiRouterFilterEntry*> list;
+        QVector<const MidiRouterFilterEntry*> firstByteMatches;
+        addList(list);
+        for (int byte1 = 0x80; byte1 < 0x100; ++byte1) {
+            list.clear();
+            firstByteMatches.clear();
+            for (const MidiRouterFilterEntry *entry : qAsConst(m_entries)) {
+                if (entry->byte1Minimum() <= byte1 && byte1 <= entry->byte1Maximum()) {
+                    if (entry->requiredBytes() == 1) {
+                        list << entry;
+                    } else if (entry->requiredBytes() == 2 || entry->requiredBytes() == 3) {
+                        firstByteMatches << entry;
+                    }
+                }
+            }
+            table->singleByteCells[byte1 - 0x80] = quint16(qMin(addList(list), 0xFFFF));
+            for (int byte2 = 0; byte2 < 0x80; ++byte2) {
+                list.clear();
+                for (const MidiRouterFilterEntry *entry : qAsConst(firstByteMatches)) {
+                    if (entry->byte2Minimum() <= byte2 && byte2 <= entry->byte2Maximum()) {
+                        list << entry;
+                    }
+                }
+                table->cells[byte1 - 0x80][byte2] = quint16(qMin(addList(list), 0xFFFF));
+            }
+        }
+        // Entries which require some other number of bytes than 1 through 3 only ever get tested on the first byte, so
+        // just test them all for those events
+        list.clear();
+        for (const MidiRouterFilterEntry *entry : qAsConst(m_entries)) {
+            if (entry->requiredBytes() < 1 || 3 < entry->requiredBytes()) {
+                list << entry;
+            }
+        }
+        table->otherSizesCell = quint16(qMin(addList(list), 0xFFFF));
+        if (table->candidates.count() > 0xFFFF) {
+            // With this many different lists, the table would be no faster than just testing each entry in turn anyway
+            qWarning() << Q_FUNC_INFO << "The filter's entries are too varied to compile into a table (needed" << table->candidates.count() << "candidates), so they will be tested one at a time instead";
+            delete table;
+            table = nullptr;
+        }
+    }
+    MidiRouterFilterTable *oldTable{m_table.exchange(table, std::memory_order_acq_rel)};
+    if (oldTable) {
+        // The process callback may still be looking at the old table, so give it a moment before deleting it
+        QTimer::singleShot(1000, this, [oldTable](){ delete oldTable; });
+    }
+}
+
 MidiRouterFilter::Direction MidiRouterFilter::direction() const
 {
     return m_direction;
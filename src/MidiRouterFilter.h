@@ -3,7 +3,11 @@
 #include "MidiRouterDevice.h"
 #include <jack/midiport.h>
 
+#include <atomic>
+
+class QTimer;
 class MidiRouterFilterEntry;
+struct MidiRouterFilterTable;
 /**
  * \brief A stack of filters which take a midi event and either accept or reject them
  */
@@ -30,6 +34,10 @@ public:
     /**
      * \brief Test whether any filter matches the filter, and return the one that does (if any)
      * The matching is done in the order of the entries list, and the first match is returned
+     *
+     * To avoid testing every entry for every event, the entries are compiled into a table (whenever they change,
+     * on the filter's own thread), which holds the entries which might match each combination of first and second
+     * byte, so only those need testing. This is safe to call from the process callback.
      * @param event The midi event to attempt to find a match for
      * @return The filter entry which matches the event (if null, there were no matches)
      */
@@ -100,5 +108,10 @@ public:
 private:
     QList<MidiRouterFilterEntry*> m_entries;
     Direction m_direction{InputDirection};
+    // The compiled version of the entries list used by match() (this is nullptr when there are no entries, or if
+    // compiling failed, in which case we fall back to testing each entry in turn)
+    std::atomic<MidiRouterFilterTable*> m_table{nullptr};
+    QTimer *m_tableCompiler{nullptr};
+    void compileTable();
 };
 Q_DECLARE_METATYPE(QList<MidiRouterFilterEntry*>)
@@ -0,0 +1,312 @@
+/*
+  ==============================================================================
+
+    PatternFileFormat.cpp
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#include "PatternFileFormat.h"
+
+#include <QDebug>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QStringList>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+
+static const QByteArray patternFileSignature{"ZBPT"};
+// Deeper than this, and we're looking at broken (or malicious) data, not a pattern
+static constexpr int maximumNestingDepth{64};
+
+enum PatternFileValueTag : quint8 {
+    NullTag = 0,
+    FalseTag = 1,
+    TrueTag = 2,
+    IntegerTag = 3,
+    DoubleTag = 4,
+    StringTag = 5,
+    ArrayTag = 6,
+    ObjectTag = 7,
+};
+
+class PatternFileEncoder {
+public:
+    PatternFileEncoder() {
+        data.reserve(4096);
+    }
+    QByteArray data;
+    // The index of each object key which has been written so far
+    QHash<QString, quint64> keys;
+
+    void writeVarint(quint64 value) {
+        while (value >= 0x80) {
+            data.append(char((value & 0x7f) | 0x80));
+            value = value >> 7;
+        }
+        data.append(char(value));
+    }
+    void writeString(const QString &string) {
+        const QByteArray utf8{string.toUtf8()};
+        writeVarint(quint64(utf8.size()));
+        data.append(utf8);
+    }
+    // Keys are written out in full the first time they are encountered (marked by a leading zero),
+    // and after that as their index in the list of known keys, plus one
+    void writeKey(const QString &key) {
+        QHash<QString, quint64>::const_iterator existing = keys.constFind(key);
+        if (existing == keys.constEnd()) {
+            writeVarint(0);
+            writeString(key);
+            keys.insert(key, quint64(keys.count()));
+        } else {
+            writeVarint(existing.value() + 1);
+        }
+    }
+    void writeValue(const QJsonValue &value) {
+        switch (value.type()) {
+            case QJsonValue::Bool:
+                data.append(char(value.toBool() ? TrueTag : FalseTag));
+                break;
+            case QJsonValue::Double:
+            {
+                const double number{value.toDouble()};
+                // Json numbers are all doubles, but almost everything in a pattern is a small integer, so store those as such
+                // (anything which cannot make that round trip exactly, including negative zero, is stored as the full double)
+                if (std::trunc(number) == number && std::abs(number) <= 9007199254740992.0 && !(number == 0 && std::signbit(number))) {
+                    const qint64 integer{qint64(number)};
+                    data.append(char(IntegerTag));
+                    writeVarint((quint64(integer) << 1) ^ quint64(integer >> 63));
+                } else {
+                    quint64 bits;
+                    std::memcpy(&bits, &number, sizeof(bits));
+                    bits = qToLittleEndian(bits);
+                    data.append(char(DoubleTag));
+                    data.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+                }
+                break;
+            }
+            case QJsonValue::String:
+                data.append(char(StringTag));
+                writeString(value.toString());
+                break;
+            case QJsonValue::Array:
+            {
+                const QJsonArray array{value.toArray()};
+                data.append(char(ArrayTag));
+                writeVarint(quint64(array.count()));
+                for (const QJsonValue &entry : array) {
+                    writeValue(entry);
+                }
+                break;
+            }
+            case QJsonValue::Object:
+            {
+                const QJsonObject object{value.toObject()};
+                data.append(char(ObjectTag));
+                writeVarint(quint64(object.count()));
+                for (QJsonObject::const_iterator entry = object.constBegin(); entry != object.constEnd(); ++entry) {
+                    writeKey(entry.key());
+                    writeValue(entry.value());
+                }
+                break;
+            }
+            case QJsonValue::Null:
+            case QJsonValue::Undefined:
+            default:
+                data.append(char(NullTag));
+                break;
+        }
+    }
+};
+
+class PatternFileDecoder {
+public:
+    PatternFileDecoder(const QByteArray &data, int position)
+        : data(data.constData())
+        , size(data.size())
+        , position(position)
+    {}
+    const char *data{nullptr};
+    const int size{0};
+    int position{0};
+    bool failed{false};
+    QStringList keys;
+
+    quint64 readVarint() {
+        quint64 value{0};
+        int shift{0};
+        while (!failed) {
+            if (position >= size || shift > 63) {
+                failed = true;
+                break;
+            }
+            const quint8 byte{quint8(data[position++])};
+            value |= quint64(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+            shift += 7;
+        }
+        return value;
+    }
+    QString readString() {
+        const quint64 length{readVarint()};
+        if (failed || length > quint64(size - position)) {
+            failed = true;
+            return QString();
+        }
+        const QString string{QString::fromUtf8(data + position, int(length))};
+        position += int(length);
+        return string;
+    }
+    QString readKey() {
+        const quint64 index{readVarint()};
+        if (failed) {
+            return QString();
+        } else if (index == 0) {
+            const QString key{readString()};
+            keys << key;
+            return key;
+        } else if (index <= quint64(keys.count())) {
+            return keys.at(int(index - 1));
+        }
+        failed = true;
+        return QString();
+    }
+    QJsonValue readValue(int depth) {
+        if (failed || position >= size || depth > maximumNestingDepth) {
+            failed = true;
+            return QJsonValue();
+        }
+        switch (quint8(data[position++])) {
+            case NullTag:
+                return QJsonValue(QJsonValue::Null);
+            case FalseTag:
+                return QJsonValue(false);
+            case TrueTag:
+                return QJsonValue(true);
+            case IntegerTag:
+            {
+                const quint64 zigzag{readVarint()};
+                return QJsonValue(qint64((zigzag >> 1) ^ (~(zigzag & 1) + 1)));
+            }
+            case DoubleTag:
+            {
+                if (size - position < int(sizeof(quint64))) {
+                    failed = true;
+                    return QJsonValue();
+                }
+                quint64 bits;
+                std::memcpy(&bits, data + position, sizeof(bits));
+                position += int(sizeof(bits));
+                bits = qFromLittleEndian(bits);
+                double number;
+                std::memcpy(&number, &bits, sizeof(number));
+                return QJsonValue(number);
+            }
+            case StringTag:
+                return QJsonValue(readString());
+            case ArrayTag:
+            {
+                const quint64 count{readVarint()};
+                QJsonArray array;
+                for (quint64 index = 0; index < count && !failed; ++index) {
+                    array.append(readValue(depth + 1));
+                }
+                return array;
+            }
+            case ObjectTag:
+            {
+                const quint64 count{readVarint()};
+                QJsonObject object;
+                for (quint64 index = 0; index < count && !failed; ++index) {
+                    const QString key{readKey()};
+                    object.insert(key, readValue(depth + 1));
+                }
+                return object;
+            }
+            default:
+                failed = true;
+                return QJsonValue();
+        }
+    }
+};
+
+QString PatternFileFormat::binaryFileName(const QString& jsonFileName)
+{
+    if (jsonFileName.endsWith(QLatin1String{".json"})) {
+        return jsonFileName.left(jsonFileName.length() - 5) + QLatin1String{".zbp"};
+    }
+    return jsonFileName + QLatin1String{".zbp"};
+}
+
+QString PatternFileFormat::jsonFileName(const QString& binaryFileName)
+{
+    if (binaryFileName.endsWith(QLatin1String{".zbp"})) {
+        return binaryFileName.left(binaryFileName.length() - 4) + QLatin1String{".json"};
+    }
+    return binaryFileName + QLatin1String{".json"};
+}
+
+QByteArray PatternFileFormat::encode(const QJsonObject& pattern)
+{
+    PatternFileEncoder encoder;
+    encoder.data.append(patternFileSignature);
+    encoder.data.append(char(CurrentVersion));
+    encoder.writeValue(pattern);
+    return encoder.data;
+}
+
+QJsonObject PatternFileFormat::decode(const QByteArray& data, bool* ok)
+{
+    QJsonObject pattern;
+    bool success{false};
+    if (isBinary(data) && data.size() > patternFileSignature.size()) {
+        const quint8 version{quint8(data.at(patternFileSignature.size()))};
+        if (version == 1) {
+            PatternFileDecoder decoder(data, patternFileSignature.size() + 1);
+            const QJsonValue value{decoder.readValue(0)};
+            if (decoder.failed == false && value.isObject()) {
+                pattern = value.toObject();
+                success = true;
+            } else {
+                qWarning() << Q_FUNC_INFO << "Failed to decode pattern data, which appears to be corrupted (stopped at byte" << decoder.position << "of" << data.size() << ")";
+            }
+        } else {
+            qWarning() << Q_FUNC_INFO << "Pattern data is in version" << version << "of the format, which is newer than the newest we know how to read (" << CurrentVersion << ")";
+        }
+    }
+    if (ok) {
+        *ok = success;
+    }
+    return pattern;
+}
+
+bool PatternFileFormat::isBinary(const QByteArray& data)
+{
+    return data.startsWith(patternFileSignature);
+}
+
+QJsonDocument PatternFileFormat::toJson(const QJsonObject& pattern)
+{
+    QJsonObject interchange{pattern};
+    const QJsonValue notes{pattern.value("notes")};
+    if (notes.isArray()) {
+        interchange["notes"] = QString::fromUtf8(QJsonDocument(notes.toArray()).toJson());
+    }
+    return QJsonDocument(interchange);
+}
+
+QJsonObject PatternFileFormat::fromJson(const QJsonDocument& json)
+{
+    QJsonObject pattern{json.object()};
+    const QJsonValue notes{pattern.value("notes")};
+    if (notes.isString()) {
+        pattern["notes"] = QJsonDocument::fromJson(notes.toString().toUtf8()).array();
+    }
+    return pattern;
+}
@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    PatternFileFormat.h
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+
+/**
+ * \brief The compact binary encoding used for storing patterns, and its conversion to and from the json interchange format
+ *
+ * The json format for patterns (as written by PlayGridManager::modelToJson) stores the notes as a json document inside a
+ * string in another json document, which means every pattern has to be parsed twice to be loaded, and text json is both
+ * large and slow to parse in the first place. The binary format stores the very same tree of values (so converting
+ * between the two is lossless), except that the notes are stored as an actual array, rather than as a string.
+ *
+ * The encoding is a simple tagged tree of values: integers are stored as variable length integers, object keys are
+ * stored only the first time they are encountered and referred to by index after that (which for patterns, where the
+ * same handful of keys is used for every single step, is where most of the size goes), and strings are stored as utf8.
+ *
+ * Files in this format start with the four bytes "ZBPT", followed by the version of the format they were written in.
+ * Any change to the format must bump the version, and decode() must keep reading the older versions.
+ *
+ * Inside a sketchpad, the binary file is stored where the json one used to be, with a different suffix (see binaryFileName()),
+ * and it is the authoritative one: whenever it exists, it is what gets loaded. Saving a sketchpad only writes the binary
+ * file, and removes any legacy json file for the pattern once that has been written, and the json file is written only
+ * when exporting. Sketchpads saved before the binary format existed only have json files, which are loaded as before.
+ */
+class PatternFileFormat {
+public:
+    /**
+     * \brief The current version of the binary format (this is what encode() writes)
+     */
+    static constexpr quint8 CurrentVersion{1};
+
+    /**
+     * \brief The name of the binary file which goes alongside the given json file
+     * @param jsonFileName The full path of a pattern's json file (of the form "something.pattern.json")
+     * @return The full path of the binary file for the same pattern (of the form "something.pattern.zbp")
+     */
+    static QString binaryFileName(const QString &jsonFileName);
+    /**
+     * \brief The name of the json file which goes alongside the given binary file (the reverse of binaryFileName())
+     * @param binaryFileName The full path of a pattern's binary file (of the form "something.pattern.zbp")
+     * @return The full path of the json file for the same pattern (of the form "something.pattern.json")
+     */
+    static QString jsonFileName(const QString &binaryFileName);
+
+    /**
+     * \brief Encode the given pattern into the binary format
+     * @param pattern A pattern object, with the notes stored as an array (see PlayGridManager::modelToJsonObject)
+     * @return The binary representation of the pattern
+     */
+    static QByteArray encode(const QJsonObject &pattern);
+    /**
+     * \brief Decode the given binary data into a pattern object
+     * @param data Data in the binary format
+     * @param ok If not null, this will be set to true if the data was decoded successfully, or false if it was not
+     * @return The pattern object, with the notes stored as an array (or an empty object if the data could not be decoded)
+     */
+    static QJsonObject decode(const QByteArray &data, bool *ok = nullptr);
+    /**
+     * \brief Whether the given data looks like it is in the binary format (that is, whether it starts with the format's signature)
+     */
+    static bool isBinary(const QByteArray &data);
+
+    /**
+     * \brief Convert a pattern object with the notes stored as an array into the json interchange format
+     * @param pattern A pattern object, with the notes stored as an array
+     * @return The json interchange representation of the pattern (with the notes stored as a json string)
+     */
+    static QJsonDocument toJson(const QJsonObject &pattern);
+    /**
+     * \brief Convert the json interchange format into a pattern object with the notes stored as an array
+     * @param json A pattern in the json interchange format (with the notes stored as a json string)
+     * @return The pattern object, with the notes stored as an array
+     */
+    static QJsonObject fromJson(const QJsonDocument &json);
+};
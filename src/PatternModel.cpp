@@ -20,10 +20,13 @@
  */
 
 #include "PatternModel.h"
+#include "BackgroundFileWriter.h"
 #include "KeyScales.h"
 #include "Note.h"
+#include "PatternFileFormat.h"
 #include "SegmentHandler.h"
 #include "PlayfieldManager.h"
+#include "RandomStream.h"
 #include "ZynthboxBasics.h"
 
 #include <QDateTime>
@@ -32,6 +35,9 @@
 #include <QPointer>
 #include <QRandomGenerator>
 #include <QTimer>
+#include <QVector>
+#include <atomic>
+#include <memory>
 
 // Hackety hack - we don't need all the thing, just need some storage things (MidiBuffer and MidiNote specifically)
 #define JUCE_GLOBAL_MODULE_SETTINGS_INCLUDED 1
@@ -396,9 +402,10 @@ public:
      * \brief Get the probability result of the next step and progress playback
      * This will increase the current step by one (or wrap), and calculate the
      * probability for that step, returning whether the step should play or not.
+     * @param random The random stream to use for the step's probability
      * @return Whether the next step in the sequence should play
      */
-    bool nextStep() {
+    bool nextStep(RandomStream &random) {
         ++current;
         if (current == length) {
             current = 0;
@@ -409,7 +416,7 @@ public:
         } else if (steps[current] == 1) {
             return true;
         }
-        return QRandomGenerator::global()->generateDouble() < steps[current];
+        return random.generateDouble() < steps[current];
     }
     void reset() {
         current = length - 1;
@@ -474,6 +481,68 @@ struct StepData {
     }
 };
 
+/**
+ * \brief The playback-relevant parts of a single subnote on a step
+ * These are the values otherwise looked up in the subnote's metadata hash, pulled out once when the step's plan is compiled
+ */
+struct CompiledSubnote {
+    const Note *subnote{nullptr};
+    int subnoteIndex{0};
+    int delay{0};
+    int velocity{64};
+    int duration{0};
+    int probability{0};
+    int nextStep{0};
+    int ratchetStyle{0};
+    int ratchetCount{0};
+    int ratchetProbability{100};
+};
+
+/**
+ * \brief Everything fillStepData needs to know about the contents of a single position in the pattern
+ *
+ * The plans are compiled on the model's thread whenever the positions they describe change (see
+ * PatternModel::Private::rebuildStepPlans), so that building the step data during playback does not
+ * need to go through the model's notes and metadata variants at all.
+ */
+struct StepPlan {
+    // The note on the position (if there is none, the rest of the plan is irrelevant)
+    const Note *note{nullptr};
+    // Whether the position is enabled (in the keyed data, defaulting to true)
+    bool enabled{true};
+    // Whether there was metadata for each of the subnotes (if not, each subnote is compiled with default values)
+    bool hasMetadata{false};
+    // One entry for each valid subnote on the position's note
+    QVector<CompiledSubnote> subnotes;
+};
+
+/**
+ * \brief The compiled plans for every position in a model, stored flat (row * width + column)
+ *
+ * Each position holds a pointer to an immutable plan, which the model's thread swaps out when the position
+ * changes. A table is only ever created with the dimensions it is given, and is replaced entirely when the
+ * model's dimensions change.
+ */
+struct StepPlanTable {
+    StepPlanTable(const int &rows, const int &width)
+        : rows(rows)
+        , width(width)
+        , plans(new std::atomic<StepPlan*>[rows * width])
+    {
+        for (int position = 0; position < rows * width; ++position) {
+            plans[position].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+    ~StepPlanTable() {
+        for (int position = 0; position < rows * width; ++position) {
+            delete plans[position].load(std::memory_order_relaxed);
+        }
+    }
+    const int rows;
+    const int width;
+    std::unique_ptr<std::atomic<StepPlan*>[]> plans;
+};
+
 struct PatternModelDefaults {
 public:
     constexpr static const int externalMidiChannel{-1};
@@ -522,6 +591,11 @@ public:
         for (int i = 0; i < NoteDataPoolSize; ++i) {
             delete noteDataPool[i].object;
         }
+        for (const RetiredStepPlans &retired : qAsConst(retiredStepPlans)) {
+            delete retired.plan;
+            delete retired.table;
+        }
+        delete stepPlans.load();
     }
     PatternModel *q{nullptr};
     ZLPatternSynchronisationManager *zlSyncManager{nullptr};
@@ -570,6 +644,45 @@ public:
     // nb: this documents intent, and is used by the Same As Previous probability option
     bool mostRecentProbabilityResult{true};
 
+    /**
+     * \brief A stream of random numbers which is only ever touched by one thread, which other threads can ask to be reseeded
+     * Reseeding is posted here, and applied by the thread which owns the stream, the next time it fetches the stream.
+     */
+    struct PendingSeedRandomStream {
+        void postSeed(const quint64 &seed) {
+            pendingSeed.store(seed, std::memory_order_relaxed);
+            seedPending.store(true, std::memory_order_release);
+        }
+        RandomStream &stream() {
+            if (seedPending.exchange(false, std::memory_order_acquire)) {
+                random.seed(pendingSeed.load(std::memory_order_relaxed));
+            }
+            return random;
+        }
+    private:
+        RandomStream random{QRandomGenerator::global()->generate64()};
+        std::atomic<quint64> pendingSeed{0};
+        std::atomic<bool> seedPending{false};
+    };
+    // The stream of random numbers used for the probabilistic decisions made during sequence playback (only used by handleSequenceAdvancement)
+    PendingSeedRandomStream playbackRandom;
+    // The stream of random numbers used for the probabilistic decisions made when playing individual steps (only used by playStep)
+    PendingSeedRandomStream stepRandom;
+    void postSeed(const quint64 &seed) {
+        playbackRandom.postSeed(seed);
+        stepRandom.postSeed(seed);
+    }
+    /**
+     * \brief Reseed the random streams, if we have been asked to use deterministic seeds (see PatternModel::setRandomSeed)
+     */
+    void applyDeterministicSeed() {
+        quint64 deterministicSeed{0};
+        if (RandomStream::deterministicSeed(deterministicSeed)) {
+            // Give each pattern its own stream, based on where it lives (so patterns don't all make the same decisions)
+            postSeed(deterministicSeed ^ (quint64(sketchpadTrack + 1) << 32) ^ (quint64(clipIndex + 1) << 16));
+        }
+    }
+
     // These contain the generated information per step, stored per-position (that
     // is, the key of each entry is row * width + column). The position must be cleared
     // on any change made to the step (which should always be done through stepNote and
@@ -588,7 +701,36 @@ public:
         }
     }
 
-    void fillStepData(StepData &stepData, const bool &lockMidiChannelToClipIndex, const qint64 &nextPosition, bool &invalidateNoteBuffersImmediately, const qint64 &noteDuration, const int &schedulingIncrement) {
+    // The compiled plans for each of the positions in the model. This is only ever replaced on the model's thread (see rebuildStepPlans()), and only read during sequence playback
+    std::atomic<StepPlanTable*> stepPlans{nullptr};
+    // Sequence playback happens on a single thread, and these count the advancements started and completed on it, across all patterns
+    // (a plan which was replaced while advancement n was running can be deleted once n advancements have completed)
+    static std::atomic<quint64> advancementsStarted;
+    static std::atomic<quint64> advancementsCompleted;
+    // Plans and tables which have been replaced, but which sequence playback might still be reading from
+    struct RetiredStepPlans {
+        quint64 advancement{0};
+        StepPlan *plan{nullptr};
+        StepPlanTable *table{nullptr};
+    };
+    QList<RetiredStepPlans> retiredStepPlans;
+    /**
+     * \brief Get the compiled plan for the given position
+     * @param row The model row of the position
+     * @param column The column of the position
+     * @return The plan for the position, or nullptr if there is nothing there
+     */
+    const StepPlan *stepPlan(int row, int column) const {
+        if (performanceActive && performanceClone) {
+            return performanceClone->d->stepPlan(row, column);
+        }
+        const StepPlanTable *table{stepPlans.load()};
+        if (table && -1 < row && row < table->rows && -1 < column && column < table->width) {
+            return table->plans[(row * table->width) + column].load();
+        }
+        return nullptr;
+    }
+    StepPlan *compileStepPlan(int row, int column) {
         static const QLatin1String velocityString{"velocity"};
         static const QLatin1String delayString{"delay"};
         static const QLatin1String durationString{"duration"};
@@ -598,19 +740,124 @@ public:
         static const QLatin1String ratchetCountString{"ratchet-count"};
         static const QLatin1String ratchetProbabilityString{"ratchet-probability"};
         static const QLatin1String nextStepString{"next-step"};
-        auto subnoteSender = [this, lockMidiChannelToClipIndex, nextPosition, &invalidateNoteBuffersImmediately, noteDuration, schedulingIncrement, &stepData](const Note* subnote, const QVariantHash &metaHash, const qint64 &delay, StepData &noteStepData, int subnoteIndex) {
+        const Note *note = qobject_cast<const Note*>(q->getNote(row, column));
+        if (note == nullptr) {
+            return nullptr;
+        }
+        StepPlan *plan = new StepPlan;
+        plan->note = note;
+        const QVariant enabledVariant = q->getKeyedDataValue(row, column, enabledString);
+        plan->enabled = enabledVariant.isValid() ? enabledVariant.toBool() : true;
+        const QVariantList &subnotes = note->subnotes();
+        const QVariantList &meta = q->getMetadata(row, column).toList();
+        plan->hasMetadata = (meta.count() == subnotes.count());
+        plan->subnotes.reserve(subnotes.count());
+        for (int subnoteIndex = 0; subnoteIndex < subnotes.count(); ++subnoteIndex) {
+            const Note *subnote = subnotes[subnoteIndex].value<Note*>();
+            if (subnote) {
+                CompiledSubnote compiled;
+                compiled.subnote = subnote;
+                compiled.subnoteIndex = subnoteIndex;
+                if (plan->hasMetadata) {
+                    const QVariantHash &metaHash = meta[subnoteIndex].toHash();
+                    compiled.delay = metaHash.value(delayString, 0).toInt();
+                    compiled.velocity = metaHash.value(velocityString, 64).toInt();
+                    compiled.duration = metaHash.value(durationString, 0).toInt();
+                    compiled.probability = metaHash.value(probabilityString, 0).toInt();
+                    compiled.nextStep = metaHash.value(nextStepString, 0).toInt();
+                    compiled.ratchetStyle = metaHash.value(ratchetStyleString, 0).toInt();
+                    compiled.ratchetCount = metaHash.value(ratchetCountString, 0).toInt();
+                    compiled.ratchetProbability = metaHash.value(ratchetProbabilityString, 100).toInt();
+                }
+                plan->subnotes << compiled;
+            }
+        }
+        return plan;
+    }
+    // Ensure that any change to the model's contents also rebuilds the plans for the positions it affects
+    void connectStepPlanInvalidation() {
+        QObject::connect(q, &QAbstractItemModel::dataChanged, q, [this](const QModelIndex &topLeft, const QModelIndex &bottomRight){ rebuildStepPlans(topLeft.row(), topLeft.column(), bottomRight.row(), bottomRight.column()); }, Qt::DirectConnection);
+        QObject::connect(q, &QAbstractItemModel::modelReset, q, [this](){ rebuildStepPlans(); }, Qt::DirectConnection);
+        QObject::connect(q, &NotesModel::rowsChanged, q, [this](){ rebuildStepPlans(); }, Qt::DirectConnection);
+        QObject::connect(q, &PatternModel::widthChanged, q, [this](){ rebuildStepPlans(); }, Qt::DirectConnection);
+        rebuildStepPlans();
+    }
+    /**
+     * \brief Compile new plans for the given range of positions (or for all of them, if the range is not given)
+     * This happens on the model's thread, after the change has been made to the model. The new plans are swapped in
+     * for the old ones, which are deleted once sequence playback can no longer be reading from them. If the model's
+     * dimensions no longer match the current table, a new table is compiled in its entirety and swapped in instead.
+     * @param firstRow The first model row to rebuild
+     * @param firstColumn The first column to rebuild
+     * @param lastRow The last model row to rebuild
+     * @param lastColumn The last column to rebuild
+     */
+    void rebuildStepPlans(int firstRow = -1, int firstColumn = -1, int lastRow = -1, int lastColumn = -1) {
+        const int firstRetired{retiredStepPlans.count()};
+        StepPlanTable *table{stepPlans.load()};
+        const int rows{q->rowCount()};
+        if (table == nullptr || table->rows != rows || table->width != width || firstRow < 0 || firstColumn < 0) {
+            StepPlanTable *newTable = new StepPlanTable(rows, width);
+            for (int row = 0; row < rows; ++row) {
+                for (int column = 0; column < width; ++column) {
+                    newTable->plans[(row * width) + column].store(compileStepPlan(row, column), std::memory_order_relaxed);
+                }
+            }
+            stepPlans.store(newTable);
+            if (table) {
+                retiredStepPlans << RetiredStepPlans{0, nullptr, table};
+            }
+            // Anything built from the old plans is out of date now
+            clearStepData();
+        } else {
+            lastRow = qMin(lastRow, rows - 1);
+            lastColumn = qMin(lastColumn, width - 1);
+            for (int row = firstRow; row <= lastRow; ++row) {
+                for (int column = firstColumn; column <= lastColumn; ++column) {
+                    StepPlan *oldPlan = table->plans[(row * width) + column].exchange(compileStepPlan(row, column));
+                    if (oldPlan) {
+                        retiredStepPlans << RetiredStepPlans{0, oldPlan, nullptr};
+                    }
+                    clearStepData(row, column);
+                }
+            }
+        }
+        // Only look at where playback is once the new plans are in place, as any advancement which starts after this will only see those
+        const quint64 advancement{advancementsStarted.load()};
+        for (int index = firstRetired; index < retiredStepPlans.count(); ++index) {
+            retiredStepPlans[index].advancement = advancement;
+        }
+        deleteRetiredStepPlans();
+    }
+    // Delete the retired plans which sequence playback is done with
+    void deleteRetiredStepPlans() {
+        const quint64 completed{advancementsCompleted.load()};
+        QMutableListIterator<RetiredStepPlans> iterator(retiredStepPlans);
+        while (iterator.hasNext()) {
+            const RetiredStepPlans &retired = iterator.next();
+            if (retired.advancement <= completed) {
+                delete retired.plan;
+                delete retired.table;
+                iterator.remove();
+            }
+        }
+    }
+
+    void fillStepData(StepData &stepData, const bool &lockMidiChannelToClipIndex, const qint64 &nextPosition, bool &invalidateNoteBuffersImmediately, const qint64 &noteDuration, const int &schedulingIncrement, RandomStream &random) {
+        auto subnoteSender = [this, &random, lockMidiChannelToClipIndex, nextPosition, &invalidateNoteBuffersImmediately, noteDuration, schedulingIncrement, &stepData](const CompiledSubnote &compiled, const qint64 &delay, StepData &noteStepData) {
             bool sendNotes{true};
-            // qDebug() << Q_FUNC_INFO << "Preparing note" << subnote << "at index" << subnoteIndex << "with meta hash" << metaHash;
-            const int probability{metaHash.value(probabilityString, 0).toInt()};
+            const Note *subnote{compiled.subnote};
+            // qDebug() << Q_FUNC_INFO << "Preparing note" << subnote << "at index" << compiled.subnoteIndex;
+            const int probability{compiled.probability};
             if (probability > 0) {
                 invalidateNoteBuffersImmediately = true;
                 if (probability != 10) { // 10 is the Same As Previous option (meaning simply use whatever the most recent probability result was for this pattern)
-                    mostRecentProbabilityResult = noteStepData.getOrCreateProbabilitySequence(subnoteIndex, probability).nextStep();
+                    mostRecentProbabilityResult = noteStepData.getOrCreateProbabilitySequence(compiled.subnoteIndex, probability).nextStep(random);
                 }
                 sendNotes = mostRecentProbabilityResult;
             }
             if (sendNotes) {
-                int nextStep{metaHash.value(nextStepString, 0).toInt()};
+                int nextStep{compiled.nextStep};
                 if (nextStep > 0) {
                     // Technically the steps are 0-indexed, but this makes displaying it a little easier, and it's inexpensive here anyway
                     --nextStep;
@@ -619,14 +866,14 @@ public:
                     nextStep = (patternLength - nextPosition + nextStep) * noteDuration;
                     playfieldManager->setClipPlaystate(song, sketchpadTrack, clipIndex, PlayfieldManager::PlayingState, PlayfieldManager::CurrentPosition, playfieldManager->clipOffset(song, sketchpadTrack, clipIndex) + nextStep);
                 }
-                int velocity{metaHash.value(velocityString, 64).toInt()};
+                int velocity{compiled.velocity};
                 if (velocity == 0) {
                     velocity = 64;
                 } else if (velocity == -1) {
                     sendNotes = false;
                 }
                 if (sendNotes) {
-                    int duration{metaHash.value(durationString, 0).toInt() * patternTickToSyncTimerTick};
+                    int duration{compiled.duration * patternTickToSyncTimerTick};
                     if (duration == 0) {
                         // If the duration is 0, duration should be the size of a step
                         duration = noteDuration;
@@ -634,9 +881,9 @@ public:
                         // If the duration is less than 0, and we have a default note duration given, use that, otherwise use the step length
                         duration = (defaultNoteDuration + 1) < PatternModelDefaults::defaultNoteDuration ? noteDuration : defaultNoteDuration * patternTickToSyncTimerTick;
                     }
-                    const int ratchetCount{metaHash.value(ratchetCountString, 0).toInt()};
+                    const int ratchetCount{compiled.ratchetCount};
                     if (ratchetCount > 0) {
-                        const int ratchetStyle{metaHash.value(ratchetStyleString, 0).toInt()};
+                        const int ratchetStyle{compiled.ratchetStyle};
                         qint64 ratchetDelay{qMax(qint64(1), noteDuration / ratchetCount)};
                         qint64 ratchetDuration{duration};
                         qint64 ratchetLastDuration{duration};
@@ -659,7 +906,7 @@ public:
                                 // These are the default values, so just pass this through
                                 break;
                         }
-                        const int ratchetProbability{metaHash.value(ratchetProbabilityString, 100).toInt()};
+                        const int ratchetProbability{compiled.ratchetProbability};
                         if (ratchetProbability < 100) {
                             invalidateNoteBuffersImmediately = true;
                         }
@@ -667,7 +914,7 @@ public:
                         for (int ratchetIndex = 0; ratchetIndex < ratchetCount; ++ratchetIndex) {
                             sendNotes = true;
                             if (ratchetProbability < 100) {
-                                if (QRandomGenerator::global()->generateDouble() * 100 < ratchetProbability) {
+                                if (random.generateDouble() * 100 < ratchetProbability) {
                                     sendNotes = false;
                                 }
                             }
@@ -699,37 +946,29 @@ public:
             subsequentStep.updateSwing(noteDuration, ourPosition % 2 == 0 ? 50 : (performanceActive && performanceClone ? performanceClone->d->swing : swing));
             const int row = (ourPosition / width) % availableBars;
             const int column = ourPosition - (row * width);
-            const Note *note = (performanceActive && performanceClone) ? qobject_cast<const Note*>(performanceClone->getNote(row + bankOffset, column)) : qobject_cast<const Note*>(q->getNote(row + bankOffset, column));
-            const QVariant enabledVariant = (performanceActive && performanceClone) ? performanceClone->getKeyedDataValue(row + bankOffset, column, enabledString) : q->getKeyedDataValue(row + bankOffset, column, enabledString);
-            const bool stepEnabled = enabledVariant.isValid() ? enabledVariant.toBool() : true;
-            if (stepEnabled && note) {
-                const QVariantList &subnotes = note->subnotes();
-                const QVariantList &meta = (performanceActive && performanceClone) ? performanceClone->getMetadata(row + bankOffset, column).toList() : q->getMetadata(row + bankOffset, column).toList();
+            const StepPlan *plan = stepPlan(row + bankOffset, column);
+            const Note *note = plan ? plan->note : nullptr;
+            if (note && plan->enabled) {
                 // The first step (that is, the "current" step) we want to treat to all the things
                 if (subsequentStepIndex == 0) {
                     // qDebug() << Q_FUNC_INFO << "Step: Position" << ourPosition;
-                    if (meta.count() == subnotes.count()) {
-                        for (int subnoteIndex = 0; subnoteIndex < subnotes.count(); ++subnoteIndex) {
-                            const Note *subnote = subnotes[subnoteIndex].value<Note*>();
-                            const QVariantHash &metaHash = meta[subnoteIndex].toHash();
-                            if (subnote) {
-                                const qint64 delay{(metaHash.value(delayString, 0).toInt()) + subsequentStep.swingOffset};
-                                // Only handle if the delay is zero or in the future (since if it's in
-                                // the past, we'd be handling it twice, and at the wrong time)
-                                // qDebug() << Q_FUNC_INFO << "Delay is" << delay;
-                                if (delay >= 0) {
-                                    // qDebug() << Q_FUNC_INFO << "Delay" << delay << "is zero or positive, so sending step";
-                                    subnoteSender(subnote, metaHash, delay, subsequentStep, subnoteIndex);
-                                }
+                    if (plan->hasMetadata) {
+                        for (const CompiledSubnote &compiled : plan->subnotes) {
+                            const qint64 delay{compiled.delay + subsequentStep.swingOffset};
+                            // Only handle if the delay is zero or in the future (since if it's in
+                            // the past, we'd be handling it twice, and at the wrong time)
+                            // qDebug() << Q_FUNC_INFO << "Delay is" << delay;
+                            if (delay >= 0) {
+                                // qDebug() << Q_FUNC_INFO << "Delay" << delay << "is zero or positive, so sending step";
+                                subnoteSender(compiled, delay, subsequentStep);
                             }
                         }
-                    } else if (subnotes.count() > 0) {
-                        for (const QVariant &subnoteVar : subnotes) {
-                            const Note *subnote = subnoteVar.value<Note*>();
-                            if (subnote && subsequentStep.swingOffset >= 0) {
+                    } else if (note->subnotes().count() > 0) {
+                        for (const CompiledSubnote &compiled : plan->subnotes) {
+                            if (subsequentStep.swingOffset >= 0) {
                                 const int avaialbleChannel = syncTimer->nextAvailableChannel(sketchpadTrack, quint64(schedulingIncrement));
-                                addNoteToBuffer(stepData.getOrCreateBuffer(subsequentStep.swingOffset), subnote, 64, true, avaialbleChannel);
-                                addNoteToBuffer(stepData.getOrCreateBuffer(subsequentStep.swingOffset + noteDuration), subnote, 64, false, avaialbleChannel);
+                                addNoteToBuffer(stepData.getOrCreateBuffer(subsequentStep.swingOffset), compiled.subnote, 64, true, avaialbleChannel);
+                                addNoteToBuffer(stepData.getOrCreateBuffer(subsequentStep.swingOffset + noteDuration), compiled.subnote, 64, false, avaialbleChannel);
                             }
                         }
                     } else if (subsequentStep.swingOffset >= 0) {
@@ -740,18 +979,14 @@ public:
                 // The lookahead notes only need handling if, and only if, there is matching meta (or negative swing), and the delay+swing is negative (that meaning, the position of the entry is before that step)
                 } else {
                     // qDebug() << Q_FUNC_INFO << "Step: Subsequent" << subsequentStepIndex;
-                    if (meta.count() == subnotes.count() || subsequentStep.swingOffset < 0) {
+                    if (plan->hasMetadata || subsequentStep.swingOffset < 0) {
                         const qint64 positionAdjustment{subsequentStepIndex * noteDuration};
-                        for (int subnoteIndex = 0; subnoteIndex < subnotes.count(); ++subnoteIndex) {
-                            const Note *subnote = subnotes[subnoteIndex].value<Note*>();
-                            const QVariantHash &metaHash = meta[subnoteIndex].toHash();
-                            if (subnote) {
-                                const qint64 delay{(metaHash.value(delayString, 0).toInt()) + subsequentStep.swingOffset};
-                                // qDebug() << Q_FUNC_INFO << "Delay is" << delay;
-                                if (delay < 0 && positionAdjustment + delay < noteDuration) {
-                                    // qDebug() << Q_FUNC_INFO << "Delay is negative and within the current step for subsequent" << subsequentStepIndex << "sending step with position adjusted to" << positionAdjustment + delay;
-                                    subnoteSender(subnote, metaHash, positionAdjustment + delay, subsequentStep, subnoteIndex);
-                                }
+                        for (const CompiledSubnote &compiled : plan->subnotes) {
+                            const qint64 delay{compiled.delay + subsequentStep.swingOffset};
+                            // qDebug() << Q_FUNC_INFO << "Delay is" << delay;
+                            if (delay < 0 && positionAdjustment + delay < noteDuration) {
+                                // qDebug() << Q_FUNC_INFO << "Delay is negative and within the current step for subsequent" << subsequentStepIndex << "sending step with position adjusted to" << positionAdjustment + delay;
+                                subnoteSender(compiled, positionAdjustment + delay, subsequentStep);
                             }
                         }
                     }
@@ -780,15 +1015,19 @@ public:
         if (performanceActive && performanceClone) {
             performanceClone->d->invalidatePosition(row, column);
         } else {
-            if (row == -1 || column == -1) {
-                stepData.clear();
-            } else {
-                const int basePosition = (row * width) + column;
-                for (int subsequentNoteIndex = 0; subsequentNoteIndex < lookaheadAmount; ++subsequentNoteIndex) {
-                    // We clear backwards, just because might as well (by subtracting the subsequentNoteIndex from our base position)
-                    int ourPosition = (basePosition - subsequentNoteIndex) % patternLength;
-                    stepData.remove(ourPosition);
-                }
+            clearStepData(row, column);
+        }
+    }
+    // The part of invalidatePosition() which works on our own step data (whether or not we are performing)
+    void clearStepData(int row = -1, int column = -1) {
+        if (row == -1 || column == -1) {
+            stepData.clear();
+        } else {
+            const int basePosition = (row * width) + column;
+            for (int subsequentNoteIndex = 0; subsequentNoteIndex < lookaheadAmount; ++subsequentNoteIndex) {
+                // We clear backwards, just because might as well (by subtracting the subsequentNoteIndex from our base position)
+                int ourPosition = (basePosition - subsequentNoteIndex) % patternLength;
+                stepData.remove(ourPosition);
             }
         }
     }
@@ -887,10 +1126,14 @@ public:
     }
 };
 
+std::atomic<quint64> PatternModel::Private::advancementsStarted{0};
+std::atomic<quint64> PatternModel::Private::advancementsCompleted{0};
+
 PatternModel::PatternModel(SequenceModel* parent)
     : NotesModel(parent ? parent->playGridManager() : nullptr)
     , d(new Private(this))
 {
+    d->connectStepPlanInvalidation();
     d->zlSyncManager = new ZLPatternSynchronisationManager(this);
     d->segmentHandler = SegmentHandler::instance();
     connect(d->syncTimer, &SyncTimer::timerRunningChanged, this, [this](){
@@ -1065,6 +1308,7 @@ PatternModel::PatternModel(PatternModel* parent)
     : NotesModel(parent->playGridManager())
     , d(new Private(this))
 {
+    d->connectStepPlanInvalidation();
     // Register the performance model changes in the parent (basically "just" for thumbnail purposes and ui updates
     connect(this, &PatternModel::noteDestinationChanged, parent, &NotesModel::registerChange);
     connect(this, &PatternModel::stepLengthChanged, parent, &NotesModel::registerChange);
@@ -1645,11 +1889,8 @@ void PatternModel::setWidth(int width)
 bool PatternModel::exportToFile(const QString &fileName) const
 {
     bool success{false};
-    QFile patternFile(fileName);
     if (!d->lastSavedTimes.contains(fileName) || d->lastSavedTimes[fileName] < lastModified()) {
-        if (patternFile.open(QIODevice::WriteOnly)) {
-            patternFile.write(playGridManager()->modelToJson(this).toUtf8());
-            patternFile.close();
+        if (BackgroundFileWriter::writeAtomically(fileName, playGridManager()->modelToJson(this).toUtf8())) {
             success = true;
             d->lastSavedTimes[fileName] = QDateTime::currentMSecsSinceEpoch();
         }
@@ -1657,6 +1898,39 @@ bool PatternModel::exportToFile(const QString &fileName) const
     return success;
 }
 
+bool PatternModel::exportToFileInBackground(const QString &fileName, const bool &includeJson, std::function<void(bool)> completion) const
+{
+    bool queued{false};
+    if (!d->lastSavedTimes.contains(fileName) || d->lastSavedTimes[fileName] < lastModified()) {
+        // Write the binary version of the pattern (which is what gets used for loading, see SequenceModel::load), and the json interchange file next to it if asked
+        const QJsonObject patternObject{playGridManager()->modelToJsonObject(this)};
+        // Anything changed after this point will need saving again, even if the writes below succeed
+        const qint64 saveTime{QDateTime::currentMSecsSinceEpoch()};
+        // Only count the pattern as saved once all the files have made it to the disk
+        std::shared_ptr<int> remainingWrites{std::make_shared<int>(includeJson ? 2 : 1)};
+        std::shared_ptr<bool> allWritten{std::make_shared<bool>(true)};
+        PatternModel *context{const_cast<PatternModel*>(this)};
+        auto writeCompleted = [this, fileName, saveTime, remainingWrites, allWritten, completion](bool success){
+            *allWritten = *allWritten && success;
+            --(*remainingWrites);
+            if (*remainingWrites == 0) {
+                if (*allWritten) {
+                    d->lastSavedTimes[fileName] = qMax(d->lastSavedTimes.value(fileName), saveTime);
+                }
+                if (completion) {
+                    completion(*allWritten);
+                }
+            }
+        };
+        if (includeJson) {
+            BackgroundFileWriter::instance()->write(fileName, PatternFileFormat::toJson(patternObject).toJson(), context, writeCompleted);
+        }
+        BackgroundFileWriter::instance()->write(PatternFileFormat::binaryFileName(fileName), PatternFileFormat::encode(patternObject), context, writeCompleted);
+        queued = true;
+    }
+    return queued;
+}
+
 QObject* PatternModel::sequence() const
 {
     return d->sequence;
@@ -1671,6 +1945,7 @@ void PatternModel::setSketchpadTrack(int sketchpadTrack)
 {
     if (d->sketchpadTrack != sketchpadTrack) {
         d->sketchpadTrack = sketchpadTrack;
+        d->applyDeterministicSeed();
         Q_EMIT sketchpadTrackChanged();
     }
 }
@@ -1690,6 +1965,7 @@ void PatternModel::setClipIndex(int clipIndex)
 {
     if (d->clipIndex != clipIndex) {
         d->clipIndex = clipIndex;
+        d->applyDeterministicSeed();
         Q_EMIT clipIndexChanged();
     }
 }
@@ -2575,7 +2851,7 @@ void PatternModel::playStep(const int& step, const bool &playAsSequencer)
             const int schedulingIncrement{0};
             // This is going to be ignored, since we will always invalidate after test firing a step
             bool invalidateNoteBuffersImmediately{false};
-            d->fillStepData(stepData, lockMidiChannelToClipIndex, nextPosition, invalidateNoteBuffersImmediately, noteDuration, schedulingIncrement);
+            d->fillStepData(stepData, lockMidiChannelToClipIndex, nextPosition, invalidateNoteBuffersImmediately, noteDuration, schedulingIncrement, d->stepRandom.stream());
         }
         QHash<int, juce::MidiBuffer>::const_iterator position;
         for (position = stepData.positionBuffers.constBegin(); position != stepData.positionBuffers.constEnd(); ++position) {
@@ -2593,6 +2869,8 @@ void PatternModel::playStep(const int& step, const bool &playAsSequencer)
 
 void PatternModel::handleSequenceAdvancement(qint64 sequencePosition, int progressionLength) const
 {
+    // Tells the model's thread that the plans it has replaced before now might be in use (see Private::rebuildStepPlans())
+    Private::advancementsStarted.fetch_add(1);
     if (!d->zlSyncManager->channelMuted && isPlaying()) {
         // For a pattern on tracks set to target other tracks, we need to use that track's targeting settings, not our own
         const ZynthboxBasics::Track targetTrack{MidiRouter::instance()->sketchpadTrackTargetTrack(ZynthboxBasics::Track(d->sketchpadTrack))};
@@ -2602,6 +2880,8 @@ void PatternModel::handleSequenceAdvancement(qint64 sequencePosition, int progre
         };
         qint64 noteDuration{0};
         bool relevantToUs{false};
+        // Fetching the stream here applies any seed posted since the previous advancement
+        RandomStream &random = d->playbackRandom.stream();
         for (int progressionIncrement = 0; progressionIncrement <= progressionLength; ++progressionIncrement) {
             // As we might change the offset on some step, we'll need that in here
             const qint64 playbackOffset{d->playfieldManager->clipOffset(d->song, d->sketchpadTrack, d->clipIndex, true) - (d->segmentHandler->songMode() ? d->segmentHandler->startOffset() : 0)};
@@ -2623,7 +2903,7 @@ void PatternModel::handleSequenceAdvancement(qint64 sequencePosition, int progre
 
                 StepData &stepData = d->getOrCreateStepData(nextPosition + (d->bankOffset * d->width));
                 if (stepData.isValid == false) {
-                    d->fillStepData(stepData, lockMidiChannelToClipIndex, nextPosition, invalidateNoteBuffersImmediately, noteDuration, schedulingIncrement);
+                    d->fillStepData(stepData, lockMidiChannelToClipIndex, nextPosition, invalidateNoteBuffersImmediately, noteDuration, schedulingIncrement, random);
                 }
                 switch (d->noteDestination) {
                     case PatternModel::SampleLoopedDestination:
@@ -2655,6 +2935,7 @@ void PatternModel::handleSequenceAdvancement(qint64 sequencePosition, int progre
             }
         }
     }
+    Private::advancementsCompleted.fetch_add(1);
 }
 
 void PatternModel::updateSequencePosition(qint64 sequencePosition)
@@ -2692,6 +2973,12 @@ void PatternModel::resetSequenceProbabilities()
 {
     d->invalidateProbabilities();
     d->mostRecentProbabilityResult = true;
+    d->applyDeterministicSeed();
+}
+
+void PatternModel::setRandomSeed(const quint64& seed)
+{
+    d->postSeed(seed);
 }
 
 void PatternModel::handleMidiMessage(const MidiRouter::ListenerPort &port, const quint64 &timestamp, const unsigned char &byte1, const unsigned char &byte2, const unsigned char &byte3, const int& sketchpadTrack, const QString& hardwareDeviceId)
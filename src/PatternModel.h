@@ -27,6 +27,8 @@
 #include "MidiRouter.h"
 #include "KeyScales.h"
 
+#include <functional>
+
 class ClipCommandRing;
 /**
  * \brief A way to keep channel of the notes which make up a conceptual song pattern
@@ -557,6 +559,19 @@ public:
      * @return True if the file was successfully written, otherwise false
      */
     Q_INVOKABLE bool exportToFile(const QString &fileName) const;
+    /**
+     * \brief Export the pattern to the given file on a background thread, if the pattern has changed since it was last saved there
+     * The data is generated immediately, and the binary version of the pattern (see PatternFileFormat), which is what gets used
+     * when loading the pattern, is then written atomically by the BackgroundFileWriter, next to the given json file. The json
+     * representation is only written to the given file itself if includeJson is true.
+     * The pattern is only considered saved once everything has been written successfully.
+     * @param fileName The file you wish to write the pattern's json representation to (the binary file's name is based on this)
+     * @param includeJson Whether to also write the json representation
+     * @param completion If given, and the pattern was queued up for writing, this is called on the main thread once the writing
+     * is done, with true if all files were written successfully, otherwise false (it is not called if the pattern is destroyed first)
+     * @return True if the pattern had changes, and was queued up for writing, otherwise false
+     */
+    bool exportToFileInBackground(const QString &fileName, const bool &includeJson, std::function<void(bool)> completion = nullptr) const;
 
     QObject* sequence() const;
     /**
@@ -826,6 +841,19 @@ public:
      * \brief This will reset any tested probability type things (used e.g. when all-notes-off is received)
      */
     void resetSequenceProbabilities();
+    /**
+     * \brief Restart the random number stream used for probability and ratchet decisions from the given seed
+     *
+     * Each pattern has its own stream of random numbers. By default each stream is seeded randomly, but
+     * if the environment variable ZYNTHBOX_DETERMINISTIC_SEED is set to a number, each pattern's stream
+     * will instead be seeded from that number (combined with the pattern's track and clip), and reseeded
+     * whenever the sequence stops, so that playback is reproducible from one run to the next.
+     *
+     * This is safe to call from any thread: the new seed is applied by sequence playback the next time it
+     * advances (and by playStep the next time a step is played), rather than while it is drawing from the stream.
+     * @param seed The seed to restart the stream from
+     */
+    Q_INVOKABLE void setRandomSeed(const quint64 &seed);
 
     Q_SLOT void handleMidiMessage(const MidiRouter::ListenerPort &port, const quint64 &timestamp, const unsigned char &byte1, const unsigned char &byte2, const unsigned char &byte3, const int& sketchpadTrack, const QString& hardwareDeviceId);
 private:
@@ -23,6 +23,7 @@
 #include "ZynthboxBasics.h"
 #include "Note.h"
 #include "NotesModel.h"
+#include "PatternFileFormat.h"
 #include "PatternModel.h"
 #include "SegmentHandler.h"
 #include "SettingsContainer.h"
@@ -67,11 +68,12 @@ static const QString midiNoteNames[128]{
     "C9", "C#9", "D9", "D#9", "E9", "F9", "F#9", "G9"
 };
 
-PlayGridManager* timer_callback_ticker{nullptr};
-void timer_callback(int beat) {
-    if (timer_callback_ticker) {
-        timer_callback_ticker->handleMetronomeTick(beat);
-    }
+// Called directly by the sync timer for each tick, so playback progresses in lockstep with the timer
+void timer_callback(int /*beat*/, void */*data*/) {
+    static PlayfieldManager *playfieldManager{PlayfieldManager::instance()};
+    static SegmentHandler *segmentHandler{SegmentHandler::instance()};
+    playfieldManager->progressPlayback();
+    segmentHandler->progressPlayback();
 }
 
 class ZLPGMSynchronisationManager : public QObject {
@@ -129,6 +131,7 @@ public:
                 note->setSketchpadTrack(track);
                 QQmlEngine::setObjectOwnership(note, QQmlEngine::CppOwnership);
                 notes << note;
+                trackNotes[track][midiNote] = note;
             }
         }
 
@@ -220,8 +223,18 @@ public:
             hardwareInNoteActivations[i] = 0;
             hardwareOutNoteActivations[i] = 0;
         }
-        QObject::connect(midiRouter, &MidiRouter::noteChanged, q, [this](const MidiRouter::ListenerPort &port, const int &/*midiNote*/, const int &/*midiChannel*/, const int &/*velocity*/, const bool &/*setOn*/, const quint64 &timestamp, const unsigned char& byte1, const unsigned char& byte2, const unsigned char& byte3, const int &sketchpadTrack, const QString& hardwareDeviceId){ emitMidiMessage(port, timestamp, byte1, byte2, byte3, sketchpadTrack, hardwareDeviceId); }, Qt::DirectConnection);
-        QObject::connect(midiRouter, &MidiRouter::midiMessage, q, [this](int port, int size, const unsigned char& byte1, const unsigned char& byte2, const unsigned char& byte3, const int& sketchpadTrack, bool fromInternal ){ handleMidiMessage(port, size, byte1, byte2, byte3, sketchpadTrack, fromInternal); }, Qt::QueuedConnection);
+        QObject::connect(midiRouter, &MidiRouter::listenerMessagesReceived, q, [this](const MidiRouter::ListenerPort &port, const QVector<MidiRouter::ListenerMessage> &messages){
+            for (const MidiRouter::ListenerMessage &message : messages) {
+                if (message.isNoteMessage) {
+                    emitMidiMessage(port, message.timestamp, message.byte1, message.byte2, message.byte3, message.sketchpadTrack, message.hardwareDeviceId);
+                }
+            }
+        }, Qt::DirectConnection);
+        QObject::connect(midiRouter, &MidiRouter::listenerMessagesReceived, q, [this](const MidiRouter::ListenerPort &port, const QVector<MidiRouter::ListenerMessage> &messages){
+            for (const MidiRouter::ListenerMessage &message : messages) {
+                handleMidiMessage(port, message.size, message.byte1, message.byte2, message.byte3, message.sketchpadTrack, message.fromInternal);
+            }
+        }, Qt::QueuedConnection);
         currentPlaygrids = {
             {"minigrid", 0}, // As these are sorted alphabetically, notesgrid for minigrid and
             {"playgrid", 1}, // stepsequencer for playgrid
@@ -239,8 +252,6 @@ public:
     PlayGridManager *q;
     ZLPGMSynchronisationManager *zlSyncManager{nullptr};
     QQmlEngine *engine{nullptr};
-    SegmentHandler *segmentHandler{nullptr};
-    PlayfieldManager *playfieldManager{nullptr};
     QStringList playgrids;
     QVariantMap currentPlaygrids;
     QString preferredSequencer;
@@ -250,6 +261,10 @@ public:
     QHash<QString, PatternModel*> patternModels;
     QHash<QString, NotesModel*> notesModels;
     QList<Note*> notes;
+    // All the plain notes (which are all created up front), for direct lookup by sketchpad track and midi note
+    Note *trackNotes[ZynthboxTrackCount][128];
+    // The compound notes, keyed on the signature of their subnotes (see getCompoundNote())
+    QHash<int, Note*> compoundNotes;
     QHash<QString, SettingsContainer*> settingsContainers;
     QHash<QString, QObject*> namedInstances;
     QHash<Note*, int> noteStateMap;
@@ -461,11 +476,8 @@ public:
 
     Note *findExistingNote(int midiNote, int sketchpadTrack) {
         Note *note{nullptr};
-        for (Note *aNote : qAsConst(notes)) {
-            if (aNote->midiNote() == midiNote && aNote->sketchpadTrack() == sketchpadTrack) {
-                note = aNote;
-                break;
-            }
+        if (0 <= midiNote && midiNote < 128 && 0 <= sketchpadTrack && sketchpadTrack < ZynthboxTrackCount) {
+            note = trackNotes[sketchpadTrack][midiNote];
         }
         return note;
     }
@@ -497,8 +509,8 @@ PlayGridManager::PlayGridManager(QObject* parent)
     , d(new Private(this))
 {
     d->syncTimer = qobject_cast<SyncTimer*>(SyncTimer::instance());
-    timer_callback_ticker = this;
-    connect(d->syncTimer, &SyncTimer::timerTick, this, &timer_callback, Qt::DirectConnection);
+    d->syncTimer->registerTickCallback("PlayGridManager playback progress", &timer_callback, nullptr, 200);
+    connect(d->syncTimer, &SyncTimer::timerTick, this, &PlayGridManager::handleMetronomeTick);
     connect(d->syncTimer, &SyncTimer::timerRunningChanged, this, &PlayGridManager::metronomeActiveChanged);
     connect(d->syncTimer, &SyncTimer::timerRunningChanged, this, [this](){
         if (d->syncTimer->timerRunning() == false) {
@@ -543,6 +555,7 @@ PlayGridManager::PlayGridManager(QObject* parent)
 
 PlayGridManager::~PlayGridManager()
 {
+    d->syncTimer->unregisterTickCallback(&timer_callback, nullptr);
     delete d;
 }
 
@@ -697,23 +710,8 @@ QObject* PlayGridManager::getNote(int midiNote, int sketchpadTrack)
     Note *note{nullptr};
     const int theTrack{sketchpadTrack == -1 ? d->syncTimer->currentTrack() : std::clamp(sketchpadTrack, 0, ZynthboxTrackCount - 1)};
     // The channel numbers here /are/ invalid - however, we need them to distinguish "invalid" notes while still having a Note to operate with
-    if (0 <= midiNote && midiNote <= 127) {
-        for (Note *aNote : d->notes) {
-            if (aNote->midiNote() == midiNote && aNote->sketchpadTrack() == theTrack) {
-                note = aNote;
-                break;
-            }
-        }
-        if (!note) {
-            static const QString note_int_to_str_map[12]{"C", "C#","D","D#","E","F","F#","G","G#","A","A#","B"};
-            note = new Note(this);
-            note->setName(note_int_to_str_map[midiNote % 12]);
-            note->setMidiNote(midiNote);
-            note->setSketchpadTrack(theTrack);
-            QQmlEngine::setObjectOwnership(note, QQmlEngine::CppOwnership);
-            d->notes << note;
-        }
-    }
+    // All the possible plain notes are created when we start up, so this is simply a matter of looking it up
+    note = d->findExistingNote(midiNote, theTrack);
     return note;
 }
 
@@ -739,23 +737,25 @@ QObject* PlayGridManager::getCompoundNote(const QVariantList& notes)
         ++index;
     }
     if (fake_midi_note > 127) {
-        for (Note *aNote : d->notes) {
-            if (aNote->midiNote() == fake_midi_note) {
-                note = aNote;
-                break;
-            }
-        }
+        note = d->compoundNotes.value(fake_midi_note);
         if (!note) {
             note = new Note(this);
             note->setMidiNote(fake_midi_note);
             note->setSubnotes(notes);
             QQmlEngine::setObjectOwnership(note, QQmlEngine::CppOwnership);
             d->notes << note;
+            d->compoundNotes.insert(fake_midi_note, note);
+            Q_EMIT noteCountChanged();
         }
     }
     return note;
 }
 
+int PlayGridManager::noteCount() const
+{
+    return d->notes.count();
+}
+
 QObject* PlayGridManager::getSettingsStore(const QString& name)
 {
     SettingsContainer *settings = d->settingsContainers.value(name);
@@ -879,7 +879,18 @@ QString PlayGridManager::modelToJson(const QObject* model) const
     const NotesModel* actualModel = qobject_cast<const NotesModel*>(model);
     const PatternModel* patternModel = qobject_cast<const PatternModel*>(model);
     if (patternModel) {
-        QJsonObject modelObject;
+        json = PatternFileFormat::toJson(modelToJsonObject(patternModel));
+    } else if (actualModel) {
+        json.setArray(d->generateModelNotesSection(actualModel));
+    }
+    return json.toJson();
+}
+
+QJsonObject PlayGridManager::modelToJsonObject(const QObject* model) const
+{
+    QJsonObject modelObject;
+    const PatternModel* patternModel = qobject_cast<const PatternModel*>(model);
+    if (patternModel) {
         modelObject["height"] = patternModel->height();
         modelObject["width"] = patternModel->width();
         modelObject["noteDestination"] = int(patternModel->noteDestination());
@@ -901,20 +912,18 @@ QString PlayGridManager::modelToJson(const QObject* model) const
         modelObject["gridModelStartNote"] = patternModel->gridModelStartNote();
         modelObject["gridModelEndNote"] = patternModel->gridModelEndNote();
         modelObject["hasNotes"] = patternModel->hasNotes();
-        QJsonDocument notesDoc;
-        notesDoc.setArray(d->generateModelNotesSection(patternModel));
-        modelObject["notes"] = QString::fromUtf8(notesDoc.toJson());
-        // Add in the Sound data from whatever sound is currently in use...
-        json.setObject(modelObject);
-    } else if (actualModel) {
-        json.setArray(d->generateModelNotesSection(actualModel));
+        modelObject["notes"] = d->generateModelNotesSection(patternModel);
     }
-    return json.toJson();
+    return modelObject;
 }
 
 void PlayGridManager::setModelFromJson(QObject* model, const QString& json)
 {
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(json.toUtf8());
+    setModelFromJsonDocument(model, QJsonDocument::fromJson(json.toUtf8()));
+}
+
+void PlayGridManager::setModelFromJsonDocument(QObject* model, const QJsonDocument& jsonDoc, const QJsonDocument& notesJson)
+{
     if (jsonDoc.isArray()) {
         NotesModel* actualModel = qobject_cast<NotesModel*>(model);
         actualModel->startLongOperation();
@@ -942,7 +951,13 @@ void PlayGridManager::setModelFromJson(QObject* model, const QString& json)
         QJsonObject patternObject = jsonDoc.object();
         if (pattern) {
             pattern->startLongOperation();
-            setModelFromJson(model, patternObject.value("notes").toString());
+            if (notesJson.isNull()) {
+                // The notes are stored as a json string in the interchange format, and as an actual array in the binary one
+                const QJsonValue notes{patternObject.value("notes")};
+                setModelFromJsonDocument(model, notes.isArray() ? QJsonDocument(notes.toArray()) : QJsonDocument::fromJson(notes.toString().toUtf8()));
+            } else {
+                setModelFromJsonDocument(model, notesJson);
+            }
             pattern->setHeight(patternObject.value("height").toInt());
             pattern->setWidth(patternObject.value("width").toInt());
             if (patternObject.contains("noteLength")) {
@@ -1025,9 +1040,18 @@ void PlayGridManager::setModelFromJsonFile(QObject *model, const QString &jsonFi
     QFile file(jsonFile);
     if (file.exists()) {
         if (file.open(QIODevice::ReadOnly)) {
-            QString data = QString::fromUtf8(file.readAll());
+            const QByteArray data{file.readAll()};
             file.close();
-            setModelFromJson(model, data);
+            // Patterns might also be stored in the binary format, so accept that here as well
+            if (PatternFileFormat::isBinary(data)) {
+                bool ok{false};
+                const QJsonObject pattern{PatternFileFormat::decode(data, &ok)};
+                if (ok) {
+                    setModelFromJsonDocument(model, QJsonDocument(pattern));
+                }
+            } else {
+                setModelFromJsonDocument(model, QJsonDocument::fromJson(data));
+            }
         }
     }
 }
@@ -1174,14 +1198,6 @@ QObject * PlayGridManager::syncTimer()
 
 void PlayGridManager::handleMetronomeTick(int beat)
 {
-    if (d->playfieldManager == nullptr) {
-        d->playfieldManager = PlayfieldManager::instance();
-    }
-    d->playfieldManager->progressPlayback();
-    if (d->segmentHandler == nullptr) {
-        d->segmentHandler = SegmentHandler::instance();
-    }
-    d->segmentHandler->progressPlayback();
     Q_EMIT metronomeTick(beat);
     if (beat % d->beatSubdivision6 == 0) {
         d->metronomeBeat128th = beat / d->beatSubdivision6;
@@ -27,6 +27,7 @@
 #include <QObject>
 #include <QCoreApplication>
 #include <QVariantMap>
+#include <QJsonDocument>
 #include <QJsonObject>
 
 class ClipCommandRing;
@@ -104,6 +105,11 @@ class PlayGridManager : public QObject
      * @default 0
      */
     Q_PROPERTY(int currentSketchpadTrack READ currentSketchpadTrack NOTIFY currentSketchpadTrackChanged)
+    /**
+     * \brief The number of Note objects currently alive (all the plain notes for all tracks, plus every compound note created so far)
+     * Compound notes are never deleted once created, so this is useful for keeping an eye on how many have accumulated
+     */
+    Q_PROPERTY(int noteCount READ noteCount NOTIFY noteCountChanged)
 
     Q_PROPERTY(QObject* syncTimer READ syncTimer CONSTANT)
     Q_PROPERTY(bool metronomeActive READ metronomeActive NOTIFY metronomeActiveChanged)
@@ -191,8 +197,21 @@ public:
      */
     Q_INVOKABLE QObject* getPatternModel(const QString&name, SequenceModel *sequence = nullptr);
     Q_INVOKABLE QObject* getNotesModel(const QString &name);
+    /**
+     * \brief Get the Note object for the given midi note on the given sketchpad track
+     * @param midiNote The midi note (0 through 127)
+     * @param sketchpadTrack The sketchpad track (-1 for the current track)
+     * @return The note, or null if the midi note is out of range
+     */
     Q_INVOKABLE QObject* getNote(int midiNote, int sketchpadTrack = -1);
+    /**
+     * \brief Get the compound Note object made up of the given list of notes (it will be created if it doesn't already exist)
+     * @param notes A list of Note objects
+     * @return The compound note, or null if the list contains anything which is not a Note
+     */
     Q_INVOKABLE QObject* getCompoundNote(const QVariantList &notes);
+    int noteCount() const;
+    Q_SIGNAL void noteCountChanged();
     Q_INVOKABLE QObject* getSettingsStore(const QString &name);
 
     /**
@@ -245,6 +264,16 @@ public:
      * @return A string containing a representation of the model's notes in JSON form
      */
     Q_INVOKABLE QString modelToJson(const QObject *model) const;
+    /**
+     * \brief Get a JSON object representing the given pattern, with its notes stored as an array
+     *
+     * This is the same structure as the one returned by modelToJson(), except the notes are not turned into a string,
+     * which is what the binary pattern format stores (see PatternFileFormat).
+     *
+     * @param model A PatternModel object
+     * @return An object representing the pattern (or an empty object if the model is not a pattern)
+     */
+    QJsonObject modelToJsonObject(const QObject *model) const;
     /**
      * \brief Set the contents of the given model based on the given JSON representation
      *
@@ -252,11 +281,22 @@ public:
      * @param json A string containing a JSON formatted representation of a model's contents (or a list, see notesListToJson())
      */
     Q_INVOKABLE void setModelFromJson(QObject *model, const QString &json);
+    /**
+     * \brief Set the contents of the given model based on an already parsed JSON representation
+     *
+     * As a pattern's notes are stored as a string inside the pattern object, they need parsing on their own,
+     * and that can be done ahead of time too (for example, when parsing a lot of patterns on other threads).
+     *
+     * @param model A NotesModel object to set to match the json structure
+     * @param json A parsed JSON representation of a model's contents (see setModelFromJson(QObject*, const QString&))
+     * @param notesJson For patterns, the parsed contents of the pattern object's notes value (if this is null, that value will be parsed here)
+     */
+    void setModelFromJsonDocument(QObject *model, const QJsonDocument &json, const QJsonDocument &notesJson = QJsonDocument());
     /**
      * \brief Set the contents of the given model based on the JSON representation contained in the given file
      *
      * @param model A NotesModel object to set to match the json structure
-     * @param jsonFile A file which must contain only a JSON formatted representation of a model's contents (or a list, see notesListToJson())
+     * @param jsonFile A file which must contain only a JSON formatted representation of a model's contents (or a list, see notesListToJson()), or a pattern in the binary format (see PatternFileFormat)
      */
     Q_INVOKABLE void setModelFromJsonFile(QObject *model, const QString &jsonFile);
     /**
@@ -59,6 +59,7 @@
 #include "SyncTimer.h"
 #include "ZLEngineBehaviour.h"
 #include "PlayfieldManager.h"
+#include "ProcessTiming.h"
 #include "KeyScales.h"
 #include "Chords.h"
 #include "ProcessWrapper.h"
@@ -78,6 +79,7 @@
 #include "SysexMessage.h"
 #include "AudioFileConverter.h"
 #include "LedManager.h"
+#include "LockFreeRing.h"
 
 #include "folderlistmodel/qquickfolderlistmodel.h"
 
@@ -316,6 +318,24 @@ void Plugin::initialize()
 
     qDebug() << "Initialising PlayfieldManager";
     PlayfieldManager::instance();
+
+    // The rings only count their overflows (as they are mostly written to from realtime threads), so report those from here
+    QTimer *ringOverflowReportTimer = new QTimer(this);
+    ringOverflowReportTimer->setInterval(10000);
+    connect(ringOverflowReportTimer, &QTimer::timeout, this, [](){
+        LockFreeRingBase::reportOverflows();
+    });
+    ringOverflowReportTimer->start();
+
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+    qDebug() << "Starting process timing reports";
+    QTimer *processTimingReportTimer = new QTimer(this);
+    processTimingReportTimer->setInterval(10000);
+    connect(processTimingReportTimer, &QTimer::timeout, this, [](){
+        ProcessTimingStatistics::reportAll(SamplerSynth::instance()->sampleRate());
+    });
+    processTimingReportTimer->start();
+#endif
 }
 
 void Plugin::shutdown()
@@ -0,0 +1,42 @@
+#include "ProcessTiming.h"
+
+#include <QDebug>
+
+// The head of the list of all statistics instances (new ones are pushed onto the front, and none are ever removed)
+static std::atomic<ProcessTimingStatistics*> firstStatistics{nullptr};
+
+ProcessTimingStatistics::ProcessTimingStatistics(const char* name)
+    : m_name(name)
+{
+    m_next = firstStatistics.load();
+    while (firstStatistics.compare_exchange_weak(m_next, this) == false) {}
+}
+
+void ProcessTimingStatistics::reportAll(const double sampleRate)
+{
+    for (ProcessTimingStatistics *statistics = firstStatistics.load(); statistics != nullptr; statistics = statistics->m_next) {
+        statistics->report(sampleRate);
+    }
+}
+
+void ProcessTimingStatistics::report(const double sampleRate)
+{
+    // The amount of time available for processing each frame, if we are to keep up with realtime
+    const double nanosecondsPerFrameBudget{1000000000.0 / sampleRate};
+    for (int index = 0; index < BucketCount; ++index) {
+        Bucket &bucket = m_buckets[index];
+        const quint64 calls{bucket.calls.exchange(0, std::memory_order_relaxed)};
+        const quint64 frames{bucket.frames.exchange(0, std::memory_order_relaxed)};
+        const quint64 nanoseconds{bucket.nanoseconds.exchange(0, std::memory_order_relaxed)};
+        const quint64 worstNanoseconds{bucket.worstNanoseconds.exchange(0, std::memory_order_relaxed)};
+        if (calls > 0 && frames > 0) {
+            const quint64 bufferSize{frames / calls};
+            const double averageNanosecondsPerFrame{double(nanoseconds) / double(frames)};
+            const double worstNanosecondsPerFrame{double(worstNanoseconds) / double(bufferSize)};
+            qInfo().nospace() << "Process timing for " << m_name << " at " << bufferSize << " frames per call (" << calls << " calls):"
+                << " average " << averageNanosecondsPerFrame << " ns/frame,"
+                << " worst " << worstNanosecondsPerFrame << " ns/frame,"
+                << " fits " << (averageNanosecondsPerFrame > 0 ? nanosecondsPerFrameBudget / averageNanosecondsPerFrame : 0) << " instances per core";
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QtGlobal>
+#include <atomic>
+#include <chrono>
+
+/**
+ * \brief Timing statistics for one of the audio hot paths (a process function, or a part of one)
+ *
+ * Instances are intended to be created through the MEASURE_PROCESS_TIMING macro, which only does
+ * anything when libzynthbox is built with the MEASURE_PROCESS_TIMING cmake option turned on. Every
+ * instance registers itself in a global list, and reportAll() writes out the statistics for each of
+ * them (per buffer size, as processing cost per frame is rarely constant across buffer sizes), and
+ * then starts the measurements over.
+ *
+ * Adding a measurement is safe to do from a realtime thread (it is a handful of relaxed atomic operations).
+ */
+class ProcessTimingStatistics {
+public:
+    explicit ProcessTimingStatistics(const char *name);
+    ~ProcessTimingStatistics() {}
+
+    /**
+     * \brief Add a single measurement
+     * @param nanoseconds How long the processing took
+     * @param frames How many frames were processed in that time
+     */
+    void add(const quint64 nanoseconds, const quint32 frames) {
+        Bucket &bucket = m_buckets[bucketIndex(frames)];
+        bucket.calls.fetch_add(1, std::memory_order_relaxed);
+        bucket.frames.fetch_add(frames, std::memory_order_relaxed);
+        bucket.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        quint64 worst{bucket.worstNanoseconds.load(std::memory_order_relaxed)};
+        while (worst < nanoseconds && bucket.worstNanoseconds.compare_exchange_weak(worst, nanoseconds, std::memory_order_relaxed) == false) {}
+    }
+
+    /**
+     * \brief Write out the statistics gathered since the last report for all the known hot paths, and reset them
+     * @param sampleRate The sample rate used to work out how many instances of each path fit on a single core
+     */
+    static void reportAll(const double sampleRate);
+private:
+    // Buffer sizes 16 through 4096 each get their own bucket (anything else goes in the nearest one)
+    static constexpr int BucketCount{9};
+    static inline int bucketIndex(quint32 frames) {
+        int index{0};
+        while (frames > 16 && index < BucketCount - 1) {
+            frames = frames >> 1;
+            ++index;
+        }
+        return index;
+    }
+    struct Bucket {
+        std::atomic<quint64> calls{0};
+        std::atomic<quint64> frames{0};
+        std::atomic<quint64> nanoseconds{0};
+        std::atomic<quint64> worstNanoseconds{0};
+    };
+    void report(const double sampleRate);
+    const char *m_name{nullptr};
+    Bucket m_buckets[BucketCount];
+    ProcessTimingStatistics *m_next{nullptr};
+};
+
+/**
+ * \brief Measures the time from its construction to its destruction, and adds it to the given statistics
+ */
+class ProcessTimingScope {
+public:
+    ProcessTimingScope(ProcessTimingStatistics &statistics, const quint32 frames)
+        : m_statistics(statistics)
+        , m_frames(frames)
+        , m_start(std::chrono::steady_clock::now())
+    {}
+    ~ProcessTimingScope() {
+        m_statistics.add(quint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count()), m_frames);
+    }
+private:
+    ProcessTimingStatistics &m_statistics;
+    const quint32 m_frames;
+    const std::chrono::steady_clock::time_point m_start;
+};
+
+#ifdef ZYNTHBOX_MEASURE_PROCESS_TIMING
+#define PROCESS_TIMING_CONCATENATE_ACTUAL(first, second) first##second
+#define PROCESS_TIMING_CONCATENATE(first, second) PROCESS_TIMING_CONCATENATE_ACTUAL(first, second)
+/**
+ * \brief Measure the time from this point until the end of the current scope, as processing the given number of frames
+ * @param name The name the measurements will be reported under (use the same name in several places to have those be reported together)
+ * @param frames The number of frames processed in the scope
+ */
+#define MEASURE_PROCESS_TIMING(name, frames) \
+    static ProcessTimingStatistics PROCESS_TIMING_CONCATENATE(processTimingStatistics, __LINE__){name}; \
+    const ProcessTimingScope PROCESS_TIMING_CONCATENATE(processTimingScope, __LINE__){PROCESS_TIMING_CONCATENATE(processTimingStatistics, __LINE__), quint32(frames)};
+#else
+#define MEASURE_PROCESS_TIMING(name, frames)
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QByteArray>
+#include <QtGlobal>
+
+/**
+ * \brief A small, fast, seedable stream of pseudo-random numbers
+ *
+ * This is an implementation of xoshiro256**, seeded through splitmix64. Each instance is its own
+ * independent stream with no shared state, which means it is safe to use from a realtime thread
+ * (there is no locking or allocation involved), but also that any one instance should only be
+ * used by one thread at a time.
+ *
+ * Two streams given the same seed will produce the same sequence of numbers, which makes it
+ * possible to get reproducible results out of things which make random decisions.
+ */
+class RandomStream {
+public:
+    explicit RandomStream(quint64 seedValue = 0) {
+        seed(seedValue);
+    }
+    ~RandomStream() {}
+
+    /**
+     * \brief Restart the stream from the given seed
+     * @param seedValue Any value (including zero) is a valid seed
+     */
+    void seed(quint64 seedValue) {
+        for (int i = 0; i < 4; ++i) {
+            seedValue += 0x9e3779b97f4a7c15ULL;
+            quint64 mixed{seedValue};
+            mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebULL;
+            state[i] = mixed ^ (mixed >> 31);
+        }
+    }
+    /**
+     * \brief Get the next 64 bit value from the stream
+     */
+    quint64 generate64() {
+        const quint64 result{rotateLeft(state[1] * 5, 7) * 9};
+        const quint64 shifted{state[1] << 17};
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= shifted;
+        state[3] = rotateLeft(state[3], 45);
+        return result;
+    }
+    /**
+     * \brief Get the next value from the stream as a double in the range [0, 1)
+     */
+    double generateDouble() {
+        // Use the top 53 bits, which is the precision of a double's mantissa
+        return double(generate64() >> 11) * (1.0 / 9007199254740992.0);
+    }
+    /**
+     * \brief Whether we have been asked to use deterministic seeds, and if so, what the base seed is
+     *
+     * This is set by setting the environment variable ZYNTHBOX_DETERMINISTIC_SEED to a number. Anything
+     * which makes random decisions should, when this returns true, seed its streams from the given seed
+     * (combined with something which identifies the thing doing the deciding), rather than randomly.
+     * @param seedValue Set to the base seed, if one was given
+     * @return True if a deterministic seed was given
+     */
+    static bool deterministicSeed(quint64 &seedValue) {
+        static const QByteArray deterministicSeedVariable{qgetenv("ZYNTHBOX_DETERMINISTIC_SEED")};
+        if (deterministicSeedVariable.isEmpty() == false) {
+            bool isNumber{false};
+            seedValue = deterministicSeedVariable.toULongLong(&isNumber);
+            return isNumber;
+        }
+        return false;
+    }
+private:
+    static inline quint64 rotateLeft(const quint64 value, const int amount) {
+        return (value << amount) | (value >> (64 - amount));
+    }
+    quint64 state[4];
+};
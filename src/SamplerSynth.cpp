@@ -1,9 +1,12 @@
 
 #include "SamplerSynth.h"
 
+#include "GraineratorGrainRendering.h"
 #include "Helper.h"
 #include "PatternModel.h"
 #include "PlayGridManager.h"
+#include "ProcessTiming.h"
+#include "RandomStream.h"
 #include "SamplerSynthSound.h"
 #include "SamplerSynthVoice.h"
 #include "ClipCommand.h"
@@ -86,9 +89,9 @@ public:
 };
 
 // granular sampler synth stuff:
-// * note on, start sending out clip commands based on the grain settings and the note and velocity, note off stops sending out notes (don't stop existing notes, just let the voice stop itself)
+// * note on, start spawning grains based on the grain settings and the note and velocity, note off stops spawning grains (don't stop existing grains, just let them finish by themselves)
 // * settings stored on clip
-// * grain envelope (grainADSR)
+// * grain envelope (grainADSR, used as the window for each grain)
 // * grain selection area (existing start/end)
 // * grain interval (minimum, maximum, value is ms)
 // * grain size (minimum, maximum, value is ms)
@@ -97,7 +100,7 @@ public:
 // get clipcommand for note
 // start grain generator
     // pick grain based on clip data
-    // start grain (create command based on clip's size, pan)
+    // start grain (fill in a free grain in the grainerator's grain pool, based on clip's size, pan)
     // pick next grain time (interval + if variation is above 0, pick a time)
 // note off:
 // stop grain generator
@@ -105,12 +108,24 @@ public:
 
 struct GraineratorVoice {
 public:
-    GraineratorVoice(SamplerChannel *channel)
+    GraineratorVoice(SamplerChannel *channel, const int &voiceIndex)
         : channel(channel)
-    {}
+        , random(QRandomGenerator::global()->generate64())
+    {
+        // If we have been asked to be deterministic, each voice gets its own seed, based on which channel and voice it is
+        quint64 seed{0};
+        if (RandomStream::deterministicSeed(seed)) {
+            useDeterministicSeed = true;
+            deterministicSeed = seed ^ (quint64(channel->midiChannel + 2) << 40) ^ (quint64(voiceIndex + 1) << 24);
+        }
+    }
     ~GraineratorVoice() {}
     void start(ClipCommand *clipCommand, quint64 timestamp) {
         command = clipCommand;
+        if (useDeterministicSeed) {
+            // Restart the stream for every note, so the same note played on the same voice always gets the same grains
+            random.seed(deterministicSeed ^ quint64(clipCommand->midiNote + 1));
+        }
         midiNote = clipCommand->midiNote;
         aftertouch = clipCommand->volume;
         envelope.reset();
@@ -132,66 +147,19 @@ public:
         isTailingOff = true;
         envelope.noteOff();
     }
-    ClipCommand *pickNextGrain() {
-        const ClipAudioSource *clip = command->clip;
-        const ClipAudioSourceSliceSettings *slice{command->clip->sliceFromIndex(command->slice)};
-        ClipCommand *newGrain = ClipCommand::channelCommand(command->clip, command->midiChannel);
-        if (newGrain == nullptr) {
-            qWarning() << Q_FUNC_INFO << "Could not get a new grain, for some reason!";
-        }
-        newGrain->midiNote = command->midiNote;
-        newGrain->startPlayback = true;
-        newGrain->changeVolume = true;
-        newGrain->volume = aftertouch * envelopeValue;
-        newGrain->setStartPosition = true;
-        newGrain->setStopPosition = true;
-        newGrain->changePan = true;
-
-        // We have two potential pitch ranges, with a weight that says which one of them to use more regularly
-        // This might for example be used to make the majority of grains play at standard forward speed, and a
-        // few occasional grains playing some variant of backward. To make that happen, you would use the settings
-        // min1 = 1.0, max1 = 1.0, priority = 0.9, min2 = -1.2, max2 = -0.8
-        // which then will result in the forward grains playing at normal pitch, backwards grains playing backward
-        // at between 1.2 and 0.8 speed, and 90% of the generated grains being from the first set.
-        if (slice->grainPitchMinimum1() == 1.0 && slice->grainPitchMaximum1() == 1.0 && slice->grainPitchMinimum2() == 1.0 && slice->grainPitchMaximum2() == 1.0) {
-            // If all the pitch ranges are set to just play at normal pitch, don't do the random generation stuff below
-            newGrain->changePitch = false;
-            newGrain->pitchChange = 1.0f;
-        } else {
-            newGrain->changePitch = true;
-            if (QRandomGenerator::global()->generateDouble() < slice->grainPitchPriority()) {
-                // Lower range, use the first pitch range pair
-                newGrain->pitchChange = slice->grainPitchMinimum1() + QRandomGenerator::global()->bounded(slice->grainPitchMaximum1() - slice->grainPitchMinimum1()) + pitch;
-            } else {
-                // Upper range, use the second pitch range pair
-                newGrain->pitchChange = slice->grainPitchMinimum2() + QRandomGenerator::global()->bounded(slice->grainPitchMaximum2() - slice->grainPitchMinimum2()) + pitch;
-            }
-        }
-
-        // grain duration (grain size start plus random from 0 through grain size additional, at most the size of the sample window)
-        // (divided by 1000, because start and stop are expected to be in seconds, not milliseconds)
-        const double duration = qMin((double(slice->grainSize()) + QRandomGenerator::global()->bounded(double(slice->grainSizeAdditional()))) / (abs(newGrain->pitchChange) * 1000.0f), double(clip->getDuration()));
-        // grain start position
-        if (windowSize < duration) {
-            // If the duration is too long to fit inside the window, just start at the start - allow people to do it, since well, it'll work anyway
-            newGrain->startPosition = position;
-        } else {
-            // Otherwise use the standard logic: from current position, to somewhere within the sample window, minus duration to ensure entire sample playback happens inside window
-            newGrain->startPosition = position + QRandomGenerator::global()->bounded(double(windowSize - duration));
-        }
-        // Make sure we stick inside the window
-        if (newGrain->startPosition > stopPosition) {
-            newGrain->startPosition = startPosition + (newGrain->startPosition - stopPosition);
-        }
-        // grain stop position (start position plus duration - which has already been bounded by the above)
-        newGrain->stopPosition = newGrain->startPosition + duration;
-        // pan variance (random between pan minimum and pan maximum)
-        newGrain->pan = slice->grainPanMinimum() + QRandomGenerator::global()->bounded(slice->grainPanMaximum() - slice->grainPanMinimum());
-        return newGrain;
+    /**
+     * \brief A random value from 0 up to (but not including) the given range
+     */
+    inline double bounded(const double &range) {
+        return random.generateDouble() * range;
     }
     juce::ADSR envelope;
     SamplerChannel *channel{nullptr};
     ClipCommand *command{nullptr};
+    // Each voice has its own random stream, so picking grains doesn't touch any state shared with other threads
+    RandomStream random;
+    bool useDeterministicSeed{false};
+    quint64 deterministicSeed{0};
     float aftertouch{0};
     float pitch{0};
     float envelopeValue{0};
@@ -206,15 +174,38 @@ public:
     bool isTailingOff{false};
 };
 
+/**
+ * \brief A single grain, played back directly from the sound's data by the Grainerator
+ *
+ * This holds only what is needed to play back a short, windowed, stretch of sample data, with
+ * everything which can be worked out ahead of time done when the grain is spawned, so rendering
+ * a grain is little more than an interpolated read and a multiply-add per frame.
+ */
+struct GraineratorGrain : public GraineratorGrainPlayback {
+    SamplerSynthSound *sound{nullptr};
+    SamplerSoundHandle soundHandle;
+    // Used to identify the grain's position in the clip's playback positions model (along with the grain's index)
+    ClipCommand *positionId{nullptr};
+    jack_nframes_t startFrame{0};
+    float gain{0};
+    float pan{0};
+    bool active{false};
+};
+
 #define GRAINERATOR_VOICES 16
+#define GRAINERATOR_GRAINS 256
 class Grainerator {
 public:
     explicit Grainerator(SamplerChannel *channel)
         : channel(channel)
     {
         for (int i = 0; i < GRAINERATOR_VOICES; ++i) {
-            voices[i] = new GraineratorVoice(channel);
+            voices[i] = new GraineratorVoice(channel, i);
         }
+        for (int i = 0; i < GRAINERATOR_GRAINS; ++i) {
+            freeGrains[i] = GRAINERATOR_GRAINS - 1 - i;
+        }
+        freeGrainCount = GRAINERATOR_GRAINS;
     }
     ~Grainerator() {}
     void start(ClipCommand *command, quint64 timestamp) {
@@ -288,7 +279,15 @@ public:
             }
         }
     }
+    /**
+     * \brief Run the grain scheduling for the given stretch of frames, spawning any grains which should start during it
+     * Nothing is rendered here, that happens for the whole process cycle in one go in render()
+     * @param nframes The number of frames to schedule for
+     * @param framesPerMillisecond How many frames there are in a millisecond
+     * @param current_frames The absolute frame the stretch starts at
+     */
     void process(jack_nframes_t nframes, float framesPerMillisecond, jack_nframes_t current_frames) {
+        MEASURE_PROCESS_TIMING("Grainerator", nframes)
         for (jack_nframes_t frame = 0; frame < nframes; ++frame) {
             for (GraineratorVoice *voice : qAsConst(voices)) {
                 ClipCommand *command = voice->command;
@@ -303,14 +302,14 @@ public:
                             voice->envelope.noteOn();
                             voice->envelopeValue = voice->envelope.getNextSample();
                         }
-                        // pick the grain to play and schedule that at position `frame`
-                        channel->handleCommand(voice->pickNextGrain(), current_frames + frame);
+                        // pick the grain to play and start that at position `frame`
+                        spawnGrain(voice, current_frames + frame);
                         // work out how many frames we have until the next grain
                         // (grain interval minimum,
                         // plus random 0 through grain interval additional,
                         // multiplied by framesPerMillisecond)
                         const ClipAudioSourceSliceSettings *slice{command->clip->sliceFromIndex(command->slice)};
-                        const double additionalInterval = slice->grainIntervalAdditional() > 0 ? QRandomGenerator::global()->bounded(double(slice->grainIntervalAdditional())) : 0.0f;
+                        const double additionalInterval = slice->grainIntervalAdditional() > 0 ? voice->bounded(double(slice->grainIntervalAdditional())) : 0.0f;
                         if (slice->grainInterval() == 0) {
                             voice->framesUntilNextGrain = framesPerMillisecond * (double(voice->stopPosition - voice->startPosition) + additionalInterval);
                         } else {
@@ -345,8 +344,29 @@ public:
             }
         }
     }
+    /**
+     * \brief Render all the active grains for the whole process cycle into their sounds' buffers
+     * @param nframes The number of frames in the process cycle
+     * @param current_frames The absolute frame the process cycle starts at
+     */
+    void render(jack_nframes_t nframes, jack_nframes_t current_frames);
 private:
+    /**
+     * \brief Pick a new grain for the given voice, and start it playing at the given frame
+     */
+    void spawnGrain(GraineratorVoice *voice, jack_nframes_t timestamp);
+    inline void releaseGrain(const int &grainIndex) {
+        grains[grainIndex].active = false;
+        grains[grainIndex].sound = nullptr;
+        freeGrains[freeGrainCount] = grainIndex;
+        ++freeGrainCount;
+    }
     GraineratorVoice *voices[GRAINERATOR_VOICES];
+    GraineratorGrain grains[GRAINERATOR_GRAINS];
+    // A stack of the indices of the grains which are not currently playing
+    int freeGrains[GRAINERATOR_GRAINS];
+    int freeGrainCount{0};
+    quint64 droppedGrainCount{0};
     SamplerChannel *channel{nullptr};
 };
 
@@ -490,7 +510,10 @@ void SamplerChannel::midiMessageToClipCommands(ClipCommandRing* listToPopulate,
                                         command->changeLooping = true;
                                         command->looping = slice->looping();
                                         matchedClip = matchedSlice = true;
-                                        listToPopulate->write(command, 0);
+                                        if (listToPopulate->write(command, 0) == false) {
+                                            // Then there were more commands than we have space for, so hand this one back for reuse
+                                            SyncTimer::instance()->deleteClipCommand(command);
+                                        }
                                         // qDebug() << Q_FUNC_INFO << "Wrote command to list for" << clip << "slice" << slice << "subvoice" << subvoice;
                                     }
                                 }
@@ -532,7 +555,7 @@ void SamplerChannel::resortSamples()
 int SamplerChannel::process(jack_nframes_t nframes) {
     // First handle any queued up commands (starting, stopping, changes to voice state, that sort of stuff)
     quint64 timestamp{0};
-    while (commandRing.readHead->processed == false) {
+    while (commandRing.hasUnread()) {
         ClipCommand *command = commandRing.read(&timestamp);
         handleCommand(command, timestamp);
     }
@@ -572,7 +595,7 @@ int SamplerChannel::process(jack_nframes_t nframes) {
                         const int note{event.buffer[1]};
                         const int velocity{event.buffer[2]};
                         midiMessageToClipCommands(&commandRing, byte1, note, velocity);
-                        while (commandRing.readHead->processed == false) {
+                        while (commandRing.hasUnread()) {
                             ClipCommand *command = commandRing.read();
                             const ClipAudioSourceSliceSettings *slice{command->clip->sliceFromIndex(command->slice)};
                             // qDebug() << Q_FUNC_INFO << command->stopPlayback << command->startPlayback << command->clip->getFilePath();
@@ -666,6 +689,8 @@ int SamplerChannel::process(jack_nframes_t nframes) {
             // And now handle the remaining events if the most recent midi event was before the last frame
             grainerator->process((current_frames + nframes) - lastMidiEventFrame, framesPerMicrosecond * 1000.0f, lastMidiEventFrame);
         }
+        // Play back all the grains the grainerator has going for this whole cycle in one go
+        grainerator->render(nframes, current_frames);
 
         // Then, if we've actually got our ports set up, let's play whatever voices are active
         for (SubChannel &subChannel : subChannels) {
@@ -749,15 +774,13 @@ int SamplerSynthPrivate::process(jack_nframes_t nframes)
         * - Update the clip's position models most recent position update
         */
         // First clear all the sounds' internal buffers, where that makes sense
-        for (const SamplerSoundList::Entry &entry : clipSounds.ringData) {
-            if (entry.empty == false) {
-                SamplerSynthSound *sound = entry.samplerSound;
-                if (sound && sound->isValid) {
-                    memset(sound->leftBuffer, 0, nframes * sizeof (jack_default_audio_sample_t));
-                    memset(sound->rightBuffer, 0, nframes * sizeof (jack_default_audio_sample_t));
-                }
+        clipSounds.refreshLiveSounds();
+        clipSounds.forEachLiveSound([nframes](SamplerSynthSound *sound, ClipAudioSource */*clip*/){
+            if (sound->isValid) {
+                memset(sound->leftBuffer, 0, nframes * sizeof (jack_default_audio_sample_t));
+                memset(sound->rightBuffer, 0, nframes * sizeof (jack_default_audio_sample_t));
             }
-        }
+        });
         // Process each of the channels in turn
         jack_default_audio_sample_t *leftBuffers[11][SubChannelCount]{{nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}};
         jack_default_audio_sample_t *rightBuffers[11][SubChannelCount]{{nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}, {nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr}};
@@ -783,20 +806,16 @@ int SamplerSynthPrivate::process(jack_nframes_t nframes)
         }
         // Finalise processing on each individual sound
         // static int throttler{0}; ++throttler; if (throttler > 200) { throttler = 0; };
-        for (const SamplerSoundList::Entry &entry : clipSounds.ringData) {
-            if (entry.empty == false) {
-                SamplerSynthSound *sound = entry.samplerSound;
-                ClipAudioSource *clip = entry.audioSource;
-                const int channelIndex{clip->sketchpadTrack() + 1};
-                const int channelAffinity{((clip->registerForPolyphonicPlayback() ? clip->sketchpadSlotRow() : ZynthboxSampleSlotRowCount) * ZynthboxSlotCount) + clip->sketchpadSlot()};
-                // if (throttler == 0) { qDebug() << Q_FUNC_INFO << "Working on clip" << clip << "with channel" << channelIndex << "and sub-channel affinity" << channelAffinity << "and one of our buffers is" << leftBuffers[channelIndex][channelAffinity]; }
-                if (leftBuffers[channelIndex][channelAffinity] && rightBuffers[channelIndex][channelAffinity]) {
-                    jack_default_audio_sample_t *laneOutputBuffers[2]{leftBuffers[channelIndex][channelAffinity], rightBuffers[channelIndex][channelAffinity]};
-                    jack_default_audio_sample_t *soundBuffers[2]{sound->leftBuffer, sound->rightBuffer};
-                    clip->finaliseProcess(soundBuffers, laneOutputBuffers, nframes);
-                }
+        clipSounds.forEachLiveSound([nframes, &leftBuffers, &rightBuffers](SamplerSynthSound *sound, ClipAudioSource *clip){
+            const int channelIndex{clip->sketchpadTrack() + 1};
+            const int channelAffinity{((clip->registerForPolyphonicPlayback() ? clip->sketchpadSlotRow() : ZynthboxSampleSlotRowCount) * ZynthboxSlotCount) + clip->sketchpadSlot()};
+            // if (throttler == 0) { qDebug() << Q_FUNC_INFO << "Working on clip" << clip << "with channel" << channelIndex << "and sub-channel affinity" << channelAffinity << "and one of our buffers is" << leftBuffers[channelIndex][channelAffinity]; }
+            if (leftBuffers[channelIndex][channelAffinity] && rightBuffers[channelIndex][channelAffinity]) {
+                jack_default_audio_sample_t *laneOutputBuffers[2]{leftBuffers[channelIndex][channelAffinity], rightBuffers[channelIndex][channelAffinity]};
+                jack_default_audio_sample_t *soundBuffers[2]{sound->leftBuffer, sound->rightBuffer};
+                clip->finaliseProcess(soundBuffers, laneOutputBuffers, nframes);
             }
-        }
+        });
         // Update the clips' position model information
         jack_nframes_t current_frames;
         jack_time_t current_usecs;
@@ -811,6 +830,137 @@ int SamplerSynthPrivate::process(jack_nframes_t nframes)
     return 0;
 }
 
+void Grainerator::spawnGrain(GraineratorVoice *voice, jack_nframes_t timestamp)
+{
+    if (freeGrainCount == 0) {
+        ++droppedGrainCount;
+        // Only complain on the first, and then every thousandth, dropped grain, so we don't end up flooding the output
+        if (droppedGrainCount % 1000 == 1) {
+            qWarning() << Q_FUNC_INFO << "Failed to find a free grain - Grainerator has" << GRAINERATOR_GRAINS << "grains available, and the new grain has been dropped (this has happened" << droppedGrainCount << "times)";
+        }
+        return;
+    }
+    const ClipCommand *command{voice->command};
+    ClipAudioSource *clip{command->clip};
+    SamplerSoundHandle soundHandle;
+    SamplerSynthSound *sound{channel->d->clipSounds.find(clip, &soundHandle)};
+    if (sound == nullptr || sound->isValid == false || sound->audioData() == nullptr) {
+        return;
+    }
+    const ClipAudioSourceSliceSettings *slice{clip->sliceFromIndex(command->slice)};
+    const ClipAudioSourceSliceSettings *rootSlice{clip->rootSliceActual()};
+
+    // We have two potential pitch ranges, with a weight that says which one of them to use more regularly
+    // This might for example be used to make the majority of grains play at standard forward speed, and a
+    // few occasional grains playing some variant of backward. To make that happen, you would use the settings
+    // min1 = 1.0, max1 = 1.0, priority = 0.9, min2 = -1.2, max2 = -0.8
+    // which then will result in the forward grains playing at normal pitch, backwards grains playing backward
+    // at between 1.2 and 0.8 speed, and 90% of the generated grains being from the first set.
+    float pitchChange{1.0f};
+    if (slice->grainPitchMinimum1() == 1.0 && slice->grainPitchMaximum1() == 1.0 && slice->grainPitchMinimum2() == 1.0 && slice->grainPitchMaximum2() == 1.0) {
+        // If all the pitch ranges are set to just play at normal pitch, don't do the random generation stuff below
+    } else if (voice->random.generateDouble() < slice->grainPitchPriority()) {
+        // Lower range, use the first pitch range pair
+        pitchChange = slice->grainPitchMinimum1() + voice->bounded(slice->grainPitchMaximum1() - slice->grainPitchMinimum1()) + voice->pitch;
+    } else {
+        // Upper range, use the second pitch range pair
+        pitchChange = slice->grainPitchMinimum2() + voice->bounded(slice->grainPitchMaximum2() - slice->grainPitchMinimum2()) + voice->pitch;
+    }
+    if (pitchChange == 0) {
+        // A grain which doesn't move through the sample makes no sound, so don't bother
+        return;
+    }
+
+    // grain duration (grain size start plus random from 0 through grain size additional, at most the size of the sample window)
+    // (divided by 1000, because start and stop are expected to be in seconds, not milliseconds)
+    const double duration = qMin((double(slice->grainSize()) + voice->bounded(double(slice->grainSizeAdditional()))) / (abs(pitchChange) * 1000.0f), double(clip->getDuration()));
+    // grain start position
+    double startPosition{voice->position};
+    if (voice->windowSize >= duration) {
+        // Use the standard logic: from current position, to somewhere within the sample window, minus duration to ensure entire sample playback happens inside window
+        // (if the duration is too long to fit inside the window, just start at the start - allow people to do it, since well, it'll work anyway)
+        startPosition += voice->bounded(double(voice->windowSize - duration));
+    }
+    // Make sure we stick inside the window
+    if (startPosition > voice->stopPosition) {
+        startPosition = voice->startPosition + (startPosition - voice->stopPosition);
+    }
+    // grain stop position (start position plus duration - which has already been bounded by the above)
+    const double stopPosition{startPosition + duration};
+    // pan variance (random between pan minimum and pan maximum)
+    const float pan{std::clamp(float(slice->pan()) + float(slice->grainPanMinimum() + voice->bounded(slice->grainPanMaximum() - slice->grainPanMinimum())), -1.0f, 1.0f)};
+
+    const int grainIndex{freeGrains[freeGrainCount - 1]};
+    --freeGrainCount;
+    GraineratorGrain &grain = grains[grainIndex];
+    grain.sound = sound;
+    grain.soundHandle = soundHandle;
+    grain.positionId = voice->command;
+    grain.inL = sound->audioData()->getReadPointer(0);
+    grain.inR = sound->audioData()->getNumChannels() > 1 ? sound->audioData()->getReadPointer(1) : grain.inL;
+    grain.sampleDuration = sound->length();
+
+    // This matches what SamplerSynthVoice does for the playback speed, and if we're using timestretching for our clip's
+    // pitch shifting, then we should not also be applying the clip's pitch shifting or the speed ratio here
+    const bool timeStretchOff{rootSlice->timeStretchStyle() == ClipAudioSource::TimeStretchOff};
+    const double clipPitchChange{timeStretchOff ? pitchChange * rootSlice->pitchChangePrecalc() : pitchChange};
+    grain.increment = std::pow(2.0, (voice->midiNote - slice->effectiveRootNote()) / 12.0) * clipPitchChange * (timeStretchOff ? clip->speedRatio() : 1.0f) * sound->sampleRateRatio();
+    const double sourceStartPosition{startPosition * sound->sourceSampleRate() / sound->stretchRate()};
+    const double sourceStopPosition{stopPosition * sound->sourceSampleRate() / sound->stretchRate()};
+    // Backward grains play from the stop position, towards the start position
+    grain.sourcePosition = grain.increment < 0 ? sourceStopPosition : sourceStartPosition;
+    grain.totalFrames = jack_nframes_t(std::max(0.0, (sourceStopPosition - sourceStartPosition) / std::abs(grain.increment)));
+
+    grain.window.reset();
+    grain.window.setSampleRate(channel->sampleRate());
+    grain.window.setParameters(slice->grainADSR().getParameters());
+    grain.window.noteOn();
+    const jack_nframes_t releaseFrames{jack_nframes_t(slice->grainADSR().getParameters().release * channel->sampleRate())};
+    grain.releaseFrame = grain.totalFrames > releaseFrames ? grain.totalFrames - releaseFrames : 0;
+    grain.startFrame = timestamp;
+    grain.framesRendered = 0;
+
+    // For the root slice, don't apply the gain twice, that's just silly, and for everything else, apply both the root slice gain, and the current slice
+    const float gain{voice->aftertouch * voice->envelopeValue * (slice == rootSlice ? 1 : rootSlice->gainHandlerActual()->operationalGain()) * slice->gainHandlerActual()->operationalGain()};
+    const float lPan = 0.5f * (1.0f + qMax(-1.0f, pan));
+    const float rPan = 0.5f * (1.0f - qMax(0.0f, pan));
+    grain.gain = gain;
+    grain.pan = pan;
+    grain.leftFromLeft = gain * 0.5f * (lPan + 1.0f);
+    grain.leftFromRight = gain * 0.5f * (lPan - 1.0f);
+    grain.rightFromLeft = gain * 0.5f * (rPan - 1.0f);
+    grain.rightFromRight = gain * 0.5f * (rPan + 1.0f);
+    grain.active = true;
+}
+
+void Grainerator::render(jack_nframes_t nframes, jack_nframes_t current_frames)
+{
+    MEASURE_PROCESS_TIMING("Grainerator grains", nframes)
+    for (int grainIndex = 0; grainIndex < GRAINERATOR_GRAINS; ++grainIndex) {
+        GraineratorGrain &grain = grains[grainIndex];
+        if (grain.active == false) {
+            continue;
+        }
+        if (channel->d->clipSounds.isValid(grain.soundHandle) == false || grain.sound->isValid == false) {
+            // The sound has gone away underneath us, so there's nothing left to play
+            releaseGrain(grainIndex);
+            continue;
+        }
+        jack_nframes_t frame{grain.startFrame > current_frames ? grain.startFrame - current_frames : 0};
+        if (frame >= nframes) {
+            continue;
+        }
+        float windowValue{0};
+        const bool finished{grain.render(grain.sound->leftBuffer, grain.sound->rightBuffer, frame, nframes, windowValue)};
+        if (ClipAudioSourcePositionsModel *positionsModel = grain.sound->clip()->playbackPositionsModel()) {
+            positionsModel->setPositionData(current_frames + nframes, grain.positionId, grainIndex, windowValue * grain.gain, windowValue * grain.gain, grain.sourcePosition / grain.sampleDuration, grain.pan);
+        }
+        if (finished) {
+            releaseGrain(grainIndex);
+        }
+    }
+}
+
 static int sampler_process(jack_nframes_t nframes, void* arg) {
     return static_cast<SamplerSynthPrivate*>(arg)->process(nframes);
 }
@@ -1007,8 +1157,7 @@ int SamplerSynth::activeVoices() const
 void SamplerSynth::registerClip(ClipAudioSource *clip)
 {
     QMutexLocker locker(&d->synthMutex);
-    SamplerSynthSound *sound{nullptr};
-    d->clipSounds.find(clip, &sound);
+    SamplerSynthSound *sound{d->clipSounds.find(clip)};
     if (!sound) {
         sound = new SamplerSynthSound(clip);
         sound->leftPort = jack_port_register(d->jackClient, QString("Clip%1-SidechannelLeft").arg(clip->id()).toUtf8(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
@@ -1058,8 +1207,7 @@ void SamplerSynth::registerClip(ClipAudioSource *clip)
 void SamplerSynth::unregisterClip(ClipAudioSource *clip)
 {
     QMutexLocker locker(&d->synthMutex);
-    SamplerSynthSound *sound{nullptr};
-    d->clipSounds.find(clip, &sound);
+    SamplerSynthSound *sound{d->clipSounds.find(clip)};
     if (sound) {
         clip->setSidechainPorts(nullptr, nullptr);
         if (sound->leftPort) {
@@ -1091,11 +1239,14 @@ void SamplerSynth::unregisterClip(ClipAudioSource *clip)
     }
 }
 
-SamplerSynthSound * SamplerSynth::clipToSound(ClipAudioSource* clip) const
+SamplerSynthSound * SamplerSynth::clipToSound(ClipAudioSource* clip, SamplerSoundHandle *handle) const
 {
-    SamplerSynthSound *sound{nullptr};
-    d->clipSounds.find(clip, &sound);
-    return sound;
+    return d->clipSounds.find(clip, handle);
+}
+
+bool SamplerSynth::isSoundRegistered(const SamplerSoundHandle& handle) const
+{
+    return d->clipSounds.isValid(handle);
 }
 
 void SamplerSynth::setSamplePickingStyle(const int& channel, const ClipAudioSource::SamplePickingStyle& samplePickingStyle) const
@@ -1105,22 +1256,23 @@ void SamplerSynth::setSamplePickingStyle(const int& channel, const ClipAudioSour
     }
 }
 
-void SamplerSynth::handleClipCommand(ClipCommand *clipCommand, quint64 currentTick)
+bool SamplerSynth::handleClipCommand(ClipCommand *clipCommand, quint64 currentTick)
 {
-    SamplerSynthSound *sound{nullptr};
-    d->clipSounds.find(clipCommand->clip, &sound);
+    bool queued{true};
+    SamplerSynthSound *sound{d->clipSounds.find(clipCommand->clip)};
     if (sound && clipCommand->midiChannel + 1 < d->channels.count()) {
         SamplerChannel *channel = d->channels[clipCommand->midiChannel + 1];
-        if (channel->commandRing.writeHead->processed) {
-            // qDebug() << Q_FUNC_INFO << "Wrote clip command" << clipCommand << "at tick" << currentTick << "on channel" << channel << "for clip" << clipCommand->clip << "for track/polyphonic/slot/row" << clipCommand->clip->sketchpadTrack() << clipCommand->clip->registerForPolyphonicPlayback() << clipCommand->clip->sketchpadSlot() << clipCommand->clip->sketchpadSlotRow();
-            channel->commandRing.write(clipCommand, currentTick);
-        } else {
-            qWarning() << Q_FUNC_INFO << "Big problem! Attempted to add a clip command to the queue, but we've not handled the one that's already in the queue.";
+        // qDebug() << Q_FUNC_INFO << "Wrote clip command" << clipCommand << "at tick" << currentTick << "on channel" << channel << "for clip" << clipCommand->clip << "for track/polyphonic/slot/row" << clipCommand->clip->sketchpadTrack() << clipCommand->clip->registerForPolyphonicPlayback() << clipCommand->clip->sketchpadSlot() << clipCommand->clip->sketchpadSlotRow();
+        if (channel->commandRing.write(clipCommand, currentTick) == false) {
+            // Big problem! We've not handled the commands which are already in the queue. The ring counts this for
+            // reporting (this is called from the process callback), and the caller hands the command back for reuse
+            queued = false;
         }
     // } else {
         // Since debugging things out will attempt to read data out of the object, and the thing might've disappeared, so... let's probably avoid that
         // qWarning() << Q_FUNC_INFO << "Unknown clip" << clipCommand->clip << "or unacceptable midi channel" << clipCommand->midiChannel;
     }
+    return queued;
 }
 
 void SamplerSynth::setChannelEnabled(const int &channel, const bool &enabled) const
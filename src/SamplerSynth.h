@@ -9,6 +9,7 @@
 struct ClipCommand;
 class SamplerSynthPrivate;
 class SamplerSynthSound;
+struct SamplerSoundHandle;
 class SyncTimerPrivate;
 namespace tracktion_engine {
     class Engine;
@@ -51,7 +52,20 @@ public:
 
     void registerClip(ClipAudioSource *clip);
     void unregisterClip(ClipAudioSource *clip);
-    SamplerSynthSound *clipToSound(ClipAudioSource *clip) const;
+    /**
+     * \brief Get the sound registered for the given clip
+     * @param clip The clip to get the sound for
+     * @param handle If given, this will be set to a handle which can be used to cheaply check whether the sound is still registered
+     * @return The sound for the given clip, or nullptr if the clip is not registered
+     * @see isSoundRegistered(const SamplerSoundHandle&)
+     */
+    SamplerSynthSound *clipToSound(ClipAudioSource *clip, SamplerSoundHandle *handle = nullptr) const;
+    /**
+     * \brief Whether the sound the given handle was retrieved for is still registered
+     * @param handle A handle as retrieved by clipToSound
+     * @return True if the sound is still registered, otherwise false
+     */
+    bool isSoundRegistered(const SamplerSoundHandle &handle) const;
 
     /**
      * \brief Set a given sampelrsynth channel's sample picking style
@@ -61,7 +75,8 @@ public:
     void setSamplePickingStyle(const int &channel, const ClipAudioSource::SamplePickingStyle &samplePickingStyle) const;
 protected:
     // Some stuff to ensure SyncTimer can operate with sufficient speed
-    void handleClipCommand(ClipCommand* clipCommand, quint64 currentTick);
+    // Returns false if the command could not be queued (in which case the caller still owns it)
+    bool handleClipCommand(ClipCommand* clipCommand, quint64 currentTick);
 
     /**
      * \brief Set a given samplersynth channel as enabled (or not) for processing
@@ -2,23 +2,383 @@
 #include "SamplerSynthSound.h"
 #include "AudioLevels.h"
 #include "ClipAudioSourceSliceSettings.h"
+#include "LockFreeRing.h"
 #include "SamplerSynth.h"
 #include "JUCEHeaders.h"
 
 #include <QCoreApplication>
 #include <QDebug>
+#include <QDir>
 #include <QFileInfo>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QRunnable>
+#include <QStandardPaths>
 #include <QString>
 #include <QTimer>
+#include <QThread>
 #include <QThreadPool>
 
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 namespace tracktion_engine {
 #include <tracktion_engine/3rd_party/soundtouch/include/SoundTouch.h>
 };
 
+// The amount of audio at the start of a sample which is kept locked in memory, so voices starting playback never have to wait for the disk
+#define SampleStorageLockedHeadSeconds 2
+// The amount of audio which is read ahead of a voice's playback position at a time (see SamplerSynthSound::prefetch())
+#define SampleStoragePrefetchSeconds 2
+// The default for the most memory locked for sample heads across all samples (can be set using the ZYNTHBOX_SAMPLE_LOCK_BUDGET_MB environment variable)
+#define SampleStorageDefaultLockBudgetMegabytes 256
+#define SampleStoragePrefetchRingSize 256
+
+class SamplerSynthSoundData;
+/**
+ * \brief Keeps track of all the mapped sample storage, and the parts of it which are locked in memory
+ *
+ * Locking the head of every sample would, with a large enough sample library, end up locking most of the memory,
+ * so the total amount locked is kept within a budget. When a new head would take the total past that budget, the
+ * heads of the samples which were least recently played are unlocked to make space (and they are locked again the
+ * next time they are played, see prefetch()).
+ *
+ * The manager also runs a thread which does the prefetching (as both madvise and mlock are system calls which may
+ * have to wait for the disk, which must never happen on the process thread).
+ */
+class SampleStorageManager : public QThread {
+public:
+    /**
+     * \brief The manager, which is created the first time any sample storage is allocated
+     * This is safe to call from any thread, and will return nullptr if there is no sample storage yet
+     */
+    static SampleStorageManager *existingInstance() {
+        return s_instance.load(std::memory_order_acquire);
+    }
+    /**
+     * \brief The manager, creating it if it does not already exist (so do not call this from the process thread)
+     */
+    static SampleStorageManager *instance() {
+        static SampleStorageManager *manager{[](){
+            SampleStorageManager *newManager = new SampleStorageManager;
+            newManager->start();
+            s_instance.store(newManager, std::memory_order_release);
+            return newManager;
+        }()};
+        return manager;
+    }
+
+    void registerBuffer(SamplerSynthSoundData *buffer);
+    void unregisterBuffer(SamplerSynthSoundData *buffer);
+    void lockHead(SamplerSynthSoundData *buffer);
+    /**
+     * \brief Ask for the given part of the buffer to be read ahead of time, and its head to be locked if it has been unlocked
+     * This is safe to call from the process thread
+     * @param buffer The buffer to prefetch data for
+     * @param startSample The first sample to read ahead
+     * @param sampleCount The number of samples to read ahead
+     */
+    void prefetch(SamplerSynthSoundData *buffer, const int &startSample, const int &sampleCount);
+    /**
+     * \brief A value which is larger every time it is fetched (used to find the least recently played sample)
+     * This is safe to call from the process thread
+     */
+    quint64 nextUse() {
+        return m_useCounter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+protected:
+    void run() override;
+private:
+    SampleStorageManager();
+    ~SampleStorageManager() override {}
+    void unlockHead(SamplerSynthSoundData *buffer);
+    void wakeUp() {
+        if (m_wakeupPending.exchange(true, std::memory_order_acq_rel) == false && m_wakeupDescriptor > -1) {
+            const uint64_t increment{1};
+            if (write(m_wakeupDescriptor, &increment, sizeof(increment)) < 0) {
+                // This only fails if the counter would overflow, in which case the thread is already going to wake up
+            }
+        }
+    }
+    static std::atomic<SampleStorageManager*> s_instance;
+    struct PrefetchRequest {
+        SamplerSynthSoundData *buffer{nullptr};
+        int startSample{0};
+        int sampleCount{0};
+    };
+    LockFreeRing<PrefetchRequest, SampleStoragePrefetchRingSize, LockFreeRingWriters::MultipleWriters> m_prefetchRequests{"SamplerSynthSound prefetch requests"};
+    int m_wakeupDescriptor{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)};
+    std::atomic<bool> m_wakeupPending{false};
+    std::atomic<quint64> m_useCounter{0};
+    // Everything below is only touched while holding the mutex
+    QMutex m_mutex;
+    QList<SamplerSynthSoundData*> m_buffers;
+    size_t m_lockedBytes{0};
+    size_t m_lockBudget{0};
+};
+std::atomic<SampleStorageManager*> SampleStorageManager::s_instance{nullptr};
+
+/**
+ * \brief An audio buffer whose sample data lives in a memory mapped cache file
+ *
+ * Anonymous memory has nowhere to go on a system without swap, so a large sample library would end up pushing
+ * everything else out of memory. Keeping the decoded samples in a file mapping instead lets the kernel drop
+ * pages nobody is using when memory gets tight, and page them back in (with its usual readahead) when they are
+ * needed again. The head of the sample can be locked in memory using lockHead(), so that starting playback
+ * never has to wait for the disk.
+ *
+ * The cache files are unnamed, so they disappear as soon as the buffer is destroyed (or the process ends).
+ * Their location can be set using the ZYNTHBOX_SAMPLE_STORAGE_PATH environment variable. The default is deliberately on
+ * a real filesystem rather than a tmpfs: pages in a tmpfs can only be dropped by swapping them out, so without swap they
+ * would be exactly as unreclaimable as anonymous memory. The cost is that each decoded sample (and time stretched copy)
+ * is written out to the disk once, some time after it is loaded, and is only read back if it was dropped from memory.
+ * If the mapping fails for whatever reason, the buffer falls back to keeping its data in memory.
+ */
+class SamplerSynthSoundData : public juce::AudioBuffer<float> {
+public:
+    SamplerSynthSoundData() {}
+    SamplerSynthSoundData(int numChannels, int numSamples) {
+        allocate(numChannels, numSamples);
+    }
+    ~SamplerSynthSoundData() {
+        unmap();
+    }
+    /**
+     * \brief Set up (cleared) storage for the given number of channels and samples, dropping any existing data
+     */
+    void allocate(int numChannels, int numSamples) {
+        unmap();
+        const size_t bytes{sizeof(float) * size_t(numChannels) * size_t(numSamples)};
+        if (bytes > 0) {
+            static const QString storagePath{qEnvironmentVariable("ZYNTHBOX_SAMPLE_STORAGE_PATH", QString("%1/sample-storage").arg(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)))};
+            QDir().mkpath(storagePath);
+            m_fileDescriptor = open(storagePath.toUtf8().constData(), O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+            if (m_fileDescriptor > -1 && ftruncate(m_fileDescriptor, off_t(bytes)) == 0) {
+                void *mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fileDescriptor, 0);
+                if (mapped != MAP_FAILED) {
+                    m_mapped = static_cast<float*>(mapped);
+                    m_mappedBytes = bytes;
+                }
+            }
+            if (m_mapped) {
+                std::vector<float*> channels(size_t(numChannels), nullptr);
+                for (int channel = 0; channel < numChannels; ++channel) {
+                    channels[size_t(channel)] = m_mapped + (size_t(channel) * size_t(numSamples));
+                }
+                setDataToReferTo(channels.data(), numChannels, numSamples);
+                SampleStorageManager::instance()->registerBuffer(this);
+                return;
+            }
+            qWarning() << Q_FUNC_INFO << "Failed to set up mapped sample storage in" << storagePath << "-" << strerror(errno) << "- keeping the sample data in memory instead";
+            if (m_fileDescriptor > -1) {
+                close(m_fileDescriptor);
+                m_fileDescriptor = -1;
+            }
+        }
+        setSize(numChannels, numSamples);
+    }
+    /**
+     * \brief Lock the given number of samples at the start of each channel in memory
+     * The head may be unlocked again later, to make space for the heads of other samples (see SampleStorageManager)
+     * @param numSamples The number of samples to lock (clamped to the length of the buffer)
+     */
+    void lockHead(int numSamples) {
+        if (m_mapped) {
+            m_headSamples = qMin(numSamples, getNumSamples());
+            SampleStorageManager::instance()->lockHead(this);
+        }
+    }
+    /**
+     * \brief Ask for the given part of the sample data to be read from the disk ahead of playback
+     * This is safe to call from the process thread (the work is done on the sample storage manager's thread)
+     * @param startSample The first sample which will be played
+     * @param sampleCount The number of samples to read ahead
+     */
+    void prefetch(const int &startSample, const int &sampleCount) {
+        if (m_mapped) {
+            SampleStorageManager *manager{SampleStorageManager::existingInstance()};
+            if (manager) {
+                m_lastUse.store(manager->nextUse(), std::memory_order_relaxed);
+                manager->prefetch(this, startSample, sampleCount);
+            }
+        }
+    }
+private:
+    friend class SampleStorageManager;
+    void unmap() {
+        if (m_mapped) {
+            // Stop the manager from doing anything else with us before the storage goes away
+            SampleStorageManager::instance()->unregisterBuffer(this);
+            // Make sure we're not left referring to the storage we're about to get rid of
+            setSize(0, 0);
+            munmap(m_mapped, m_mappedBytes);
+            m_mapped = nullptr;
+            m_mappedBytes = 0;
+        }
+        if (m_fileDescriptor > -1) {
+            close(m_fileDescriptor);
+            m_fileDescriptor = -1;
+        }
+    }
+    size_t headBytes() const {
+        return sizeof(float) * size_t(m_headSamples) * size_t(getNumChannels());
+    }
+    int m_fileDescriptor{-1};
+    float *m_mapped{nullptr};
+    size_t m_mappedBytes{0};
+    // The remaining members are only touched by the manager, while holding its mutex (except for m_lastUse)
+    int m_headSamples{0};
+    bool m_headLocked{false};
+    std::atomic<quint64> m_lastUse{0};
+};
+
+SampleStorageManager::SampleStorageManager()
+    : QThread()
+{
+    setObjectName("SampleStorageManager");
+    bool budgetIsValid{false};
+    const quint64 budgetMegabytes{qEnvironmentVariable("ZYNTHBOX_SAMPLE_LOCK_BUDGET_MB").toULongLong(&budgetIsValid)};
+    m_lockBudget = size_t(budgetIsValid ? budgetMegabytes : SampleStorageDefaultLockBudgetMegabytes) * 1024 * 1024;
+}
+
+void SampleStorageManager::registerBuffer(SamplerSynthSoundData *buffer)
+{
+    QMutexLocker locker(&m_mutex);
+    buffer->m_lastUse.store(nextUse(), std::memory_order_relaxed);
+    m_buffers << buffer;
+}
+
+void SampleStorageManager::unregisterBuffer(SamplerSynthSoundData *buffer)
+{
+    QMutexLocker locker(&m_mutex);
+    if (buffer->m_headLocked) {
+        // Unmapping unlocks the pages anyway, so we only need to make a note that the memory is available again
+        buffer->m_headLocked = false;
+        m_lockedBytes -= buffer->headBytes();
+    }
+    m_buffers.removeOne(buffer);
+}
+
+void SampleStorageManager::lockHead(SamplerSynthSoundData *buffer)
+{
+    QMutexLocker locker(&m_mutex);
+    const size_t bytes{buffer->headBytes()};
+    if (buffer->m_headLocked || bytes == 0 || m_buffers.contains(buffer) == false) {
+        return;
+    }
+    if (bytes > m_lockBudget) {
+        qDebug() << Q_FUNC_INFO << "Not locking the head of the sample data in memory, as it is larger than the whole budget of" << m_lockBudget << "bytes";
+        return;
+    }
+    // Make space by unlocking the heads of whichever samples were played the longest time ago
+    while (m_lockedBytes + bytes > m_lockBudget) {
+        SamplerSynthSoundData *leastRecentlyUsed{nullptr};
+        for (SamplerSynthSoundData *other : qAsConst(m_buffers)) {
+            if (other != buffer && other->m_headLocked && (leastRecentlyUsed == nullptr || other->m_lastUse.load(std::memory_order_relaxed) < leastRecentlyUsed->m_lastUse.load(std::memory_order_relaxed))) {
+                leastRecentlyUsed = other;
+            }
+        }
+        if (leastRecentlyUsed == nullptr) {
+            break;
+        }
+        unlockHead(leastRecentlyUsed);
+    }
+    const size_t channelBytes{sizeof(float) * size_t(buffer->m_headSamples)};
+    int lockedChannels{0};
+    for (; lockedChannels < buffer->getNumChannels(); ++lockedChannels) {
+        if (mlock(buffer->getReadPointer(lockedChannels), channelBytes) != 0) {
+            qDebug() << Q_FUNC_INFO << "Failed to lock the head of the sample data in memory" << strerror(errno);
+            break;
+        }
+    }
+    if (lockedChannels == buffer->getNumChannels()) {
+        buffer->m_headLocked = true;
+        m_lockedBytes += bytes;
+    } else {
+        for (int channel = 0; channel < lockedChannels; ++channel) {
+            munlock(buffer->getReadPointer(channel), channelBytes);
+        }
+    }
+}
+
+void SampleStorageManager::unlockHead(SamplerSynthSoundData *buffer)
+{
+    const size_t channelBytes{sizeof(float) * size_t(buffer->m_headSamples)};
+    for (int channel = 0; channel < buffer->getNumChannels(); ++channel) {
+        munlock(buffer->getReadPointer(channel), channelBytes);
+    }
+    buffer->m_headLocked = false;
+    m_lockedBytes -= buffer->headBytes();
+}
+
+void SampleStorageManager::prefetch(SamplerSynthSoundData *buffer, const int &startSample, const int &sampleCount)
+{
+    if (m_prefetchRequests.write([buffer, &startSample, &sampleCount](PrefetchRequest &request){
+        request.buffer = buffer;
+        request.startSample = startSample;
+        request.sampleCount = sampleCount;
+    })) {
+        wakeUp();
+    }
+}
+
+void SampleStorageManager::run()
+{
+    static const uintptr_t pageSize{uintptr_t(sysconf(_SC_PAGESIZE))};
+    pollfd wakeupPoll{m_wakeupDescriptor, POLLIN, 0};
+    PrefetchRequest request;
+    while (true) {
+        uint64_t wakeupCount{0};
+        if (m_wakeupDescriptor > -1 && read(m_wakeupDescriptor, &wakeupCount, sizeof(wakeupCount)) < 0) {
+            // Nothing to reset, which just means we woke up on the timeout
+        }
+        // Clear the pending flag only once the eventfd has been drained, so a wakeup from after this point is not lost
+        m_wakeupPending.store(false, std::memory_order_release);
+        while (m_prefetchRequests.read(request)) {
+            QMutexLocker locker(&m_mutex);
+            // The buffer may have gone away since the request was made, in which case there is nothing to do
+            SamplerSynthSoundData *buffer{request.buffer};
+            if (m_buffers.contains(buffer) == false) {
+                continue;
+            }
+            if (buffer->m_headLocked == false && buffer->m_headSamples > 0) {
+                locker.unlock();
+                lockHead(buffer);
+                locker.relock();
+                if (m_buffers.contains(buffer) == false) {
+                    continue;
+                }
+            }
+            const int startSample{qBound(0, request.startSample, buffer->getNumSamples())};
+            const int sampleCount{qMin(request.sampleCount, buffer->getNumSamples() - startSample)};
+            if (sampleCount > 0) {
+                for (int channel = 0; channel < buffer->getNumChannels(); ++channel) {
+                    // madvise wants a page aligned start address
+                    const uintptr_t start{uintptr_t(buffer->getReadPointer(channel, startSample))};
+                    const uintptr_t alignedStart{start & ~(pageSize - 1)};
+                    madvise(reinterpret_cast<void*>(alignedStart), size_t(start - alignedStart) + sizeof(float) * size_t(sampleCount), MADV_WILLNEED);
+                }
+            }
+        }
+        if (m_wakeupPending.load(std::memory_order_acquire) == false && m_prefetchRequests.hasUnread()) {
+            // Something arrived between draining the ring and now, without managing to wake us up, so go round again
+            continue;
+        }
+        if (m_wakeupDescriptor > -1) {
+            poll(&wakeupPoll, 1, 1000);
+        } else {
+            // If we couldn't get an eventfd for whatever reason, fall back to checking in regularly
+            msleep(5);
+        }
+    }
+}
+
 class SamplerSynthSoundTimestretcher : public QObject, public QRunnable {
     Q_OBJECT
 public:
@@ -28,7 +388,7 @@ public:
     void run() override;
     Q_SLOT void abort();
     Q_SIGNAL void done();
-    juce::AudioBuffer<float> data;
+    SamplerSynthSoundData data;
     int sampleLength{0};
     double stretchRate{1.0f};
 private:
@@ -47,7 +407,7 @@ public:
     Q_SIGNAL void done();
     bool isAborted();
 
-    juce::AudioBuffer<float> *buffer{nullptr};
+    SamplerSynthSoundData *buffer{nullptr};
     juce::FileInputSource *thumbnailSource{nullptr};
     SamplerSynthSoundPrivate *soundPrivate{nullptr};
 
@@ -79,7 +439,7 @@ public:
 
     SamplerSynthSound *q{nullptr};
     QTimer soundLoader;
-    std::unique_ptr<juce::AudioBuffer<float>> data;
+    std::unique_ptr<SamplerSynthSoundData> data;
     int length{0};
     double sourceSampleRate{0.0f};
     double sampleRateRatio{0.0f};
@@ -193,6 +553,22 @@ juce::AudioBuffer<float> *SamplerSynthSound::audioData() const noexcept
     return d->data.get();
 }
 
+void SamplerSynthSound::prefetch(const double &position, const bool &backward) const
+{
+    if (isValid) {
+        SamplerSynthSoundData *data{d->playbackTimeStretcher && d->clip->rootSliceActual()->timeStretchStyle() != ClipAudioSource::TimeStretchOff ? &d->playbackTimeStretcher->data : d->data.get()};
+        if (data) {
+            const int sampleCount{prefetchLength()};
+            data->prefetch(backward ? qMax(0, int(position) - sampleCount) : int(position), sampleCount);
+        }
+    }
+}
+
+int SamplerSynthSound::prefetchLength() const
+{
+    return int(d->sourceSampleRate * SampleStoragePrefetchSeconds);
+}
+
 const int & SamplerSynthSound::length() const
 {
     if (d->playbackTimeStretcher && d->clip->rootSliceActual()->timeStretchStyle() != ClipAudioSource::TimeStretchOff) {
@@ -255,7 +631,7 @@ void SamplerSynthSoundAudioLoader::run()
                 if (soundPrivate->sourceSampleRate > 0 && format->lengthInSamples > 0) {
                     soundPrivate->sampleRateRatio = soundPrivate->sourceSampleRate / SamplerSynth::instance()->sampleRate();
                     soundPrivate->length = (int) format->lengthInSamples;
-                    juce::AudioBuffer<float> *newBuffer = new juce::AudioBuffer<float>(jmin(2, int(format->numChannels)), soundPrivate->length);
+                    SamplerSynthSoundData *newBuffer = new SamplerSynthSoundData(jmin(2, int(format->numChannels)), soundPrivate->length);
                     static const int chunkSize{1024};
                     int currentStartSample{0};
                     while (currentStartSample < soundPrivate->length) {
@@ -267,9 +643,11 @@ void SamplerSynthSoundAudioLoader::run()
                         }
                     }
                     if (isAborted() == false) {
+                        newBuffer->lockHead(int(soundPrivate->sourceSampleRate * SampleStorageLockedHeadSeconds));
                         buffer = newBuffer;
                         qDebug() << Q_FUNC_INFO << "Loaded data at sample rate" << soundPrivate->sourceSampleRate << "from playback file" << file.getFullPathName().toRawUTF8();
                     } else {
+                        delete newBuffer;
                         qDebug() << Q_FUNC_INFO << "Aborted sound load from playback file" << file.getFullPathName().toRawUTF8();
                     }
                 }
@@ -376,7 +754,7 @@ void SamplerSynthSoundTimestretcher::run()
         // actually need, to make sure we have enough space for all the samples, as flushing SoundTouch
         // will produce potentially some blank samples at the end to fill the output buffer up)
         const int initialFeedSize = d->soundTouch.getSetting(SETTING_INITIAL_LATENCY);
-        data.setSize(numChannels, numSamples * d->soundTouch.getInputOutputSampleRatio() + initialFeedSize, true);
+        data.allocate(numChannels, numSamples * d->soundTouch.getInputOutputSampleRatio() + initialFeedSize);
         // qDebug() << Q_FUNC_INFO << "Set the size of our output buffer to" << data.getNumSamples() << "based on" << numSamples << "input samples, an output ratio of" << d->soundTouch.getInputOutputSampleRatio() << "and initial feed size of" << initialFeedSize;
 
         const size_t blockSize{512};
@@ -443,7 +821,9 @@ void SamplerSynthSoundTimestretcher::run()
                 if (d->isAborted() == false) {
                     // const int previousSize{data.getNumSamples()};
                     // Resize the buffer to be the exact size we're supposed to have been given
-                    data.setSize(numChannels, numSamples * d->soundTouch.getInputOutputSampleRatio(), true);
+                    // (shrinking in place, as the data lives in our mapped storage, which we don't want to copy out of)
+                    data.setSize(numChannels, numSamples * d->soundTouch.getInputOutputSampleRatio(), true, false, true);
+                    data.lockHead(int(d->parent->sourceSampleRate * SampleStorageLockedHeadSeconds));
                     sampleLength = data.getNumSamples();
                     stretchRate = d->clip->speedRatio();
                     // qDebug() << Q_FUNC_INFO << "Sample has been stretched and whatnot, and the rate by which that is a thing is" << stretchRate << "after reducing the buffer size by" << previousSize - sampleLength;
@@ -3,6 +3,7 @@
 #include "ClipAudioSource.h"
 #include "JUCEHeaders.h"
 #include <QDebug>
+#include <atomic>
 
 class SamplerSynthSoundPrivate;
 class SamplerSynthSound {
@@ -11,6 +12,17 @@ public:
     ~SamplerSynthSound();
     ClipAudioSource *clip() const;
     juce::AudioBuffer<float>* audioData() const noexcept;
+    /**
+     * \brief Ask for prefetchLength() samples of the data from the given position on to be read from the disk ahead of playback
+     * This is safe to call from the process thread (the work is done elsewhere)
+     * @param position The position in the audio data (see audioData()) at which playback is about to happen
+     * @param backward If true, the samples before the position are read ahead instead (for playback going backward)
+     */
+    void prefetch(const double &position, const bool &backward = false) const;
+    /**
+     * \brief The number of samples a single call to prefetch() asks for
+     */
+    int prefetchLength() const;
     const int &length() const;
     const double &sourceSampleRate() const;
     // The amount of stretch applied to the sample compared to the source version (will be 1.0 if time stretching is disabled)
@@ -29,73 +41,188 @@ private:
     SamplerSynthSoundPrivate *d{nullptr};
 };
 
+/**
+ * \brief A handle for a sound registered in a SamplerSoundList
+ * A handle stays valid for as long as the sound it was handed out for remains registered, and checking
+ * whether that is still the case is a single comparison (see SamplerSoundList::isValid)
+ */
+struct SamplerSoundHandle {
+    int slot{-1};
+    quint32 generation{0};
+};
+
 #define SamplerSoundListSize 512
+// Twice the number of slots, to keep the probe sequences short
+#define SamplerSoundListBucketCount 1024
+/**
+ * \brief The registry of the sounds known to SamplerSynth
+ *
+ * Sounds live in fixed slots, and a slot's generation is bumped whenever its occupant changes, which is what
+ * makes a SamplerSoundHandle cheap to validate. Finding the sound for a clip goes through an open addressing
+ * hash table keyed on the clip, so lookups take the same (short) time however many sounds are registered.
+ *
+ * Registering and removing sounds must happen on one thread at a time (SamplerSynth serialises them using its
+ * mutex), while lookups are safe from any thread. The process callback walks a dense list of the live sounds,
+ * which it refreshes using refreshLiveSounds() whenever the registry has changed.
+ */
 class SamplerSoundList {
 public:
-    struct alignas(64) Entry {
-        Entry *previous{nullptr};
-        Entry *next{nullptr};
-        SamplerSynthSound *samplerSound{nullptr};
-        ClipAudioSource *audioSource{nullptr};
-        bool empty{true};
-    };
-
-    SamplerSoundList () {
-        Entry* entryPrevious{&ringData[SamplerSoundListSize - 1]};
-        for (quint64 i = 0; i < SamplerSoundListSize; ++i) {
-            entryPrevious->next = &ringData[i];
-            ringData[i].previous = entryPrevious;
-            entryPrevious = &ringData[i];
+    SamplerSoundList() {
+        for (std::atomic<int> &bucket : buckets) {
+            bucket = EmptyBucket;
         }
-        readHead = writeHead = ringData;
     }
     ~SamplerSoundList() {}
-    void insert(SamplerSynthSound *samplerSound, ClipAudioSource *audioSource) {
-        for (Entry &entry : ringData) {
-            if (entry.empty == true && entry.samplerSound == nullptr && entry.audioSource == nullptr) {
-                entry.samplerSound = samplerSound;
-                entry.audioSource = audioSource;
-                entry.empty = false;
-                return;
+    SamplerSoundHandle insert(SamplerSynthSound *samplerSound, ClipAudioSource *audioSource) {
+        if (find(audioSource) == nullptr) {
+            for (int slotIndex = 0; slotIndex < SamplerSoundListSize; ++slotIndex) {
+                Slot &slot = slots[slotIndex];
+                if (slot.samplerSound == nullptr) {
+                    // Find the bucket for the new entry (reusing the first tombstone on the way, if there is one)
+                    int bucketIndex{bucketFor(audioSource)};
+                    for (int probe = 0; probe < SamplerSoundListBucketCount; ++probe) {
+                        if (buckets[bucketIndex] < 0) {
+                            break;
+                        }
+                        bucketIndex = (bucketIndex + 1) & (SamplerSoundListBucketCount - 1);
+                    }
+                    if (buckets[bucketIndex] >= 0) {
+                        break;
+                    }
+                    // Fill the slot before publishing it in the table, so nobody finds it half-filled
+                    slot.audioSource = audioSource;
+                    slot.samplerSound = samplerSound;
+                    const quint32 generation{++slot.generation};
+                    buckets[bucketIndex].store(slotIndex, std::memory_order_release);
+                    ++version;
+                    return SamplerSoundHandle{slotIndex, generation};
+                }
             }
+            qWarning() << Q_FUNC_INFO << "There is no space left to register the sound" << samplerSound << "for" << audioSource << "This likely means the list size is too small, which will require attention at the api level.";
         }
-        qWarning() << Q_FUNC_INFO << "There is unprocessed data stored at the write location: id" << writeHead->samplerSound << writeHead->audioSource << "This likely means the buffer size is too small, which will require attention at the api level.";
+        return SamplerSoundHandle{};
     }
-    void find(SamplerSynthSound *samplerSound, ClipAudioSource **audioSource) {
-        for (const Entry &entry : ringData) {
-            if (entry.empty == false && entry.samplerSound == samplerSound) {
-                *audioSource = entry.audioSource;
+    /**
+     * \brief Find the sound registered for the given clip
+     * @param audioSource The clip to find the sound for
+     * @param handle If given, this will be set to a handle for the sound (or an invalid handle if there is no sound for the clip)
+     * @return The sound registered for the clip, or nullptr if there is none
+     */
+    SamplerSynthSound *find(ClipAudioSource *audioSource, SamplerSoundHandle *handle = nullptr) const {
+        int bucketIndex{bucketFor(audioSource)};
+        for (int probe = 0; probe < SamplerSoundListBucketCount; ++probe) {
+            const int slotIndex{buckets[bucketIndex].load(std::memory_order_acquire)};
+            if (slotIndex == EmptyBucket) {
                 break;
+            } else if (slotIndex > -1) {
+                const Slot &slot = slots[slotIndex];
+                const quint32 generation{slot.generation};
+                if (slot.audioSource == audioSource) {
+                    if (handle) {
+                        *handle = SamplerSoundHandle{slotIndex, generation};
+                    }
+                    return slot.samplerSound;
+                }
             }
+            bucketIndex = (bucketIndex + 1) & (SamplerSoundListBucketCount - 1);
+        }
+        if (handle) {
+            *handle = SamplerSoundHandle{};
         }
-        return;
+        return nullptr;
+    }
+    /**
+     * \brief Whether the sound the given handle was handed out for is still registered
+     */
+    bool isValid(const SamplerSoundHandle &handle) const {
+        return handle.slot > -1 && slots[handle.slot].generation == handle.generation;
     }
-    void find(ClipAudioSource *audioSource, SamplerSynthSound **samplerSound) {
-        for (const Entry &entry : ringData) {
-            if (entry.empty == false && entry.audioSource == audioSource) {
-                *samplerSound = entry.samplerSound;
+    bool remove(SamplerSynthSound *samplerSound, ClipAudioSource *audioSource) {
+        int bucketIndex{bucketFor(audioSource)};
+        for (int probe = 0; probe < SamplerSoundListBucketCount; ++probe) {
+            const int slotIndex{buckets[bucketIndex]};
+            if (slotIndex == EmptyBucket) {
                 break;
+            } else if (slotIndex > -1) {
+                Slot &slot = slots[slotIndex];
+                if (slot.audioSource == audioSource && slot.samplerSound == samplerSound) {
+                    // Leave a tombstone, so that the probe sequences running through this bucket remain intact
+                    buckets[bucketIndex] = TombstoneBucket;
+                    // If the next bucket is empty, no probe sequence runs past this one, and the tombstone (along
+                    // with any directly before it) can be turned back into an empty bucket. Lookups running at the
+                    // same time are fine with this, as they would have stopped at that next empty bucket anyway.
+                    int nextBucketIndex{(bucketIndex + 1) & (SamplerSoundListBucketCount - 1)};
+                    int tombstoneIndex{bucketIndex};
+                    while (buckets[nextBucketIndex] == EmptyBucket && buckets[tombstoneIndex] == TombstoneBucket) {
+                        buckets[tombstoneIndex].store(EmptyBucket, std::memory_order_release);
+                        nextBucketIndex = tombstoneIndex;
+                        tombstoneIndex = (tombstoneIndex - 1) & (SamplerSoundListBucketCount - 1);
+                    }
+                    ++slot.generation;
+                    slot.samplerSound = nullptr;
+                    slot.audioSource = nullptr;
+                    ++version;
+                    return true;
+                }
             }
+            bucketIndex = (bucketIndex + 1) & (SamplerSoundListBucketCount - 1);
         }
-        return;
+        return false;
     }
+
     /**
-     * \brief Attempt to read the data out of the ring, until there are no more unprocessed entries
-     * @return Whether or not the read was valid
+     * \brief Bring the dense list of live sounds up to date, if anything has changed since last time
+     * @note This, and forEachLiveSound(), must only be called from the one thread (SamplerSynth's process callback)
      */
-    bool remove(SamplerSynthSound *samplerSound, ClipAudioSource *audioSource) {
-        for (Entry &entry : ringData) {
-            if (entry.empty == false && entry.samplerSound == samplerSound && entry.audioSource == audioSource) {
-                entry.samplerSound = nullptr;
-                entry.audioSource = nullptr;
-                entry.empty = true;
-                return true;
+    void refreshLiveSounds() {
+        const quint32 currentVersion{version};
+        if (liveVersion != currentVersion) {
+            liveVersion = currentVersion;
+            liveCount = 0;
+            for (int slotIndex = 0; slotIndex < SamplerSoundListSize; ++slotIndex) {
+                if (slots[slotIndex].samplerSound != nullptr) {
+                    liveSlots[liveCount] = slotIndex;
+                    ++liveCount;
+                }
+            }
+        }
+    }
+    /**
+     * \brief Call the given function for each of the live sounds
+     * @param function A function taking a SamplerSynthSound* and a ClipAudioSource*
+     */
+    template<typename Function>
+    void forEachLiveSound(Function function) const {
+        for (int liveIndex = 0; liveIndex < liveCount; ++liveIndex) {
+            const Slot &slot = slots[liveSlots[liveIndex]];
+            SamplerSynthSound *samplerSound{slot.samplerSound};
+            ClipAudioSource *audioSource{slot.audioSource};
+            // The sound might have been removed since we last refreshed
+            if (samplerSound && audioSource) {
+                function(samplerSound, audioSource);
             }
         }
-        return false;
     }
-    Entry ringData[SamplerSoundListSize];
-    Entry *readHead{nullptr};
-    Entry *writeHead{nullptr};
     QString name;
+private:
+    static constexpr int EmptyBucket{-1};
+    static constexpr int TombstoneBucket{-2};
+    static constexpr int BucketBits{10};
+    static_assert((1 << BucketBits) == SamplerSoundListBucketCount, "The bucket count must match the number of bits used to index the buckets");
+    static inline int bucketFor(const ClipAudioSource *audioSource) {
+        // Fibonacci hashing of the pointer (dropping the low bits, which are always zero due to alignment)
+        return int(((quint64(quintptr(audioSource)) >> 4) * 0x9E3779B97F4A7C15ULL) >> (64 - BucketBits));
+    }
+    struct Slot {
+        std::atomic<quint32> generation{0};
+        std::atomic<SamplerSynthSound*> samplerSound{nullptr};
+        std::atomic<ClipAudioSource*> audioSource{nullptr};
+    };
+    Slot slots[SamplerSoundListSize];
+    std::atomic<int> buckets[SamplerSoundListBucketCount];
+    std::atomic<quint32> version{0};
+    // Only touched by the process callback
+    int liveSlots[SamplerSoundListSize];
+    int liveCount{0};
+    quint32 liveVersion{0};
 };
@@ -5,68 +5,58 @@
 #include "ClipAudioSourceSubvoiceSettings.h"
 #include "ClipCommand.h"
 #include "GainHandler.h"
+#include "LockFreeRing.h"
+#include "ProcessTiming.h"
 #include "SamplerSynth.h"
 #include "SamplerSynthSound.h"
+#include "SamplerSynthVoiceRendering.h"
 #include "SyncTimer.h"
 
 #include <QDebug>
 #include <QtMath>
 
 #define DataRingSize 1024
-class SamplerSynthVoiceDataRing {
+struct SamplerSynthVoiceDataRingEntry {
+    jack_nframes_t time{0};
+    float data{-1};
+    int channel{-1};
+    int note{-1};
+};
+class SamplerSynthVoiceDataRing : public LockFreeRing<SamplerSynthVoiceDataRingEntry, DataRingSize> {
 public:
-    struct alignas(64) Entry {
-        Entry *previous{nullptr};
-        Entry *next{nullptr};
-        jack_nframes_t time{0};
-        float data{-1};
-        int channel{-1};
-        int note{-1};
-        bool processed{true};
-    };
-
-    SamplerSynthVoiceDataRing () {
-        Entry* entryPrevious{&ringData[DataRingSize - 1]};
-        for (quint64 i = 0; i < DataRingSize; ++i) {
-            entryPrevious->next = &ringData[i];
-            ringData[i].previous = entryPrevious;
-            entryPrevious = &ringData[i];
-        }
-        readHead = writeHead = ringData;
-    }
+    explicit SamplerSynthVoiceDataRing(const char *name)
+        : LockFreeRing(name)
+    {}
     ~SamplerSynthVoiceDataRing() {}
+    using LockFreeRing::write;
     void write(jack_nframes_t time, float data, int midiChannel = -1, int midiNote = -1) {
-        Entry *entry = writeHead;
-        writeHead = writeHead->next;
-        if (entry->processed == false) {
-            qWarning() << Q_FUNC_INFO << "There is unprocessed data stored at the write location:" << writeHead->data << "for time" << writeHead->time << "This likely means the buffer size is too small, which will require attention at the api level.";
-        }
-        entry->time = time;
-        entry->data = data;
-        entry->channel = midiChannel;
-        entry->note = midiNote;
-        entry->processed = false;
+        write([time, data, midiChannel, midiNote](SamplerSynthVoiceDataRingEntry &entry) {
+            entry.time = time;
+            entry.data = data;
+            entry.channel = midiChannel;
+            entry.note = midiNote;
+        });
     }
+    using LockFreeRing::read;
     float read(int *midiChannel, int *midiNote) {
-        Entry *entry = readHead;
-        readHead = readHead->next;
-        float data = entry->data;
-        if (midiChannel) {
-            *midiChannel = entry->channel;
-        }
-        if (midiNote) {
-            *midiNote = entry->note;
+        float data{-1};
+        const SamplerSynthVoiceDataRingEntry *entry{peek()};
+        if (entry) {
+            data = entry->data;
+            if (midiChannel) {
+                *midiChannel = entry->channel;
+            }
+            if (midiNote) {
+                *midiNote = entry->note;
+            }
+            markAsRead();
         }
-        entry->processed = true;
         return data;
     }
-    Entry ringData[DataRingSize];
-    Entry *readHead{nullptr};
-    Entry *writeHead{nullptr};
-    QString name;
 };
 
 #define PlayheadCount 2
+#define SamplerSynthVoiceSubBlockSize SamplerSynthVoiceRendering::SubBlockSize
 struct PlayheadData {
 public:
     PlayheadData() {}
@@ -302,20 +292,16 @@ public:
         for (int i = 0; i < 128; ++i) {
             initialCC[i] = 0;
         }
-        aftertouchRing.name = "aftertouchRing";
-        pitchRing.name = "pitchRing";
-        ccControlRing.name = "ccControlRing";
-        ccValueRing.name = "ccValueRing";
     }
 
     // This is perhaps a little over-much, but it means we can handle
     // start/stop cycles so short that it fits inside a single process
     // run, as is needed for the granular playback mode
     ClipCommandRing commandRing;
-    SamplerSynthVoiceDataRing aftertouchRing;
-    SamplerSynthVoiceDataRing pitchRing;
-    SamplerSynthVoiceDataRing ccControlRing;
-    SamplerSynthVoiceDataRing ccValueRing;
+    SamplerSynthVoiceDataRing aftertouchRing{"aftertouchRing"};
+    SamplerSynthVoiceDataRing pitchRing{"pitchRing"};
+    SamplerSynthVoiceDataRing ccControlRing{"ccControlRing"};
+    SamplerSynthVoiceDataRing ccValueRing{"ccValueRing"};
     juce::ADSR adsr;
     SyncTimer *syncTimer{nullptr};
     SamplerSynth *samplerSynth{nullptr};
@@ -324,8 +310,14 @@ public:
     ClipAudioSourceSliceSettings *slice{nullptr};
     ClipAudioSourceSubvoiceSettings *subvoiceSettings{nullptr};
     SamplerSynthSound* sound{nullptr};
+    // Used to check that the sound is still registered with the sampler, without having to look it up every time
+    SamplerSoundHandle soundHandle;
     double pitchRatio = 0;
     double sourceSamplePosition = 0;
+    // How far, and in which direction, the playback position moved for each frame most recently rendered
+    double playbackIncrement = 0;
+    // The playback position the most recent prefetch was asked for at (see SamplerSynthSound::prefetch())
+    double prefetchedPosition = 0;
     float initialGain = 0;
     float targetGain = 0, lgain = 0, rgain = 0;
     // Used to make sure the first sample on looped playback is interpolated to an empty previous sample, rather than the previous sample in the loop
@@ -340,6 +332,13 @@ public:
     float allpassBufferR{0.0f};
 
     PlaybackData playbackData;
+
+    // Scratch space for rendering a sub-block (the frames between two events)
+    alignas(16) float subBlockLeft[SamplerSynthVoiceSubBlockSize];
+    alignas(16) float subBlockRight[SamplerSynthVoiceSubBlockSize];
+    alignas(16) float subBlockAmplitude[SamplerSynthVoiceSubBlockSize];
+    alignas(16) float subBlockPannedLeft[SamplerSynthVoiceSubBlockSize];
+    alignas(16) float subBlockPannedRight[SamplerSynthVoiceSubBlockSize];
 };
 
 SamplerSynthVoice::SamplerSynthVoice(SamplerSynth *samplerSynth)
@@ -361,7 +360,11 @@ SamplerSynthVoice::~SamplerSynthVoice()
 void SamplerSynthVoice::handleCommand(ClipCommand* clipCommand, jack_nframes_t timestamp)
 {
     // qDebug() << Q_FUNC_INFO << "Handling command" << clipCommand << "for cas" << clipCommand->clip << "on track/polyphonic/slot/row" << clipCommand->clip->sketchpadTrack() << clipCommand->clip->registerForPolyphonicPlayback() << clipCommand->clip->sketchpadSlot() << clipCommand->clip->sketchpadSlotRow();
-    d->commandRing.write(clipCommand, timestamp);
+    if (d->commandRing.write(clipCommand, timestamp) == false) {
+        // We've not got space for any more commands, so drop this one (the ring counts it for reporting), and hand it back for reuse
+        d->syncTimer->deleteClipCommand(clipCommand);
+        return;
+    }
     if (clipCommand->stopPlayback == true) {
         // Available after the tailoff period
         const ClipAudioSourceSliceSettings *slice{clipCommand->clip->sliceFromIndex(clipCommand->slice)};
@@ -396,7 +399,9 @@ void SamplerSynthVoice::checkExclusivity(ClipCommand* clipCommand, jack_nframes_
         newCommand->slice = d->clipCommand->slice;
         newCommand->subvoice = d->clipCommand->subvoice;
         newCommand->volume = 1.0f;
-        d->commandRing.write(newCommand, timestamp);
+        if (d->commandRing.write(newCommand, timestamp) == false) {
+            d->syncTimer->deleteClipCommand(newCommand);
+        }
     }
 }
 
@@ -498,7 +503,7 @@ static inline float nextSample(const float *source, const int &sourceLength, dou
 void SamplerSynthVoice::startNote(ClipCommand *clipCommand, jack_nframes_t timestamp)
 {
     // qDebug() << Q_FUNC_INFO << "Starting note for clipCommand" << clipCommand << "with clip" << clipCommand->clip << "on track/polyphonic/slot/row" << clipCommand->clip->sketchpadTrack() << clipCommand->clip->registerForPolyphonicPlayback() << clipCommand->clip->sketchpadSlot() << clipCommand->clip->sketchpadSlotRow();
-    if (auto sound = d->samplerSynth->clipToSound(clipCommand->clip)) {
+    if (auto sound = d->samplerSynth->clipToSound(clipCommand->clip, &d->soundHandle)) {
         // qDebug() << Q_FUNC_INFO << "Got a sound, this is lovely, and our initial gain is" << clipCommand->volume;
         d->sound = sound;
         d->clip = sound->clip();
@@ -555,6 +560,14 @@ void SamplerSynthVoice::startNote(ClipCommand *clipCommand, jack_nframes_t times
         } else {
             d->sourceSamplePosition = d->playbackData.startPosition;
         }
+        // Anything past the locked head of the sample may well not be in memory, so get it on its way (process() keeps
+        // asking for the next window as playback moves along, see there)
+        const bool playingBackward{d->clipCommand->changePitch && d->clipCommand->pitchChange < 0};
+        sound->prefetch(d->sourceSamplePosition, playingBackward);
+        d->prefetchedPosition = d->sourceSamplePosition;
+        if (d->playbackData.isLooping && d->playbackData.loopPosition != d->playbackData.startPosition) {
+            sound->prefetch(d->playbackData.loopPosition, playingBackward);
+        }
 
         if (clipCommand->looping == true) {
             availableAfter = UINT_MAX;
@@ -628,25 +641,17 @@ void SamplerSynthVoice::handlePitchChange(jack_nframes_t time, int channel, int
     d->pitchRing.write(time, pitchValue, channel, note);
 }
 
-inline float interpolateHermite4pt3oX(float x0, float x1, float x2, float x3, float t)
-{
-    float c0 = x1;
-    float c1 = .5F * (x2 - x0);
-    float c2 = x0 - (2.5F * x1) + (2 * x2) - (.5F * x3);
-    float c3 = (.5F * (x3 - x0)) + (1.5F * (x1 - x2));
-    return (((((c3 * t) + c2) * t) + c1) * t) + c0;
-}
-
 // if we perform highpass filtering, we need to invert the output of the allpass (multiply it by -1)
 static const double highpassSign{-1.f};
 void SamplerSynthVoice::process(jack_default_audio_sample_t */*leftBuffer*/, jack_default_audio_sample_t */*rightBuffer*/, jack_nframes_t nframes, jack_nframes_t current_frames, jack_time_t /*current_usecs*/, jack_time_t /*next_usecs*/, float /*period_usecs*/)
 {
+    MEASURE_PROCESS_TIMING("SamplerSynthVoice", nframes)
     float peakGainLeft{0.0f}, peakGainRight{0.0f};
     int dataChannel{0}, dataNote{0};
 
     // First, a quick sanity check, just to be on the safe side:
     // Ensure that the clip we're operating on is still known to the sampler
-    if (d->clip && d->samplerSynth->clipToSound(d->clip) == nullptr) {
+    if (d->clip && d->samplerSynth->isSoundRegistered(d->soundHandle) == false) {
         stopNote(0, false, current_frames);
     }
 
@@ -675,11 +680,16 @@ void SamplerSynthVoice::process(jack_default_audio_sample_t */*leftBuffer*/, jac
         d->playbackData.backwardTailingOffPosition = d->playbackData.startPosition + (double(d->adsr.getParameters().release * d->playbackData.sourceSampleRate) / d->sound->stretchRate());
     }
 
-    // Process each frame in turn (any commands that want handling for a given frame, control changes, that sort of thing, and finally the audio itself)
-    for(jack_nframes_t frame = 0; frame < nframes; ++frame) {
+    // Rather than doing all the work for every frame, we split the period into sub-blocks at the
+    // frames where an event (a command, or a control, pitch, or aftertouch change) lands. Events
+    // are handled at the start of each sub-block, and the audio in between is rendered in one go,
+    // using the values which can only change on an event boundary (pitch ratio, gain, pan), and
+    // vector operations for the gain, panning, and mixing stages.
+    jack_nframes_t frame{0};
+    while (frame < nframes) {
         // Check if we've got any commands that need handling for this frame
         const jack_nframes_t currentFrame{current_frames + frame};
-        while (d->commandRing.readHead->processed == false && d->commandRing.readHead->timestamp <= currentFrame) {
+        while (d->commandRing.hasUnread() && d->commandRing.peek()->timestamp <= currentFrame) {
             ClipCommand *newCommand = d->commandRing.read();
             // We only want to delete the command if it's only a stop command, since then nothing else will be handling it
             bool shouldDelete{false};
@@ -700,7 +710,7 @@ void SamplerSynthVoice::process(jack_default_audio_sample_t */*leftBuffer*/, jac
             }
         }
 
-        while (d->ccControlRing.readHead->processed == false && d->ccControlRing.readHead->time == frame) {
+        while (d->ccControlRing.hasUnread() && d->ccControlRing.peek()->time == frame) {
             // Consume the control change values, but... we don't really have anything to properly use them for
             const float control = d->ccControlRing.read(&dataChannel, &dataNote);
             float value = d->ccValueRing.read(&dataChannel, &dataNote);
@@ -729,13 +739,13 @@ void SamplerSynthVoice::process(jack_default_audio_sample_t */*leftBuffer*/, jac
                 }
             }
         }
-        while (d->pitchRing.readHead->processed == false && d->pitchRing.readHead->time == frame) {
+        while (d->pitchRing.hasUnread() && d->pitchRing.peek()->time == frame) {
             const float pitch = d->pitchRing.read(&dataChannel, &dataNote);
             if (isTailingOff == false && (d->clipCommand && (dataChannel == -1 || (d->clipCommand && dataChannel == d->clipCommand->midiChannel)))) {
                 d->pitchRatio = std::pow(2.0, (std::clamp(pitch + double(d->clipCommand->midiNote), 0.0, 127.0) - double(d->slice->effectiveRootNote())) / 12.0);
             }
         }
-        while (d->aftertouchRing.readHead->processed == false && d->aftertouchRing.readHead->time == frame) {
+        while (d->aftertouchRing.hasUnread() && d->aftertouchRing.peek()->time == frame) {
             const float aftertouch = d->aftertouchRing.read(&dataChannel, &dataNote);
             if (isTailingOff == false && (d->clipCommand && (dataChannel == -1 || (d->clipCommand && dataChannel == d->clipCommand->midiChannel)) && (dataNote == -1 || (d->clipCommand && dataNote == d->clipCommand->midiNote)))) {
                 // const float previousGain = d->targetGain;
@@ -747,21 +757,18 @@ void SamplerSynthVoice::process(jack_default_audio_sample_t */*leftBuffer*/, jac
                 // if (d->subvoiceSettings == nullptr) { qDebug() << d->clip << "On frame" << currentFrame << "target gain changed by" << d->targetGain - previousGain << "from" << previousGain << "to" << d->targetGain << "with current gain at" << d->lgain; }
             }
         }
-        if (d->clipCommand) {
-            float targetGainDelta{abs(d->targetGain - d->lgain)};
-            if (targetGainDelta > 0.000001) {
-                static const float maxGainChangePerFrame{0.0001f};
-                float newGain{0.0f};
-                if (d->targetGain > d->lgain) {
-                    newGain = d->lgain + qMin(targetGainDelta, maxGainChangePerFrame);
-                } else {
-                    newGain = d->lgain - qMin(targetGainDelta, maxGainChangePerFrame);
-                }
-                d->lgain = d->rgain = d->clipCommand->volume = newGain;
-            } else {
-                d->lgain = d->rgain = d->clipCommand->volume = d->targetGain;
+
+        // Find the frame where the next event lands (or the end of the period, or the largest sub-block we can fit in our scratch buffers, whichever comes first)
+        jack_nframes_t subBlockEnd{qMin(nframes, frame + SamplerSynthVoiceSubBlockSize)};
+        if (d->commandRing.hasUnread() && d->commandRing.peek()->timestamp < quint64(current_frames) + subBlockEnd) {
+            subBlockEnd = jack_nframes_t(d->commandRing.peek()->timestamp - current_frames);
+        }
+        for (const SamplerSynthVoiceDataRing *dataRing : {&d->ccControlRing, &d->pitchRing, &d->aftertouchRing}) {
+            if (dataRing->hasUnread() && dataRing->peek()->time > frame && dataRing->peek()->time < subBlockEnd) {
+                subBlockEnd = dataRing->peek()->time;
             }
         }
+
         // Don't actually perform playback operations unless we've got something to play
         if (d->clip && d->sound->isValid) {
             // If we're using timestretching for our clip shifting, then we should not also be applying the clip's pitch shifting here
@@ -772,105 +779,156 @@ void SamplerSynthVoice::process(jack_default_audio_sample_t */*leftBuffer*/, jac
             const float clipGain = (d->slice == d->clip->rootSliceActual() ? 1 : d->clip->rootSliceActual()->gainHandlerActual()->operationalGain()) * d->slice->gainHandlerActual()->operationalGain() * (d->subvoiceSettings ? d->subvoiceSettings->gain() : 1.0f);
             const float lPan = 0.5f * (1.0f + qMax(-1.0f, d->playbackData.pan));
             const float rPan = 0.5f * (1.0f - qMax(0.0f, d->playbackData.pan));
-
-            const float envelopeValue = d->adsr.getNextSample();
-            float l{0};
-            float r{0};
             // If we're using timestretching for our clip's pitch shifting, then we also should not be applying the speed ratio here
             const double pitchRatio{d->pitchRatio * clipPitchChange * (d->clip->rootSliceActual()->timeStretchStyle() == ClipAudioSource::TimeStretchOff ? d->clip->speedRatio() : 1.0f) * d->sound->sampleRateRatio()};
-            for (int playheadIndex = 0; playheadIndex < PlayheadCount; ++playheadIndex) {
-                const PlayheadData &playhead = d->playbackData.playheads[playheadIndex];
-                if (playhead.active) {
-                    float playheadL{0};
-                    float playheadR{0};
-                    const int sampleIndex{int(playhead.sourceSamplePosition)};
-                    float modIntegral{0};
-                    const float fraction = std::modf(playhead.sourceSamplePosition, &modIntegral);
-                    if ((fraction < 0.0001f && pitchRatio == 1.0f)) {
-                        // If we're just doing un-pitch-shifted playback, don't bother interpolating,
-                        // just grab the sample as given and adjust according to the requests, might
-                        // as well save a bit of processing (it's a very common case, and used for
-                        // e.g. the metronome ticks and sketches, and we do want that stuff to be as
-                        // low impact as we can reasonably make it).
-                        playheadL = sampleIndex < d->playbackData.sampleDuration ? d->playbackData.inL[sampleIndex] * d->lgain * envelopeValue * clipGain : 0;
-                        playheadR = d->playbackData.inR != nullptr && sampleIndex < d->playbackData.sampleDuration ? d->playbackData.inR[sampleIndex] * d->rgain * envelopeValue * clipGain : l;
+            d->playbackIncrement = pitchRatio;
+
+            // First pass, per frame: the gain ramp, envelope, and playhead interpolation, which all carry state from one frame to the next
+            int renderedFrames{0};
+            bool stopAfterRendering{false};
+            for (jack_nframes_t subBlockFrame = frame; subBlockFrame < subBlockEnd; ++subBlockFrame) {
+                float targetGainDelta{abs(d->targetGain - d->lgain)};
+                if (targetGainDelta > 0.000001) {
+                    static const float maxGainChangePerFrame{0.0001f};
+                    float newGain{0.0f};
+                    if (d->targetGain > d->lgain) {
+                        newGain = d->lgain + qMin(targetGainDelta, maxGainChangePerFrame);
                     } else {
-                        // Use Hermite interpolation to ensure out sound data is reasonably on the expected
-                        // curve. We could use linear interpolation, but Hermite is cheap enough that it's
-                        // worth it for the improvements in sound quality. Any more and we'll need to do some
-                        // precalc work and do sample stretching per octave/note/whatnot ahead of time...
-                        // Maybe that's something we could offer an option for, if people really really want it?
-                        int previousSampleIndex{sampleIndex - 1};
-                        int nextSampleIndex{sampleIndex + 1};
-                        int nextNextSampleIndex{sampleIndex + 2};
-                        if (d->playbackData.isLooping && d->slice->loopCrossfadeAmount() == 0) {
-                            // If we are looping, we'll need to wrap our data stream to match the loop
-                            // But, don't do this if we're crossfading (at which point the loop stream interpolation is done by the playheads, not here)
-                            if (d->firstRoll) {
+                        newGain = d->lgain - qMin(targetGainDelta, maxGainChangePerFrame);
+                    }
+                    d->lgain = d->rgain = d->clipCommand->volume = newGain;
+                } else {
+                    d->lgain = d->rgain = d->clipCommand->volume = d->targetGain;
+                }
+
+                float l{0};
+                float r{0};
+                for (int playheadIndex = 0; playheadIndex < PlayheadCount; ++playheadIndex) {
+                    const PlayheadData &playhead = d->playbackData.playheads[playheadIndex];
+                    if (playhead.active) {
+                        float playheadL{0};
+                        float playheadR{0};
+                        const int sampleIndex{int(playhead.sourceSamplePosition)};
+                        float modIntegral{0};
+                        const float fraction = std::modf(playhead.sourceSamplePosition, &modIntegral);
+                        if ((fraction < 0.0001f && pitchRatio == 1.0f)) {
+                            // If we're just doing un-pitch-shifted playback, don't bother interpolating,
+                            // just grab the sample as given and adjust according to the requests, might
+                            // as well save a bit of processing (it's a very common case, and used for
+                            // e.g. the metronome ticks and sketches, and we do want that stuff to be as
+                            // low impact as we can reasonably make it).
+                            playheadL = sampleIndex < d->playbackData.sampleDuration ? d->playbackData.inL[sampleIndex] : 0;
+                            playheadR = d->playbackData.inR != nullptr && sampleIndex < d->playbackData.sampleDuration ? d->playbackData.inR[sampleIndex] : playheadL;
+                        } else {
+                            // Use Hermite interpolation to ensure out sound data is reasonably on the expected
+                            // curve. We could use linear interpolation, but Hermite is cheap enough that it's
+                            // worth it for the improvements in sound quality. Any more and we'll need to do some
+                            // precalc work and do sample stretching per octave/note/whatnot ahead of time...
+                            // Maybe that's something we could offer an option for, if people really really want it?
+                            int previousSampleIndex{sampleIndex - 1};
+                            int nextSampleIndex{sampleIndex + 1};
+                            int nextNextSampleIndex{sampleIndex + 2};
+                            if (d->playbackData.isLooping && d->slice->loopCrossfadeAmount() == 0) {
+                                // If we are looping, we'll need to wrap our data stream to match the loop
+                                // But, don't do this if we're crossfading (at which point the loop stream interpolation is done by the playheads, not here)
+                                if (d->firstRoll) {
+                                    previousSampleIndex = previousSampleIndex < playhead.startPosition ? -1 : previousSampleIndex;
+                                    d->firstRoll = false;
+                                } else {
+                                    previousSampleIndex = previousSampleIndex < playhead.startPosition ? playhead.stopPosition - 1 : previousSampleIndex;
+                                }
+                                if (nextSampleIndex > playhead.stopPosition) {
+                                    nextSampleIndex = playhead.startPosition;
+                                    nextNextSampleIndex = nextSampleIndex + 1;
+                                } else if (nextNextSampleIndex > playhead.stopPosition) {
+                                    nextSampleIndex = playhead.startPosition;
+                                }
+                            } else {
                                 previousSampleIndex = previousSampleIndex < playhead.startPosition ? -1 : previousSampleIndex;
-                                d->firstRoll = false;
+                                nextSampleIndex = nextSampleIndex > playhead.stopPosition ? -1 : nextSampleIndex;
+                                nextNextSampleIndex = nextNextSampleIndex > playhead.stopPosition ? -1 : nextNextSampleIndex;
+                            }
+                            // If the various other sample positions are outside the sample area, the sample value is 0 and we should be treating it like there's no sample data
+                            playheadL = SamplerSynthVoiceRendering::interpolatedSample(d->playbackData.inL, d->playbackData.sampleDuration, previousSampleIndex, sampleIndex, nextSampleIndex, nextNextSampleIndex, fraction);
+                            if (d->playbackData.inR == nullptr) {
+                                playheadR = playheadL;
                             } else {
-                                previousSampleIndex = previousSampleIndex < playhead.startPosition ? playhead.stopPosition - 1 : previousSampleIndex;
+                                playheadR = SamplerSynthVoiceRendering::interpolatedSample(d->playbackData.inR, d->playbackData.sampleDuration, previousSampleIndex, sampleIndex, nextSampleIndex, nextNextSampleIndex, fraction);
                             }
-                            if (nextSampleIndex > playhead.stopPosition) {
-                                nextSampleIndex = playhead.startPosition;
-                                nextNextSampleIndex = nextSampleIndex + 1;
-                            } else if (nextNextSampleIndex > playhead.stopPosition) {
-                                nextSampleIndex = playhead.startPosition;
+                        }
+                        l += (playheadL * playhead.playheadGain);
+                        r += (playheadR * playhead.playheadGain);
+                    }
+                }
+                // Progress the playheads (so that when we try and check next sample, they will be at the proper position)
+                for (int playheadIndex = 0; playheadIndex < PlayheadCount; ++playheadIndex) {
+                    PlayheadData &playhead = d->playbackData.playheads[playheadIndex];
+                    if (playhead.active) {
+                        playhead.progress(pitchRatio);
+                    }
+                }
+
+                d->subBlockLeft[renderedFrames] = l;
+                d->subBlockRight[renderedFrames] = r;
+                // The voice gain is the same for both channels (lgain and rgain are always equal), so we apply it along with
+                // the envelope and clip gain as a single per-frame amplitude once the sub-block is rendered.
+                // The sound data might possibly disappear while we're attempting to play,
+                // and if that happens, we really need to not try and use it. If it does
+                // happen, zero out the inputs to avoid terrible noises and an angry jackd
+                // which will just mute the heck out of everything and give up.
+                // Specifically, this will invariably happen when doing offline pitch
+                // shifting or speed ratio adjustments
+                d->subBlockAmplitude[renderedFrames] = d->sound->isValid ? d->lgain * d->adsr.getNextSample() * clipGain : 0;
+                ++renderedFrames;
+
+                d->sourceSamplePosition += pitchRatio;
+
+                if (d->adsr.isActive()) {
+                    if (pitchRatio > 0) {
+                        // We're playing the sample forwards, so let's handle things with that direction in mind
+                        if (d->playbackData.isLooping) {
+                            if (d->sourceSamplePosition >= d->playbackData.stopPosition) {
+                                d->sourceSamplePosition = d->playbackData.loopPosition;
                             }
                         } else {
-                            previousSampleIndex = previousSampleIndex < playhead.startPosition ? -1 : previousSampleIndex;
-                            nextSampleIndex = nextSampleIndex > playhead.stopPosition ? -1 : nextSampleIndex;
-                            nextNextSampleIndex = nextNextSampleIndex > playhead.stopPosition ? -1 : nextNextSampleIndex;
+                            if (d->sourceSamplePosition >= d->playbackData.stopPosition)
+                            {
+                                stopAfterRendering = true;
+                            } else if (isTailingOff == false && d->sourceSamplePosition >= d->playbackData.forwardTailingOffPosition) {
+                                stopNote(d->targetGain, true, current_frames + subBlockFrame);
+                            }
                         }
-                        // If the various other sample positions are outside the sample area, the sample value is 0 and we should be treating it like there's no sample data
-                        const float l0 = d->playbackData.sampleDuration < previousSampleIndex || previousSampleIndex == -1 ? 0 : d->playbackData.inL[(int)previousSampleIndex];
-                        const float l1 = d->playbackData.sampleDuration < sampleIndex ? 0 : d->playbackData.inL[(int)sampleIndex];
-                        const float l2 = d->playbackData.sampleDuration < nextSampleIndex || nextSampleIndex == -1 ? 0 : d->playbackData.inL[(int)nextSampleIndex];
-                        const float l3 = d->playbackData.sampleDuration < nextNextSampleIndex || nextNextSampleIndex == -1 ? 0 : d->playbackData.inL[(int)nextNextSampleIndex];
-                        playheadL = interpolateHermite4pt3oX(l0, l1, l2, l3, fraction) * d->lgain * envelopeValue * clipGain;
-                        if (d->playbackData.inR == nullptr) {
-                            playheadR = playheadL;
+                    } else {
+                        // We're playing the sample backwards, so let's handle things with that direction in mind
+                        // That is, start position is used for the stop location and vice versa
+                        if (d->playbackData.isLooping) {
+                            if (d->sourceSamplePosition <= d->playbackData.stopPosition) {
+                                // TODO Switch start position for the loop position here - this'll likely need that second loop position to make sense... or will it?! thought needed at any rate.
+                                d->sourceSamplePosition = d->playbackData.stopPosition;
+                            }
                         } else {
-                            const float r0 = d->playbackData.sampleDuration < previousSampleIndex || previousSampleIndex == -1 ? 0 : d->playbackData.inR[(int)previousSampleIndex];
-                            const float r1 = d->playbackData.sampleDuration < sampleIndex ? 0 : d->playbackData.inR[(int)sampleIndex];
-                            const float r2 = d->playbackData.sampleDuration < nextSampleIndex || nextSampleIndex == -1 ? 0 : d->playbackData.inR[(int)nextSampleIndex];
-                            const float r3 = d->playbackData.sampleDuration < nextNextSampleIndex || nextNextSampleIndex == -1 ? 0 : d->playbackData.inR[(int)nextNextSampleIndex];
-                            playheadR = interpolateHermite4pt3oX(r0, r1, r2, r3, fraction) * d->rgain * envelopeValue * clipGain;
+                            if (d->sourceSamplePosition <= d->playbackData.startPosition)
+                            {
+                                stopAfterRendering = true;
+                            } else if (isTailingOff == false && d->sourceSamplePosition <= d->playbackData.backwardTailingOffPosition) {
+                                stopNote(d->targetGain, true, current_frames + subBlockFrame);
+                            }
                         }
                     }
-                    l += (playheadL * playhead.playheadGain);
-                    r += (playheadR * playhead.playheadGain);
+                } else {
+                    stopAfterRendering = true;
                 }
-            }
-            // Progress the playheads (so that when we try and check next sample, they will be at the proper position)
-            for (int playheadIndex = 0; playheadIndex < PlayheadCount; ++playheadIndex) {
-                PlayheadData &playhead = d->playbackData.playheads[playheadIndex];
-                if (playhead.active) {
-                    playhead.progress(pitchRatio);
+                if (stopAfterRendering) {
+                    // Once the voice has stopped there is nothing more to render until the next event
+                    break;
                 }
             }
 
-            // The sound data might possibly disappear while we're attempting to play,
-            // and if that happens, we really need to not try and use it. If it does
-            // happen, zero out the inputs to avoid terrible noises and an angry jackd
-            // which will just mute the heck out of everything and give up.
-            // Specifically, this will invariably happen when doing offline pitch
-            // shifting or speed ratio adjustments
-            if (d->sound->isValid == false) {
-                l = r = 0;
-            }
-
-            // Implement M/S Panning
-            const float mSignal = 0.5 * (l + r);
-            const float sSignal = 0.5 * (l - r);
-            l = lPan * mSignal + sSignal;
-            r = rPan * mSignal - sSignal;
-
             // FIXME: Sort out the filter situation...
             // Alright... allpass filter is clearly the wrong thing here, we really want to leave things alone unless
             // explicitly applying a filter, and... an allpass may well have a flat response, but isn't phase correct,
-            // so, let's avoid that and get back to that later on
+            // so, let's avoid that and get back to that later on (as it carries state between frames, it will want to
+            // live in the per-frame pass above, applied to l and r after panning)
             //
             // // Apply allpass filter effect
             // // Roughly based on https://thewolfsound.com/lowpass-highpass-filter-plugin-with-juce/
@@ -895,57 +953,36 @@ void SamplerSynthVoice::process(jack_default_audio_sample_t */*leftBuffer*/, jac
             //     r = 0.5f * (r + allpassFilteredSampleR);
             // }
 
-            if (l > peakGainLeft) {
-                peakGainLeft = l;
-            }
-            if (r > peakGainRight) {
-                peakGainRight = r;
-            }
-
-            // Add the playback data into the current sound's playback buffer at the current frame position
-            // static uint throttler{0}; ++throttler; if (throttler > 200 * nframes) { throttler = 0; };
-            // if (throttler == 0) { qDebug() << Q_FUNC_INFO << d->sound; }
-            *(d->sound->leftBuffer + int(frame)) += l;
-            *(d->sound->rightBuffer + int(frame)) += r;
+            // Second pass, vectorised across the whole sub-block: apply the per-frame amplitude, then M/S panning,
+            // and finally mix the result into the current sound's playback buffer at the sub-block's position
+            SamplerSynthVoiceRendering::amplifyPanAndMix(d->subBlockLeft, d->subBlockRight, d->subBlockAmplitude, lPan, rPan, d->subBlockPannedLeft, d->subBlockPannedRight, d->sound->leftBuffer + int(frame), d->sound->rightBuffer + int(frame), renderedFrames, peakGainLeft, peakGainRight);
 
-            d->sourceSamplePosition += pitchRatio;
-
-            if (d->adsr.isActive()) {
-                if (pitchRatio > 0) {
-                    // We're playing the sample forwards, so let's handle things with that direction in mind
-                    if (d->playbackData.isLooping) {
-                        if (d->sourceSamplePosition >= d->playbackData.stopPosition) {
-                            d->sourceSamplePosition = d->playbackData.loopPosition;
-                        }
+            if (stopAfterRendering) {
+                stopNote(d->targetGain, false, current_frames + frame + jack_nframes_t(renderedFrames) - 1, peakGainLeft, peakGainRight);
+            }
+        } else if (d->clipCommand) {
+            // Nothing to play, but keep the gain ramp moving so it is where it should be once we do have something
+            for (jack_nframes_t subBlockFrame = frame; subBlockFrame < subBlockEnd; ++subBlockFrame) {
+                float targetGainDelta{abs(d->targetGain - d->lgain)};
+                if (targetGainDelta > 0.000001) {
+                    static const float maxGainChangePerFrame{0.0001f};
+                    if (d->targetGain > d->lgain) {
+                        d->lgain = d->rgain = d->clipCommand->volume = d->lgain + qMin(targetGainDelta, maxGainChangePerFrame);
                     } else {
-                        if (d->sourceSamplePosition >= d->playbackData.stopPosition)
-                        {
-                            stopNote(d->targetGain, false, currentFrame, peakGainLeft, peakGainRight);
-                        } else if (isTailingOff == false && d->sourceSamplePosition >= d->playbackData.forwardTailingOffPosition) {
-                            stopNote(d->targetGain, true, currentFrame, peakGainLeft, peakGainRight);
-                        }
+                        d->lgain = d->rgain = d->clipCommand->volume = d->lgain - qMin(targetGainDelta, maxGainChangePerFrame);
                     }
                 } else {
-                    // We're playing the sample backwards, so let's handle things with that direction in mind
-                    // That is, start position is used for the stop location and vice versa
-                    if (d->playbackData.isLooping) {
-                        if (d->sourceSamplePosition <= d->playbackData.stopPosition) {
-                            // TODO Switch start position for the loop position here - this'll likely need that second loop position to make sense... or will it?! thought needed at any rate.
-                            d->sourceSamplePosition = d->playbackData.stopPosition;
-                        }
-                    } else {
-                        if (d->sourceSamplePosition <= d->playbackData.startPosition)
-                        {
-                            stopNote(d->targetGain, false, currentFrame, peakGainLeft, peakGainRight);
-                        } else if (isTailingOff == false && d->sourceSamplePosition <= d->playbackData.backwardTailingOffPosition) {
-                            stopNote(d->targetGain, true, currentFrame, peakGainLeft, peakGainRight);
-                        }
-                    }
+                    d->lgain = d->rgain = d->clipCommand->volume = d->targetGain;
                 }
-            } else {
-                stopNote(d->targetGain, false, currentFrame, peakGainLeft, peakGainRight);
             }
         }
+        frame = subBlockEnd;
+    }
+    // Once playback has moved half a prefetch window on from where we last asked (or jumped, by looping or restarting), ask
+    // for the next window, so the sample data stays ahead of the playback position (this only posts a request, so never blocks)
+    if (d->clip && d->clipCommand && d->sound && std::abs(d->sourceSamplePosition - d->prefetchedPosition) >= d->sound->prefetchLength() / 2) {
+        d->sound->prefetch(d->sourceSamplePosition, d->playbackIncrement < 0);
+        d->prefetchedPosition = d->sourceSamplePosition;
     }
     for (int playheadIndex = 0; playheadIndex < PlayheadCount; ++playheadIndex) {
         PlayheadData &playhead = d->playbackData.playheads[playheadIndex];
@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+    SamplerSynthVoiceRendering.h
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+/**
+ * \brief The sample rendering stages of SamplerSynthVoice::process(), kept free of the voice's state
+ *
+ * These only work on the buffers they are handed, which means they can be run on their own (see the dspbenchmark
+ * tool, which uses them to measure the cost of rendering a voice without needing jack, a sound, or a sampler).
+ */
+namespace SamplerSynthVoiceRendering {
+    // The largest number of frames rendered in one go when there are no events to split the period on
+    constexpr int SubBlockSize{64};
+
+    /**
+     * \brief Four point, third order Hermite interpolation between x1 and x2
+     * @param t How far between x1 and x2 the interpolated value should be (0 through 1)
+     */
+    inline float interpolateHermite4pt3oX(float x0, float x1, float x2, float x3, float t)
+    {
+        float c0 = x1;
+        float c1 = .5F * (x2 - x0);
+        float c2 = x0 - (2.5F * x1) + (2 * x2) - (.5F * x3);
+        float c3 = (.5F * (x3 - x0)) + (1.5F * (x1 - x2));
+        return (((((c3 * t) + c2) * t) + c1) * t) + c0;
+    }
+
+    /**
+     * \brief The interpolated value of some audio data at a position between two of its samples
+     * Any index which is -1, or past the end of the data, is treated as silence
+     * @param data The audio data to read from
+     * @param sampleDuration The number of samples in the data
+     * @param previousSampleIndex The index of the sample before the one at sampleIndex
+     * @param sampleIndex The index of the sample at or immediately before the position
+     * @param nextSampleIndex The index of the sample after the one at sampleIndex
+     * @param nextNextSampleIndex The index of the sample after the one at nextSampleIndex
+     * @param fraction How far past sampleIndex the position is (0 through 1)
+     */
+    inline float interpolatedSample(const float *data, const int &sampleDuration, const int &previousSampleIndex, const int &sampleIndex, const int &nextSampleIndex, const int &nextNextSampleIndex, const float &fraction)
+    {
+        const float x0 = sampleDuration < previousSampleIndex || previousSampleIndex == -1 ? 0 : data[previousSampleIndex];
+        const float x1 = sampleDuration < sampleIndex ? 0 : data[sampleIndex];
+        const float x2 = sampleDuration < nextSampleIndex || nextSampleIndex == -1 ? 0 : data[nextSampleIndex];
+        const float x3 = sampleDuration < nextNextSampleIndex || nextNextSampleIndex == -1 ? 0 : data[nextNextSampleIndex];
+        return interpolateHermite4pt3oX(x0, x1, x2, x3, fraction);
+    }
+
+    /**
+     * \brief Apply the per-frame amplitude and panning to a rendered sub-block, and mix it into the output
+     *
+     * The panning is M/S style, which works out to l' = l * (lPan + 1) / 2 + r * (lPan - 1) / 2 and
+     * r' = l * (rPan - 1) / 2 + r * (rPan + 1) / 2
+     *
+     * @param left The rendered left channel (which will have the amplitude applied in place)
+     * @param right The rendered right channel (which will have the amplitude applied in place)
+     * @param amplitude The amplitude for each frame
+     * @param lPan The left pan amount
+     * @param rPan The right pan amount
+     * @param pannedLeft Scratch space for the panned left channel
+     * @param pannedRight Scratch space for the panned right channel
+     * @param outputLeft The left channel to mix the result into
+     * @param outputRight The right channel to mix the result into
+     * @param frames The number of frames in the sub-block
+     * @param peakLeft Will be raised to the highest panned left value, if that is above its current value
+     * @param peakRight Will be raised to the highest panned right value, if that is above its current value
+     */
+    inline void amplifyPanAndMix(float *left, float *right, const float *amplitude, const float &lPan, const float &rPan, float *pannedLeft, float *pannedRight, float *outputLeft, float *outputRight, const int &frames, float &peakLeft, float &peakRight)
+    {
+        juce::FloatVectorOperations::multiply(left, amplitude, frames);
+        juce::FloatVectorOperations::multiply(right, amplitude, frames);
+        juce::FloatVectorOperations::copyWithMultiply(pannedLeft, left, 0.5f * (lPan + 1.0f), frames);
+        juce::FloatVectorOperations::addWithMultiply(pannedLeft, right, 0.5f * (lPan - 1.0f), frames);
+        juce::FloatVectorOperations::copyWithMultiply(pannedRight, left, 0.5f * (rPan - 1.0f), frames);
+        juce::FloatVectorOperations::addWithMultiply(pannedRight, right, 0.5f * (rPan + 1.0f), frames);
+        peakLeft = std::max(peakLeft, juce::FloatVectorOperations::findMaximum(pannedLeft, frames));
+        peakRight = std::max(peakRight, juce::FloatVectorOperations::findMaximum(pannedRight, frames));
+        juce::FloatVectorOperations::add(outputLeft, pannedLeft, frames);
+        juce::FloatVectorOperations::add(outputRight, pannedRight, frames);
+    }
+}
@@ -26,6 +26,7 @@
 
 // Hackety hack - we don't need all the thing, just need to convince CAS it exists
 #define JUCE_GLOBAL_MODULE_SETTINGS_INCLUDED 1
+#include "AudioLevels.h"
 #include "ClipAudioSource.h"
 #include "ClipCommand.h"
 #include "SyncTimer.h"
@@ -105,6 +106,11 @@ public:
                         }
                         // qDebug() << Q_FUNC_INFO << "Scheduled stop command" << command;
                         syncTimer->scheduleTimerCommand(0, TimerCommand::cloneTimerCommand(command));
+                    } else if (command->operation == TimerCommand::ChannelRecorderStartOperation) {
+                        // Each copy of the command starts its own recording, so get that one ready before handing it over
+                        TimerCommand *clonedCommand = TimerCommand::cloneTimerCommand(command);
+                        AudioLevels::instance()->armRecordingForCommand(clonedCommand);
+                        syncTimer->scheduleTimerCommand(0, clonedCommand);
                     } else {
                         // qDebug() << Q_FUNC_INFO << "Scheduled" << command << command->operation;
                         syncTimer->scheduleTimerCommand(0, TimerCommand::cloneTimerCommand(command));
@@ -167,7 +173,9 @@ public:
                             } else if (command->operation == TimerCommand::ChannelRecorderStartOperation || command->operation == TimerCommand::ChannelRecorderStopOperation) {
                                 // TODO Ensure that we don't scroll back past channel recorder operations like this and leave the state weird
                                 if (direction == 1) {
-                                    syncTimer->scheduleTimerCommand(0, TimerCommand::cloneTimerCommand(command));
+                                    TimerCommand *clonedCommand = TimerCommand::cloneTimerCommand(command);
+                                    AudioLevels::instance()->armRecordingForCommand(clonedCommand);
+                                    syncTimer->scheduleTimerCommand(0, clonedCommand);
                                 }
                             } else {
                                 if (direction == -1) {
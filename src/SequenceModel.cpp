@@ -20,7 +20,9 @@
  */
 
 #include "SequenceModel.h"
+#include "BackgroundFileWriter.h"
 #include "Note.h"
+#include "PatternFileFormat.h"
 #include "PatternModel.h"
 #include "SegmentHandler.h"
 #include "SyncTimer.h"
@@ -32,11 +34,19 @@
 #include <QDirIterator>
 #include <QElapsedTimer>
 #include <QFile>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QPointer>
 #include <QRegularExpression>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 
+#include <memory>
+
 #define PATTERN_COUNT (ZynthboxTrackCount * ZynthboxSlotCount)
 static const QStringList globalSequenceNames{"global", "global2", "global3", "global4", "global5", "global6", "global7", "global8", "global9", "global10"};
 static const QStringList clipNames{"a", "b", "c", "d", "e"};
@@ -181,6 +191,39 @@ public:
     int sceneIndex{-1};
     bool shouldMakeSounds{true};
     bool isLoading{true};
+    // The metadata most recently written to each file, so we can avoid writing it again when nothing has changed
+    QHash<QString, QByteArray> savedMetadata;
+    // The pattern files known to exist on disk in the binary format (either loaded from it, or written by this sequence since it was loaded)
+    QSet<QString> savedPatternFiles;
+    // The pattern files this sequence has made sure do not exist since it was loaded
+    QSet<QString> removedPatternFiles;
+    // Bumped every time the sequence is marked as dirty, so a save can tell whether anything changed while it was being written
+    quint64 dirtyGeneration{0};
+    QTimer *saveThrottle{nullptr};
+    /**
+     * \brief Keeps track of the operations queued up by a single save, and how they went
+     */
+    struct SaveProgress {
+        // Starts out at one, which is released once everything has been queued up
+        int remainingOperations{1};
+        bool success{true};
+    };
+    /**
+     * \brief Called once everything queued up by a save has been performed
+     * @param success Whether every operation was successful
+     * @param savedDirtyGeneration The dirty generation at the time the save was started
+     */
+    void saveCompleted(const bool &success, const quint64 &savedDirtyGeneration) {
+        if (success && savedDirtyGeneration == dirtyGeneration) {
+            q->setIsDirty(false);
+        } else {
+            if (success == false) {
+                qWarning() << Q_FUNC_INFO << "Failed to save the sequence" << q->objectName() << "to" << filePath << "- will try again shortly";
+            }
+            // Either the save failed, or something changed while it was being written, so we'll need another go
+            saveThrottle->start();
+        }
+    }
 
     void ensureFilePath(const QString &explicitFile) {
         if (!explicitFile.isEmpty()) {
@@ -228,17 +271,17 @@ SequenceModel::SequenceModel(PlayGridManager* parent)
     d->syncTimer = SyncTimer::instance();
     d->segmentHandler = SegmentHandler::instance();
     // Save yourself anytime changes, but not too often, and only after a second... Let's be a bit gentle here
-    QTimer *saveThrottle = new QTimer(this);
-    saveThrottle->setSingleShot(true);
-    saveThrottle->setInterval(1000);
-    connect(saveThrottle, &QTimer::timeout, this, [this](){
+    d->saveThrottle = new QTimer(this);
+    d->saveThrottle->setSingleShot(true);
+    d->saveThrottle->setInterval(1000);
+    connect(d->saveThrottle, &QTimer::timeout, this, [this](){
         if (isDirty()) {
             save();
         }
     });
-    connect(this, &SequenceModel::isDirtyChanged, this, [this, saveThrottle](){
+    connect(this, &SequenceModel::isDirtyChanged, this, [this](){
         if (isDirty()) {
-            saveThrottle->start();
+            d->saveThrottle->start();
         }
     });
     connect(this, &SequenceModel::countChanged, this, [this](){
@@ -454,6 +497,9 @@ bool SequenceModel::isDirty() const
 
 void SequenceModel::setIsDirty(bool isDirty)
 {
+    if (isDirty) {
+        ++d->dirtyGeneration;
+    }
     if (d->isDirty != isDirty) {
         d->isDirty = isDirty;
         Q_EMIT isDirtyChanged();
@@ -496,11 +542,67 @@ void SequenceModel::importFrom(const QString& fileName)
     load(fileName, true);
 }
 
+/**
+ * \brief Reads and parses a single pattern file (see SequenceModel::load, which runs these on a pool of worker threads)
+ */
+class PatternFileParser : public QRunnable {
+public:
+    explicit PatternFileParser(const QString &filePath)
+        : filePath(filePath)
+    {
+        setAutoDelete(false);
+    }
+    void run() override {
+        // If there is a binary version of the pattern, that is the authoritative one (and much quicker to load), and the json
+        // file is only used for sketchpads which have not been saved since the binary format was introduced (or if the binary file is broken)
+        const QFileInfo binaryFileInfo{PatternFileFormat::binaryFileName(filePath)};
+        hasBinary = binaryFileInfo.exists();
+        if (hasBinary) {
+            QFile patternFile{binaryFileInfo.absoluteFilePath()};
+            if (patternFile.open(QIODevice::ReadOnly)) {
+                bool ok{false};
+                const QJsonObject patternObject{PatternFileFormat::decode(patternFile.readAll(), &ok)};
+                patternFile.close();
+                if (ok) {
+                    patternJson = QJsonDocument(patternObject);
+                    notesJson = QJsonDocument(patternObject.value("notes").toArray());
+                    loaded = true;
+                    return;
+                }
+            }
+        }
+        QFile patternFile{filePath};
+        if (patternFile.open(QIODevice::ReadOnly)) {
+            patternJson = QJsonDocument::fromJson(patternFile.readAll());
+            patternFile.close();
+            // The pattern's notes are stored as a json string inside the pattern object, so parse that as well while we're here
+            if (patternJson.isObject()) {
+                notesJson = QJsonDocument::fromJson(patternJson.object().value("notes").toString().toUtf8());
+            }
+            loaded = true;
+        }
+    }
+    QString filePath;
+    int trackIndex{0};
+    int clipIndex{0};
+    QString clipName;
+    QJsonDocument patternJson;
+    QJsonDocument notesJson;
+    bool loaded{false};
+    // Whether the binary version of the pattern exists (whether or not it was the one used for loading)
+    bool hasBinary{false};
+};
+
 void SequenceModel::load(const QString &fileName, bool importOnly)
 {
     QElapsedTimer elapsedTimer;
     elapsedTimer.start();
     int loadedPatternCount{0};
+    // Make sure anything we (or anybody else) have saved has actually reached the disk before we read from it
+    BackgroundFileWriter::instance()->waitForDone();
+    d->savedMetadata.clear();
+    d->savedPatternFiles.clear();
+    d->removedPatternFiles.clear();
     d->isLoading = true;
     Q_EMIT isLoadingChanged();
     beginResetModel();
@@ -531,28 +633,49 @@ void SequenceModel::load(const QString &fileName, bool importOnly)
     if (jsonDoc.isObject()) {
         // First, load the patterns from disk
         QDir dir(QString("%1/patterns").arg(pathToLoadFrom.left(pathToLoadFrom.lastIndexOf("/"))));
-        QFileInfoList entries = dir.entryInfoList({"*.pattern.json"}, QDir::Files, QDir::NoSort);
+        // Patterns saved since the binary format was introduced only have the binary file, and older ones only the json file
+        // (and exported ones both), so list both kinds, by the name of the json file (which is what the parser expects)
+        QStringList entries;
+        for (const QFileInfo &entry : dir.entryInfoList({"*.pattern.json", "*.pattern.zbp"}, QDir::Files, QDir::NoSort)) {
+            const QString jsonFilePath{entry.suffix() == QLatin1String{"zbp"} ? PatternFileFormat::jsonFileName(entry.absoluteFilePath()) : entry.absoluteFilePath()};
+            if (entries.contains(jsonFilePath) == false) {
+                entries << jsonFilePath;
+            }
+        }
         QCollator collator;
         collator.setNumericMode(true);
-        std::sort(entries.begin(), entries.end(), [&](const QFileInfo &file1, const QFileInfo &file2){ return collator.compare(file1.absoluteFilePath(), file2.absoluteFilePath()) < 0; });
+        std::sort(entries.begin(), entries.end(), [&](const QString &file1, const QString &file2){ return collator.compare(file1, file2) < 0; });
         // Now we have a list of all the entries in the patterns directory that has the pattern
         // file suffix, sorted naturally (so 10 is at the end, not after 1, which is just silly)
-        int actualIndex{0};
         // The filename for patterns is "part(trackIndex)(partLetter).pattern.json"
         // where trackIndex is a number from 1 through 10, and partName is a single lower-case letter
         QRegularExpression patternFilenameRegexp("part(\\d\\d?)([a-z])");
-        for (const QFileInfo &entry : entries) {
-            // The filename for patterns is "sequencename-(channelIndex)(clipName).pattern.json"
-            const QString absolutePath{entry.absoluteFilePath()};
-            QRegularExpressionMatch match = patternFilenameRegexp.match(entry.fileName());
+        // Reading and parsing the files is the slow part of loading, so do that for all the patterns at once, spread
+        // out across a pool of worker threads, and once that's done, fill in the models here (in order, as before)
+        QList<PatternFileParser*> parsers;
+        QThreadPool parserPool;
+        parserPool.setMaxThreadCount(QThread::idealThreadCount());
+        for (const QString &entry : qAsConst(entries)) {
+            const QString entryFileName{entry.mid(entry.lastIndexOf('/') + 1)};
+            QRegularExpressionMatch match = patternFilenameRegexp.match(entryFileName);
             if (!match.hasMatch()) {
-                qWarning() << Q_FUNC_INFO << "This file is not recognised as a pattern file, skipping (is this an old-style filename? In that case, you can restore it by renaming it to part#n.pattern.json to match the name of the clip it is in):" << entry.fileName();
+                qWarning() << Q_FUNC_INFO << "This file is not recognised as a pattern file, skipping (is this an old-style filename? In that case, you can restore it by renaming it to part#n.pattern.json to match the name of the clip it is in):" << entryFileName;
                 continue;
             }
-            const int trackIndex{match.captured(1).toInt() - 1};
-            const QString clipName{match.captured(2)};
-            const int clipIndex = clipNames.indexOf(clipName);
-//             qDebug() << "Loading pattern track" << trackIndex + 1 << "clip" << clipName << "for sequence" << this << "from file" << absolutePath;
+            PatternFileParser *parser = new PatternFileParser(entry);
+            parser->trackIndex = match.captured(1).toInt() - 1;
+            parser->clipName = match.captured(2);
+            parser->clipIndex = clipNames.indexOf(parser->clipName);
+            parsers << parser;
+            parserPool.start(parser);
+        }
+        parserPool.waitForDone();
+        int actualIndex{0};
+        for (PatternFileParser *parser : qAsConst(parsers)) {
+            const int &trackIndex{parser->trackIndex};
+            const QString &clipName{parser->clipName};
+            const int &clipIndex{parser->clipIndex};
+//             qDebug() << "Loading pattern track" << trackIndex + 1 << "clip" << clipName << "for sequence" << this << "from file" << parser->filePath;
             while (actualIndex < (trackIndex * ZynthboxSlotCount) + clipIndex) {
                 // then we're missing some patterns, which is not great and we should deal with that so we don't end up with holes in the model...
                 const int intermediaryTrackIndex = actualIndex / ZynthboxSlotCount;
@@ -573,19 +696,18 @@ void SequenceModel::load(const QString &fileName, bool importOnly)
             model->setSketchpadTrack(trackIndex);
             model->setClipIndex(clipIndex);
             insertPattern(model);
-            if (entry.exists()) {
-                QFile patternFile{absolutePath};
-                if (patternFile.open(QIODevice::ReadOnly)) {
-                    QString patternData = QString::fromUtf8(patternFile.readAll());
-                    patternFile.close();
-                    playGridManager()->setModelFromJson(model, patternData);
-                }
+            if (parser->loaded) {
+                playGridManager()->setModelFromJsonDocument(model, parser->patternJson, parser->notesJson);
+            }
+            if (parser->hasBinary && importOnly == false) {
+                d->savedPatternFiles.insert(parser->filePath);
             }
             model->endLongOperation();
             ++loadedPatternCount;
 //             qWarning() << "Loaded and added:" << model;
             ++actualIndex;
         }
+        qDeleteAll(parsers);
         // Then set the values on the sequence
         QJsonObject obj = jsonDoc.object();
         setActivePattern(obj.value("activePattern").toInt());
@@ -640,7 +762,7 @@ bool SequenceModel::save(const QString &fileName, bool exportOnly)
 
         QJsonDocument jsonDoc;
         jsonDoc.setObject(sequenceObject);
-        QString data = jsonDoc.toJson();
+        const QByteArray data = jsonDoc.toJson();
 
         QString saveToPath;
         if (exportOnly) {
@@ -649,8 +771,22 @@ bool SequenceModel::save(const QString &fileName, bool exportOnly)
             d->ensureFilePath(fileName);
             saveToPath = d->filePath;
         }
-        QDir sequenceLocation(saveToPath.left(saveToPath.lastIndexOf("/")));
-        QDir patternLocation(saveToPath.left(saveToPath.lastIndexOf("/")) + "/patterns");
+        // The actual writing (and removing) of files happens on a background thread, and only patterns which have
+        // changed since they were last saved get written, so saving doesn't hold up the ui waiting on the disk.
+        // The sequence is only marked as saved once all of that has been done successfully (see saveCompleted())
+        BackgroundFileWriter *writer{BackgroundFileWriter::instance()};
+        std::shared_ptr<Private::SaveProgress> progress{std::make_shared<Private::SaveProgress>()};
+        const quint64 savedDirtyGeneration{d->dirtyGeneration};
+        QPointer<SequenceModel> sequence{this};
+        auto operationCompleted = [this, sequence, progress, savedDirtyGeneration](bool operationSuccess){
+            progress->success = progress->success && operationSuccess;
+            --progress->remainingOperations;
+            if (progress->remainingOperations == 0 && sequence) {
+                d->saveCompleted(progress->success, savedDirtyGeneration);
+            }
+        };
+        const QString sequenceLocation{saveToPath.left(saveToPath.lastIndexOf("/"))};
+        const QString patternLocation{sequenceLocation + "/patterns"};
         bool hasAnyPattern{false};
         for (int i = 0; i < PATTERN_COUNT; ++i) {
             PatternModel *pattern = d->patternModelIterator[i];
@@ -660,39 +796,83 @@ bool SequenceModel::save(const QString &fileName, bool exportOnly)
                 }
             }
         }
-        if (sequenceLocation.exists() || (hasAnyPattern && sequenceLocation.mkpath(sequenceLocation.path()))) {
-            QFile dataFile(saveToPath);
-            if (dataFile.open(QIODevice::WriteOnly) && dataFile.write(data.toUtf8())) {
-                dataFile.close();
-                if (patternLocation.exists() || patternLocation.mkpath(patternLocation.path())) {
-                    // The filename for patterns is "part(trackIndex)(clipLetter).pattern.json"
-                    for (int i = 0; i < PATTERN_COUNT; ++i) {
-                        PatternModel *pattern = d->patternModelIterator[i];
-                        if (pattern) {
-                            QString patternIdentifier = QString::number(i + 1);
-                            if (pattern->sketchpadTrack() > -1 && pattern->clipIndex() > -1) {
-                                patternIdentifier = QString("%1%2").arg(QString::number(pattern->sketchpadTrack() + 1)).arg(clipNames[pattern->clipIndex()]);
-                            }
-                            QString fileName = QString("%1/part%2.pattern.json").arg(patternLocation.path()).arg(patternIdentifier);
-                            QFile patternFile(fileName);
-                            if (pattern->hasContent()) {
-                                pattern->exportToFile(fileName);
-                            } else if (patternFile.exists()) {
-                                qDebug() << Q_FUNC_INFO << "Pattern" << patternIdentifier << "in sequence" << objectName() << "has no notes, but the file exists, so delete it";
-                                patternFile.remove();
+        if (hasAnyPattern) {
+            // Only write the metadata if it has actually changed since we last wrote it
+            if (d->savedMetadata.value(saveToPath) != data) {
+                ++progress->remainingOperations;
+                writer->write(saveToPath, data, this, [this, saveToPath, data, operationCompleted](bool writeSuccess){
+                    if (writeSuccess) {
+                        d->savedMetadata[saveToPath] = data;
+                    }
+                    operationCompleted(writeSuccess);
+                });
+            }
+            // The filename for patterns is "part(trackIndex)(clipLetter).pattern.json"
+            for (int i = 0; i < PATTERN_COUNT; ++i) {
+                PatternModel *pattern = d->patternModelIterator[i];
+                if (pattern) {
+                    QString patternIdentifier = QString::number(i + 1);
+                    if (pattern->sketchpadTrack() > -1 && pattern->clipIndex() > -1) {
+                        patternIdentifier = QString("%1%2").arg(QString::number(pattern->sketchpadTrack() + 1)).arg(clipNames[pattern->clipIndex()]);
+                    }
+                    const QString fileName = QString("%1/part%2.pattern.json").arg(patternLocation).arg(patternIdentifier);
+                    if (pattern->hasContent()) {
+                        ++progress->remainingOperations;
+                        // The binary file is the authoritative one, so the legacy json file is only written when exporting. When saving,
+                        // any json file left over from before the pattern was saved in the binary format is removed once the binary
+                        // file has been written, so there is never a stale json file lying around for anything else to pick up.
+                        const bool queued = pattern->exportToFileInBackground(fileName, exportOnly, [this, sequence, exportOnly, writer, fileName, operationCompleted](bool writeSuccess){
+                            if (writeSuccess && sequence) {
+                                d->savedPatternFiles.insert(fileName);
+                                d->removedPatternFiles.remove(fileName);
+                                if (exportOnly == false) {
+                                    writer->remove(fileName);
+                                }
                             }
+                            operationCompleted(writeSuccess);
+                        });
+                        if (queued == false) {
+                            // Nothing had changed, so there was nothing to write
+                            --progress->remainingOperations;
                         }
-                    }
-                    if (hasAnyPattern == false) {
-                        // If we've not got any patterns, get rid of the container folder again, keep things nice and lean and clean
-                        qDebug() << Q_FUNC_INFO << "No patterns in sequence" << objectName() << "have notes, get rid of the sequences folder" << sequenceLocation.path();
-                        sequenceLocation.removeRecursively();
+                    } else if (d->savedPatternFiles.contains(fileName) || d->removedPatternFiles.contains(fileName) == false) {
+                        // Whether the files actually exist is checked as part of the removal, on the writer's thread
+                        progress->remainingOperations += 2;
+                        auto removeCompleted = [this, fileName, operationCompleted](bool removeSuccess){
+                            if (removeSuccess) {
+                                d->savedPatternFiles.remove(fileName);
+                                d->removedPatternFiles.insert(fileName);
+                            }
+                            operationCompleted(removeSuccess);
+                        };
+                        writer->remove(fileName, this, removeCompleted);
+                        writer->remove(PatternFileFormat::binaryFileName(fileName), this, removeCompleted);
                     }
                 }
-                success = true;
             }
+        } else if (!d->savedMetadata.isEmpty() || QDir(sequenceLocation).exists()) {
+            // If we've not got any patterns, get rid of the container folder again, keep things nice and lean and clean
+            qDebug() << Q_FUNC_INFO << "No patterns in sequence" << objectName() << "have notes, get rid of the sequences folder" << sequenceLocation;
+            ++progress->remainingOperations;
+            writer->removeFolder(sequenceLocation, this, [this, saveToPath, operationCompleted](bool removeSuccess){
+                if (removeSuccess) {
+                    d->savedMetadata.remove(saveToPath);
+                    d->savedPatternFiles.clear();
+                }
+                operationCompleted(removeSuccess);
+            });
+        }
+        // Everything has been queued up, so release the hold on the save being completed
+        operationCompleted(true);
+        if (exportOnly) {
+            // When exporting, whoever asked for it will expect the files to be there once we return (and waiting here
+            // also means that all of the completions have been called, so we know how it went)
+            writer->waitForDone();
+            success = progress->success && progress->remainingOperations == 0;
+        } else {
+            // The outcome of the save will be known once the writer is done (see saveCompleted())
+            success = true;
         }
-        setIsDirty(false);
     }
     return success;
 }
@@ -238,7 +238,9 @@ public:
      * @note Any file in the location WILL be overwritten if it already exists
      * @param fileName An optional filename to be used to perform the operation in place of the automatically chosen one (pass the metadata.sequence.json location)
      * @param exportOnly If set to true, this will make this function only export the information, and not actually touch the internal state of the sequence
-     * @return True if successful, false if not
+     * @note The files are written in the background, and the sequence is only marked as no longer dirty once they have all been
+     * written successfully (if that fails, or the sequence changes in the meantime, it will be saved again shortly after)
+     * @return When exporting, true if all files were written successfully, otherwise false. When saving, true if the save was started
      */
     Q_INVOKABLE bool save(const QString &fileName = QString(), bool exportOnly = false);
 
@@ -0,0 +1,172 @@
+/*
+  ==============================================================================
+
+    StereoBiquadCascade.h
+    Created: 16 Oct 2026
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <utility>
+
+/**
+ * \brief A chain of biquad filters, which processes the left and right channels of a stereo signal together
+ *
+ * This is what the equalisers run on (see JackPassthroughFilter for where the coefficients come from). Rather than running
+ * each band over each channel in turn (which for six bands and two channels means twelve passes over the audio), each frame
+ * goes through all of the bands in one go, with the left and right samples held side by side in a single vector register,
+ * and all of the filter state kept in registers for the whole block.
+ *
+ * The set of bands which are enabled picks a version of the processing function in which the disabled bands have been
+ * compiled out entirely, so there is no per-sample cost to a band being bypassed.
+ *
+ * The bands are transposed direct form II biquads, with their coefficients normalised (that is, a0 is 1, and the coefficients
+ * are stored as b0, b1, b2, a1, a2). First order filters are simply biquads with b2 and a2 set to zero.
+ */
+class StereoBiquadCascade {
+public:
+    static constexpr int BandCount{6};
+
+    StereoBiquadCascade() {}
+    ~StereoBiquadCascade() {}
+
+    /**
+     * \brief Set whether the given band should be applied (a disabled band lets audio through untouched)
+     * This is safe to call from any thread, and will take effect on the next call to process()
+     * @param band The index of the band (0 through BandCount - 1)
+     * @param enabled Whether or not the band should be applied
+     */
+    void setBandEnabled(const int &band, const bool &enabled) {
+        bands[band].enabled.store(enabled, std::memory_order_relaxed);
+    }
+    /**
+     * \brief The coefficients for the given band (b0, b1, b2, a1, a2)
+     * These are read at the start of each call to process(), so only change them on the thread which calls that
+     * @param band The index of the band (0 through BandCount - 1)
+     */
+    float *coefficients(const int &band) {
+        return bands[band].coefficients;
+    }
+
+    /**
+     * \brief Clear the filter state of all bands, as though they had only ever been fed silence
+     * Call this on the thread which calls process()
+     */
+    void reset() {
+        for (Band &band : bands) {
+            band.z1 = StereoSample{0, 0};
+            band.z2 = StereoSample{0, 0};
+        }
+    }
+
+    /**
+     * \brief Run the enabled bands over the given audio, in place
+     * @param left The left channel's audio
+     * @param right The right channel's audio
+     * @param nframes The number of frames in each channel
+     */
+    void process(float *left, float *right, const int &nframes) {
+        int enabledBands{0};
+        for (int band = 0; band < BandCount; ++band) {
+            Band &theBand = bands[band];
+            const bool enabled{theBand.enabled.load(std::memory_order_relaxed)};
+            if (enabled) {
+                if (theBand.wasEnabled == false) {
+                    // Don't let whatever was left over from the last time the band was in use leak back out
+                    theBand.z1 = StereoSample{0, 0};
+                    theBand.z2 = StereoSample{0, 0};
+                }
+                enabledBands |= (1 << band);
+            }
+            theBand.wasEnabled = enabled;
+        }
+        if (enabledBands != 0) {
+            kernels[enabledBands](bands, left, right, nframes);
+        }
+    }
+private:
+    // Two floats side by side in one register (with gcc and clang, this is a neon register on arm, and an sse one on x86)
+    typedef float StereoSample __attribute__((vector_size(2 * sizeof(float))));
+    struct Band {
+        float coefficients[5]{1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        StereoSample z1{0, 0};
+        StereoSample z2{0, 0};
+        std::atomic<bool> enabled{true};
+        bool wasEnabled{true};
+    };
+    // The working copy of a band used while processing a block
+    struct BandState {
+        StereoSample b0, b1, b2, a1, a2, z1, z2;
+    };
+    Band bands[BandCount];
+
+    template<int EnabledBands, int BandIndex>
+    static inline void loadBand(Band *bands, BandState *states) {
+        if constexpr ((EnabledBands & (1 << BandIndex)) != 0) {
+            const float *coefficients{bands[BandIndex].coefficients};
+            BandState &state = states[BandIndex];
+            state.b0 = StereoSample{coefficients[0], coefficients[0]};
+            state.b1 = StereoSample{coefficients[1], coefficients[1]};
+            state.b2 = StereoSample{coefficients[2], coefficients[2]};
+            state.a1 = StereoSample{coefficients[3], coefficients[3]};
+            state.a2 = StereoSample{coefficients[4], coefficients[4]};
+            state.z1 = bands[BandIndex].z1;
+            state.z2 = bands[BandIndex].z2;
+        }
+    }
+    template<int EnabledBands, int BandIndex>
+    static inline void storeBand(Band *bands, const BandState *states) {
+        if constexpr ((EnabledBands & (1 << BandIndex)) != 0) {
+            bands[BandIndex].z1 = snapToZero(states[BandIndex].z1);
+            bands[BandIndex].z2 = snapToZero(states[BandIndex].z2);
+        }
+    }
+    // Like juce's filters, flush very small state values to zero at the end of each block, so silence doesn't decay into denormals
+    static inline StereoSample snapToZero(StereoSample value) {
+        for (int lane = 0; lane < 2; ++lane) {
+            if (-1.0e-8f < value[lane] && value[lane] < 1.0e-8f) {
+                value[lane] = 0;
+            }
+        }
+        return value;
+    }
+    template<int EnabledBands, int BandIndex>
+    static inline void processBand(StereoSample &sample, BandState *states) {
+        if constexpr ((EnabledBands & (1 << BandIndex)) != 0) {
+            BandState &state = states[BandIndex];
+            const StereoSample output{state.b0 * sample + state.z1};
+            state.z1 = state.b1 * sample - state.a1 * output + state.z2;
+            state.z2 = state.b2 * sample - state.a2 * output;
+            sample = output;
+        }
+    }
+    template<int EnabledBands, std::size_t... BandIndices>
+    static void processBlock(Band *bands, float *left, float *right, const int nframes, std::index_sequence<BandIndices...>) {
+        BandState states[BandCount];
+        (loadBand<EnabledBands, int(BandIndices)>(bands, states), ...);
+        for (int frame = 0; frame < nframes; ++frame) {
+            StereoSample sample{left[frame], right[frame]};
+            (processBand<EnabledBands, int(BandIndices)>(sample, states), ...);
+            left[frame] = sample[0];
+            right[frame] = sample[1];
+        }
+        (storeBand<EnabledBands, int(BandIndices)>(bands, states), ...);
+    }
+    template<int EnabledBands>
+    static void processKernel(Band *bands, float *left, float *right, const int nframes) {
+        processBlock<EnabledBands>(bands, left, right, nframes, std::make_index_sequence<BandCount>{});
+    }
+    typedef void (*Kernel)(Band*, float*, float*, const int);
+    template<std::size_t... EnabledBandSets>
+    static constexpr std::array<Kernel, sizeof...(EnabledBandSets)> makeKernels(std::index_sequence<EnabledBandSets...>) {
+        return {{&processKernel<int(EnabledBandSets)>...}};
+    }
+    // One processing function for each possible combination of enabled bands
+    static const std::array<Kernel, (1 << BandCount)> kernels;
+};
+
+inline const std::array<StereoBiquadCascade::Kernel, (1 << StereoBiquadCascade::BandCount)> StereoBiquadCascade::kernels{StereoBiquadCascade::makeKernels(std::make_index_sequence<(1 << StereoBiquadCascade::BandCount)>{})};
@@ -1,5 +1,7 @@
+#include <cerrno>
 #include <sched.h>
 #include <sys/mman.h>
+#include <time.h>
 
 #include "SyncTimer.h"
 #include "ZynthboxBasics.h"
@@ -12,11 +14,13 @@
 #include "TimerCommand.h"
 #include "TransportManager.h"
 #include "JackThreadAffinitySetter.h"
+#include "LockFreeRing.h"
 #include "AudioLevels.h"
 #include "MidiRecorder.h"
 #include "SegmentHandler.h"
 #include "PlayGridManager.h"
 #include "PlayfieldManager.h"
+#include "ProcessTiming.h"
 #include "SequenceModel.h"
 
 #include <QDebug>
@@ -27,6 +31,9 @@
 #include <QTimer>
 #include <QWaitCondition>
 
+#include <algorithm>
+#include <atomic>
+
 #include <jack/jack.h>
 #include <jack/statistics.h>
 #include <jack/midiport.h>
@@ -48,38 +55,54 @@
 using namespace std;
 using namespace juce;
 
-struct alignas(64) StepData {
-    enum BufferType {
-        SequencerBuffer = 0, // Referring to trackBuffer (our logical sequencer)
-        ControllerBuffer = 1, // Referring to trackBufferController (our logical controller)
-    };
-    StepData() { }
-    ~StepData() {
+struct StepData;
+/**
+ * \brief The things scheduled on a single step
+ *
+ * Most steps in the ring have nothing scheduled on them, so rather than every step carrying its own set of buffers,
+ * a step is only given one of these (from a preallocated pool in SyncTimerPrivate) when something is scheduled onto it,
+ * and it is handed back to the pool once the step has been played (see SyncTimerPrivate::recycleStepContents)
+ */
+struct alignas(64) StepContent {
+    StepContent() { }
+    ~StepContent() {
         qDeleteAll(timerCommands);
         qDeleteAll(clipCommands);
     }
-    // Call this before accessing the data to ensure that it is fresh
-    void ensureFresh() {
-        if (played) {
-            played = false;
-            // It's our job to delete the timer commands, so do that first
-            for (TimerCommand* command : timerCommands) {
-                delete command;
-            }
-            // The clip commands, once sent out, become owned by SamplerSynth, so leave them alone
-            timerCommands.clear();
-            clipCommands.clear();
-            for (int track = 0; track < ZynthboxTrackCount + 1; ++track) {
-                trackBufferSequencer[track].clear();
-                trackBufferController[track].clear();
-            }
+    // Clear out the content, ready to be used for another step
+    void clear() {
+        // It's our job to delete the timer commands, so do that first
+        for (TimerCommand* command : timerCommands) {
+            delete command;
+        }
+        // The clip commands, once sent out, become owned by SamplerSynth, so leave them alone
+        timerCommands.clear();
+        clipCommands.clear();
+        for (int track = 0; track < ZynthboxTrackCount + 1; ++track) {
+            trackBufferSequencer[track].clear();
+            trackBufferController[track].clear();
         }
     }
-    void insertMidiBuffer(const juce::MidiBuffer &buffer, int sketchpadTrack, StepData::BufferType bufferType);
     juce::MidiBuffer trackBufferSequencer[ZynthboxTrackCount + 1]; // The logical "sequencer" buffer for the given track - for events that are scheduled as part of a sequence (will be ignored for recording purposes)
     juce::MidiBuffer trackBufferController[ZynthboxTrackCount + 1]; // The logical "controller" for the given track - for events to be sent out as soon as possible
     QList<ClipCommand*> clipCommands;
     QList<TimerCommand*> timerCommands;
+    // The step this content was most recently given to
+    StepData *step{nullptr};
+};
+
+struct StepData {
+    enum BufferType {
+        SequencerBuffer = 0, // Referring to trackBuffer (our logical sequencer)
+        ControllerBuffer = 1, // Referring to trackBufferController (our logical controller)
+    };
+    StepData() { }
+    ~StepData() { }
+    // Call this before accessing the data to ensure that it is fresh (this also ensures the step has content)
+    void ensureFresh();
+    void insertMidiBuffer(const juce::MidiBuffer &buffer, int sketchpadTrack, StepData::BufferType bufferType);
+    // Only set for steps which have had something scheduled on them, and which have not yet been played
+    std::atomic<StepContent*> content{nullptr};
 
     StepData *previous{nullptr};
     StepData *next{nullptr};
@@ -89,7 +112,7 @@ struct alignas(64) StepData {
     // SyncTimer sets this true to mark that it has played the step
     // Conceptually, a step starts out having been played (meaning it is not interesting to the process call),
     // and it is set to false by ensureFresh above, which is called any time just before adding anything to a step.
-    bool played{true};
+    std::atomic<bool> played{true};
 
     SyncTimerPrivate *d{nullptr};
 };
@@ -131,23 +154,43 @@ public:
         : QThread(q)
     {}
 
+    /**
+     * \brief Sleep until the given deadline, without spinning
+     *
+     * This sleeps on an absolute deadline (so time spent doing the work for each tick does not accumulate as drift),
+     * and wakes up a little before it to compensate for the scheduler's wakeup latency, which is measured as we go.
+     * How far off the deadline we actually wake up is recorded in the jitter statistics.
+     * @param till The time at which we want to be woken up
+     */
     void waitTill(frame_clock::time_point till) {
-        //spinTimeMs is used to adjust for scheduler inaccuracies. default is 2.1 milliseconds. anything lower makes fps jump around
-        auto waitTime = std::chrono::duration_cast<std::chrono::microseconds>(till - frame_clock::now() - spinTime);
-        if (waitTime.count() > 0) { //only sleep if waitTime is positive
-            usleep((long unsigned int)waitTime.count());
-        } else {
-            // overrun situation this is bad, we should tell someone!
-            // qWarning() << "The playback synchronisation timer had a falling out with reality and ended up asked to wait for a time in the past. This is not awesome, so now we make it even slower by outputting this message complaining about it.";
+        const qint64 compensation{wakeupCompensation.load(std::memory_order_relaxed)};
+        const frame_clock::time_point wakeTarget{till - frame_clock::duration(compensation)};
+        const qint64 wakeTargetNanoseconds{std::chrono::duration_cast<std::chrono::nanoseconds>(wakeTarget.time_since_epoch()).count()};
+        struct timespec wakeTargetSpec;
+        wakeTargetSpec.tv_sec = time_t(wakeTargetNanoseconds / NanosecondsPerSecond);
+        wakeTargetSpec.tv_nsec = long(wakeTargetNanoseconds % NanosecondsPerSecond);
+        // clock_nanosleep returns EINTR if interrupted by a signal, in which case we simply go back to sleep
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeTargetSpec, nullptr) == EINTR) {}
+        const frame_clock::time_point woke{frame_clock::now()};
+        // Follow the scheduler's wakeup latency with a slow moving average, and keep waking up that much early
+        // (bounded, so a single long stall doesn't make us start waking up far too early for a long while after)
+        const qint64 wakeupLatency{qint64(std::chrono::duration_cast<std::chrono::nanoseconds>(woke - wakeTarget).count())};
+        wakeupCompensation.store(std::clamp(compensation + ((wakeupLatency - compensation) / 16), qint64(0), maximumWakeupCompensation), std::memory_order_relaxed);
+        const qint64 jitter{qint64(std::chrono::duration_cast<std::chrono::nanoseconds>(woke - till).count())};
+        jitterStatistics.ticks.fetch_add(1, std::memory_order_relaxed);
+        jitterStatistics.totalAbsoluteJitter.fetch_add(quint64(std::abs(jitter)), std::memory_order_relaxed);
+        if (jitterStatistics.worstLateness.load(std::memory_order_relaxed) < jitter) {
+            jitterStatistics.worstLateness.store(jitter, std::memory_order_relaxed);
         }
-        while (till > frame_clock::now()) {
-            //spin till actual timepoint
+        if (jitterStatistics.worstEarliness.load(std::memory_order_relaxed) < -jitter) {
+            jitterStatistics.worstEarliness.store(-jitter, std::memory_order_relaxed);
         }
     }
 
     void run() override {
         TransportManager *transportManager{TransportManager::instance()};
         startTime = frame_clock::now();
+        nextTick = startTime;
         pthread_t threadId = from_HANDLE<pthread_t>(currentThreadId());
         zl_set_dsp_thread_affinity(threadId);
         std::chrono::time_point< std::chrono::_V2::steady_clock, std::chrono::duration< long long unsigned int, std::ratio< 1, NanosecondsPerSecond > > > nextMinute;
@@ -177,6 +220,7 @@ public:
                     minuteCount = 0;
                     startTime = frame_clock::now();
                     nextMinute = startTime + nanosecondsPerMinute;
+                    nextTick = startTime;
                 }
                 mutex.unlock();
                 if (aborted) {
@@ -186,11 +230,25 @@ public:
                 ++count;
                 ++cumulativeCount;
                 const double externalBpm{transportManager->bpm()};
-                waitTill(frame_clock::now() + frame_clock::duration(subbeatCountToNanoseconds(externalBpm > -1 ? externalBpm : bpm, 1)));
+                const frame_clock::duration tickInterval(subbeatCountToNanoseconds(externalBpm > -1 ? externalBpm : bpm, 1));
+                nextTick += tickInterval;
+                const frame_clock::time_point now{frame_clock::now()};
+                if (nextTick + tickInterval <= now) {
+                    // If we've fallen an entire tick or more behind (which will happen if the thread was held up for some reason),
+                    // there's no sense in trying to catch up by firing a bunch of ticks back to back, so count the ticks we missed and
+                    // skip past them. Skipping by whole ticks keeps us on the same timeline, so the next tick goes out right away,
+                    // and the ones after it go out when they would have done had we not been held up.
+                    const qint64 missedTicks{(now - nextTick) / tickInterval};
+                    jitterStatistics.missedDeadlines.fetch_add(quint64(missedTicks), std::memory_order_relaxed);
+                    nextTick += tickInterval * missedTicks;
+                }
+                // If we're less than a tick late, the wait returns immediately, and the tick goes out as soon as it can
+                waitTill(nextTick);
             }
 #ifdef DEBUG_SYNCTIMER_TIMING
             qDebug() << "Sync timer reached minute:" << minuteCount << "with interval" << interval.count();
             qDebug() << "The most recent pseudo-minute took an extra" << (frame_clock::now() - nextMinute).count() << "nanoseconds";
+            qDebug() << "Timer wakeup jitter since the last report:" << takeJitterStatistics();
 #endif
             count = 0; // Reset the count each minute
             ++minuteCount;
@@ -268,6 +326,29 @@ public:
     const std::chrono::nanoseconds getInterval() {
         return interval;
     }
+    /**
+     * \brief Statistics for how far off its deadlines the timer thread has been woken up
+     * All values are in nanoseconds, and are gathered since the last time they were fetched
+     */
+    struct JitterStatistics {
+        std::atomic<quint64> ticks{0};
+        std::atomic<quint64> totalAbsoluteJitter{0};
+        std::atomic<qint64> worstLateness{0};
+        std::atomic<qint64> worstEarliness{0};
+        std::atomic<quint64> missedDeadlines{0};
+    };
+    QVariantMap takeJitterStatistics() {
+        QVariantMap statistics;
+        const quint64 ticks{jitterStatistics.ticks.exchange(0, std::memory_order_relaxed)};
+        const quint64 totalAbsoluteJitter{jitterStatistics.totalAbsoluteJitter.exchange(0, std::memory_order_relaxed)};
+        statistics[QLatin1String("ticks")] = ticks;
+        statistics[QLatin1String("averageJitterMicroseconds")] = ticks > 0 ? double(totalAbsoluteJitter) / double(ticks * 1000) : 0.0;
+        statistics[QLatin1String("worstLatenessMicroseconds")] = double(jitterStatistics.worstLateness.exchange(0, std::memory_order_relaxed)) / 1000.0;
+        statistics[QLatin1String("worstEarlinessMicroseconds")] = double(jitterStatistics.worstEarliness.exchange(0, std::memory_order_relaxed)) / 1000.0;
+        statistics[QLatin1String("missedDeadlines")] = jitterStatistics.missedDeadlines.exchange(0, std::memory_order_relaxed);
+        statistics[QLatin1String("wakeupCompensationMicroseconds")] = double(wakeupCompensation.load(std::memory_order_relaxed)) / 1000.0;
+        return statistics;
+    }
     /**
      * \brief This is a workaround for firing a signal in a queued fashion (this could be anywhere, just as long as it's not public)
      */
@@ -288,8 +369,12 @@ private:
     QMutex mutex;
     QWaitCondition waitCondition;
 
-    // This is equivalent to .1 ms
-    const frame_clock::duration spinTime{frame_clock::duration(100000)};
+    frame_clock::time_point nextTick;
+    // How early (in nanoseconds) we ask to be woken up, to make up for the scheduler's wakeup latency
+    std::atomic<qint64> wakeupCompensation{0};
+    // This is equivalent to .5 ms
+    const qint64 maximumWakeupCompensation{500000};
+    JitterStatistics jitterStatistics;
     const std::chrono::nanoseconds nanosecondsPerMinute{NanosecondsPerMinute};
 
     bool aborted{false};
@@ -337,6 +422,75 @@ public:
 };
 
 #define StepRingCount 32768
+// The number of step contents allocated up front (and locked into memory), which is the number of steps which can have
+// something scheduled on them at the same time before we have to start allocating more
+#define StepContentPoolSize 4096
+// The most step contents we will allow to exist (if we need more than this, something has gone very wrong)
+#define StepContentMaxCount 16384
+/**
+ * \brief A fixed size, lock-free queue which any number of threads can push to and pop from
+ *
+ * Used to pass StepContent instances between the threads which schedule things, the jack process call, and the timer thread
+ */
+typedef LockFreeRing<StepContent*, StepContentMaxCount, LockFreeRingWriters::MultipleWriters, LockFreeRingReaders::MultipleReaders> StepContentQueue;
+
+/**
+ * \brief An entry in one of the command pools (see SyncTimer::getClipCommand() and SyncTimer::getTimerCommand())
+ */
+template<typename Command>
+struct CommandPoolEntry {
+    Command *command{nullptr};
+    // For handed back commands, the wall clock time after which the command is no longer in use, and can be reused
+    quint64 timestamp{0};
+};
+/**
+ * \brief A pool of commands, which any number of threads can take commands from and hand commands back to at the same time
+ */
+template<typename Command, std::size_t Capacity>
+using CommandPool = LockFreeRing<CommandPoolEntry<Command>, Capacity, LockFreeRingWriters::MultipleWriters, LockFreeRingReaders::MultipleReaders>;
+
+// The most tick callbacks which can be registered at the same time
+#define TickCallbackMaxCount 16
+// The number of ticks which can be waiting to be delivered through the timerTick signal
+#define DispatchedTicksRingSize 4096
+/**
+ * \brief A registered tick callback, along with measurements of how long calling it has been taking
+ */
+struct TickCallbackEntry {
+    const char *name{nullptr};
+    SyncTimer::TickCallback callback{nullptr};
+    void *data{nullptr};
+    quint64 budgetNanoseconds{0};
+    std::atomic<quint64> calls{0};
+    std::atomic<quint64> nanoseconds{0};
+    std::atomic<quint64> worstNanoseconds{0};
+    std::atomic<quint64> overBudgetCalls{0};
+    void set(const char *newName, SyncTimer::TickCallback newCallback, void *newData, const quint64 &newBudgetNanoseconds) {
+        name = newName;
+        callback = newCallback;
+        data = newData;
+        budgetNanoseconds = newBudgetNanoseconds;
+        calls = 0;
+        nanoseconds = 0;
+        worstNanoseconds = 0;
+        overBudgetCalls = 0;
+    }
+    void addMeasurement(const quint64 &measuredNanoseconds) {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        nanoseconds.fetch_add(measuredNanoseconds, std::memory_order_relaxed);
+        if (worstNanoseconds.load(std::memory_order_relaxed) < measuredNanoseconds) {
+            worstNanoseconds.store(measuredNanoseconds, std::memory_order_relaxed);
+        }
+        if (measuredNanoseconds > budgetNanoseconds) {
+            const quint64 overBudget{overBudgetCalls.fetch_add(1, std::memory_order_relaxed) + 1};
+            // Only complain on the first, and then every thousandth, overrun, so we don't end up flooding the output
+            if (overBudget % 1000 == 1) {
+                qWarning() << Q_FUNC_INFO << "The tick callback" << name << "took" << measuredNanoseconds << "ns, which is more than its budget of" << budgetNanoseconds << "ns (this has happened" << overBudget << "times)";
+            }
+        }
+    }
+};
+
 SyncTimerThread *timerThread{nullptr};
 class SyncTimerPrivate {
 public:
@@ -358,6 +512,16 @@ public:
         if (result != 0) {
             qDebug() << Q_FUNC_INFO << "Error locking step ring memory" << strerror(result);
         }
+        stepContentPool = new StepContent[StepContentPoolSize];
+        result = mlock(stepContentPool, sizeof(StepContent) * StepContentPoolSize);
+        if (result != 0) {
+            qDebug() << Q_FUNC_INFO << "Error locking step content pool memory" << strerror(result);
+        }
+        for (int i = 0; i < StepContentPoolSize; ++i) {
+            allStepContents[i] = &stepContentPool[i];
+            freshStepContents.write(&stepContentPool[i]);
+        }
+        stepContentCount = StepContentPoolSize;
         StepData* previous{&stepRing[StepRingCount - 1]};
         for (quint64 i = 0; i < StepRingCount; ++i) {
             jackPlayheadForTimerTick[i] = UINT64_MAX;
@@ -371,15 +535,28 @@ public:
         stepReadHead = stepRing;
 
         for (int i = 0; i < ClipCommandRingSize; ++i) {
-            freshClipCommands.write(new ClipCommand, 0);
+            ClipCommand *command = new ClipCommand;
+            if (freshClipCommands.write({command, 0}) == false) {
+                delete command;
+            }
         }
         for (int i = 0; i < TimerCommandRingSize; ++i) {
-            freshTimerCommands.write(new TimerCommand, 0);
+            TimerCommand *command = new TimerCommand;
+            if (freshTimerCommands.write({command, 0}) == false) {
+                delete command;
+            }
         }
 
         samplerSynth = SamplerSynth::instance();
         // Dangerzone - direct connection from another thread. Yes, dangerous, but also we need the precision, so we need to dill whit it
-        QObject::connect(timerThread, &SyncTimerThread::timeout, q, [this](){ hiResTimerCallback(); }, Qt::DirectConnection);
+        QObject::connect(timerThread, &SyncTimerThread::timeout, q, [this](){
+            // While freewheeling, the jack process callback takes over scheduling (see process()), and if that is
+            // still finishing off its last round right as freewheeling ends, this round will be picked up by the next one
+            if (freewheeling == false && tryAcquireSchedule()) {
+                hiResTimerCallback();
+                releaseSchedule();
+            }
+        }, Qt::DirectConnection);
         QObject::connect(timerThread, &QThread::started, q, [q](){ Q_EMIT q->timerRunningChanged(); });
         QObject::connect(timerThread, &QThread::finished, q, [q](){ Q_EMIT q->timerRunningChanged(); });
         QObject::connect(timerThread, &SyncTimerThread::pausedChanged, q, [q](){ q->timerRunningChanged(); });
@@ -392,6 +569,10 @@ public:
         if (jackClient) {
             jack_client_close(jackClient);
         }
+        for (int i = StepContentPoolSize; i < stepContentCount; ++i) {
+            delete allStepContents[i];
+        }
+        delete[] stepContentPool;
     }
     SyncTimer *q{nullptr};
     SamplerSynth *samplerSynth{nullptr};
@@ -410,6 +591,69 @@ public:
     StepData stepRing[StepRingCount];
     // The next step to be read in the step ring
     StepData* stepReadHead{nullptr};
+
+    StepContent *stepContentPool{nullptr};
+    // Every step content in existence (the pool, followed by any we have had to allocate since)
+    StepContent *allStepContents[StepContentMaxCount];
+    std::atomic<int> stepContentCount{0};
+    // Step contents ready to be given to a step
+    StepContentQueue freshStepContents{"SyncTimer fresh step contents"};
+    // Step contents which have been taken off their step, and which need clearing before they can be used again
+    StepContentQueue retiredStepContents{"SyncTimer retired step contents"};
+    // The step currently being played by the process call (its content must not be cleared until it is done)
+    std::atomic<StepData*> playingStep{nullptr};
+    // Used by stop() to play the outstanding steps in order, without having to go through the entire ring
+    StepContent *outstandingStepContents[StepContentMaxCount];
+    /**
+     * \brief Get a fresh step content
+     * This will usually be from the preallocated pool, but if that has run out, we will recycle what we can, and allocate if we have to
+     */
+    StepContent *claimStepContent() {
+        StepContent *content{nullptr};
+        if (freshStepContents.read(content) == false) {
+            recycleStepContents();
+            if (freshStepContents.read(content) == false) {
+                qWarning() << Q_FUNC_INFO << "Ran out of step contents, allocating another one (there are now" << stepContentCount + 1 << "step contents). This should not happen in normal use, and is likely a sign that something is scheduling a very great deal of things.";
+                content = new StepContent;
+                const int contentIndex{stepContentCount.fetch_add(1)};
+                if (contentIndex < StepContentMaxCount) {
+                    allStepContents[contentIndex] = content;
+                } else {
+                    stepContentCount.fetch_sub(1);
+                    qCritical() << Q_FUNC_INFO << "We have allocated" << StepContentMaxCount << "step contents, and will not be able to keep track of any more. The step this is used for will not be handled when stopping playback.";
+                }
+            }
+        }
+        return content;
+    }
+    /**
+     * \brief Hand a step content which has been taken off its step to the timer thread for clearing and recycling
+     */
+    void retireStepContent(StepContent *content) {
+        if (retiredStepContents.write(content) == false) {
+            qWarning() << Q_FUNC_INFO << "The retired step contents queue is full, which should not be possible. This step content will not be reused.";
+        }
+    }
+    /**
+     * \brief Clear out the retired step contents and make them available for use again
+     * This is called by the timer thread (and when we run out of fresh ones), and never by the process call
+     */
+    void recycleStepContents() {
+        StepContent *content{nullptr};
+        int handled{0};
+        // Only handle as many as are in the queue right now, so we don't end up going round in circles if we need to put one back
+        const int handleLimit{stepContentCount.load()};
+        while (handled < handleLimit && retiredStepContents.read(content)) {
+            ++handled;
+            if (content->step == playingStep.load()) {
+                // This one is still being played, so put it back and leave it for next time
+                retiredStepContents.write(content);
+            } else {
+                content->clear();
+                freshStepContents.write(content);
+            }
+        }
+    }
     quint64 stepNextPlaybackPosition{0};
     quint64 stepNextPlaybackPositionFrames{0};
     /**
@@ -447,10 +691,29 @@ public:
                 : std::clamp(sketchpadTrack, 0, ZynthboxTrackCount - 1);
     }
 
-    TimerCommandRing timerCommandsToDelete;
-    TimerCommandRing freshTimerCommands;
-    ClipCommandRing clipCommandsToDelete;
-    ClipCommandRing freshClipCommands;
+    // The command pools are taken from and handed back to by the process callback, the timer thread, and any number of others
+    CommandPool<TimerCommand, TimerCommandRingSize> timerCommandsToDelete{"SyncTimer handed back timer commands"};
+    CommandPool<TimerCommand, TimerCommandRingSize> freshTimerCommands{"SyncTimer fresh timer commands"};
+    CommandPool<ClipCommand, ClipCommandRingSize> clipCommandsToDelete{"SyncTimer handed back clip commands"};
+    CommandPool<ClipCommand, ClipCommandRingSize> freshClipCommands{"SyncTimer fresh clip commands"};
+    /**
+     * \brief Move the handed back commands which are no longer in use from the given handed back pool to the given fresh pool
+     * This is called from the process callback, so it never frees anything: a command which does not fit into the fresh
+     * pool (which means more commands exist than the pool was made for) simply stays where it is
+     */
+    template<typename Command, std::size_t Capacity>
+    void refreshCommands(CommandPool<Command, Capacity> &handedBack, CommandPool<Command, Capacity> &fresh) {
+        const quint64 now{wallClockUsecs};
+        CommandPoolEntry<Command> entry;
+        while (fresh.isFull() == false && handedBack.readIf(entry, [now](const CommandPoolEntry<Command> &candidate) { return candidate.timestamp < now; })) {
+            Command::clear(entry.command);
+            if (fresh.write({entry.command, 0}) == false) {
+                // Someone else filled up the pool since we checked, so put it back for later (if that fails too, the pools count it as an overflow, and it is lost)
+                handedBack.write(entry);
+                break;
+            }
+        }
+    }
 
     bool audibleMetronome{false};
     ClipAudioSource *metronomeTick{nullptr};
@@ -467,8 +730,11 @@ public:
         intervals << (thisRound - lastRound).count();
         lastRound = thisRound;
 #endif
+        // Get the steps which have been played since last time ready for use again
+        recycleStepContents();
+
         while (cumulativeBeat < (jackPlayhead + (scheduleAheadAmount * 2))) {
-            Q_EMIT q->timerTick(beat);
+            dispatchTick(beat);
 
             ClipCommand *command{nullptr};
             if (beat == 0) {
@@ -490,9 +756,57 @@ public:
             ++cumulativeBeat;
         }
 
-        // Finally, notify any listeners that commands have been sent out
+        // Finally, hand the ticks and any commands which have been sent out over to the SyncTimer's own thread for
+        // the timerTick and clipCommandSent signals (however many have built up by then get delivered in one batch)
+        if ((dispatchedTicks.hasUnread() || sentOutClipsRing.hasUnread()) && tickBatchPending.exchange(true) == false) {
+            QMetaObject::invokeMethod(q, [this](){ deliverTickBatch(); }, Qt::QueuedConnection);
+        }
+    }
+
+    TickCallbackEntry tickCallbacks[TickCallbackMaxCount];
+    // The number of entries in tickCallbacks which are in use (this, and the entries, may only be touched while holding the schedule, see tryAcquireSchedule())
+    int tickCallbackCount{0};
+    // The ticks which have been run through the tick callbacks, but not yet been sent out through the timerTick signal
+    LockFreeRing<int, DispatchedTicksRingSize> dispatchedTicks{"SyncTimer dispatched ticks"};
+    std::atomic<bool> tickBatchPending{false};
+    /**
+     * \brief Call all the registered tick callbacks for the given tick, and queue it up for the timerTick signal
+     * This must only be called by whoever is holding the schedule (see tryAcquireSchedule())
+     */
+    inline void dispatchTick(const int &tick) {
+        for (int index = 0; index < tickCallbackCount; ++index) {
+            TickCallbackEntry &entry = tickCallbacks[index];
+            const frame_clock::time_point start{frame_clock::now()};
+            entry.callback(tick, entry.data);
+            entry.addMeasurement(quint64(std::chrono::duration_cast<std::chrono::nanoseconds>(frame_clock::now() - start).count()));
+        }
+        dispatchedTicks.write(tick);
+    }
+    /**
+     * \brief Hand the clip command to SamplerSynth, and let the clipCommandSent listeners know about it
+     * If SamplerSynth could not queue the command, it is handed straight back to the pool instead (and so must not be
+     * sent out, as it may well have been reused by the time the listeners get to it)
+     */
+    void sendOutClipCommand(ClipCommand *clipCommand, quint64 timestamp) {
+        if (samplerSynth->handleClipCommand(clipCommand, timestamp)) {
+            sentOutClipsRing.write(clipCommand, 0);
+        } else {
+            q->deleteClipCommand(clipCommand);
+        }
+    }
+    /**
+     * \brief Send out the batch of ticks and commands which has built up since last time
+     * This is called on the SyncTimer's own thread
+     */
+    void deliverTickBatch() {
+        // Clear the flag first, so anything written while we are delivering gets a new batch
+        tickBatchPending = false;
+        int tick{0};
+        while (dispatchedTicks.read(tick)) {
+            Q_EMIT q->timerTick(tick);
+        }
         // You must not delete the commands themselves here, as SamplerSynth takes ownership of them
-        while (sentOutClipsRing.readHead->processed == false) {
+        while (sentOutClipsRing.hasUnread()) {
             Q_EMIT q->clipCommandSent(sentOutClipsRing.read());
         }
     }
@@ -539,7 +853,40 @@ public:
     quint64 jackPlayheadForTimerTick[StepRingCount];
     quint64 jackPlayheadForCumulativeTimerTick[StepRingCount];
     jack_time_t current_usecs{0};
+    // The actual time as reported by jack (which only differs from current_usecs while freewheeling)
+    jack_time_t wallClockUsecs{0};
     jack_time_t refreshThingsAfter{0};
+    jack_nframes_t sampleRate{48000};
+    // Freewheel mode is jack running cycles back to back as fast as it is able to, without waiting for the audio hardware,
+    // which is what we use to render things offline faster than realtime
+    std::atomic<bool> freewheeling{false};
+    std::atomic<bool> realignClock{false};
+    // Where the next cycle starts on our timeline (while freewheeling, this is synthesised from the frames processed)
+    jack_time_t synthesisedClock{0};
+    // Held by whoever is currently running hiResTimerCallback (the timer thread, or the process callback while freewheeling),
+    // or changing the tick callbacks. Neither the timer thread nor the process callback ever wait for this: if the other is
+    // still holding it (which only happens right as freewheeling starts or ends), they simply skip that round, and as
+    // hiResTimerCallback catches up on everything up to the current playhead, the next round makes up for it.
+    std::atomic<bool> scheduleInUse{false};
+    inline bool tryAcquireSchedule() {
+        return scheduleInUse.exchange(true, std::memory_order_acquire) == false;
+    }
+    // For use outside of the timer thread and process callback only (the schedule is only ever held briefly, so this does not wait long)
+    void acquireSchedule() {
+        while (tryAcquireSchedule() == false) {
+            QThread::yieldCurrentThread();
+        }
+    }
+    inline void releaseSchedule() {
+        scheduleInUse.store(false, std::memory_order_release);
+    }
+    void freewheelChanged(bool starting) {
+        if (starting == false) {
+            realignClock = true;
+        }
+        freewheeling = starting;
+        QMetaObject::invokeMethod(q, "freewheelingChanged", Qt::QueuedConnection);
+    }
     quint64 jackPlayheadReturn{0};
     quint64 jackSubbeatLengthInMicrosecondsReturn{0};
 
@@ -556,6 +903,7 @@ public:
     quint64 jackCumulativePlayheadForMidiStartEvent{0};
     juce::MidiBuffer missingBitsBuffer[ZynthboxTrackCount + 1];
     int process(jack_nframes_t nframes) {
+        MEASURE_PROCESS_TIMING("SyncTimer", nframes)
         // const std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
         void *bufferSequencer[ZynthboxTrackCount + 1];
         void *bufferController[ZynthboxTrackCount + 1];
@@ -579,8 +927,30 @@ public:
         jack_time_t next_usecs;
         float period_usecs;
         jack_get_cycle_times(jackClient, &current_frames, &current_usecs, &next_usecs, &period_usecs);
+        wallClockUsecs = current_usecs;
         // Things get refreshed 50ms after they've been marked for refreshing
-        refreshThingsAfter = current_usecs + 5000;
+        refreshThingsAfter = wallClockUsecs + 5000;
+        if (freewheeling) {
+            // While freewheeling, the wall clock has nothing to do with how much audio has been produced, so instead we
+            // run on a clock synthesised from the number of frames processed, starting from where the real one left off
+            period_usecs = (float(nframes) * 1000000.0f) / float(sampleRate);
+            current_usecs = synthesisedClock;
+            next_usecs = synthesisedClock + jack_time_t(period_usecs);
+        } else if (realignClock) {
+            // Freewheeling just ended, and the synthesised clock will have run ahead of the wall clock, so move everything
+            // positioned along the synthesised timeline back onto the real one (unsigned wraparound keeps this correct)
+            realignClock = false;
+            if (stepNextPlaybackPosition > 0) {
+                stepNextPlaybackPosition = stepNextPlaybackPosition + current_usecs - synthesisedClock;
+            }
+            if (jackNextPlaybackPosition > 0) {
+                jackNextPlaybackPosition = jackNextPlaybackPosition + current_usecs - synthesisedClock;
+            }
+            if (jackMostRecentNextUsecs > 0) {
+                jackMostRecentNextUsecs = jackMostRecentNextUsecs + current_usecs - synthesisedClock;
+            }
+        }
+        synthesisedClock = next_usecs;
         const quint64 microsecondsPerFrame = (next_usecs - current_usecs) / nframes;
 
         const bool externalClockActive{transportManager->clockSourceAvailable()};
@@ -622,6 +992,14 @@ public:
             stepNextPlaybackPosition = current_usecs;
             stepNextPlaybackPositionFrames = current_frames;
         }
+        if (freewheeling && isPaused == false) {
+            // The timer thread runs on the wall clock, and so can't keep up with a freewheeling jack, so we schedule ahead
+            // from here instead (which is fine, as while freewheeling, we are not running in realtime)
+            if (tryAcquireSchedule()) {
+                hiResTimerCallback();
+                releaseSchedule();
+            }
+        }
 
         jack_time_t currentStepUsecsStart{0};
         jack_time_t currentStepUsecsEnd = qMin(period_usecs, float(stepNextPlaybackPosition - current_usecs));
@@ -717,7 +1095,10 @@ public:
 
             // In case we're cycling through stuff we've already played, let's just... not do anything with that
             // Basically that just means nobody else has attempted to do stuff with the step since we last played it
-            if (!stepData->played) {
+            StepContent *stepContent{stepData->played ? nullptr : stepData->content.load()};
+            if (stepContent) {
+                // Make sure the timer thread doesn't clear this step's content out from under us while we're working on it
+                playingStep = stepData;
                 stepData->played = true;
                 // First, let's get the midi messages sent out
                 for (int track = 0; track < ZynthboxTrackCount + 1; ++track) {
@@ -745,12 +1126,12 @@ public:
                         }
                         return true;
                     };
-                    for (const juce::MidiMessageMetadata &juceMessage : qAsConst(stepData->trackBufferSequencer[track])) {
+                    for (const juce::MidiMessageMetadata &juceMessage : qAsConst(stepContent->trackBufferSequencer[track])) {
                         if (handleJuceMessage(juceMessage, bufferSequencer) == false) {
                             break;
                         }
                     }
-                    for (const juce::MidiMessageMetadata &juceMessage : qAsConst(stepData->trackBufferController[track])) {
+                    for (const juce::MidiMessageMetadata &juceMessage : qAsConst(stepContent->trackBufferController[track])) {
                         if (handleJuceMessage(juceMessage, bufferController) == false) {
                             break;
                         }
@@ -758,16 +1139,15 @@ public:
                 }
 
                 // Then do direct-control samplersynth things
-                for (ClipCommand *clipCommand : qAsConst(stepData->clipCommands)) {
+                for (ClipCommand *clipCommand : qAsConst(stepContent->clipCommands)) {
                     // Using the protected function, which only we (and SamplerSynth) can use, to ensure less locking
-                    samplerSynth->handleClipCommand(clipCommand, firstAvailableFrame + current_frames);
-                    sentOutClipsRing.write(clipCommand, 0);
+                    sendOutClipCommand(clipCommand, firstAvailableFrame + current_frames);
                 }
 
                 // Do playback control things as the last thing, otherwise we might end up affecting things
                 // currently happening (like, if we stop playback on the last step of a thing, we still want
                 // notes on that step to have been played and so on)
-                for (TimerCommand *command : qAsConst(stepData->timerCommands)) {
+                for (TimerCommand *command : qAsConst(stepContent->timerCommands)) {
                     Q_EMIT q->timerCommand(command);
                     switch (command->operation) {
                         case TimerCommand::StartPlaybackOperation:
@@ -791,8 +1171,7 @@ public:
                             {
                                 ClipCommand *clipCommand = static_cast<ClipCommand *>(command->variantParameter.value<void*>());
                                 if (clipCommand) {
-                                    samplerSynth->handleClipCommand(clipCommand, firstAvailableFrame + current_frames);
-                                    sentOutClipsRing.write(clipCommand, 0);
+                                    sendOutClipCommand(clipCommand, firstAvailableFrame + current_frames);
                                 } else {
                                     qWarning() << Q_FUNC_INFO << "Failed to retrieve clip command from clip based timer command";
                                 }
@@ -806,8 +1185,7 @@ public:
                             {
                                 ClipCommand *clipCommand = static_cast<ClipCommand *>(command->dataParameter);
                                 if (clipCommand) {
-                                    samplerSynth->handleClipCommand(clipCommand, firstAvailableFrame + current_frames);
-                                    sentOutClipsRing.write(clipCommand, 0);
+                                    sendOutClipCommand(clipCommand, firstAvailableFrame + current_frames);
                                 } else {
                                     qWarning() << Q_FUNC_INFO << "Failed to retrieve clip command from clip based timer command";
                                 }
@@ -843,7 +1221,7 @@ public:
                             if (command->parameter == 1) {
                                 AudioLevels::instance()->handleTimerCommand(firstAvailableFrame + current_frames, command);
                             } else {
-                                AudioLevels::instance()->startRecording(firstAvailableFrame + current_frames);
+                                AudioLevels::instance()->startArmedRecording(firstAvailableFrame + current_frames, command->bigParameter);
                             }
                             break;
                         case TimerCommand::ChannelRecorderStopOperation:
@@ -997,6 +1375,11 @@ public:
                             break;
                     }
                 }
+                // Unless something (like stopping playback) has put the step back into use, hand the content back for recycling
+                if (stepData->played && stepData->content.compare_exchange_strong(stepContent, nullptr)) {
+                    retireStepContent(stepContent);
+                }
+                playingStep = nullptr;
             }
             const double externalBpm{transportManager->bpm()};
             // If the external BPM is above -1, use that, otherwise use our internal clock
@@ -1156,6 +1539,11 @@ public:
                 q->sendAllNotesOffEverywhereImmediately();
                 qDebug() << Q_FUNC_INFO << "Metronome and playback stopped";
             }
+            if (freewheeling) {
+                // An offline render ends when playback does, so hand control back to the audio hardware
+                // (this has to be queued, as jack does not allow changing freewheel state from the process callback)
+                QMetaObject::invokeMethod(q, "setFreewheeling", Qt::QueuedConnection, Q_ARG(bool, false));
+            }
             return true;
         }
     }
@@ -1167,13 +1555,28 @@ public:
     }
 };
 
+void StepData::ensureFresh() {
+    if (played) {
+        // If there is any leftover content on the step, get rid of that first
+        StepContent *oldContent = content.exchange(nullptr);
+        if (oldContent) {
+            d->retireStepContent(oldContent);
+        }
+        StepContent *freshContent = d->claimStepContent();
+        freshContent->step = this;
+        content = freshContent;
+        played = false;
+    }
+}
+
 void StepData::insertMidiBuffer(const juce::MidiBuffer &buffer, int sketchpadTrack, StepData::BufferType bufferType) {
+    StepContent *stepContent = content.load();
     switch (bufferType) {
         case SequencerBuffer:
-            trackBufferSequencer[sketchpadTrack].addEvents(buffer, 0, -1, trackBufferSequencer[sketchpadTrack].getLastEventTime());
+            stepContent->trackBufferSequencer[sketchpadTrack].addEvents(buffer, 0, -1, stepContent->trackBufferSequencer[sketchpadTrack].getLastEventTime());
             break;
         case ControllerBuffer:
-            trackBufferController[sketchpadTrack].addEvents(buffer, 0, -1, trackBufferController[sketchpadTrack].getLastEventTime());
+            stepContent->trackBufferController[sketchpadTrack].addEvents(buffer, 0, -1, stepContent->trackBufferController[sketchpadTrack].getLastEventTime());
             break;
     }
     quint64 timestamp{d->jackCumulativePlayhead};
@@ -1205,6 +1608,9 @@ static int client_process(jack_nframes_t nframes, void* arg) {
 static int client_xrun(void* arg) {
     return static_cast<SyncTimerPrivate*>(arg)->xrun();
 }
+static void client_freewheel(int starting, void* arg) {
+    static_cast<SyncTimerPrivate*>(arg)->freewheelChanged(starting != 0);
+}
 void client_latency_callback(jack_latency_callback_mode_t mode, void *arg)
 {
     if (mode == JackPlaybackLatency) {
@@ -1248,6 +1654,7 @@ SyncTimer::SyncTimer(QObject *parent)
             // Set the process callback.
             if (jack_set_process_callback(d->jackClient, client_process, static_cast<void*>(d)) == 0) {
                 jack_set_xrun_callback(d->jackClient, client_xrun, static_cast<void*>(d));
+                jack_set_freewheel_callback(d->jackClient, client_freewheel, static_cast<void*>(d));
                 jack_set_latency_callback (d->jackClient, client_latency_callback, static_cast<void*>(d));
                 // Activate the client.
                 if (jack_activate(d->jackClient) == 0) {
@@ -1257,6 +1664,7 @@ SyncTimer::SyncTimer(QObject *parent)
                     jack_port_get_latency_range (d->jackPort[ZynthboxTrackCount], JackPlaybackLatency, &range);
                     jack_nframes_t bufferSize = jack_get_buffer_size(d->jackClient);
                     jack_nframes_t sampleRate = jack_get_sample_rate(d->jackClient);
+                    d->sampleRate = sampleRate;
                     d->jackLatency = (1000 * (double)qMax(bufferSize, range.max)) / (double)sampleRate;
                     d->updateScheduleAheadAmount();
                     qDebug() << "SyncTimer: Buffer size is supposed to be" << bufferSize << "but our maximum latency is" << range.max << "and we should be using that one to calculate how far out things should go, as that should include the amount of extra buffers alsa might (and likely does) use.";
@@ -1299,10 +1707,13 @@ void SyncTimer::queueClipToStartOnChannel(ClipAudioSource *clip, int midiChannel
 void SyncTimer::queueClipToStopOnChannel(ClipAudioSource *clip, int midiChannel)
 {
     // First, remove any references to the clip that we're wanting to stop
-    for (quint64 step = 0; step < StepRingCount; ++step) {
-        StepData *stepData = &d->stepRing[step];
-        if (!stepData->played) {
-            QMutableListIterator<ClipCommand *> stepIterator(stepData->clipCommands);
+    // (only steps with content can have anything on them, so just look through those, rather than the whole ring)
+    const int stepContentCount{d->stepContentCount.load()};
+    for (int contentIndex = 0; contentIndex < stepContentCount; ++contentIndex) {
+        StepContent *stepContent = d->allStepContents[contentIndex];
+        StepData *stepData = stepContent->step;
+        if (stepData && !stepData->played && stepData->content.load() == stepContent) {
+            QMutableListIterator<ClipCommand *> stepIterator(stepContent->clipCommands);
             while (stepIterator.hasNext()) {
                 ClipCommand *stepCommand = stepIterator.next();
                 if (stepCommand->clip == clip) {
@@ -1319,7 +1730,7 @@ void SyncTimer::queueClipToStopOnChannel(ClipAudioSource *clip, int midiChannel)
     command->midiNote = 60;
     command->stopPlayback = true;
     StepData *stepData{d->delayedStep(0)};
-    stepData->clipCommands << command;
+    stepData->content.load()->clipCommands << command;
 }
 
 void SyncTimer::queueClipToStart(ClipAudioSource *clip) {
@@ -1395,14 +1806,30 @@ void SyncTimer::stop() {
     // We also want to fire off all the clip commands (so they happen, but without making noises)
     QList<ClipCommand*> clipCommands;
     // We also want to clean up the step, so timer commands still happen at the expected times, without the other two happening
+    // Only steps with content can have anything outstanding, so rather than going through the entire ring, gather up
+    // those steps' contents, and handle them in the order they would have been played (that is, from the read head)
     const quint64 readIndex{d->stepReadHead->index};
-    for (quint64 step = 0; step < StepRingCount; ++step) {
-        StepData *stepData = &d->stepRing[(step + readIndex) % StepRingCount];
-        if (!stepData->played) {
+    const int stepContentCount{d->stepContentCount.load()};
+    int outstandingCount{0};
+    for (int contentIndex = 0; contentIndex < stepContentCount; ++contentIndex) {
+        StepContent *stepContent = d->allStepContents[contentIndex];
+        StepData *stepData = stepContent->step;
+        if (stepData && !stepData->played && stepData->content.load() == stepContent) {
+            d->outstandingStepContents[outstandingCount] = stepContent;
+            ++outstandingCount;
+        }
+    }
+    std::sort(d->outstandingStepContents, d->outstandingStepContents + outstandingCount, [readIndex](const StepContent *first, const StepContent *second) {
+        return ((first->step->index + StepRingCount - readIndex) % StepRingCount) < ((second->step->index + StepRingCount - readIndex) % StepRingCount);
+    });
+    for (int outstandingIndex = 0; outstandingIndex < outstandingCount; ++outstandingIndex) {
+        StepContent *stepContent = d->outstandingStepContents[outstandingIndex];
+        StepData *stepData = stepContent->step;
+        {
             stepData->played = true;
             // First, collect all the queued midi messages
             for (int track = 0; track < ZynthboxTrackCount + 1; ++track) {
-                for (const juce::MidiMessageMetadata& message : stepData->trackBufferSequencer[track]) {
+                for (const juce::MidiMessageMetadata& message : stepContent->trackBufferSequencer[track]) {
                     juce::MidiMessage midiMessage = message.getMessage();
                     if (midiMessage.isNoteOn()) {
                         // Just in case this is a note on message, still schedule it, but be vewy vewy quiet, we're hunting silence-wabbits
@@ -1414,7 +1841,7 @@ void SyncTimer::stop() {
                 }
             }
             // Now for the clip commands
-            for (ClipCommand *clipCommand : qAsConst(stepData->clipCommands)) {
+            for (ClipCommand *clipCommand : qAsConst(stepContent->clipCommands)) {
                 // Actually run all the commands (so we don't end up in a weird state), but also
                 // set all the volumes to 0 so we don't make the users' ears bleed
                 clipCommand->changeVolume = true;
@@ -1426,13 +1853,16 @@ void SyncTimer::stop() {
             // - Then clear out whatever else is there (yes, expensive operation during process, but needs must, and clear() specifically doesn't resize a QList, so...)
             // - Note: This is only safe, because we generally call this from SyncTimerPrivate::stopPlayback
             // - We also call it from MidiRecorder::stopPlayback, but this is itself called from SyncTimerPrivate::stopPlayback
-            if (stepData->timerCommands.length() > 0) {
-                stepData->played = false;
-                stepData->clipCommands.clear();
+            // - If there are no timer commands, the content is handed back for recycling
+            if (stepContent->timerCommands.length() > 0) {
+                stepContent->clipCommands.clear();
                 for (int track = 0; track < ZynthboxTrackCount + 1; ++track) {
-                    stepData->trackBufferSequencer[track].clear();
-                    stepData->trackBufferController[track].clear();
+                    stepContent->trackBufferSequencer[track].clear();
+                    stepContent->trackBufferController[track].clear();
                 }
+                stepData->played = false;
+            } else if (stepData->content.compare_exchange_strong(stepContent, nullptr)) {
+                d->retireStepContent(stepContent);
             }
         }
     }
@@ -1453,7 +1883,7 @@ void SyncTimer::stop() {
 
     // Make sure we're actually informing about any clips that have been sent out, in case we
     // hit somewhere between a jack roll and a synctimer tick
-    while (d->sentOutClipsRing.readHead->processed == false) {
+    while (d->sentOutClipsRing.hasUnread()) {
         Q_EMIT clipCommandSent(d->sentOutClipsRing.read());
     }
 #ifdef DEBUG_SYNCTIMER_TIMING
@@ -1611,9 +2041,9 @@ const quint64 &SyncTimer::jackSubbeatLengthInMicroseconds() const
 
 void SyncTimer::scheduleClipCommand(ClipCommand *command, quint64 delay)
 {
-    StepData *stepData{d->delayedStep(delay)};
+    StepContent *stepContent{d->delayedStep(delay)->content.load()};
     bool foundExisting{false};
-    for (ClipCommand *existingCommand : qAsConst(stepData->clipCommands)) {
+    for (ClipCommand *existingCommand : qAsConst(stepContent->clipCommands)) {
         if (existingCommand->equivalentTo(command)) {
             if (command->changeLooping) {
                 existingCommand->looping = command->looping;
@@ -1644,7 +2074,7 @@ void SyncTimer::scheduleClipCommand(ClipCommand *command, quint64 delay)
     if (foundExisting) {
         deleteClipCommand(command);
     } else {
-        stepData->clipCommands << command;
+        stepContent->clipCommands << command;
     }
 }
 
@@ -1697,7 +2127,7 @@ void SyncTimer::scheduleTimerCommand(quint64 delay, TimerCommand *command)
 {
     if (d->timerCommandBundleStarts == 0) {
         StepData *stepData{d->delayedStep(delay)};
-        stepData->timerCommands << command;
+        stepData->content.load()->timerCommands << command;
     } else {
         d->bundledTimerCommands[command] = delay;
     }
@@ -1721,16 +2151,13 @@ void SyncTimer::endTimerCommandBundle(quint64 startDelay)
         QHashIterator<TimerCommand*, quint64> bundleIterator{d->bundledTimerCommands};
         while (bundleIterator.hasNext()) {
             bundleIterator.next();
-            StepData *addToStep{logicalFirstStep};
             const quint64 delay{bundleIterator.value()};
             if (delay > StepRingCount) {
                 qCritical() << Q_FUNC_INFO << "Attempting to add a timer command further into the future than our Step Ring size. This is going to cause fairly serious problems, and we are going to need to increase the size of the ring. The ring size is" << StepRingCount << "and the requested delay was" << delay;
             }
-            for (quint64 delayCounter = 0; delayCounter < delay; ++delayCounter) {
-                addToStep = addToStep->next;
-            }
+            StepData *addToStep{&d->stepRing[(logicalFirstStep->index + delay) % StepRingCount]};
             addToStep->ensureFresh();
-            addToStep->timerCommands << bundleIterator.key();
+            addToStep->content.load()->timerCommands << bundleIterator.key();
         }
         d->bundledTimerCommands.clear();
     }
@@ -1794,7 +2221,7 @@ int SyncTimer::nextAvailableChannel(const int& sketchpadTrack, quint64 delay)
 void SyncTimer::scheduleNote(unsigned char midiNote, unsigned char midiChannel, bool setOn, unsigned char velocity, quint64 duration, quint64 delay, int sketchpadTrack)
 {
     StepData *stepData{d->delayedStep(delay)};
-    juce::MidiBuffer &addToThis = stepData->trackBufferSequencer[d->sketchpadTrack(sketchpadTrack)];
+    juce::MidiBuffer &addToThis = stepData->content.load()->trackBufferSequencer[d->sketchpadTrack(sketchpadTrack)];
     unsigned char note[3];
     if (setOn) {
         note[0] = 0x90 + midiChannel;
@@ -1913,32 +2340,114 @@ bool SyncTimer::timerRunning() {
     return !timerThread->isPaused();
 }
 
+bool SyncTimer::freewheeling() const
+{
+    return d->freewheeling;
+}
+
+bool SyncTimer::registerTickCallback(const char* name, TickCallback callback, void* data, const quint64& budgetMicroseconds)
+{
+    d->acquireSchedule();
+    if (d->tickCallbackCount < TickCallbackMaxCount) {
+        d->tickCallbacks[d->tickCallbackCount].set(name, callback, data, budgetMicroseconds * 1000);
+        ++d->tickCallbackCount;
+        d->releaseSchedule();
+        return true;
+    }
+    d->releaseSchedule();
+    qWarning() << Q_FUNC_INFO << "Failed to register the tick callback" << name << "as there is no room for more than" << TickCallbackMaxCount << "tick callbacks";
+    return false;
+}
+
+void SyncTimer::unregisterTickCallback(TickCallback callback, void* data)
+{
+    d->acquireSchedule();
+    for (int index = 0; index < d->tickCallbackCount; ++index) {
+        if (d->tickCallbacks[index].callback == callback && d->tickCallbacks[index].data == data) {
+            // Move the remaining callbacks down, so they keep being called in the order they were registered
+            for (int moveIndex = index + 1; moveIndex < d->tickCallbackCount; ++moveIndex) {
+                const TickCallbackEntry &entry = d->tickCallbacks[moveIndex];
+                d->tickCallbacks[moveIndex - 1].set(entry.name, entry.callback, entry.data, entry.budgetNanoseconds);
+            }
+            --d->tickCallbackCount;
+            break;
+        }
+    }
+    d->releaseSchedule();
+}
+
+QVariantList SyncTimer::tickCallbackStatistics() const
+{
+    // Take a copy of the numbers while holding the schedule, and only then build the list (so the timer is never kept waiting on allocations)
+    struct {
+        const char *name;
+        quint64 calls, nanoseconds, worstNanoseconds, budgetNanoseconds, overBudgetCalls;
+    } entries[TickCallbackMaxCount];
+    d->acquireSchedule();
+    const int entryCount{d->tickCallbackCount};
+    for (int index = 0; index < entryCount; ++index) {
+        TickCallbackEntry &entry = d->tickCallbacks[index];
+        entries[index].name = entry.name;
+        entries[index].calls = entry.calls.exchange(0, std::memory_order_relaxed);
+        entries[index].nanoseconds = entry.nanoseconds.exchange(0, std::memory_order_relaxed);
+        entries[index].worstNanoseconds = entry.worstNanoseconds.exchange(0, std::memory_order_relaxed);
+        entries[index].budgetNanoseconds = entry.budgetNanoseconds;
+        entries[index].overBudgetCalls = entry.overBudgetCalls.exchange(0, std::memory_order_relaxed);
+    }
+    d->releaseSchedule();
+    QVariantList statistics;
+    for (int index = 0; index < entryCount; ++index) {
+        const quint64 &calls{entries[index].calls};
+        QVariantMap entryStatistics;
+        entryStatistics[QLatin1String("name")] = QString::fromUtf8(entries[index].name);
+        entryStatistics[QLatin1String("calls")] = calls;
+        entryStatistics[QLatin1String("averageMicroseconds")] = calls > 0 ? double(entries[index].nanoseconds) / double(calls * 1000) : 0.0;
+        entryStatistics[QLatin1String("worstMicroseconds")] = double(entries[index].worstNanoseconds) / 1000.0;
+        entryStatistics[QLatin1String("budgetMicroseconds")] = double(entries[index].budgetNanoseconds) / 1000.0;
+        entryStatistics[QLatin1String("overBudgetCalls")] = entries[index].overBudgetCalls;
+        statistics << entryStatistics;
+    }
+    return statistics;
+}
+
+QVariantMap SyncTimer::timerJitterStatistics() const
+{
+    return timerThread->takeJitterStatistics();
+}
+
+void SyncTimer::setFreewheeling(const bool& freewheeling)
+{
+    if (d->jackClient && d->freewheeling != freewheeling) {
+        // The freewheeling state itself gets updated when jack calls us back to tell us it has changed
+        if (jack_set_freewheel(d->jackClient, freewheeling ? 1 : 0) != 0) {
+            qWarning() << Q_FUNC_INFO << "Failed to ask jack to change freewheel state to" << freewheeling;
+        }
+    }
+}
+
 static int returnedCommands{0};
 ClipCommand * SyncTimer::getClipCommand()
 {
     // Before fetching commands, check whether there's anything that needs refreshing and do that first
     // Might seem a little heavy to put that here, but it's the most central location, and in reality
     // it is a fairly low-impact operation, so it's not really particularly bad.
-    while (d->freshClipCommands.writeHead->processed == true && d->clipCommandsToDelete.readHead->processed == false && d->clipCommandsToDelete.readHead->timestamp < d->current_usecs) {
-        ClipCommand *refreshedCommand = d->clipCommandsToDelete.read();
-        ClipCommand::clear(refreshedCommand);
-        d->freshClipCommands.write(refreshedCommand, 0);
-    }
-    ClipCommand *command{nullptr};
-    if (d->freshClipCommands.readHead->processed == false) {
-        command = d->freshClipCommands.read();
-    }
+    d->refreshCommands(d->clipCommandsToDelete, d->freshClipCommands);
+    CommandPoolEntry<ClipCommand> entry;
+    d->freshClipCommands.read(entry);
     ++returnedCommands;
-    if (command == nullptr) {
+    if (entry.command == nullptr) {
         qDebug() << Q_FUNC_INFO << "We're returning a null command here somehow... During our full runtime, this is attempt number:" << returnedCommands;
     }
-    return command;
+    return entry.command;
 }
 
 void SyncTimer::deleteClipCommand(ClipCommand* command)
 {
     if (command) {
-        d->clipCommandsToDelete.write(command, d->refreshThingsAfter);
+        // Every command comes out of a pool the same size as this one, so the write can only fail if a command is handed back
+        // twice, or one was created outside of the pool. We can't tell which, so rather than risk freeing a command which is
+        // still in use, we leave it be (the pool counts the failure, which then gets reported outside of the process callback)
+        d->clipCommandsToDelete.write({command, d->refreshThingsAfter});
     } else {
         qDebug() << Q_FUNC_INFO << "Asked to delete a null clip command";
     }
@@ -1949,21 +2458,15 @@ TimerCommand * SyncTimer::getTimerCommand()
     // Before fetching commands, check whether there's anything that needs refreshing and do that first
     // Might seem a little heavy to put that here, but it's the most central location, and in reality
     // it is a fairly low-impact operation, so it's not really particularly bad.
-    while (d->freshTimerCommands.writeHead->processed == true  && d->timerCommandsToDelete.readHead->processed == false && d->timerCommandsToDelete.readHead->timestamp < d->current_usecs) {
-        TimerCommand* refreshedCommand = d->timerCommandsToDelete.read();
-        TimerCommand::clear(refreshedCommand);
-        d->freshTimerCommands.write(refreshedCommand, 0);
-    }
-    TimerCommand *command{nullptr};
-    if (d->freshTimerCommands.readHead->processed == false) {
-        command = d->freshTimerCommands.read();
-    }
-    return command;
+    d->refreshCommands(d->timerCommandsToDelete, d->freshTimerCommands);
+    CommandPoolEntry<TimerCommand> entry;
+    d->freshTimerCommands.read(entry);
+    return entry.command;
 }
 
 void SyncTimer::deleteTimerCommand(TimerCommand* command)
 {
-    d->timerCommandsToDelete.write(command, d->refreshThingsAfter);
+    d->timerCommandsToDelete.write({command, d->refreshThingsAfter});
 }
 
 void SyncTimer::scheduleStartPlayback(quint64 delay, bool startInSongMode, int startOffset, quint64 duration)
@@ -42,6 +42,11 @@ class SyncTimer : public QObject {
   Q_PROPERTY(int songPosition READ songPosition NOTIFY songPositionChanged)
   Q_PROPERTY(quint64 scheduleAheadAmount READ scheduleAheadAmount NOTIFY scheduleAheadAmountChanged)
   Q_PROPERTY(bool audibleMetronome READ audibleMetronome WRITE setAudibleMetronome NOTIFY audibleMetronomeChanged)
+  /**
+   * \brief Whether jack is currently freewheeling (that is, rendering offline, as fast as the cpu allows)
+   * @see setFreewheeling(bool)
+   */
+  Q_PROPERTY(bool freewheeling READ freewheeling WRITE setFreewheeling NOTIFY freewheelingChanged)
 public:
   static SyncTimer* instance() {
     static SyncTimer* instance{nullptr};
@@ -61,6 +66,48 @@ public:
    * @param beat The beat inside the current note (a number from 0 through 4*getMultiplier())
    */
   Q_SIGNAL void timerTick(int beat);
+  /**
+   * \brief A function called directly by the timer for each tick
+   * @param beat The beat inside the current note (see timerTick())
+   * @param data The data pointer passed to registerTickCallback()
+   */
+  typedef void (*TickCallback)(int beat, void *data);
+  /**
+   * \brief Register a function to be called for each tick, directly on the thread which advances the timer
+   *
+   * The timerTick signal is delivered in batches on the SyncTimer's own thread, which is fine for anything which
+   * only needs to know that ticks have happened (such as the user interface). Anything which needs to do its work
+   * in lockstep with the timer (such as scheduling upcoming notes) should register a tick callback instead.
+   *
+   * Tick callbacks run on the timer thread (or in the jack process callback while freewheeling), and so must not
+   * block, allocate, or otherwise do anything which might take an unbounded amount of time. Each callback has a
+   * budget, and the time spent in each is measured (see tickCallbackStatistics()), so it is possible to see who
+   * is eating the timer's time.
+   *
+   * @param name A name for the callback, used when reporting its statistics (this must remain valid while the callback is registered)
+   * @param callback The function to call
+   * @param data A pointer which will be passed to the function when called
+   * @param budgetMicroseconds How long a single call to the function is expected to take at the most
+   * @return True if the callback was registered, or false if there was no room for another one
+   */
+  bool registerTickCallback(const char *name, TickCallback callback, void *data, const quint64 &budgetMicroseconds);
+  /**
+   * \brief Remove a previously registered tick callback
+   * Once this function returns, the callback will not be called again
+   * @param callback The function which was registered
+   * @param data The data pointer it was registered with
+   */
+  void unregisterTickCallback(TickCallback callback, void *data);
+  /**
+   * \brief How much time the registered tick callbacks have been taking since the last time this was called
+   *
+   * Each entry in the list is a map containing the callback's name, the number of calls since the last
+   * time this was called (calls), the average and worst time taken per call (averageMicroseconds and
+   * worstMicroseconds), the callback's budget (budgetMicroseconds), and how many of the calls went past
+   * that budget (overBudgetCalls).
+   * @return A list with one map per registered tick callback
+   */
+  Q_INVOKABLE QVariantList tickCallbackStatistics() const;
   void queueClipToStart(ClipAudioSource *clip);
   void queueClipToStop(ClipAudioSource *clip);
   void queueClipToStartOnChannel(ClipAudioSource *clip, int midiChannel);
@@ -424,6 +471,44 @@ public:
   bool timerRunning();
   Q_SIGNAL void timerRunningChanged();
 
+  /**
+   * \brief Whether jack is currently freewheeling
+   * @see setFreewheeling(bool)
+   */
+  bool freewheeling() const;
+  /**
+   * \brief Set jack to freewheel, to render offline faster than realtime
+   *
+   * While freewheeling, jack stops waiting for the audio hardware and runs process cycles back to back, as fast
+   * as the clients are able to process them (the hardware outputs silence in the meantime). The timer follows
+   * along on a clock synthesised from the number of frames processed, so everything scheduled through it (and
+   * so also everything recorded through AudioLevels) ends up at the same positions it would during realtime
+   * playback.
+   *
+   * To bounce a song to disk, use AudioLevels::bounceSong(), which sets up the recording, freewheeling and
+   * playback in the right order. Freewheeling is turned off automatically when playback stops.
+   *
+   * @note Freewheel mode belongs to the jack server, not to us, so while freewheeling, every other client on the
+   * server (synths, effects, anything else connected to jack) is also run freewheeling, and nothing reaches the
+   * hardware outputs (or comes in from the hardware inputs) until it ends. Anything which expects to be running
+   * in realtime, such as an external midi device being played along with, will not be in sync during a render.
+   * @param freewheeling True to start freewheeling, false to return to realtime operation
+   */
+  Q_INVOKABLE void setFreewheeling(const bool &freewheeling);
+  Q_SIGNAL void freewheelingChanged();
+
+  /**
+   * \brief How accurately the timer thread has been woken up for its ticks since the last time this was called
+   *
+   * The returned map contains the number of ticks measured (ticks), the average distance from the
+   * deadline (averageJitterMicroseconds), the furthest past (worstLatenessMicroseconds) and before
+   * (worstEarlinessMicroseconds) a deadline it has woken up, the number of ticks skipped because the thread
+   * fell an entire tick or more behind (missedDeadlines), and how early the thread currently asks to be woken up to
+   * make up for the scheduler's wakeup latency (wakeupCompensationMicroseconds).
+   * @return A map of the jitter statistics (all times in microseconds)
+   */
+  Q_INVOKABLE QVariantMap timerJitterStatistics() const;
+
   /**
    * \brief Emitted when a GuiMessageOperation is found in the schedule
    */
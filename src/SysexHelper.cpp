@@ -285,18 +285,16 @@ void SysexHelper::process(void* outputBuffer) const
 void SysexHelper::handleInputEvent(const jack_midi_event_t& currentInputEvent) const
 {
     // qDebug() << Q_FUNC_INFO << "Received input event, writing to ring";
-    juce::MidiBuffer midiBuffer;
-    midiBuffer.addEvent(currentInputEvent.buffer, currentInputEvent.size, 0);
-    d->incomingEvents.write(midiBuffer);
+    d->incomingEvents.write(currentInputEvent.buffer, int(currentInputEvent.size));
 }
 
 void SysexHelper::handlePostponedEvents()
 {
     // FIXME Handle chunked inputs (basically, we will need to have instructions from SysexMessage whether it is complete, or we need to keep reading into the same message... and then also have a way to abort the ongoing read... and a way to inform MidiRouterDevice that we are reading sysex... so, ongoingSysexRead field in the protected area for that?)
     // Convert the various incoming events into SysexMessage objects, and announce their existence to anybody who cares
-    while (d->incomingEvents.readHead->processed == false) {
+    while (const MidiRingEntry *entry = d->incomingEvents.peek()) {
         // qDebug() << Q_FUNC_INFO << "Unprocessed input event found, handling...";
-        const juce::MidiBuffer &midiBuffer{d->incomingEvents.readHead->buffer};
+        const juce::MidiBuffer &midiBuffer{entry->buffer};
         for (const juce::MidiMessageMetadata &message : midiBuffer) {
             if (message.numBytes > 3 && message.data[0] == 0xF0 && message.data[message.numBytes - 1] == 0xF7) {
                 // Super-double-checkery to ensure this is, in fact, a SysEx message
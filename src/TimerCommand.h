@@ -3,6 +3,7 @@
 #include <QVariant>
 #include <QDebug>
 
+#include "LockFreeRing.h"
 #include "SyncTimer.h"
 
 /**
@@ -25,7 +26,7 @@ struct alignas(64) TimerCommand {
         AutomationOperation = 11, ///@< Set the value of a given parameter on a given engine on a given channel to a given value. parameter contains the channel (-1 is global fx engines, 0 through 9 being zl channels), parameter2 contains the engine index, parameter3 is the parameter's index, parameter4 is the value
         PassthroughClientOperation = 12, ///@< Set the volume of the given volume channel to the given value. parameter is the channel (-1 is global playback, 0 through 9 being zl channels), parameter2 is the setting index in the list (dry, wetfx1, wetfx2, pan, muted), parameter3 being the left value, parameter4 being right value. If parameter2 is pan or muted, parameter4 is ignored. For volumes, parameter3 and parameter4 can be 0 through 100. For pan, -100 for all left through 100 for all right, with 0 being no pan. For muted, 0 is not muted, any other value is muted.
         GuiMessageOperation = 13, ///@< Emits a signal on SyncTimer (timerMessage) which must be consumed by the UI in a queued manner. Set variantParameter to the message you wish to pass to the UI. You can also pass parameter, parameter2 and so on, but there is no guarantees made how these are interpreted by the UI (so you'll have to do your own filtering)
-        ChannelRecorderStartOperation = 20, ///@< Start recording a channel. Make sure you have set up the channel recorder before scheduling this command (see AudioLevels::setChannelToRecord and AudioLevels::setChannelFilenamePrefix). Alternatively, set parameter to 1, parameter2 to the sketchpadTrack to begin recording, and variantParameter to the full recording filename)
+        ChannelRecorderStartOperation = 20, ///@< Start recording a channel. Make sure you have set up the channel recorder before scheduling this command (see AudioLevels::setChannelToRecord and AudioLevels::setChannelFilenamePrefix). Alternatively, set parameter to 1, parameter2 to the sketchpadTrack to begin recording, and variantParameter to the full recording filename. In either case, bigParameter holds the identifier of the armed recordings to start, see AudioLevels::armRecordingForCommand)
         ChannelRecorderStopOperation = 21, ///@< Stop recording a channel (optionally set parameter to 1, and parameter 2 to the sketchpadTrack to stop recording)
         MidiRecorderStartOperation = 30, ///@< Start recording a midi channel. parameter is the sketchpad track to record (-1 for global channel, 0 through 9 for sketchpad tracks)
         MidiRecorderStopOperation = 31, ///@< Stop any ongoing midi recordings
@@ -72,49 +73,52 @@ struct alignas(64) TimerCommand {
 };
 
 #define TimerCommandRingSize 4096
-class TimerCommandRing {
+struct TimerCommandRingEntry {
+    TimerCommand *timerCommand{nullptr};
+    quint64 timestamp{0};
+};
+/**
+ * \brief A ring for passing timer commands between threads (see LockFreeRing)
+ * This may be written to from any number of threads, but only read from one
+ */
+class TimerCommandRing : public LockFreeRing<TimerCommandRingEntry, TimerCommandRingSize, LockFreeRingWriters::MultipleWriters> {
 public:
-    struct Entry {
-        Entry *next{nullptr};
-        Entry *previous{nullptr};
-        TimerCommand *timerCommand{nullptr};
-        quint64 timestamp;
-        bool processed{true};
-    };
-    explicit TimerCommandRing() {
-        Entry* entryPrevious{&ringData[TimerCommandRingSize - 1]};
-        for (quint64 i = 0; i < TimerCommandRingSize; ++i) {
-            entryPrevious->next = &ringData[i];
-            ringData[i].previous = entryPrevious;
-            entryPrevious = &ringData[i];
-        }
-        readHead = writeHead = ringData;
-    }
+    explicit TimerCommandRing()
+        : LockFreeRing("TimerCommandRing")
+    {}
     ~TimerCommandRing() {
     }
 
-    void write(TimerCommand *command, quint64 timestamp) {
-        if (writeHead->processed == false) {
-            qWarning() << Q_FUNC_INFO << "There is unprocessed data at the write location:" << writeHead->timerCommand << "This likely means the buffer size is too small, which will require attention at the api level.";
-        }
-        writeHead->timerCommand = command;
-        writeHead->timestamp = timestamp;
-        writeHead->processed = false;
-        writeHead = writeHead->next;
+    using LockFreeRing::write;
+    /**
+     * \brief Write the timer command into the ring
+     * @param command The timer command to write
+     * @param timestamp The timestamp to pass along with the command
+     * @return True if the command was written, or false if the ring was full (in which case the caller still owns the command)
+     */
+    bool write(TimerCommand *command, quint64 timestamp) {
+        return write([command, timestamp](TimerCommandRingEntry &entry) {
+            entry.timerCommand = command;
+            entry.timestamp = timestamp;
+        });
     }
+    using LockFreeRing::read;
+    /**
+     * \brief Read the oldest unread timer command out of the ring
+     * @param timestamp If given, this will be set to the timestamp the command was written with
+     * @return The timer command, or nullptr if there was nothing to read
+     */
     TimerCommand *read(quint64 *timestamp = nullptr) {
-        if (timestamp) {
-            *timestamp = readHead->timestamp;
+        TimerCommand *command{nullptr};
+        TimerCommandRingEntry *entry{peek()};
+        if (entry) {
+            if (timestamp) {
+                *timestamp = entry->timestamp;
+            }
+            command = entry->timerCommand;
+            entry->timerCommand = nullptr;
+            markAsRead();
         }
-        TimerCommand *command = readHead->timerCommand;
-        readHead->processed = true;
-        readHead->timerCommand = nullptr;
-        readHead = readHead->next;
         return command;
     }
-
-    Entry *readHead{nullptr};
-    Entry *writeHead{nullptr};
-private:
-    Entry ringData[TimerCommandRingSize];
 };